@@ -0,0 +1,183 @@
+#include "AllocatorBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "JsonWriter.h"
+#include "OffsetAllocator.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using uint32 = std::uint32_t;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct SizeDistribution
+	{
+		const char* Name;
+		uint32 Capacity;
+		uint32 MaxSize;
+
+		// One allocation in this many may be up to MaxLargeSize instead.
+		uint32 LargeEvery;
+		uint32 MaxLargeSize;
+	};
+
+	// Picks the next call: allocations twice as often as frees, so the allocator fills
+	// up and then runs near full with a fragmented free list.
+	class Sequence
+	{
+	public:
+		Sequence(const SizeDistribution& distribution, uint32 seed) : _distribution(distribution), _random(seed) {}
+
+		bool NextIsAllocate(size_t liveCount) { return liveCount == 0 or _random() % 3 != 0; }
+
+		uint32 NextSize() {
+			bool isLarge = _random() % _distribution.LargeEvery == 0;
+			return 1 + _random() % (isLarge ? _distribution.MaxLargeSize : _distribution.MaxSize);
+		}
+
+		size_t NextVictim(size_t liveCount) { return _random() % liveCount; }
+
+	private:
+		const SizeDistribution& _distribution;
+		std::mt19937 _random;
+	};
+
+	// Allocated intervals by offset.
+	using Reference = std::map<uint32, uint32>;
+
+	bool Overlaps(const Reference& reference, uint32 offset, uint32 size) {
+		auto next = reference.lower_bound(offset);
+		if (next != reference.end() and next->first < offset + size) return true;
+		if (next == reference.begin()) return false;
+		auto previous = std::prev(next);
+		return previous->first + previous->second > offset;
+	}
+
+	uint32 ReferenceLargestGap(const Reference& reference, uint32 capacity) {
+		uint32 largest = 0;
+		uint32 end = 0;
+		for (auto [offset, size] : reference) {
+			largest = std::max(largest, offset - end);
+			end = offset + size;
+		}
+		return std::max(largest, capacity - end);
+	}
+}
+
+bool RunAllocatorBenchmark(const AllocatorBenchmarkOptions& options, JsonWriter& json) {
+	const SizeDistribution distributions[] = {
+		{ "small", 1u << 20, 64, 1000, 64 },
+		{ "mixed", 1u << 20, 500, 10, 20000 },
+		{ "large", 1u << 26, 1u << 12, 4, 1u << 20 },
+	};
+	const uint32 Seed{ 1234u };
+
+	// Full consistency checks walk the whole reference, so they only run this often.
+	const int CheckInterval{ 1000 };
+
+	bool isPassing = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "allocator");
+	json.Member("operations", options.Operations);
+	json.Key("results");
+	json.BeginArray();
+
+	for (const SizeDistribution& distribution : distributions) {
+		OffsetAllocator allocator(distribution.Capacity);
+		Reference reference;
+		std::vector<OffsetAllocator::Allocation> live;
+		Sequence sequence(distribution, Seed);
+		uint64_t usedSize = 0;
+		int failedAllocations = 0;
+		bool isMatch = true;
+
+		for (int i = 0; i < options.Operations; ++i) {
+			if (sequence.NextIsAllocate(live.size())) {
+				uint32 size = sequence.NextSize();
+				OffsetAllocator::Allocation allocation = allocator.Allocate(size);
+				if (not allocation.IsValid()) {
+					failedAllocations++;
+					continue;
+				}
+
+				isMatch = isMatch and allocator.AllocationSize(allocation) == size
+					and allocation.Offset + (uint64_t)size <= distribution.Capacity
+					and not Overlaps(reference, allocation.Offset, size);
+				reference[allocation.Offset] = size;
+				usedSize += size;
+				live.push_back(allocation);
+			}
+			else {
+				size_t victim = sequence.NextVictim(live.size());
+				usedSize -= reference[live[victim].Offset];
+				reference.erase(live[victim].Offset);
+				allocator.Free(live[victim]);
+				live[victim] = live.back();
+				live.pop_back();
+			}
+
+			isMatch = isMatch and allocator.FreeSize() == distribution.Capacity - usedSize;
+			if (i % CheckInterval == 0)
+				isMatch = isMatch and allocator.LargestFreeRange() == ReferenceLargestGap(reference, distribution.Capacity);
+		}
+
+		uint32 liveCount = (uint32)live.size();
+		for (OffsetAllocator::Allocation allocation : live)
+			allocator.Free(allocation);
+
+		// Everything merged back: the whole capacity is one free range again.
+		bool isMerged = allocator.FreeSize() == distribution.Capacity
+			and allocator.LargestFreeRange() == distribution.Capacity;
+		OffsetAllocator::Allocation whole = allocator.Allocate(distribution.Capacity);
+		isMerged = isMerged and whole.IsValid() and whole.Offset == 0;
+
+		// The same calls without the reference.
+		OffsetAllocator timedAllocator(distribution.Capacity);
+		Sequence timedSequence(distribution, Seed);
+		live.clear();
+		auto start = Clock::now();
+		for (int i = 0; i < options.Operations; ++i) {
+			if (timedSequence.NextIsAllocate(live.size())) {
+				OffsetAllocator::Allocation allocation = timedAllocator.Allocate(timedSequence.NextSize());
+				if (allocation.IsValid()) live.push_back(allocation);
+			}
+			else {
+				size_t victim = timedSequence.NextVictim(live.size());
+				timedAllocator.Free(live[victim]);
+				live[victim] = live.back();
+				live.pop_back();
+			}
+		}
+		double operationsMs = MillisecondsSince(start);
+
+		isPassing = isPassing and isMatch and isMerged;
+
+		json.BeginObject();
+		json.Member("distribution", distribution.Name);
+		json.Member("capacity", distribution.Capacity);
+		json.Member("failedAllocations", failedAllocations);
+		json.Member("liveAllocationsAtEnd", liveCount);
+		json.Member("nsPerOperation", operationsMs * 1e6 / options.Operations);
+		json.Member("mopsPerSecond", options.Operations / (operationsMs * 1e3));
+		json.Member("match", isMatch);
+		json.Member("merged", isMerged);
+		json.EndObject();
+	}
+
+	json.EndArray();
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+class JsonWriter;
+
+struct AllocatorBenchmarkOptions
+{
+	// Allocate or Free calls per size distribution.
+	int Operations{ 1000000 };
+};
+
+// Runs seeded random Allocate / Free sequences through OffsetAllocator for a few size
+// distributions, checked against a reference set of allocated intervals: allocations
+// never overlap or leave the capacity, FreeSize and LargestFreeRange match the
+// reference, and freeing everything merges back into one range of the full capacity.
+// The same sequences are then timed without the reference. Returns false on any
+// mismatch.
+bool RunAllocatorBenchmark(const AllocatorBenchmarkOptions& options, JsonWriter& json);
@@ -0,0 +1,194 @@
+#include "BvhBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "JsonWriter.h"
+#include "SceneBvh.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Items spread over a square area at constant density with a little height, the
+	// way a large outdoor level is laid out.
+	struct Scene
+	{
+		std::vector<BoundingBox> Boxes;
+		float HalfSize{};
+	};
+
+	Scene MakeScene(int itemCount, std::mt19937& random) {
+		Scene scene;
+		scene.HalfSize = 2.0f * std::sqrt((float)itemCount);
+
+		std::uniform_real_distribution<float> position(-scene.HalfSize, scene.HalfSize);
+		std::uniform_real_distribution<float> height(0.0f, 20.0f);
+		std::uniform_real_distribution<float> extent(0.25f, 2.0f);
+
+		scene.Boxes.resize(itemCount);
+		for (auto& box : scene.Boxes) {
+			box.Center = { position(random), height(random), position(random) };
+			box.Extents = { extent(random), extent(random), extent(random) };
+		}
+		return scene;
+	}
+
+	// A camera at the edge of the scene slowly turning towards its middle.
+	XMFLOAT4X4 ViewProjection(const Scene& scene, int frame) {
+		float angle = 0.25f * XM_PI + 0.01f * frame;
+		XMVECTOR eye = XMVectorSet(-scene.HalfSize, 30.0f, -scene.HalfSize, 1.0f);
+		XMVECTOR target = XMVectorSet(std::cos(angle) * scene.HalfSize, 0.0f, std::sin(angle) * scene.HalfSize, 1.0f) + eye;
+		XMMATRIX view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, scene.HalfSize);
+
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, projection));
+		return viewProj;
+	}
+
+	std::vector<SceneBvh::Ray> MakeRays(const Scene& scene, int count, std::mt19937& random) {
+		std::uniform_real_distribution<float> position(-scene.HalfSize, scene.HalfSize);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		std::vector<SceneBvh::Ray> rays(count);
+		for (auto& ray : rays) {
+			ray.Origin = { position(random), 10.0f, position(random) };
+			XMStoreFloat3(&ray.Direction, XMVector3Normalize(XMVectorSet(unit(random), 0.2f * unit(random), unit(random), 0.0f)));
+		}
+		return rays;
+	}
+}
+
+bool RunBvhSweep(const BvhBenchmarkOptions& options, JsonWriter& json) {
+	JobSystem& jobSystem = JobSystem::Default();
+	bool isPassing = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "bvh");
+	json.Member("hardwareThreads", std::max(1u, std::thread::hardware_concurrency()));
+	json.Member("frames", options.Frames);
+	json.Member("movingFraction", options.MovingFraction);
+	json.Member("rays", options.RayCount);
+	json.Key("results");
+	json.BeginArray();
+
+	for (int itemCount : options.ItemCounts) {
+		std::mt19937 random(12345u);
+		Scene scene = MakeScene(itemCount, random);
+		std::vector<SceneBvh::Ray> rays = MakeRays(scene, options.RayCount, random);
+
+		auto start = Clock::now();
+		SceneBvh bvh;
+		bvh.Build(scene.Boxes, jobSystem);
+		double sahBuildMs = MillisecondsSince(start);
+		float builtSahCost = bvh.SahCost();
+
+		start = Clock::now();
+		SceneBvh insertedBvh;
+		for (int i = 0; i < itemCount; ++i)
+			insertedBvh.Insert((std::uint32_t)i, scene.Boxes[i]);
+		double insertBuildMs = MillisecondsSince(start);
+		float insertedSahCost = insertedBvh.SahCost();
+
+		FrustumCuller culler;
+		culler.Resize((std::uint32_t)itemCount);
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		for (int i = 0; i < itemCount; ++i)
+			culler.SetBounds((std::uint32_t)i, scene.Boxes[i], identity);
+
+		std::uniform_int_distribution<int> pickItem(0, itemCount - 1);
+		std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+		int movingCount = (int)(options.MovingFraction * itemCount);
+
+		std::vector<std::uint32_t> moved;
+		std::vector<std::uint32_t> bvhVisible;
+		std::vector<std::uint32_t> linearVisible;
+		std::vector<SceneBvh::RayHit> hits(rays.size());
+		double refitMs = 0.0;
+		double bvhQueryMs = 0.0;
+		double linearCullMs = 0.0;
+		double rayMs = 0.0;
+		double visitedNodes = 0.0;
+		double visibleItems = 0.0;
+		bool isMatch = true;
+
+		for (int frame = 0; frame < options.Frames; ++frame) {
+			// Moving items are refit in both structures, as an app does for the items
+			// whose World changed.
+			moved.clear();
+			for (int k = 0; k < movingCount; ++k)
+				moved.push_back((std::uint32_t)pickItem(random));
+
+			start = Clock::now();
+			for (std::uint32_t i : moved) {
+				BoundingBox& box = scene.Boxes[i];
+				box.Center.x += step(random);
+				box.Center.z += step(random);
+				bvh.Update(i, box);
+			}
+			refitMs += MillisecondsSince(start);
+
+			for (std::uint32_t i : moved)
+				culler.SetBounds(i, scene.Boxes[i], identity);
+
+			XMFLOAT4X4 viewProj = ViewProjection(scene, frame);
+
+			start = Clock::now();
+			SceneBvh::QueryStatistics statistics = bvh.QueryFrustum(viewProj, bvhVisible);
+			bvhQueryMs += MillisecondsSince(start);
+			visitedNodes += statistics.VisitedNodeCount;
+			visibleItems += statistics.ItemCount;
+
+			culler.Cull(viewProj, linearVisible, jobSystem);
+			linearCullMs += culler.LastStatistics().CullMilliseconds;
+
+			start = Clock::now();
+			bvh.RayCast(rays, hits, jobSystem);
+			rayMs += MillisecondsSince(start);
+
+			std::sort(bvhVisible.begin(), bvhVisible.end());
+			isMatch = isMatch and bvhVisible == linearVisible;
+		}
+
+		isPassing = isPassing and isMatch;
+		double frames = options.Frames;
+
+		json.BeginObject();
+		json.Member("items", itemCount);
+		json.Member("sahBuildMs", sahBuildMs);
+		json.Member("sahCost", (double)builtSahCost);
+		json.Member("insertBuildMs", insertBuildMs);
+		json.Member("insertSahCost", (double)insertedSahCost);
+		json.Member("refitMsPerFrame", refitMs / frames);
+		json.Member("sahCostAfterMoves", (double)bvh.SahCost());
+		json.Member("visibleFraction", visibleItems / (frames * itemCount));
+		json.Member("visitedNodesPerQuery", visitedNodes / frames);
+		json.Member("bvhQueryMs", bvhQueryMs / frames);
+		json.Member("linearCullMs", linearCullMs / frames);
+		json.Member("mraysPerSecond", frames * rays.size() / (rayMs * 1e3));
+		json.Member("match", isMatch);
+		json.EndObject();
+	}
+
+	json.EndArray();
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
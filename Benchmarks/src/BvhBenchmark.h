@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+class JsonWriter;
+
+struct BvhBenchmarkOptions
+{
+	std::vector<int> ItemCounts{ 10000, 100000, 1000000 };
+	int Frames{ 50 };
+
+	// Share of the items moved a little every frame, and rays cast per frame.
+	double MovingFraction{ 0.01 };
+	int RayCount{ 4096 };
+};
+
+// Builds SceneBvh trees over random scenes of every item count and times the SAH and
+// incremental builds, per frame refits, frustum queries against the linear
+// FrustumCuller, and ray casts. Returns false if the BVH and the linear culler ever
+// disagree on the visible items.
+bool RunBvhSweep(const BvhBenchmarkOptions& options, JsonWriter& json);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// FNV-1a over the bytes of the data.
+class Checksum
+{
+public:
+	void Add(const void* pData, size_t byteSize) {
+		auto pBytes = static_cast<const std::uint8_t*>(pData);
+		for (size_t i = 0; i < byteSize; ++i) {
+			_hash ^= pBytes[i];
+			_hash *= 0x100000001b3ull;
+		}
+	}
+
+	std::uint64_t Value() const { return _hash; }
+
+	static std::string ToHex(std::uint64_t value) {
+		char text[19];
+		std::snprintf(text, sizeof(text), "0x%016llx", (unsigned long long)value);
+		return text;
+	}
+
+private:
+	std::uint64_t _hash{ 0xcbf29ce484222325ull };
+};
@@ -0,0 +1,162 @@
+#include "DrawBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <span>
+
+#include "DrawQueue.h"
+#include "JsonWriter.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Stands in for a command list; counts the calls DrawQueue::Submit makes.
+	struct CountingCommandList
+	{
+		std::uint32_t PipelineStateCalls{};
+		std::uint32_t GeometryCalls{};
+		std::uint32_t TopologyCalls{};
+		std::uint32_t DrawCalls{};
+		std::uint32_t Instances{};
+
+		void SetPipelineState(const DrawPacket&) { PipelineStateCalls++; }
+		void SetGeometry(const DrawPacket&) { GeometryCalls++; }
+		void SetPrimitiveTopology(const DrawPacket&) { TopologyCalls++; }
+		void Draw(std::span<const DrawPacket> packets) {
+			DrawCalls++;
+			Instances += (std::uint32_t)packets.size();
+		}
+
+		std::uint32_t StateCalls() const { return PipelineStateCalls + GeometryCalls + TopologyCalls; }
+	};
+
+	bool Matches(const CountingCommandList& commandList, const DrawQueue::Statistics& statistics) {
+		return commandList.PipelineStateCalls == statistics.PipelineStateChanges
+			and commandList.GeometryCalls == statistics.GeometryChanges
+			and commandList.TopologyCalls == statistics.TopologyChanges
+			and commandList.DrawCalls == statistics.DrawCount
+			and commandList.Instances == statistics.PacketCount
+			and statistics.StateChanges() + statistics.SavedStateChanges == 3 * statistics.PacketCount;
+	}
+}
+
+bool RunDrawSweep(const DrawBenchmarkOptions& options, JsonWriter& json) {
+	bool isPassing = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "draws");
+	json.Member("frames", options.Frames);
+	json.Member("pipelineStates", options.PipelineStateCount);
+	json.Member("geometries", options.GeometryCount);
+	json.Member("topologies", options.TopologyCount);
+	json.Member("meshes", options.MeshCount);
+	json.Key("results");
+	json.BeginArray();
+
+	for (int packetCount : options.PacketCounts) {
+		std::mt19937 random(777u);
+		std::uniform_int_distribution<std::uint32_t> pipelineState(0, options.PipelineStateCount - 1);
+		std::uniform_int_distribution<std::uint32_t> geometry(0, options.GeometryCount - 1);
+		std::uniform_int_distribution<std::uint32_t> topology(0, options.TopologyCount - 1);
+		std::uniform_int_distribution<std::uint32_t> mesh(0, options.MeshCount - 1);
+		std::uniform_real_distribution<float> depth(1.0f, 1000.0f);
+
+		DrawQueue queue;
+		std::vector<DrawPacket> reference;
+		double radixSortMs = 0.0;
+		double stableSortMs = 0.0;
+		double submitMs = 0.0;
+		bool isMatch = true;
+		DrawQueue::Statistics sorted;
+		CountingCommandList unsortedList;
+
+		for (int frame = 0; frame < options.Frames; ++frame) {
+			queue.Clear();
+			for (int i = 0; i < packetCount; ++i)
+				queue.Add(DrawQueue::MakeKey(pipelineState(random), geometry(random), topology(random), mesh(random), depth(random)), (std::uint32_t)i);
+
+			// The order the items were added in only elides repeats by chance.
+			if (frame == 0) {
+				DrawQueue::Statistics unsorted = queue.Submit(unsortedList);
+				isMatch = isMatch and Matches(unsortedList, unsorted);
+			}
+
+			reference.assign(queue.Packets().begin(), queue.Packets().end());
+			auto start = Clock::now();
+			std::stable_sort(reference.begin(), reference.end(), [](const DrawPacket& a, const DrawPacket& b) {
+				return a.SortKey < b.SortKey;
+			});
+			stableSortMs += MillisecondsSince(start);
+
+			start = Clock::now();
+			queue.Sort();
+			radixSortMs += MillisecondsSince(start);
+
+			isMatch = isMatch and std::equal(reference.begin(), reference.end(), queue.Packets().begin(), queue.Packets().end(),
+				[](const DrawPacket& a, const DrawPacket& b) { return a.SortKey == b.SortKey and a.Item == b.Item; });
+
+			CountingCommandList sortedList;
+			start = Clock::now();
+			sorted = queue.Submit(sortedList);
+			submitMs += MillisecondsSince(start);
+			isMatch = isMatch and Matches(sortedList, sorted);
+		}
+
+		isPassing = isPassing and isMatch;
+		double frames = options.Frames;
+
+		json.BeginObject();
+		json.Member("packets", packetCount);
+		json.Member("radixSortMs", radixSortMs / frames);
+		json.Member("stableSortMs", stableSortMs / frames);
+		json.Member("submitMs", submitMs / frames);
+		json.Member("naiveStateChanges", 3 * sorted.PacketCount);
+		json.Member("unsortedStateChanges", unsortedList.StateCalls());
+		json.Member("sortedStateChanges", sorted.StateChanges());
+		json.Member("savedStateChanges", sorted.SavedStateChanges);
+		json.Member("unsortedDrawCalls", unsortedList.DrawCalls);
+		json.Member("sortedDrawCalls", sorted.DrawCount);
+		json.Member("match", isMatch);
+		json.EndObject();
+	}
+
+	json.EndArray();
+
+	// A scene like ShapesApp's: 22 items of 4 meshes sharing one state, so Submit merges
+	// runs and draws fewer times than it has packets.
+	const std::uint32_t meshItemCounts[] = { 1, 1, 10, 10 };
+	DrawQueue mergedQueue;
+	for (std::uint32_t mesh = 0, item = 0; mesh < std::size(meshItemCounts); ++mesh) {
+		for (std::uint32_t i = 0; i < meshItemCounts[mesh]; ++i, ++item)
+			mergedQueue.Add(DrawQueue::MakeKey(0, 0, 0, mesh, (float)i), item);
+	}
+	mergedQueue.Sort();
+
+	CountingCommandList mergedList;
+	DrawQueue::Statistics merged = mergedQueue.Submit(mergedList);
+	bool isMergedMatch = Matches(mergedList, merged) and merged.DrawCount == std::size(meshItemCounts)
+		and merged.DrawCount < merged.PacketCount;
+	isPassing = isPassing and isMergedMatch;
+
+	json.Key("mergedRuns");
+	json.BeginObject();
+	json.Member("packets", merged.PacketCount);
+	json.Member("drawCalls", merged.DrawCount);
+	json.Member("stateChanges", merged.StateChanges());
+	json.Member("savedStateChanges", merged.SavedStateChanges);
+	json.Member("match", isMergedMatch);
+	json.EndObject();
+
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+class JsonWriter;
+
+struct DrawBenchmarkOptions
+{
+	std::vector<int> PacketCounts{ 1000, 10000, 100000, 1000000 };
+	int Frames{ 50 };
+
+	// Distinct states the random draws pick from.
+	int PipelineStateCount{ 4 };
+	int GeometryCount{ 64 };
+	int TopologyCount{ 2 };
+	int MeshCount{ 16 };
+};
+
+// Fills a DrawQueue with random draws for every packet count and times its radix sort
+// against std::stable_sort. The sorted and unsorted queues are submitted to a command
+// counting list, which reports the state changes and draw calls sorting saves.
+// Returns false if the sorts disagree or the list's counts differ from the queue's
+// statistics.
+bool RunDrawSweep(const DrawBenchmarkOptions& options, JsonWriter& json);
@@ -0,0 +1,188 @@
+#include "IndexPackingBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "IndexPacking.h"
+#include "JsonWriter.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using IndexPacking::uint16;
+	using IndexPacking::uint32;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Written around the destination to catch stores past either end.
+	const uint16 Guard{ 0xA5A5 };
+	const size_t GuardCount{ 16 };
+
+	// Indices in [baseVertex, baseVertex + MaxIndex16], half of them at the edges of the
+	// range and around the sign flip of the signed pack.
+	std::vector<uint32> MakeIndices(size_t count, uint32 baseVertex, std::mt19937& random) {
+		const uint32 edges[] = { 0, 1, 0x7FFE, 0x7FFF, 0x8000, 0x8001, 0xFFFE, 0xFFFF };
+		std::uniform_int_distribution<uint32> offset(0, IndexPacking::MaxIndex16);
+		std::uniform_int_distribution<size_t> edge(0, std::size(edges) - 1);
+
+		std::vector<uint32> indices(count);
+		for (uint32& index : indices)
+			index = baseVertex + (random() % 2 == 0 ? edges[edge(random)] : offset(random));
+		return indices;
+	}
+
+	// Narrows into the middle of a guarded buffer, one element off 16 byte alignment,
+	// and compares with the scalar conversion.
+	bool NarrowMatchesScalar(std::span<const uint32> indices, uint32 baseVertex) {
+		std::vector<uint16> buffer(indices.size() + 2 * GuardCount + 1, Guard);
+		uint16* pDestination = buffer.data() + GuardCount + 1;
+		IndexPacking::Narrow(indices, pDestination, baseVertex);
+
+		for (size_t i = 0; i < buffer.size(); ++i) {
+			bool isDestination = i >= GuardCount + 1 and i < GuardCount + 1 + indices.size();
+			uint16 expected = isDestination ? (uint16)(indices[i - GuardCount - 1] - baseVertex) : Guard;
+			if (buffer[i] != expected)
+				return false;
+		}
+		return true;
+	}
+
+	struct TestMesh
+	{
+		std::string Name;
+		std::function<GeometryGenerator::MeshData(GeometryGenerator&)> Create;
+	};
+
+	// The ranges cover the index list in order, and each range's 16-bit indices plus its
+	// base vertex give back its triangles.
+	bool SplitRebuildsTriangles(std::span<const uint32> indices, std::span<const IndexPacking::IndexRange> ranges) {
+		std::vector<uint16> narrowed(indices.size());
+		uint32 next = 0;
+		for (const IndexPacking::IndexRange& range : ranges) {
+			if (range.StartIndex != next or range.IndexCount == 0 or range.IndexCount % 3 != 0
+				or (size_t)range.StartIndex + range.IndexCount > indices.size())
+				return false;
+
+			std::span<const uint32> rangeIndices = indices.subspan(range.StartIndex, range.IndexCount);
+			auto [minimum, maximum] = std::minmax_element(rangeIndices.begin(), rangeIndices.end());
+			if (*minimum < range.BaseVertex or *maximum - range.BaseVertex > IndexPacking::MaxIndex16)
+				return false;
+
+			IndexPacking::Narrow(rangeIndices, &narrowed[range.StartIndex], range.BaseVertex);
+			next += range.IndexCount;
+		}
+		if (next != indices.size())
+			return false;
+
+		size_t i = 0;
+		for (const IndexPacking::IndexRange& range : ranges) {
+			for (uint32 k = 0; k < range.IndexCount; ++k, ++i) {
+				if (range.BaseVertex + narrowed[i] != indices[i])
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool RunIndexPackingBenchmark(const IndexPackingBenchmarkOptions& options, JsonWriter& json) {
+	const uint32 baseVertices[] = { 0, 1, 0x8000, 0x12345, 0xFFFF0000u };
+	const size_t MaxTailLength{ 67 };
+	const size_t LargeLength{ 1 << 20 };
+
+	std::mt19937 random(31337u);
+	bool isPassing = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "indices");
+	json.Member("frames", options.Frames);
+	json.Key("narrow");
+	json.BeginArray();
+
+	for (uint32 baseVertex : baseVertices) {
+		bool isMatch = true;
+		for (size_t length = 0; length <= MaxTailLength; ++length) {
+			for (int repeat = 0; repeat < 4; ++repeat)
+				isMatch = isMatch and NarrowMatchesScalar(MakeIndices(length, baseVertex, random), baseVertex);
+		}
+
+		std::vector<uint32> large = MakeIndices(LargeLength, baseVertex, random);
+		isMatch = isMatch and NarrowMatchesScalar(large, baseVertex)
+			and IndexPacking::MaxIndex(large) == *std::max_element(large.begin(), large.end());
+
+		std::vector<uint16> narrowed(large.size());
+		auto start = Clock::now();
+		for (int frame = 0; frame < options.Frames; ++frame)
+			IndexPacking::Narrow(large, narrowed.data(), baseVertex);
+		double narrowMs = MillisecondsSince(start) / options.Frames;
+
+		isPassing = isPassing and isMatch;
+
+		json.BeginObject();
+		json.Member("baseVertex", baseVertex);
+		json.Member("narrowMs", narrowMs);
+		json.Member("narrowGBPerSecond", large.size() * sizeof(uint32) / (narrowMs * 1e6));
+		json.Member("match", isMatch);
+		json.EndObject();
+	}
+
+	json.EndArray();
+
+	const TestMesh meshes[] = {
+		{ "grid400", [](GeometryGenerator& g) { return g.CreateGrid(400.0f, 400.0f, 400, 400); } },
+		{ "sphere", [](GeometryGenerator& g) {
+			GeometryGenerator::MeshData mesh = g.CreateSphere(1.0f, 400, 400);
+			MeshOptimizer::Optimize(mesh);
+			return mesh;
+		} },
+	};
+
+	GeometryGenerator generator;
+
+	json.Key("split");
+	json.BeginArray();
+
+	for (const TestMesh& testMesh : meshes) {
+		const GeometryGenerator::MeshData mesh = testMesh.Create(generator);
+
+		std::vector<IndexPacking::IndexRange> ranges;
+		auto start = Clock::now();
+		for (int frame = 0; frame < options.Frames; ++frame)
+			ranges = IndexPacking::SplitFor16BitIndices(mesh.Indices32);
+		double splitMs = MillisecondsSince(start) / options.Frames;
+
+		bool isMatch = mesh.Vertices.size() > IndexPacking::MaxIndex16 + 1 and ranges.size() > 1
+			and SplitRebuildsTriangles(mesh.Indices32, ranges);
+		isPassing = isPassing and isMatch;
+
+		json.BeginObject();
+		json.Member("mesh", testMesh.Name);
+		json.Member("vertices", (unsigned)mesh.Vertices.size());
+		json.Member("triangles", (unsigned)(mesh.Indices32.size() / 3));
+		json.Member("ranges", (unsigned)ranges.size());
+		json.Member("splitMs", splitMs);
+		json.Member("match", isMatch);
+		json.EndObject();
+	}
+
+	json.EndArray();
+
+	// A triangle spanning more than MaxIndex16 + 1 vertices cannot be split.
+	const uint32 unsplittable[] = { 0, 1, 2, 0, 1, IndexPacking::MaxIndex16 + 1 };
+	bool isRejectingWideTriangle = IndexPacking::SplitFor16BitIndices(unsplittable).empty();
+	isPassing = isPassing and isRejectingWideTriangle;
+
+	json.Member("wideTriangleRejected", isRejectingWideTriangle);
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+class JsonWriter;
+
+struct IndexPackingBenchmarkOptions
+{
+	// Timed narrowings and splits per buffer.
+	int Frames{ 50 };
+};
+
+// Checks IndexPacking against plain scalar loops and times it. Narrow runs on every
+// length up to a few vectors, so all tails are covered, with indices around the
+// edges of the 16-bit range above several base vertices, into unaligned destinations
+// guarded against stray writes. SplitFor16BitIndices runs on meshes of more than
+// 65536 vertices; rebuilding every triangle from its range's base vertex and 16-bit
+// indices must give back the input. Returns false on any mismatch.
+bool RunIndexPackingBenchmark(const IndexPackingBenchmarkOptions& options, JsonWriter& json);
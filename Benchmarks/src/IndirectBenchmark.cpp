@@ -0,0 +1,124 @@
+#include "IndirectBenchmark.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Checksum.h"
+#include "IndirectDrawBuilder.h"
+#include "JsonWriter.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	std::vector<IndirectDrawItem> MakeItems(int itemCount, std::mt19937& random) {
+		std::uniform_int_distribution<std::uint32_t> triangleCount(1, 10000);
+		std::uniform_int_distribution<std::uint32_t> startIndex(0, 1u << 24);
+		std::uniform_int_distribution<std::int32_t> baseVertex(-1000, 1 << 20);
+
+		std::vector<IndirectDrawItem> items(itemCount);
+		for (std::uint32_t i = 0; i < items.size(); ++i)
+			items[i] = { 3 * triangleCount(random), startIndex(random), baseVertex(random), i };
+		return items;
+	}
+
+	// The commands the builder must produce, written the obvious way.
+	std::uint32_t BuildReference(std::span<const IndirectDrawItem> items, std::span<const std::uint32_t> visibleItems,
+		std::vector<IndirectDrawCommand>& commands) {
+		std::uint32_t count = 0;
+		for (std::uint32_t i : visibleItems) {
+			const IndirectDrawItem& item = items[i];
+			commands[count++] = { item.RootConstant, { item.IndexCount, 1, item.StartIndexLocation, item.BaseVertexLocation, 0 } };
+		}
+		return count;
+	}
+}
+
+bool RunIndirectBenchmark(const IndirectBenchmarkOptions& options, JsonWriter& json) {
+	Checksum checksum;
+	bool isMatch = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "indirect");
+	json.Member("frames", options.Frames);
+	json.Member("visibleFraction", options.VisibleFraction);
+	json.Key("results");
+	json.BeginArray();
+
+	for (int itemCount : options.ItemCounts) {
+		std::mt19937 random(4242u);
+		std::bernoulli_distribution isVisible(options.VisibleFraction);
+		std::vector<IndirectDrawItem> items = MakeItems(itemCount, random);
+
+		IndirectDrawBuilder builder;
+		std::vector<std::uint32_t> visibleItems;
+		std::vector<std::uint32_t> visibility;
+		std::vector<IndirectDrawCommand> commands(itemCount);
+		std::vector<IndirectDrawCommand> reference(itemCount);
+		double visibilityMs = 0.0;
+		double buildMs = 0.0;
+		double commandCount = 0.0;
+		bool isCountMatch = true;
+
+		for (int frame = 0; frame < options.Frames; ++frame) {
+			visibleItems.clear();
+			for (std::uint32_t i = 0; i < (std::uint32_t)itemCount; ++i) {
+				if (isVisible(random)) visibleItems.push_back(i);
+			}
+
+			auto start = Clock::now();
+			builder.SetVisibleItems((std::uint32_t)itemCount, visibleItems);
+			visibilityMs += MillisecondsSince(start);
+
+			// Bits past the last item are whatever the upload buffer held before.
+			visibility.assign(builder.Visibility().begin(), builder.Visibility().end());
+			if (itemCount % 32 != 0) visibility.back() |= ~0u << (itemCount % 32);
+
+			start = Clock::now();
+			std::uint32_t count = IndirectDrawBuilder::Build(items, visibility, commands);
+			buildMs += MillisecondsSince(start);
+
+			std::uint32_t referenceCount = BuildReference(items, visibleItems, reference);
+			isCountMatch = isCountMatch and count == referenceCount
+				and std::memcmp(commands.data(), reference.data(), count * sizeof(IndirectDrawCommand)) == 0;
+
+			checksum.Add(&count, sizeof(count));
+			checksum.Add(commands.data(), count * sizeof(IndirectDrawCommand));
+			commandCount += count;
+		}
+
+		isMatch = isMatch and isCountMatch;
+		double frames = options.Frames;
+
+		json.BeginObject();
+		json.Member("items", itemCount);
+		json.Member("commandsPerFrame", commandCount / frames);
+		json.Member("visibilityMs", visibilityMs / frames);
+		json.Member("buildMs", buildMs / frames);
+		json.Member("uploadBytesPerFrame", (double)(items.size() * sizeof(IndirectDrawItem)
+			+ IndirectDrawBuilder::VisibilityWordCount((std::uint32_t)itemCount) * sizeof(std::uint32_t)));
+		json.Member("commandBytesPerFrame", commandCount / frames * sizeof(IndirectDrawCommand));
+		json.Member("match", isCountMatch);
+		json.EndObject();
+	}
+
+	json.EndArray();
+
+	bool isChecksumMatch = options.ExpectedChecksum == 0 or options.ExpectedChecksum == checksum.Value();
+	bool isPassing = isMatch and isChecksumMatch;
+
+	json.Member("checksum", Checksum::ToHex(checksum.Value()));
+	if (options.ExpectedChecksum != 0)
+		json.Member("expectedChecksum", Checksum::ToHex(options.ExpectedChecksum));
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class JsonWriter;
+
+struct IndirectBenchmarkOptions
+{
+	std::vector<int> ItemCounts{ 10000, 100000, 1000000 };
+	int Frames{ 50 };
+
+	// Share of the items visible in a frame.
+	double VisibleFraction{ 0.3 };
+
+	// Checksum of the built commands, or 0 to skip the comparison.
+	std::uint64_t ExpectedChecksum{};
+};
+
+// Builds indirect draw commands with IndirectDrawBuilder, the CPU reference of the
+// argument builder shader, from random items and visibility, and compares them with
+// commands written straight from the list of visible items. Returns false if they
+// ever differ or the commands do not match the expected checksum.
+bool RunIndirectBenchmark(const IndirectBenchmarkOptions& options, JsonWriter& json);
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Minimal streaming JSON writer for benchmark reports. Commas and indentation are
+// handled here; callers only have to nest Begin/End calls correctly.
+class JsonWriter
+{
+public:
+	explicit JsonWriter(std::ostream& stream) : _stream(stream) {}
+
+	JsonWriter(const JsonWriter&) = delete;
+	JsonWriter& operator=(const JsonWriter&) = delete;
+
+	void BeginObject() { Open('{'); }
+	void EndObject() { Close('}'); }
+	void BeginArray() { Open('['); }
+	void EndArray() { Close(']'); }
+
+	// Names the next value; only valid inside an object.
+	void Key(std::string_view key) {
+		Separate();
+		WriteString(key);
+		_stream << ": ";
+		_hasKey = true;
+	}
+
+	void Value(std::string_view value) { Separate(); WriteString(value); }
+	void Value(const char* value) { Value(std::string_view(value)); }
+	void Value(bool value) { Separate(); _stream << (value ? "true" : "false"); }
+	void Value(int value) { Separate(); _stream << value; }
+	void Value(unsigned value) { Separate(); _stream << value; }
+	void Value(std::int64_t value) { Separate(); _stream << value; }
+	void Value(std::uint64_t value) { Separate(); _stream << value; }
+	void Value(double value) { Separate(); _stream << value; }
+
+	template<typename T>
+	void Member(std::string_view key, const T& value) {
+		Key(key);
+		Value(value);
+	}
+
+private:
+	void Open(char bracket) {
+		Separate();
+		_stream << bracket;
+		_isFirst.push_back(true);
+	}
+
+	void Close(char bracket) {
+		bool isEmpty = _isFirst.back();
+		_isFirst.pop_back();
+		if (not isEmpty) NewLine();
+		_stream << bracket;
+		if (_isFirst.empty()) _stream << '\n';
+	}
+
+	// Emits the comma and line break that go before a new value or key.
+	void Separate() {
+		if (_hasKey) {
+			_hasKey = false;
+			return;
+		}
+		if (_isFirst.empty()) return;
+
+		if (not _isFirst.back()) _stream << ',';
+		_isFirst.back() = false;
+		NewLine();
+	}
+
+	void NewLine() {
+		_stream << '\n';
+		for (size_t i = 0; i < _isFirst.size(); ++i)
+			_stream << "  ";
+	}
+
+	void WriteString(std::string_view text) {
+		_stream << '"';
+		for (char c : text) {
+			if (c == '"' or c == '\\') _stream << '\\';
+			_stream << c;
+		}
+		_stream << '"';
+	}
+
+private:
+	std::ostream& _stream;
+
+	// One entry per open object or array: true until it gets its first member.
+	std::vector<bool> _isFirst;
+	bool _hasKey{};
+};
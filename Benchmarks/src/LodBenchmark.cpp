@@ -0,0 +1,130 @@
+#include "LodBenchmark.h"
+
+#include <cfloat>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "JsonWriter.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using uint32 = std::uint32_t;
+	using MeshSimplifier::LodLevel;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct TestMesh
+	{
+		std::string Name;
+		std::function<GeometryGenerator::MeshData(GeometryGenerator&)> Create;
+	};
+
+	bool IsDecreasing(std::span<const LodLevel> levels) {
+		for (size_t level = 1; level < levels.size(); ++level) {
+			if (levels[level].IndexCount >= levels[level - 1].IndexCount or levels[level].Error < levels[level - 1].Error)
+				return false;
+		}
+		return true;
+	}
+
+	// Every triangle of the level has three distinct vertices that span some area.
+	bool HasNoDegenerateTriangles(const GeometryGenerator::MeshData& mesh, const LodLevel& level) {
+		if (level.IndexCount % 3 != 0 or (size_t)level.StartIndex + level.IndexCount > mesh.Indices32.size())
+			return false;
+
+		for (uint32 i = level.StartIndex; i < level.StartIndex + level.IndexCount; i += 3) {
+			uint32 i0 = mesh.Indices32[i], i1 = mesh.Indices32[i + 1], i2 = mesh.Indices32[i + 2];
+			if (i0 >= mesh.Vertices.size() or i1 >= mesh.Vertices.size() or i2 >= mesh.Vertices.size()
+				or i0 == i1 or i1 == i2 or i2 == i0)
+				return false;
+
+			XMVECTOR p0 = XMLoadFloat3(&mesh.Vertices[i0].Position);
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&mesh.Vertices[i1].Position), p0),
+				XMVectorSubtract(XMLoadFloat3(&mesh.Vertices[i2].Position), p0));
+			if (XMVectorGetX(XMVector3LengthSq(normal)) <= 0.0f)
+				return false;
+		}
+		return true;
+	}
+}
+
+bool RunLodBenchmark(const LodBenchmarkOptions& options, JsonWriter& json) {
+	const TestMesh meshes[] = {
+		{ "box", [](GeometryGenerator& g) { return g.CreateBox(1.5f, 0.5f, 1.5f, 3); } },
+		{ "sphere", [](GeometryGenerator& g) { return g.CreateSphere(0.5f, 20, 20); } },
+		{ "cylinder", [](GeometryGenerator& g) { return g.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20); } },
+		{ "geosphere4", [](GeometryGenerator& g) { return g.CreateGeosphere(1.0f, 4); } },
+		{ "grid", [](GeometryGenerator& g) { return g.CreateGrid(20.0f, 30.0f, 60, 40); } },
+	};
+	const float maxErrors[] = { FLT_MAX, 0.05f, 0.01f, 0.0f };
+
+	GeometryGenerator generator;
+	bool isPassing = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "lods");
+	json.Member("frames", options.Frames);
+	json.Member("levelCount", options.LevelCount);
+	json.Key("results");
+	json.BeginArray();
+
+	for (const TestMesh& testMesh : meshes) {
+		GeometryGenerator::MeshData source = testMesh.Create(generator);
+		MeshOptimizer::Optimize(source);
+
+		for (float maxError : maxErrors) {
+			GeometryGenerator::MeshData mesh;
+			std::vector<LodLevel> levels;
+			auto start = Clock::now();
+			for (int frame = 0; frame < options.Frames; ++frame) {
+				mesh = source;
+				levels = MeshSimplifier::AppendLodChain(mesh, options.LevelCount, 0.5f, maxError);
+			}
+			double chainMs = MillisecondsSince(start) / options.Frames;
+
+			bool isDecreasing = IsDecreasing(levels);
+			bool isNonDegenerate = true;
+			bool isWithinError = true;
+			for (const LodLevel& level : levels) {
+				isNonDegenerate = isNonDegenerate and HasNoDegenerateTriangles(mesh, level);
+				isWithinError = isWithinError and level.Error <= maxError;
+			}
+			isPassing = isPassing and isDecreasing and isNonDegenerate and isWithinError;
+
+			json.BeginObject();
+			json.Member("mesh", testMesh.Name);
+			if (maxError != FLT_MAX)
+				json.Member("maxError", maxError);
+			json.Key("levels");
+			json.BeginArray();
+			for (const LodLevel& level : levels) {
+				json.BeginObject();
+				json.Member("triangles", level.IndexCount / 3);
+				json.Member("error", level.Error);
+				json.EndObject();
+			}
+			json.EndArray();
+			json.Member("chainMs", chainMs);
+			json.Member("decreasing", isDecreasing);
+			json.Member("noDegenerateTriangles", isNonDegenerate);
+			json.Member("withinMaxError", isWithinError);
+			json.EndObject();
+		}
+	}
+
+	json.EndArray();
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+class JsonWriter;
+
+struct LodBenchmarkOptions
+{
+	// Timed level of detail chains per mesh and error bound.
+	int Frames{ 50 };
+
+	// Levels requested per chain, level 0 included.
+	unsigned LevelCount{ 5 };
+};
+
+// Builds level of detail chains for generated meshes with
+// MeshSimplifier::AppendLodChain, with and without an error bound, and checks every
+// chain: index counts strictly decrease from level to level, the reported error never
+// decreases, no level holds a degenerate triangle or an index past the vertices, and
+// no level's error exceeds the bound the chain was built with. Returns false on any
+// mismatch.
+bool RunLodBenchmark(const LodBenchmarkOptions& options, JsonWriter& json);
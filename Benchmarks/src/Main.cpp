@@ -0,0 +1,218 @@
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "AllocatorBenchmark.h"
+#include "BvhBenchmark.h"
+#include "DrawBenchmark.h"
+#include "IndexPackingBenchmark.h"
+#include "IndirectBenchmark.h"
+#include "JsonWriter.h"
+#include "LodBenchmark.h"
+#include "MeshFileBenchmark.h"
+#include "MeshOptimizerBenchmark.h"
+#include "MeshletBenchmark.h"
+#include "OcclusionBenchmark.h"
+#include "RecordBenchmark.h"
+#include "WavesBenchmark.h"
+
+namespace
+{
+	const char* const Usage =
+		"Usage: Benchmarks [options]\n"
+		"  --grid 128,256,...     grid sizes (rows = columns)\n"
+		"  --threads 1,2,4,...    thread counts, default powers of two up to the hardware threads\n"
+		"  --substeps 1,4         simulation steps per frame\n"
+		"  --frames N             measured frames per configuration\n"
+		"  --warmup N             unmeasured frames per configuration\n"
+		"  --blocking K           temporal blocking with K steps per block\n"
+		"  --sparse               sparse active tile tracking\n"
+		"  --checksum [HEX]       compare all kernels against the scalar solver and,\n"
+		"                         if given, the scalar solver against HEX\n"
+		"  --bvh                  run the scene BVH benchmark instead of the waves one\n"
+		"  --items 10000,...      BVH and indirect benchmark item counts\n"
+		"  --occlusion            run the occlusion culling benchmark; --checksum HEX\n"
+		"                         compares its depth buffers against HEX\n"
+		"  --images DIR           write the occlusion depth buffer images to DIR\n"
+		"  --draws                run the draw packet sorting benchmark\n"
+		"  --packets 1000,...     draw and record benchmark packet counts\n"
+		"  --indirect             run the indirect draw argument builder benchmark;\n"
+		"                         --checksum HEX compares its commands against HEX\n"
+		"  --record               run the parallel command recording benchmark over\n"
+		"                         --threads\n"
+		"  --meshopt              run the mesh optimizer benchmark\n"
+		"  --allocator            check and time the offset allocator\n"
+		"  --meshfile             check the mesh file round trip and that corrupt files\n"
+		"                         are rejected\n"
+		"  --meshlets             check and time the meshlet builder\n"
+		"  --lods                 check and time the level of detail chains\n"
+		"  --indices              check and time index narrowing and 16-bit splitting\n"
+		"  --out FILE             write the JSON report to FILE instead of stdout\n";
+
+	template<typename T>
+	bool ParseNumber(std::string_view text, T& value, int base = 10) {
+		auto result = std::from_chars(text.data(), text.data() + text.size(), value, base);
+		return result.ec == std::errc() and result.ptr == text.data() + text.size();
+	}
+
+	template<typename T>
+	bool ParseList(std::string_view text, std::vector<T>& values) {
+		values.clear();
+		while (not text.empty()) {
+			size_t comma = text.find(',');
+			T value{};
+			if (not ParseNumber(text.substr(0, comma), value) or value <= 0) return false;
+			values.push_back(value);
+			text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+		}
+		return not values.empty();
+	}
+}
+
+int main(int argc, char* argv[]) {
+	WavesBenchmarkOptions options;
+	BvhBenchmarkOptions bvhOptions;
+	OcclusionBenchmarkOptions occlusionOptions;
+	DrawBenchmarkOptions drawOptions;
+	IndirectBenchmarkOptions indirectOptions;
+	RecordBenchmarkOptions recordOptions;
+	MeshOptimizerBenchmarkOptions meshOptimizerOptions;
+	AllocatorBenchmarkOptions allocatorOptions;
+	MeshFileBenchmarkOptions meshFileOptions;
+	MeshletBenchmarkOptions meshletOptions;
+	LodBenchmarkOptions lodOptions;
+	IndexPackingBenchmarkOptions indexPackingOptions;
+	bool isChecksumMode = false;
+	bool isBvhMode = false;
+	bool isOcclusionMode = false;
+	bool isDrawMode = false;
+	bool isIndirectMode = false;
+	bool isRecordMode = false;
+	bool isMeshOptimizerMode = false;
+	bool isAllocatorMode = false;
+	bool isMeshFileMode = false;
+	bool isMeshletMode = false;
+	bool isLodMode = false;
+	bool isIndexPackingMode = false;
+	bool hasPacketCounts = false;
+	const char* pOutputPath = nullptr;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		const char* pValue = hasValue ? argv[i + 1] : "";
+		bool isValid = true;
+
+		if (arg == "--grid") isValid = ParseList(pValue, options.GridSizes), ++i;
+		else if (arg == "--threads") isValid = ParseList(pValue, options.ThreadCounts), ++i;
+		else if (arg == "--substeps") isValid = ParseList(pValue, options.Substeps), ++i;
+		else if (arg == "--frames") isValid = ParseNumber(pValue, options.Frames) and options.Frames > 0, ++i;
+		else if (arg == "--warmup") isValid = ParseNumber(pValue, options.WarmupFrames), ++i;
+		else if (arg == "--blocking") isValid = ParseNumber(pValue, options.StepsPerBlock), ++i;
+		else if (arg == "--sparse") options.SparseTracking = true;
+		else if (arg == "--bvh") isBvhMode = true;
+		else if (arg == "--items") isValid = ParseList(pValue, bvhOptions.ItemCounts), ++i;
+		else if (arg == "--occlusion") isOcclusionMode = true;
+		else if (arg == "--images") isValid = hasValue, occlusionOptions.ImageDirectory = pValue, ++i;
+		else if (arg == "--draws") isDrawMode = true;
+		else if (arg == "--packets") isValid = ParseList(pValue, drawOptions.PacketCounts), hasPacketCounts = true, ++i;
+		else if (arg == "--indirect") isIndirectMode = true;
+		else if (arg == "--record") isRecordMode = true;
+		else if (arg == "--meshopt") isMeshOptimizerMode = true;
+		else if (arg == "--allocator") isAllocatorMode = true;
+		else if (arg == "--meshfile") isMeshFileMode = true;
+		else if (arg == "--meshlets") isMeshletMode = true;
+		else if (arg == "--lods") isLodMode = true;
+		else if (arg == "--indices") isIndexPackingMode = true;
+		else if (arg == "--out") isValid = hasValue, pOutputPath = pValue, ++i;
+		else if (arg == "--checksum") {
+			isChecksumMode = true;
+			std::string_view hex = pValue;
+			if (hex.starts_with("0x")) hex.remove_prefix(2);
+			if (not hex.empty() and hex[0] != '-') {
+				isValid = ParseNumber(hex, options.ExpectedChecksum, 16);
+				++i;
+			}
+		}
+		else isValid = false;
+
+		// Options that take a value have moved i onto it, or past the last argument if
+		// it is missing.
+		if (not isValid) {
+			if (i >= argc)
+				std::fprintf(stderr, "Missing value for %.*s\n%s", (int)arg.size(), arg.data(), Usage);
+			else if (argv[i] != arg.data())
+				std::fprintf(stderr, "Invalid value for %.*s: %s\n%s", (int)arg.size(), arg.data(), argv[i], Usage);
+			else
+				std::fprintf(stderr, "Invalid argument: %.*s\n%s", (int)arg.size(), arg.data(), Usage);
+			return 2;
+		}
+	}
+
+	std::ofstream file;
+	if (pOutputPath) {
+		file.open(pOutputPath);
+		if (not file) {
+			std::fprintf(stderr, "Cannot open %s\n", pOutputPath);
+			return 2;
+		}
+	}
+
+	JsonWriter json(pOutputPath ? file : std::cout);
+	if (isBvhMode) {
+		bvhOptions.Frames = options.Frames;
+		return RunBvhSweep(bvhOptions, json) ? 0 : 1;
+	}
+	if (isDrawMode) {
+		drawOptions.Frames = options.Frames;
+		return RunDrawSweep(drawOptions, json) ? 0 : 1;
+	}
+	if (isIndexPackingMode) {
+		indexPackingOptions.Frames = options.Frames;
+		return RunIndexPackingBenchmark(indexPackingOptions, json) ? 0 : 1;
+	}
+	if (isLodMode) {
+		lodOptions.Frames = options.Frames;
+		return RunLodBenchmark(lodOptions, json) ? 0 : 1;
+	}
+	if (isMeshletMode) {
+		meshletOptions.Frames = options.Frames;
+		return RunMeshletBenchmark(meshletOptions, json) ? 0 : 1;
+	}
+	if (isMeshFileMode) {
+		meshFileOptions.Frames = options.Frames;
+		return RunMeshFileBenchmark(meshFileOptions, json) ? 0 : 1;
+	}
+	if (isAllocatorMode)
+		return RunAllocatorBenchmark(allocatorOptions, json) ? 0 : 1;
+	if (isMeshOptimizerMode) {
+		meshOptimizerOptions.Frames = options.Frames;
+		return RunMeshOptimizerBenchmark(meshOptimizerOptions, json) ? 0 : 1;
+	}
+	if (isRecordMode) {
+		if (hasPacketCounts) recordOptions.PacketCounts = drawOptions.PacketCounts;
+		recordOptions.ThreadCounts = options.ThreadCounts;
+		recordOptions.Frames = options.Frames;
+		return RunRecordSweep(recordOptions, json) ? 0 : 1;
+	}
+	if (isIndirectMode) {
+		indirectOptions.ItemCounts = bvhOptions.ItemCounts;
+		indirectOptions.Frames = options.Frames;
+		indirectOptions.ExpectedChecksum = options.ExpectedChecksum;
+		return RunIndirectBenchmark(indirectOptions, json) ? 0 : 1;
+	}
+	if (isOcclusionMode) {
+		occlusionOptions.Frames = options.Frames;
+		occlusionOptions.ExpectedChecksum = options.ExpectedChecksum;
+		return RunOcclusionBenchmark(occlusionOptions, json) ? 0 : 1;
+	}
+	if (isChecksumMode)
+		return RunWavesChecksum(options, json) ? 0 : 1;
+
+	RunWavesSweep(options, json);
+	return 0;
+}
@@ -0,0 +1,276 @@
+#include "MeshFileBenchmark.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "JsonWriter.h"
+#include "MeshFile.h"
+#include "MeshSimplifier.h"
+#include "VertexLayout.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using uint32 = std::uint32_t;
+	using Bytes = std::vector<std::byte>;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// The shapes ShapesApp caches, with the same levels of detail.
+	MeshFile::Contents BuildContents() {
+		GeometryGenerator generator;
+		GeometryGenerator::MeshData box = generator.CreateBox(1.5f, 0.5f, 1.5f, 3);
+		GeometryGenerator::MeshData grid = generator.CreateGrid(20.0f, 30.0f, 60, 40);
+		GeometryGenerator::MeshData sphere = generator.CreateSphere(0.5f, 20, 20);
+		GeometryGenerator::MeshData cylinder = generator.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
+
+		auto boxLods = MeshSimplifier::AppendLodChain(box, 4);
+		auto sphereLods = MeshSimplifier::AppendLodChain(sphere, 4);
+		auto cylinderLods = MeshSimplifier::AppendLodChain(cylinder, 4);
+
+		auto source = [](const GeometryGenerator::Vertex& vertex) {
+			return VertexSource{ .Position = vertex.Position, .Color = DirectX::XMFLOAT4(0.2f, 0.4f, 0.6f, 1.0f) };
+		};
+
+		MeshFile::Contents contents;
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "box", box, boxLods, source);
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "grid", grid, {}, source);
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "sphere", sphere, sphereLods, source);
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "cylinder", cylinder, cylinderLods, source);
+		return contents;
+	}
+
+	template<typename T>
+	bool SameBytes(std::span<const T> a, std::span<const T> b) {
+		return a.size() == b.size() and std::memcmp(a.data(), b.data(), a.size_bytes()) == 0;
+	}
+
+	// The mapped image holds exactly the contents it was serialized from.
+	bool MatchesContents(const MeshFile::Image& image, const MeshFile::Contents& contents) {
+		const MeshFile::Header& header = image.GetHeader();
+		if (not image.HasVertexLayout<ColorVertexLayout>()
+			or not SameBytes(image.Submeshes(), std::span<const MeshFile::SubmeshRecord>(contents.Submeshes))
+			or not SameBytes(image.Lods(), std::span<const MeshFile::LodRecord>(contents.Lods))
+			or not SameBytes(image.Vertices(), std::span<const std::byte>(contents.Vertices))
+			or header.IndexCount != contents.Indices.size())
+			return false;
+
+		std::span<const std::byte> indices = image.Indices();
+		for (uint32 i = 0; i < header.IndexCount; ++i) {
+			uint32 index = 0;
+			std::memcpy(&index, &indices[(size_t)i * header.IndexByteSize], header.IndexByteSize);
+			if (index != contents.Indices[i])
+				return false;
+		}
+		return true;
+	}
+
+	// What Image::Open promises to the code using an image, checked independently.
+	bool RecordsWithinFile(const MeshFile::Image& image) {
+		const MeshFile::Header& header = image.GetHeader();
+		auto isIndexRange = [&](uint32 start, uint32 count) { return (std::uint64_t)start + count <= header.IndexCount; };
+
+		for (const MeshFile::LodRecord& lod : image.Lods()) {
+			if (not isIndexRange(lod.StartIndexLocation, lod.IndexCount))
+				return false;
+		}
+		for (const MeshFile::SubmeshRecord& submesh : image.Submeshes()) {
+			if (std::memchr(submesh.Name, '\0', sizeof(submesh.Name)) == nullptr
+				or not isIndexRange(submesh.StartIndexLocation, submesh.IndexCount)
+				or (std::uint64_t)submesh.FirstLod + submesh.LodCount > image.Lods().size())
+				return false;
+		}
+		return image.Vertices().size() == (size_t)header.VertexCount * header.VertexStride
+			and image.Indices().size() == (size_t)header.IndexCount * header.IndexByteSize;
+	}
+
+	bool WriteFile(const std::filesystem::path& path, std::span<const std::byte> bytes) {
+		std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+		fout.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+		return not fout.fail();
+	}
+
+	Bytes ReadFile(const std::filesystem::path& path) {
+		std::ifstream fin(path, std::ios::binary);
+		std::vector<char> text((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+		Bytes bytes(text.size());
+		std::memcpy(bytes.data(), text.data(), text.size());
+		return bytes;
+	}
+
+	template<typename T>
+	void Store(Bytes& bytes, std::uint64_t offset, T value) {
+		std::memcpy(&bytes[(size_t)offset], &value, sizeof(T));
+	}
+
+	struct Corruption
+	{
+		const char* Name;
+		std::function<void(Bytes&, const MeshFile::Header&)> Apply;
+	};
+
+	// Byte offset of field member of record index of a table.
+	template<typename TRecord>
+	std::uint64_t RecordOffset(const MeshFile::Section& table, uint32 index, size_t member) {
+		return table.Offset + (std::uint64_t)index * sizeof(TRecord) + member;
+	}
+}
+
+bool RunMeshFileBenchmark(const MeshFileBenchmarkOptions& options, JsonWriter& json) {
+	using MeshFile::Header;
+	using MeshFile::LodRecord;
+	using MeshFile::SubmeshRecord;
+
+	// The sphere, submesh 2, has levels of detail.
+	const uint32 Sphere{ 2 };
+
+	const Corruption corruptions[] = {
+		{ "empty", [](Bytes& bytes, const Header&) { bytes.clear(); } },
+		{ "truncatedHeader", [](Bytes& bytes, const Header&) { bytes.resize(sizeof(Header) - 1); } },
+		{ "truncatedHalf", [](Bytes& bytes, const Header&) { bytes.resize(bytes.size() / 2); } },
+		{ "truncatedLastByte", [](Bytes& bytes, const Header&) { bytes.pop_back(); } },
+		{ "appendedByte", [](Bytes& bytes, const Header&) { bytes.push_back(std::byte{}); } },
+		{ "magic", [](Bytes& bytes, const Header&) { Store(bytes, offsetof(Header, Magic), 0x12345678u); } },
+		{ "version", [](Bytes& bytes, const Header&) { Store(bytes, offsetof(Header, Version), MeshFile::Version + 1); } },
+		{ "indexByteSize", [](Bytes& bytes, const Header&) { Store(bytes, offsetof(Header, IndexByteSize), 3u); } },
+		{ "lodCount", [](Bytes& bytes, const Header& header) { Store(bytes, offsetof(Header, LodCount), header.LodCount + 1); } },
+		{ "misalignedSection", [](Bytes& bytes, const Header& header) {
+			Store(bytes, offsetof(Header, Indices) + offsetof(MeshFile::Section, Offset), header.Indices.Offset + 4);
+		} },
+		{ "sectionPastEnd", [](Bytes& bytes, const Header& header) {
+			Store(bytes, offsetof(Header, Vertices) + offsetof(MeshFile::Section, Offset), header.FileByteSize + MeshFile::SectionAlignment);
+		} },
+		{ "firstLodPastTable", [Sphere](Bytes& bytes, const Header& header) {
+			Store(bytes, RecordOffset<SubmeshRecord>(header.Submeshes, Sphere, offsetof(SubmeshRecord, FirstLod)), header.LodCount);
+		} },
+		{ "lodCountPastTable", [Sphere](Bytes& bytes, const Header& header) {
+			Store(bytes, RecordOffset<SubmeshRecord>(header.Submeshes, Sphere, offsetof(SubmeshRecord, LodCount)), header.LodCount + 1);
+		} },
+		{ "firstLodWrapsAround", [Sphere](Bytes& bytes, const Header& header) {
+			Store(bytes, RecordOffset<SubmeshRecord>(header.Submeshes, Sphere, offsetof(SubmeshRecord, FirstLod)), ~0u);
+		} },
+		{ "submeshIndicesPastEnd", [Sphere](Bytes& bytes, const Header& header) {
+			Store(bytes, RecordOffset<SubmeshRecord>(header.Submeshes, Sphere, offsetof(SubmeshRecord, IndexCount)), header.IndexCount + 1);
+		} },
+		{ "submeshStartWrapsAround", [Sphere](Bytes& bytes, const Header& header) {
+			Store(bytes, RecordOffset<SubmeshRecord>(header.Submeshes, Sphere, offsetof(SubmeshRecord, StartIndexLocation)), ~0u - 2);
+		} },
+		{ "negativeBaseVertex", [Sphere](Bytes& bytes, const Header& header) {
+			Store(bytes, RecordOffset<SubmeshRecord>(header.Submeshes, Sphere, offsetof(SubmeshRecord, BaseVertexLocation)), -1);
+		} },
+		{ "unterminatedName", [Sphere](Bytes& bytes, const Header& header) {
+			std::memset(&bytes[(size_t)RecordOffset<SubmeshRecord>(header.Submeshes, Sphere, 0)], 'x', sizeof(SubmeshRecord::Name));
+		} },
+		{ "lodStartPastEnd", [](Bytes& bytes, const Header& header) {
+			Store(bytes, RecordOffset<LodRecord>(header.Lods, 0, offsetof(LodRecord, StartIndexLocation)), header.IndexCount);
+		} },
+		{ "lodIndicesPastEnd", [](Bytes& bytes, const Header& header) {
+			Store(bytes, RecordOffset<LodRecord>(header.Lods, 0, offsetof(LodRecord, IndexCount)), header.IndexCount);
+		} },
+	};
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "dx12-meshfile-benchmark";
+	std::filesystem::create_directories(directory);
+	std::filesystem::path path = directory / "shapes.dxmesh";
+	std::filesystem::path corruptPath = directory / "corrupt.dxmesh";
+
+	const MeshFile::Contents contents = BuildContents();
+	const std::uint64_t contentHash = 0x0123456789ABCDEFull;
+
+	double serializeMs = 0.0;
+	double writeMs = 0.0;
+	double mapMs = 0.0;
+	bool isWritten = true;
+	bool isRoundTrip = true;
+	for (int frame = 0; frame < options.Frames; ++frame) {
+		auto start = Clock::now();
+		MeshFile::Image serialized = MeshFile::Image::Serialize(contents, contentHash);
+		serializeMs += MillisecondsSince(start);
+
+		start = Clock::now();
+		isWritten = isWritten and serialized.WriteTo(path);
+		writeMs += MillisecondsSince(start);
+
+		start = Clock::now();
+		MeshFile::Image mapped = MeshFile::Image::Map(path);
+		mapMs += MillisecondsSince(start);
+
+		isRoundTrip = isRoundTrip and mapped.IsValid() and mapped.IsMapped()
+			and mapped.GetHeader().ContentHash == contentHash
+			and std::memcmp(&mapped.GetHeader(), &serialized.GetHeader(), sizeof(Header)) == 0
+			and MatchesContents(mapped, contents) and MatchesContents(serialized, contents);
+	}
+
+	const Bytes file = ReadFile(path);
+	const Header header = MeshFile::Image::Map(path).GetHeader();
+
+	json.BeginObject();
+	json.Member("benchmark", "meshfile");
+	json.Member("frames", options.Frames);
+	json.Member("fileBytes", (std::uint64_t)file.size());
+	json.Member("submeshes", header.SubmeshCount);
+	json.Member("lods", header.LodCount);
+	json.Member("serializeMs", serializeMs / options.Frames);
+	json.Member("writeMs", writeMs / options.Frames);
+	json.Member("mapMs", mapMs / options.Frames);
+	json.Member("roundTrip", isWritten and isRoundTrip);
+	json.Key("corruptions");
+	json.BeginArray();
+
+	bool isRejectingAll = true;
+	for (const Corruption& corruption : corruptions) {
+		Bytes corrupt = file;
+		corruption.Apply(corrupt, header);
+		bool isRejected = WriteFile(corruptPath, corrupt) and not MeshFile::Image::Map(corruptPath).IsValid();
+		isRejectingAll = isRejectingAll and isRejected;
+
+		json.BeginObject();
+		json.Member("corruption", corruption.Name);
+		json.Member("rejected", isRejected);
+		json.EndObject();
+	}
+	json.EndArray();
+
+	// Random flips of the header and tables; the streams hold no offsets.
+	std::mt19937 random(777u);
+	std::uniform_int_distribution<size_t> flippedByte(0, (size_t)header.Vertices.Offset - 1);
+	std::uniform_int_distribution<int> flippedBit(0, 7);
+	int rejectedFlips = 0;
+	bool isFlipSafe = true;
+	for (int i = 0; i < options.ByteFlips; ++i) {
+		Bytes corrupt = file;
+		corrupt[flippedByte(random)] ^= std::byte(1u << flippedBit(random));
+		WriteFile(corruptPath, corrupt);
+
+		MeshFile::Image image = MeshFile::Image::Map(corruptPath);
+		if (not image.IsValid())
+			rejectedFlips++;
+		else
+			isFlipSafe = isFlipSafe and RecordsWithinFile(image);
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+
+	bool isPassing = isWritten and isRoundTrip and isRejectingAll and isFlipSafe;
+
+	json.Member("byteFlips", options.ByteFlips);
+	json.Member("rejectedByteFlips", rejectedFlips);
+	json.Member("acceptedByteFlipsWithinFile", isFlipSafe);
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
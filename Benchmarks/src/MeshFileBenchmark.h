@@ -0,0 +1,20 @@
+#pragma once
+
+class JsonWriter;
+
+struct MeshFileBenchmarkOptions
+{
+	// Timed serializations, writes and maps.
+	int Frames{ 50 };
+
+	// Single byte corruptions of the header and tables, each mapped once.
+	int ByteFlips{ 2000 };
+};
+
+// Serializes the ShapesApp geometry into a mesh file, writes it to a temporary
+// directory, maps it back and compares the submeshes, levels of detail, vertices and
+// indices with what was serialized. Then maps truncated and corrupted copies: the
+// targeted corruptions of the header and tables must all be rejected, and a copy that
+// still opens after a random byte flip must only hold records within the file.
+// Returns false on any mismatch.
+bool RunMeshFileBenchmark(const MeshFileBenchmarkOptions& options, JsonWriter& json);
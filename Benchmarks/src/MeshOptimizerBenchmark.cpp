@@ -0,0 +1,112 @@
+#include "MeshOptimizerBenchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "JsonWriter.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using uint32 = std::uint32_t;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct TestMesh
+	{
+		std::string Name;
+		std::function<GeometryGenerator::MeshData(GeometryGenerator&)> Create;
+	};
+
+	// A triangle by the contents of its vertices, rotated to start at the smallest
+	// one. Vertex fetch optimization renumbers vertices, so indices cannot be compared.
+	using Triangle = std::array<float, 33>;
+
+	std::vector<Triangle> SortedTriangles(const GeometryGenerator::MeshData& mesh) {
+		std::vector<Triangle> triangles(mesh.Indices32.size() / 3);
+		for (size_t t = 0; t < triangles.size(); ++t) {
+			std::array<std::array<float, 11>, 3> corners;
+			for (size_t k = 0; k < 3; ++k) {
+				const GeometryGenerator::Vertex& v = mesh.Vertices[mesh.Indices32[3 * t + k]];
+				corners[k] = { v.Position.x, v.Position.y, v.Position.z, v.Normal.x, v.Normal.y, v.Normal.z,
+					v.TangentU.x, v.TangentU.y, v.TangentU.z, v.TexC.x, v.TexC.y };
+			}
+
+			// Rotating keeps the winding.
+			size_t first = std::min_element(corners.begin(), corners.end()) - corners.begin();
+			for (size_t k = 0; k < 3; ++k)
+				std::copy(corners[(first + k) % 3].begin(), corners[(first + k) % 3].end(), triangles[t].begin() + 11 * k);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+bool RunMeshOptimizerBenchmark(const MeshOptimizerBenchmarkOptions& options, JsonWriter& json) {
+	const TestMesh meshes[] = {
+		{ "geosphere3", [](GeometryGenerator& g) { return g.CreateGeosphere(1.0f, 3); } },
+		{ "geosphere5", [](GeometryGenerator& g) { return g.CreateGeosphere(1.0f, 5); } },
+		{ "geosphere6", [](GeometryGenerator& g) { return g.CreateGeosphere(1.0f, 6); } },
+		{ "grid64", [](GeometryGenerator& g) { return g.CreateGrid(64.0f, 64.0f, 64, 64); } },
+		{ "grid256", [](GeometryGenerator& g) { return g.CreateGrid(256.0f, 256.0f, 256, 256); } },
+		{ "sphere", [](GeometryGenerator& g) { return g.CreateSphere(1.0f, 64, 64); } },
+		{ "cylinder", [](GeometryGenerator& g) { return g.CreateCylinder(0.5f, 0.3f, 3.0f, 64, 32); } },
+	};
+
+	GeometryGenerator generator;
+	bool isPassing = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "meshopt");
+	json.Member("frames", options.Frames);
+	json.Member("cacheSize", MeshOptimizer::DefaultCacheSize);
+	json.Key("results");
+	json.BeginArray();
+
+	for (const TestMesh& testMesh : meshes) {
+		const GeometryGenerator::MeshData source = testMesh.Create(generator);
+		MeshOptimizer::CacheStatistics before = MeshOptimizer::AnalyzeVertexCache(source.Indices32, (uint32)source.Vertices.size());
+
+		GeometryGenerator::MeshData optimized;
+		double optimizeMs = 0.0;
+		for (int frame = 0; frame < options.Frames; ++frame) {
+			optimized = source;
+			auto start = Clock::now();
+			MeshOptimizer::Optimize(optimized);
+			optimizeMs += MillisecondsSince(start);
+		}
+
+		MeshOptimizer::CacheStatistics after = MeshOptimizer::AnalyzeVertexCache(optimized.Indices32, (uint32)optimized.Vertices.size());
+		bool isPermutation = SortedTriangles(source) == SortedTriangles(optimized);
+		bool isNotWorse = after.Acmr <= before.Acmr;
+		isPassing = isPassing and isPermutation and isNotWorse;
+
+		json.BeginObject();
+		json.Member("mesh", testMesh.Name);
+		json.Member("triangles", (unsigned)(source.Indices32.size() / 3));
+		json.Member("vertices", (unsigned)source.Vertices.size());
+		json.Member("acmrBefore", before.Acmr);
+		json.Member("acmrAfter", after.Acmr);
+		json.Member("atvrBefore", before.Atvr);
+		json.Member("atvrAfter", after.Atvr);
+		json.Member("optimizeMs", optimizeMs / options.Frames);
+		json.Member("permutation", isPermutation);
+		json.Member("acmrNotWorse", isNotWorse);
+		json.EndObject();
+	}
+
+	json.EndArray();
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+class JsonWriter;
+
+struct MeshOptimizerBenchmarkOptions
+{
+	// Timed optimizations per mesh.
+	int Frames{ 50 };
+};
+
+// Runs generated geospheres, grids, spheres and cylinders through MeshOptimizer and
+// reports their vertex cache efficiency (ACMR and ATVR) before and after. Returns
+// false if the optimized index buffer is not a permutation of the original triangles,
+// with their winding, or if its ACMR got worse.
+bool RunMeshOptimizerBenchmark(const MeshOptimizerBenchmarkOptions& options, JsonWriter& json);
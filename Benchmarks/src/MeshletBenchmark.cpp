@@ -0,0 +1,226 @@
+#include "MeshletBenchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "JsonWriter.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using uint32 = std::uint32_t;
+	using MeshletBuilder::Meshlet;
+	using MeshletBuilder::MeshletData;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct TestMesh
+	{
+		std::string Name;
+		std::function<GeometryGenerator::MeshData(GeometryGenerator&)> Create;
+	};
+
+	// Slack for float rounding, relative to the size of the meshes.
+	const float Tolerance{ 1e-4f };
+
+	// Mesh vertex index of corner k of primitive p of the meshlet.
+	uint32 MeshIndex(const MeshletData& data, const Meshlet& meshlet, uint32 p, int k) {
+		uint32 local = MeshletBuilder::UnpackPrimitive(data.Primitives[meshlet.PrimitiveOffset + p], k);
+		return local < meshlet.VertexCount ? data.VertexIndices[meshlet.VertexOffset + local] : ~0u;
+	}
+
+	bool IsWithinLimits(const MeshletData& data, const MeshletBuilder::Options& limits) {
+		for (const Meshlet& meshlet : data.Meshlets) {
+			if (meshlet.VertexCount == 0 or meshlet.VertexCount > limits.MaxVertices
+				or meshlet.PrimitiveCount == 0 or meshlet.PrimitiveCount > limits.MaxPrimitives
+				or (size_t)meshlet.VertexOffset + meshlet.VertexCount > data.VertexIndices.size()
+				or (size_t)meshlet.PrimitiveOffset + meshlet.PrimitiveCount > data.Primitives.size())
+				return false;
+		}
+		return true;
+	}
+
+	// The meshlets' triangles, in meshlet order, are the source triangles in source order.
+	bool RebuildsIndices(const MeshletData& data, std::span<const uint32> indices, uint32 baseVertex = 0) {
+		size_t next = 0;
+		for (const Meshlet& meshlet : data.Meshlets) {
+			for (uint32 p = 0; p < meshlet.PrimitiveCount; ++p) {
+				for (int k = 0; k < 3; ++k) {
+					if (next == indices.size() or MeshIndex(data, meshlet, p, k) != indices[next++] + baseVertex)
+						return false;
+				}
+			}
+		}
+		return next == indices.size();
+	}
+
+	XMVECTOR Corner(const GeometryGenerator::MeshData& mesh, const MeshletData& data, const Meshlet& meshlet, uint32 p, int k) {
+		return XMLoadFloat3(&mesh.Vertices[MeshIndex(data, meshlet, p, k)].Position);
+	}
+
+	bool SphereHoldsVertices(const GeometryGenerator::MeshData& mesh, const MeshletData& data, const Meshlet& meshlet) {
+		XMVECTOR center = XMLoadFloat3(&meshlet.Center);
+		for (uint32 i = 0; i < meshlet.VertexCount; ++i) {
+			XMVECTOR position = XMLoadFloat3(&mesh.Vertices[data.VertexIndices[meshlet.VertexOffset + i]].Position);
+			if (XMVectorGetX(XMVector3Length(XMVectorSubtract(position, center))) > meshlet.Radius + Tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	// A cone that can cull holds every face normal within its cutoff, and its apex lies
+	// behind every face's plane.
+	bool ConeHoldsNormals(const GeometryGenerator::MeshData& mesh, const MeshletData& data, const Meshlet& meshlet) {
+		if (meshlet.ConeCutoff > 1.0f)
+			return true;
+
+		XMVECTOR axis = XMLoadFloat3(&meshlet.ConeAxis);
+		XMVECTOR apex = XMLoadFloat3(&meshlet.ConeApex);
+		float minDot = std::sqrt(1.0f - meshlet.ConeCutoff * meshlet.ConeCutoff);
+		for (uint32 p = 0; p < meshlet.PrimitiveCount; ++p) {
+			XMVECTOR p0 = Corner(mesh, data, meshlet, p, 0);
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(Corner(mesh, data, meshlet, p, 1), p0),
+				XMVectorSubtract(Corner(mesh, data, meshlet, p, 2), p0));
+			float length = XMVectorGetX(XMVector3Length(normal));
+			if (length <= 0.0f) continue;
+			normal = XMVectorScale(normal, 1.0f / length);
+
+			if (XMVectorGetX(XMVector3Dot(normal, axis)) < minDot - Tolerance
+				or XMVectorGetX(XMVector3Dot(XMVectorSubtract(p0, apex), normal)) < -Tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	// Counts the eyes the meshlet is culled for; clears isSound if any of them sees the
+	// front of one of its triangles.
+	int CullForEyes(const GeometryGenerator::MeshData& mesh, const MeshletData& data, const Meshlet& meshlet,
+		std::span<const XMFLOAT3> eyes, bool& isSound) {
+		int culled = 0;
+		for (const XMFLOAT3& eyePosition : eyes) {
+			XMVECTOR eye = XMLoadFloat3(&eyePosition);
+			if (not MeshletBuilder::IsBackfacing(meshlet, eye)) continue;
+			culled++;
+
+			for (uint32 p = 0; p < meshlet.PrimitiveCount; ++p) {
+				XMVECTOR p0 = Corner(mesh, data, meshlet, p, 0);
+				XMVECTOR normal = XMVector3Cross(XMVectorSubtract(Corner(mesh, data, meshlet, p, 1), p0),
+					XMVectorSubtract(Corner(mesh, data, meshlet, p, 2), p0));
+				if (XMVectorGetX(XMVector3Dot(XMVectorSubtract(p0, eye), normal)) < -Tolerance)
+					isSound = false;
+			}
+		}
+		return culled;
+	}
+}
+
+bool RunMeshletBenchmark(const MeshletBenchmarkOptions& options, JsonWriter& json) {
+	const TestMesh meshes[] = {
+		{ "geosphere5", [](GeometryGenerator& g) { return g.CreateGeosphere(1.0f, 5); } },
+		{ "sphere", [](GeometryGenerator& g) { return g.CreateSphere(1.0f, 40, 40); } },
+		{ "box", [](GeometryGenerator& g) { return g.CreateBox(1.5f, 0.5f, 1.5f, 3); } },
+		{ "grid", [](GeometryGenerator& g) { return g.CreateGrid(20.0f, 30.0f, 60, 40); } },
+		{ "cylinder", [](GeometryGenerator& g) { return g.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20); } },
+	};
+	const MeshletBuilder::Options limitSets[] = {
+		{},
+		{ .MaxVertices = 128, .MaxPrimitives = 256 },
+		{ .MaxVertices = 3, .MaxPrimitives = 1 },
+	};
+
+	GeometryGenerator generator;
+	std::mt19937 random(99u);
+	std::uniform_real_distribution<float> eyeCoordinate(-20.0f, 20.0f);
+	std::vector<XMFLOAT3> eyes(options.EyeSamples);
+	for (XMFLOAT3& eye : eyes)
+		eye = XMFLOAT3(eyeCoordinate(random), eyeCoordinate(random), eyeCoordinate(random));
+
+	MeshletData concatenated;
+	std::vector<uint32> concatenatedIndices;
+	uint32 baseVertex = 0;
+	bool isPassing = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "meshlets");
+	json.Member("frames", options.Frames);
+	json.Member("eyeSamples", options.EyeSamples);
+	json.Key("results");
+	json.BeginArray();
+
+	for (const TestMesh& testMesh : meshes) {
+		GeometryGenerator::MeshData mesh = testMesh.Create(generator);
+		MeshOptimizer::Optimize(mesh);
+
+		for (const MeshletBuilder::Options& limits : limitSets) {
+			MeshletData data;
+			auto start = Clock::now();
+			for (int frame = 0; frame < options.Frames; ++frame)
+				data = MeshletBuilder::Build(mesh, limits);
+			double buildMs = MillisecondsSince(start) / options.Frames;
+
+			bool isWithinLimits = IsWithinLimits(data, limits);
+			bool isRebuilt = isWithinLimits and RebuildsIndices(data, mesh.Indices32);
+			bool isBounded = isRebuilt;
+			bool isSound = isRebuilt;
+			int cullable = 0;
+			int culled = 0;
+			double vertexCount = 0.0;
+			if (isRebuilt) {
+				for (const Meshlet& meshlet : data.Meshlets) {
+					isBounded = isBounded and SphereHoldsVertices(mesh, data, meshlet) and ConeHoldsNormals(mesh, data, meshlet);
+					cullable += meshlet.ConeCutoff <= 1.0f;
+					culled += CullForEyes(mesh, data, meshlet, eyes, isSound);
+					vertexCount += meshlet.VertexCount;
+				}
+			}
+
+			isPassing = isPassing and isWithinLimits and isRebuilt and isBounded and isSound;
+
+			json.BeginObject();
+			json.Member("mesh", testMesh.Name);
+			json.Member("maxVertices", limits.MaxVertices);
+			json.Member("maxPrimitives", limits.MaxPrimitives);
+			json.Member("triangles", (unsigned)(mesh.Indices32.size() / 3));
+			json.Member("meshlets", (unsigned)data.Meshlets.size());
+			json.Member("verticesPerMeshlet", vertexCount / data.Meshlets.size());
+			json.Member("cullableMeshlets", cullable);
+			json.Member("culledFraction", (double)culled / ((double)data.Meshlets.size() * options.EyeSamples));
+			json.Member("buildMs", buildMs);
+			json.Member("withinLimits", isWithinLimits);
+			json.Member("rebuildsIndices", isRebuilt);
+			json.Member("boundsHold", isBounded);
+			json.Member("cullingSound", isSound);
+			json.EndObject();
+
+			if (&limits == &limitSets[0]) {
+				MeshletBuilder::Append(concatenated, data, baseVertex);
+				for (uint32 index : mesh.Indices32)
+					concatenatedIndices.push_back(index + baseVertex);
+				baseVertex += (uint32)mesh.Vertices.size();
+			}
+		}
+	}
+
+	json.EndArray();
+
+	// The meshes' meshlets appended into one set index one concatenated vertex buffer.
+	bool isAppendMatch = RebuildsIndices(concatenated, concatenatedIndices);
+	isPassing = isPassing and isAppendMatch;
+
+	json.Member("appendRebuildsIndices", isAppendMatch);
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
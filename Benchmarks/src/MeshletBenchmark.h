@@ -0,0 +1,21 @@
+#pragma once
+
+class JsonWriter;
+
+struct MeshletBenchmarkOptions
+{
+	// Timed builds per mesh and option set.
+	int Frames{ 50 };
+
+	// Random eye positions the normal cone test is run against per meshlet.
+	int EyeSamples{ 64 };
+};
+
+// Splits generated meshes into meshlets with MeshletBuilder and checks the result: no
+// meshlet exceeds its vertex and triangle limits, the local indices rebuild the source
+// triangle list exactly, every bounding sphere holds its meshlet's vertices, every
+// normal cone holds its meshlet's face normals with the apex behind all their planes,
+// and no eye for which IsBackfacing culls a meshlet sees the front of one of its
+// triangles. Also checks that Append rebases meshlets onto concatenated vertex
+// buffers. Returns false on any mismatch.
+bool RunMeshletBenchmark(const MeshletBenchmarkOptions& options, JsonWriter& json);
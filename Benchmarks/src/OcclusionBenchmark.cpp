@@ -0,0 +1,219 @@
+#include "OcclusionBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <vector>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include "Checksum.h"
+#include "FrustumCuller.h"
+#include "JsonWriter.h"
+#include "OcclusionCuller.h"
+
+using namespace DirectX;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// A grid of blocks with one building each, separated by streets at least four
+	// meters wide, and props scattered over the streets and roofs.
+	struct City
+	{
+		static constexpr int BlocksPerSide{ 16 };
+		static constexpr float BlockPitch{ 24.0f };
+		static constexpr int PropCount{ 4000 };
+
+		// Buildings first, then props.
+		std::vector<BoundingBox> Boxes;
+		std::uint32_t BuildingCount{};
+		float HalfSize{ 0.5f * BlocksPerSide * BlockPitch };
+	};
+
+	City MakeCity() {
+		City city;
+		std::mt19937 random(4242u);
+		std::uniform_real_distribution<float> footprint(6.0f, 10.0f);
+		std::uniform_real_distribution<float> height(8.0f, 60.0f);
+
+		for (int i = 0; i < City::BlocksPerSide; ++i) {
+			for (int j = 0; j < City::BlocksPerSide; ++j) {
+				float halfHeight = 0.5f * height(random);
+				city.Boxes.push_back(BoundingBox(
+					XMFLOAT3(-city.HalfSize + (i + 0.5f) * City::BlockPitch, halfHeight, -city.HalfSize + (j + 0.5f) * City::BlockPitch),
+					XMFLOAT3(footprint(random), halfHeight, footprint(random))));
+			}
+		}
+		city.BuildingCount = (std::uint32_t)city.Boxes.size();
+
+		std::uniform_real_distribution<float> position(-city.HalfSize, city.HalfSize);
+		std::uniform_real_distribution<float> extent(0.3f, 1.5f);
+		for (int i = 0; i < City::PropCount; ++i) {
+			XMFLOAT3 extents(extent(random), extent(random), extent(random));
+			city.Boxes.push_back(BoundingBox(XMFLOAT3(position(random), extents.y, position(random)), extents));
+		}
+		return city;
+	}
+
+	// The [-1, 1] cube every box is drawn with.
+	OccluderMesh MakeCube() {
+		OccluderMesh cube;
+		for (int corner = 0; corner < 8; ++corner)
+			cube.Positions.push_back(XMFLOAT3(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f));
+		cube.Indices = {
+			0, 2, 3, 0, 3, 1,	// -z
+			4, 5, 7, 4, 7, 6,	// +z
+			0, 4, 6, 0, 6, 2,	// -x
+			1, 3, 7, 1, 7, 5,	// +x
+			0, 1, 5, 0, 5, 4,	// -y
+			2, 6, 7, 2, 7, 3,	// +y
+		};
+		return cube;
+	}
+
+	XMFLOAT4X4 BoxWorld(const BoundingBox& box) {
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixMultiply(
+			XMMatrixScaling(box.Extents.x, box.Extents.y, box.Extents.z),
+			XMMatrixTranslation(box.Center.x, box.Center.y, box.Center.z)));
+		return world;
+	}
+
+	// Eye height walk down the middle street, looking left and right.
+	XMFLOAT4X4 ViewProjection(const City& city, int frame, float aspectRatio) {
+		float yaw = 0.4f * std::sin(0.1f * frame);
+		XMVECTOR eye = XMVectorSet(0.0f, 1.7f, -city.HalfSize - 10.0f + 3.0f * frame, 1.0f);
+		XMVECTOR target = eye + XMVectorSet(std::sin(yaw), 0.0f, std::cos(yaw), 0.0f);
+		XMMATRIX view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * XM_PI, aspectRatio, 0.5f, 3.0f * city.HalfSize);
+
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, projection));
+		return viewProj;
+	}
+}
+
+bool RunOcclusionBenchmark(const OcclusionBenchmarkOptions& options, JsonWriter& json) {
+	const City city = MakeCity();
+	const OccluderMesh cube = MakeCube();
+
+	FrustumCuller frustumCuller;
+	frustumCuller.Resize((std::uint32_t)city.Boxes.size());
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	for (std::uint32_t i = 0; i < city.Boxes.size(); ++i)
+		frustumCuller.SetBounds(i, city.Boxes[i], identity);
+
+	OcclusionCuller culler((std::uint32_t)options.Width, (std::uint32_t)options.Height);
+	OcclusionCuller reference((std::uint32_t)options.Width, (std::uint32_t)options.Height);
+	const float aspectRatio = (float)options.Width / options.Height;
+
+	std::vector<std::uint32_t> visible;
+	std::vector<std::uint32_t> candidates;
+	std::vector<std::uint32_t> occluders;
+	std::vector<std::uint32_t> occluded;
+	Checksum checksum;
+	double drawMs = 0.0;
+	double hiZMs = 0.0;
+	double testMs = 0.0;
+	double occluderCount = 0.0;
+	double triangleCount = 0.0;
+	double visibleCount = 0.0;
+	double occludedCount = 0.0;
+	int falseOcclusionCount = 0;
+
+	for (int frame = 0; frame < options.Frames; ++frame) {
+		XMFLOAT4X4 viewProj = ViewProjection(city, frame, aspectRatio);
+		frustumCuller.Cull(viewProj, visible);
+
+		candidates.clear();
+		for (std::uint32_t i : visible) {
+			if (i < city.BuildingCount)
+				candidates.push_back(i);
+		}
+
+		auto start = Clock::now();
+		culler.BeginFrame(viewProj);
+		culler.SelectOccluders(city.Boxes, candidates, (std::uint32_t)options.MaxOccluders, occluders);
+		for (std::uint32_t i : occluders)
+			culler.RenderOccluder(cube.Positions, cube.Indices, BoxWorld(city.Boxes[i]));
+		drawMs += MillisecondsSince(start);
+
+		start = Clock::now();
+		culler.BuildHiZ();
+		hiZMs += MillisecondsSince(start);
+
+		start = Clock::now();
+		occluded.clear();
+		for (std::uint32_t i : visible) {
+			if (culler.IsOccluded(city.Boxes[i]))
+				occluded.push_back(i);
+		}
+		testMs += MillisecondsSince(start);
+
+		occluderCount += culler.LastStatistics().OccluderCount;
+		triangleCount += culler.LastStatistics().TriangleCount;
+		visibleCount += visible.size();
+		occludedCount += occluded.size();
+
+		std::span<const float> depths = culler.Level(0);
+		checksum.Add(depths.data(), depths.size_bytes());
+
+		// An occluded box drawn on its own must not come out in front of the depth
+		// buffer anywhere; the rasterizer is deterministic, so equal depths are hidden.
+		for (std::uint32_t i : occluded) {
+			reference.BeginFrame(viewProj);
+			reference.RenderOccluder(cube.Positions, cube.Indices, BoxWorld(city.Boxes[i]));
+			std::span<const float> boxDepths = reference.Level(0);
+			for (size_t p = 0; p < depths.size(); ++p) {
+				if (boxDepths[p] < depths[p]) {
+					falseOcclusionCount++;
+					break;
+				}
+			}
+		}
+	}
+
+	bool isImageWritten = true;
+	if (not options.ImageDirectory.empty()) {
+		std::filesystem::path directory(options.ImageDirectory);
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		isImageWritten = culler.WriteDepthImage(directory / "occlusion-depth.pgm")
+			and culler.WriteDepthImage(directory / "occlusion-hiz3.pgm", std::min(3u, culler.LevelCount() - 1));
+	}
+
+	bool isChecksumMatch = options.ExpectedChecksum == 0 or options.ExpectedChecksum == checksum.Value();
+	bool isPassing = falseOcclusionCount == 0 and isChecksumMatch and isImageWritten;
+	double frames = options.Frames;
+
+	json.BeginObject();
+	json.Member("benchmark", "occlusion");
+	json.Member("frames", options.Frames);
+	json.Member("width", culler.Width());
+	json.Member("height", culler.Height());
+	json.Member("items", city.Boxes.size());
+	json.Member("occludersPerFrame", occluderCount / frames);
+	json.Member("trianglesPerFrame", triangleCount / frames);
+	json.Member("drawOccludersMs", drawMs / frames);
+	json.Member("hiZMs", hiZMs / frames);
+	json.Member("testMs", testMs / frames);
+	json.Member("frustumVisiblePerFrame", visibleCount / frames);
+	json.Member("occludedFraction", visibleCount > 0.0 ? occludedCount / visibleCount : 0.0);
+	json.Member("falseOcclusions", falseOcclusionCount);
+	json.Member("checksum", Checksum::ToHex(checksum.Value()));
+	if (options.ExpectedChecksum != 0)
+		json.Member("expectedChecksum", Checksum::ToHex(options.ExpectedChecksum));
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class JsonWriter;
+
+struct OcclusionBenchmarkOptions
+{
+	int Frames{ 50 };
+	int Width{ 320 };
+	int Height{ 192 };
+
+	// Occluders drawn per frame, picked by OcclusionCuller::SelectOccluders.
+	int MaxOccluders{ 16 };
+
+	// Checksum of the depth buffers the scene must reproduce, or 0 to skip the comparison.
+	std::uint64_t ExpectedChecksum{};
+
+	// If set, the depth buffer and a pyramid level of the last frame are written here
+	// as reference images.
+	std::string ImageDirectory{};
+};
+
+// Walks a camera down a street of a box city, draws the largest buildings into an
+// OcclusionCuller and tests the buildings and street props in the view frustum
+// against it. Every box reported occluded is drawn on its own and compared with the
+// depth buffer; returns false if any of its pixels would have been visible, or if the
+// depth buffers do not match the expected checksum.
+bool RunOcclusionBenchmark(const OcclusionBenchmarkOptions& options, JsonWriter& json);
@@ -0,0 +1,214 @@
+#include "RecordBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <thread>
+
+#include "DrawQueue.h"
+#include "JobSystem.h"
+#include "JsonWriter.h"
+#include "ParallelCommandRecorder.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using uint32 = std::uint32_t;
+
+	double MillisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	std::vector<unsigned> DefaultThreadCounts() {
+		unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+		std::vector<unsigned> threadCounts;
+		for (unsigned threads = 1; threads < hardwareThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(hardwareThreads);
+		return threadCounts;
+	}
+
+	enum class CommandType : uint32 { PipelineState, Geometry, Topology, Draw };
+
+	// A state change with the new state's id, or a draw of Count packets from Value on.
+	struct RecordedCommand
+	{
+		CommandType Type{};
+		uint32 Value{};
+		uint32 Count{};
+	};
+
+	// Stands in for a command list; logs the calls DrawQueue::Submit makes.
+	struct RecordingCommandList
+	{
+		const DrawPacket* pFirstPacket{};
+		std::vector<RecordedCommand> Commands{};
+
+		void SetPipelineState(const DrawPacket& packet) {
+			Commands.push_back({ CommandType::PipelineState, DrawQueue::PipelineState(packet.SortKey) });
+		}
+		void SetGeometry(const DrawPacket& packet) {
+			Commands.push_back({ CommandType::Geometry, DrawQueue::Geometry(packet.SortKey) });
+		}
+		void SetPrimitiveTopology(const DrawPacket& packet) {
+			Commands.push_back({ CommandType::Topology, DrawQueue::Topology(packet.SortKey) });
+		}
+		void Draw(std::span<const DrawPacket> packets) {
+			Commands.push_back({ CommandType::Draw, (uint32)(packets.data() - pFirstPacket), (uint32)packets.size() });
+		}
+	};
+
+	// ParallelCommandRecorder backend over recording lists; Execute notes the lists
+	// submitted, in order.
+	struct RecordingBackend
+	{
+		std::vector<RecordingCommandList> Lists;
+		std::vector<const RecordingCommandList*> Submitted;
+		int ExecuteCalls{};
+
+		RecordingCommandList& BeginList(uint32 list, DrawQueue::Chunk) {
+			Lists[list].Commands.clear();
+			return Lists[list];
+		}
+
+		void EndList(uint32) {}
+
+		void Execute(uint32 listCount) {
+			ExecuteCalls++;
+			Submitted.clear();
+			for (uint32 i = 0; i < listCount; ++i)
+				Submitted.push_back(&Lists[i]);
+		}
+	};
+
+	// A draw as the GPU runs it: the state bound at the time and the packets drawn.
+	struct ResolvedDraw
+	{
+		uint32 PipelineState{};
+		uint32 Geometry{};
+		uint32 Topology{};
+		uint32 First{};
+		uint32 Count{};
+
+		bool operator==(const ResolvedDraw&) const = default;
+	};
+
+	const uint32 UnsetState{ ~0u };
+
+	// Replays the lists in order. Command lists do not inherit state from the lists
+	// before them, so it starts out unset on every list.
+	void Resolve(std::span<const RecordingCommandList* const> lists, std::vector<ResolvedDraw>& draws) {
+		draws.clear();
+		for (const RecordingCommandList* pList : lists) {
+			ResolvedDraw state{ UnsetState, UnsetState, UnsetState };
+			for (const RecordedCommand& command : pList->Commands) {
+				switch (command.Type) {
+				case CommandType::PipelineState: state.PipelineState = command.Value; break;
+				case CommandType::Geometry: state.Geometry = command.Value; break;
+				case CommandType::Topology: state.Topology = command.Value; break;
+				case CommandType::Draw:
+					state.First = command.Value;
+					state.Count = command.Count;
+					draws.push_back(state);
+					break;
+				}
+			}
+		}
+	}
+
+	bool HasUnsetState(std::span<const ResolvedDraw> draws) {
+		return std::ranges::any_of(draws, [](const ResolvedDraw& draw) {
+			return draw.PipelineState == UnsetState or draw.Geometry == UnsetState or draw.Topology == UnsetState;
+		});
+	}
+}
+
+bool RunRecordSweep(const RecordBenchmarkOptions& options, JsonWriter& json) {
+	std::vector<unsigned> threadCounts = options.ThreadCounts.empty() ? DefaultThreadCounts() : options.ThreadCounts;
+	bool isPassing = true;
+
+	json.BeginObject();
+	json.Member("benchmark", "record");
+	json.Member("frames", options.Frames);
+	json.Member("minPacketsPerList", ParallelCommandRecorder::DefaultMinPacketsPerList);
+	json.Key("results");
+	json.BeginArray();
+
+	for (int packetCount : options.PacketCounts) {
+		std::mt19937 random(2024u);
+		std::uniform_int_distribution<uint32> pipelineState(0, options.PipelineStateCount - 1);
+		std::uniform_int_distribution<uint32> geometry(0, options.GeometryCount - 1);
+		std::uniform_int_distribution<uint32> topology(0, options.TopologyCount - 1);
+		std::uniform_int_distribution<uint32> mesh(0, options.MeshCount - 1);
+		std::uniform_real_distribution<float> depth(1.0f, 1000.0f);
+
+		DrawQueue queue;
+		for (int i = 0; i < packetCount; ++i)
+			queue.Add(DrawQueue::MakeKey(pipelineState(random), geometry(random), topology(random), mesh(random), depth(random)), (uint32)i);
+		queue.Sort();
+
+		RecordingCommandList serialList{ queue.Packets().data() };
+		DrawQueue::Statistics serialStatistics;
+		auto start = Clock::now();
+		for (int frame = 0; frame < options.Frames; ++frame) {
+			serialList.Commands.clear();
+			serialStatistics = queue.Submit(serialList);
+		}
+		double serialMs = MillisecondsSince(start) / options.Frames;
+
+		std::vector<ResolvedDraw> serialDraws;
+		const RecordingCommandList* pSerialList = &serialList;
+		Resolve({ &pSerialList, 1 }, serialDraws);
+
+		json.BeginObject();
+		json.Member("packets", packetCount);
+		json.Member("draws", serialStatistics.DrawCount);
+		json.Member("serialMs", serialMs);
+		json.Key("threads");
+		json.BeginArray();
+
+		for (unsigned threads : threadCounts) {
+			JobSystem jobSystem(threads - 1);
+			ParallelCommandRecorder recorder;
+			RecordingBackend backend;
+			backend.Lists.resize(threads, RecordingCommandList{ queue.Packets().data() });
+
+			DrawQueue::Statistics statistics;
+			start = Clock::now();
+			for (int frame = 0; frame < options.Frames; ++frame)
+				statistics = recorder.Record(queue, backend, threads, jobSystem);
+			double recordMs = MillisecondsSince(start) / options.Frames;
+
+			std::vector<ResolvedDraw> draws;
+			Resolve(backend.Submitted, draws);
+			bool isMatch = backend.ExecuteCalls == options.Frames
+				and backend.Submitted.size() == recorder.Chunks().size()
+				and statistics.PacketCount == serialStatistics.PacketCount
+				and statistics.DrawCount == serialStatistics.DrawCount
+				and statistics.StateChanges() + statistics.SavedStateChanges == 3 * statistics.PacketCount
+				and draws == serialDraws and not HasUnsetState(draws);
+			isPassing = isPassing and isMatch;
+
+			json.BeginObject();
+			json.Member("threads", threads);
+			json.Member("lists", (unsigned)recorder.Chunks().size());
+			json.Member("recordMs", recordMs);
+			json.Member("speedup", serialMs / recordMs);
+			json.Member("stateChanges", statistics.StateChanges());
+			json.Member("match", isMatch);
+			json.EndObject();
+		}
+
+		json.EndArray();
+		json.EndObject();
+	}
+
+	json.EndArray();
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
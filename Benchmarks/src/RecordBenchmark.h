@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+class JsonWriter;
+
+struct RecordBenchmarkOptions
+{
+	std::vector<int> PacketCounts{ 20000, 100000 };
+	std::vector<unsigned> ThreadCounts{};	// Empty: 1, 2, 4, ... up to the hardware threads.
+	int Frames{ 50 };
+
+	// Distinct states and meshes the random draws pick from.
+	int PipelineStateCount{ 4 };
+	int GeometryCount{ 64 };
+	int TopologyCount{ 2 };
+	int MeshCount{ 16 };
+};
+
+// Records sorted DrawQueues of random draws with ParallelCommandRecorder onto command
+// lists that only log their calls, for every thread count, and times it against
+// recording the whole queue onto one list. Returns false if replaying the logged lists
+// in submission order ever draws something different, or with different state, than
+// the single list.
+bool RunRecordSweep(const RecordBenchmarkOptions& options, JsonWriter& json);
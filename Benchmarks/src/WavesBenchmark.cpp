@@ -0,0 +1,290 @@
+#include "WavesBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <DirectXMath.h>
+
+#include "Checksum.h"
+#include "JobSystem.h"
+#include "JsonWriter.h"
+#include "MappedBuffer.h"
+#include "VertexLayout.h"
+#include "Waves.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// The vertex format WavesApp streams the water with.
+	using Vertex = ColorVertexLayout::Vertex;
+
+	// Simulation parameters used by WavesApp.
+	const float SpatialStep{ 1.0f };
+	const float TimeStep{ 0.03f };
+	const float Speed{ 4.0f };
+	const float Damping{ 0.2f };
+
+	// Modelled memory traffic: a step reads the previous and current heights and
+	// writes the new ones, the normal pass reads the heights and writes five planes,
+	// packing reads two heights and writes one vertex.
+	const double StepBytesPerCell{ 3 * sizeof(float) };
+	const double NormalBytesPerCell{ 6 * sizeof(float) };
+	const double PackBytesPerVertex{ 2 * sizeof(float) + sizeof(Vertex) };
+
+	using Clock = std::chrono::steady_clock;
+
+	double SecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Deterministic stand-in for the random splashes of WavesApp.
+	class Splasher
+	{
+	public:
+		void Disturb(Waves& waves) {
+			int i = 4 + (int)(Next() % (waves.RowCount() - 8));
+			int j = 4 + (int)(Next() % (waves.ColumnCount() - 8));
+			float magnitude = 0.2f + 0.3f * (Next() % 1000) / 1000.0f;
+			waves.Disturb(i, j, magnitude);
+		}
+
+	private:
+		std::uint32_t Next() {
+			_state = _state * 1664525u + 1013904223u;
+			return _state >> 8;
+		}
+
+		std::uint32_t _state{ 12345u };
+	};
+
+	std::vector<unsigned> DefaultThreadCounts() {
+		unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+		std::vector<unsigned> threadCounts;
+		for (unsigned threads = 1; threads < hardwareThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(hardwareThreads);
+		return threadCounts;
+	}
+
+	void Configure(Waves& waves, const WavesBenchmarkOptions& options, JobSystem& jobSystem) {
+		waves.SetJobSystem(&jobSystem);
+		if (options.StepsPerBlock > 1)
+			waves.SetTemporalBlocking(options.StepsPerBlock);
+		if (options.SparseTracking)
+			waves.SetSparseTracking(true);
+	}
+
+	void PackVertices(const Waves& waves, HostMappedBuffer<Vertex>& buffer) {
+		const XMFLOAT4 color(0.0f, 0.0f, 1.0f, 1.0f);
+		waves.WriteVertices(buffer.Elements(), [&color](const XMFLOAT3& position)
+			{
+				return ColorVertexLayout::Pack({ .Position = position, .Color = color });
+			}, waves.InterpolationFactor());
+	}
+
+	struct ScenarioResult
+	{
+		std::vector<float> Heights;
+		std::uint64_t Checksum{};
+	};
+
+	// Splashes and updates for a fixed number of frames, then checksums the heights,
+	// normals, tangents and packed vertices.
+	ScenarioResult RunScenario(Waves& waves, const WavesBenchmarkOptions& options, int substeps) {
+		Splasher splasher;
+		for (int frame = 0; frame < options.Frames; ++frame) {
+			splasher.Disturb(waves);
+			waves.Update(substeps * TimeStep);
+		}
+
+		ScenarioResult result;
+		Checksum checksum;
+		for (int i = 0; i < waves.RowCount(); ++i) {
+			const float* pHeights = waves.HeightRow(i);
+			result.Heights.insert(result.Heights.end(), pHeights, pHeights + waves.ColumnCount());
+		}
+		checksum.Add(result.Heights.data(), result.Heights.size() * sizeof(float));
+
+		for (int i = 0; i < waves.VertexCount(); ++i) {
+			XMFLOAT3 normal = waves.Normal(i);
+			XMFLOAT3 tangent = waves.TangentX(i);
+			checksum.Add(&normal, sizeof(normal));
+			checksum.Add(&tangent, sizeof(tangent));
+		}
+
+		HostMappedBuffer<Vertex> vertices(waves.VertexCount());
+		PackVertices(waves, vertices);
+		checksum.Add(vertices.Data(), (size_t)waves.VertexCount() * sizeof(Vertex));
+
+		result.Checksum = checksum.Value();
+		return result;
+	}
+}
+
+void RunWavesSweep(const WavesBenchmarkOptions& options, JsonWriter& json) {
+	std::vector<unsigned> threadCounts = options.ThreadCounts.empty() ? DefaultThreadCounts() : options.ThreadCounts;
+	std::sort(threadCounts.begin(), threadCounts.end());
+
+	json.BeginObject();
+	json.Member("benchmark", "waves");
+	json.Member("simd", WaveKernels::ToString(WaveKernels::BestAvailable()));
+	json.Member("hardwareThreads", std::max(1u, std::thread::hardware_concurrency()));
+	json.Member("stepsPerBlock", options.StepsPerBlock);
+	json.Member("sparseTracking", options.SparseTracking);
+	json.Member("frames", options.Frames);
+	json.Key("results");
+	json.BeginArray();
+
+	for (int gridSize : options.GridSizes) {
+		for (int substeps : options.Substeps) {
+			// Scaling is measured against the smallest thread count of the sweep.
+			double baselineNsPerCell = 0.0;
+			unsigned baselineThreads = threadCounts.front();
+
+			for (unsigned threads : threadCounts) {
+				JobSystem jobSystem(threads - 1);
+				Waves waves(gridSize, gridSize, SpatialStep, TimeStep, Speed, Damping);
+				Configure(waves, options, jobSystem);
+				HostMappedBuffer<Vertex> vertices(waves.VertexCount());
+
+				Splasher splasher;
+				for (int frame = 0; frame < options.WarmupFrames; ++frame) {
+					splasher.Disturb(waves);
+					waves.Update(substeps * TimeStep);
+					PackVertices(waves, vertices);
+				}
+
+				long long steps = 0;
+				double simulateSeconds = 0.0;
+				double packSeconds = 0.0;
+				for (int frame = 0; frame < options.Frames; ++frame) {
+					splasher.Disturb(waves);
+
+					auto start = Clock::now();
+					steps += waves.Update(substeps * TimeStep);
+					simulateSeconds += SecondsSince(start);
+
+					start = Clock::now();
+					PackVertices(waves, vertices);
+					packSeconds += SecondsSince(start);
+				}
+
+				double cells = (double)gridSize * gridSize;
+				double nsPerCell = simulateSeconds * 1e9 / (cells * std::max(1ll, steps));
+				double simulateBytes = cells * (steps * StepBytesPerCell + options.Frames * NormalBytesPerCell);
+				double packBytes = cells * options.Frames * PackBytesPerVertex;
+
+				if (threads == baselineThreads)
+					baselineNsPerCell = nsPerCell;
+				double speedup = baselineNsPerCell / nsPerCell;
+
+				json.BeginObject();
+				json.Member("grid", gridSize);
+				json.Member("threads", threads);
+				json.Member("substeps", substeps);
+				json.Member("steps", (std::int64_t)steps);
+				json.Member("simulateNsPerCellStep", nsPerCell);
+				json.Member("simulateGBps", simulateBytes / simulateSeconds * 1e-9);
+				json.Member("packNsPerVertex", packSeconds * 1e9 / (cells * options.Frames));
+				json.Member("packGBps", packBytes / packSeconds * 1e-9);
+				json.Member("speedup", speedup);
+				json.Member("scalingEfficiency", speedup * baselineThreads / threads);
+				json.EndObject();
+			}
+		}
+	}
+
+	json.EndArray();
+	json.EndObject();
+}
+
+bool RunWavesChecksum(const WavesBenchmarkOptions& options, JsonWriter& json) {
+	const int gridSize = options.GridSizes.front();
+	const int substeps = options.Substeps.back();
+
+	JobSystem serial(0);
+	Waves reference(gridSize, gridSize, SpatialStep, TimeStep, Speed, Damping);
+	reference.SetSimdLevel(WaveKernels::SimdLevel::Scalar);
+	reference.SetJobSystem(&serial);
+	ScenarioResult expected = RunScenario(reference, options, substeps);
+
+	bool isPassing = options.ExpectedChecksum == 0 or options.ExpectedChecksum == expected.Checksum;
+
+	json.BeginObject();
+	json.Member("benchmark", "waves-checksum");
+	json.Member("grid", gridSize);
+	json.Member("substeps", substeps);
+	json.Member("frames", options.Frames);
+	json.Member("referenceChecksum", Checksum::ToHex(expected.Checksum));
+	if (options.ExpectedChecksum != 0)
+		json.Member("expectedChecksum", Checksum::ToHex(options.ExpectedChecksum));
+	json.Key("variants");
+	json.BeginArray();
+
+	struct Variant
+	{
+		const char* Name;
+		int StepsPerBlock;
+		bool SparseTracking;
+	};
+	const Variant variants[] = {
+		{ "dense", 0, false },
+		{ "blocked", 4, false },
+		{ "sparse", 0, true },
+	};
+
+	std::vector<unsigned> threadCounts = options.ThreadCounts;
+	if (threadCounts.empty()) {
+		threadCounts = { 1 };
+		if (std::thread::hardware_concurrency() > 1)
+			threadCounts.push_back(std::thread::hardware_concurrency());
+	}
+
+	for (auto level : { WaveKernels::SimdLevel::Scalar, WaveKernels::SimdLevel::Sse2, WaveKernels::SimdLevel::Avx2 }) {
+		if (not WaveKernels::IsAvailable(level)) continue;
+
+		for (unsigned threads : threadCounts) {
+			for (const Variant& variant : variants) {
+				JobSystem jobSystem(threads - 1);
+				Waves waves(gridSize, gridSize, SpatialStep, TimeStep, Speed, Damping);
+				waves.SetSimdLevel(level);
+				waves.SetJobSystem(&jobSystem);
+				if (variant.StepsPerBlock > 1)
+					waves.SetTemporalBlocking(variant.StepsPerBlock, 64, 64);
+				if (variant.SparseTracking)
+					waves.SetSparseTracking(true, 0.0f);
+
+				ScenarioResult actual = RunScenario(waves, options, substeps);
+
+				float maxHeightError = 0.0f;
+				for (size_t i = 0; i < actual.Heights.size(); ++i)
+					maxHeightError = std::max(maxHeightError, std::abs(actual.Heights[i] - expected.Heights[i]));
+
+				bool isMatch = actual.Checksum == expected.Checksum;
+				isPassing = isPassing and isMatch;
+
+				json.BeginObject();
+				json.Member("simd", WaveKernels::ToString(level));
+				json.Member("threads", threads);
+				json.Member("variant", variant.Name);
+				json.Member("checksum", Checksum::ToHex(actual.Checksum));
+				json.Member("maxHeightError", (double)maxHeightError);
+				json.Member("match", isMatch);
+				json.EndObject();
+			}
+		}
+	}
+
+	json.EndArray();
+	json.Member("pass", isPassing);
+	json.EndObject();
+
+	return isPassing;
+}
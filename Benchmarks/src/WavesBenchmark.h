@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class JsonWriter;
+
+struct WavesBenchmarkOptions
+{
+	std::vector<int> GridSizes{ 128, 256, 512, 1024, 2048 };
+	std::vector<unsigned> ThreadCounts{};	// Empty: 1, 2, 4, ... up to the hardware threads.
+	std::vector<int> Substeps{ 1, 4 };
+	int WarmupFrames{ 10 };
+	int Frames{ 50 };
+
+	// Simulation variants, see Waves::SetTemporalBlocking and Waves::SetSparseTracking.
+	int StepsPerBlock{};
+	bool SparseTracking{};
+
+	// Checksum mode: reference checksum the scalar solver must reproduce, or 0 to
+	// only compare the optimized variants against the scalar solver.
+	std::uint64_t ExpectedChecksum{};
+};
+
+// Times Waves::Update and the vertex packing over every combination of grid size,
+// thread count and substep count.
+void RunWavesSweep(const WavesBenchmarkOptions& options, JsonWriter& json);
+
+// Runs a fixed scenario with the single threaded scalar solver and with every SIMD
+// level, thread count and stepping variant, and compares checksums of the results.
+// Returns false on any mismatch.
+bool RunWavesChecksum(const WavesBenchmarkOptions& options, JsonWriter& json);
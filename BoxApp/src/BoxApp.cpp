@@ -4,6 +4,8 @@
 #include <DirectXColors.h>
 #include <d3dcompiler.h>
 
+#include "MeshBounds.h"
+
 using namespace DirectX;
 
 BoxApp::BoxApp(HINSTANCE hInstance)
@@ -261,27 +263,8 @@ void BoxApp::BuildShaders()
 
 void BoxApp::BuildInputLayout()
 {
-	D3D12_INPUT_ELEMENT_DESC positionDesc{
-		.SemanticName = "Position",
-		.SemanticIndex = 0,
-		.Format = DXGI_FORMAT_R32G32B32_FLOAT,
-		.InputSlot = 0,
-		.AlignedByteOffset = 0,
-		.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-		.InstanceDataStepRate = 0,
-	};
-
-	D3D12_INPUT_ELEMENT_DESC elementDesc{
-	.SemanticName = "Color",
-	.SemanticIndex = 0,
-	.Format = DXGI_FORMAT_R32G32B32A32_FLOAT,
-	.InputSlot = 0,
-	.AlignedByteOffset = 12,
-	.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-	.InstanceDataStepRate = 0,
-	};
-
-	_inputLayout = { positionDesc , elementDesc };
+	auto inputElements = InputLayout::Elements<ColorVertexLayout>();
+	_inputLayout.assign(inputElements.begin(), inputElements.end());
 }
 
 void BoxApp::BuildBoxGeometry()
@@ -291,14 +274,14 @@ void BoxApp::BuildBoxGeometry()
 
 	std::array<Vertex, 8> vertices
 	{
-		XMFLOAT3(-1, -1, -1), XMFLOAT4(Colors::White),
-		XMFLOAT3(-1,  1, -1), XMFLOAT4(Colors::Black),
-		XMFLOAT3(1,  1, -1), XMFLOAT4(Colors::Red),
-		XMFLOAT3(1, -1, -1), XMFLOAT4(Colors::Green),
-		XMFLOAT3(-1, -1,  1), XMFLOAT4(Colors::Blue),
-		XMFLOAT3(-1,  1,  1), XMFLOAT4(Colors::Yellow),
-		XMFLOAT3(1,  1,  1), XMFLOAT4(Colors::Cyan),
-		XMFLOAT3(1, -1,  1), XMFLOAT4(Colors::Magenta),
+		ColorVertexLayout::Pack({ .Position = XMFLOAT3(-1, -1, -1), .Color = XMFLOAT4(Colors::White) }),
+		ColorVertexLayout::Pack({ .Position = XMFLOAT3(-1,  1, -1), .Color = XMFLOAT4(Colors::Black) }),
+		ColorVertexLayout::Pack({ .Position = XMFLOAT3(1,  1, -1), .Color = XMFLOAT4(Colors::Red) }),
+		ColorVertexLayout::Pack({ .Position = XMFLOAT3(1, -1, -1), .Color = XMFLOAT4(Colors::Green) }),
+		ColorVertexLayout::Pack({ .Position = XMFLOAT3(-1, -1,  1), .Color = XMFLOAT4(Colors::Blue) }),
+		ColorVertexLayout::Pack({ .Position = XMFLOAT3(-1,  1,  1), .Color = XMFLOAT4(Colors::Yellow) }),
+		ColorVertexLayout::Pack({ .Position = XMFLOAT3(1,  1,  1), .Color = XMFLOAT4(Colors::Cyan) }),
+		ColorVertexLayout::Pack({ .Position = XMFLOAT3(1, -1,  1), .Color = XMFLOAT4(Colors::Magenta) }),
 	};
 
 	std::array<uint16_t, 36> indices
@@ -347,10 +330,15 @@ void BoxApp::BuildBoxGeometry()
 	_pMeshGeometry->IndexFormat = DXGI_FORMAT_R16_UINT;
 	_pMeshGeometry->IndexBufferByteSize = iBufferByteSize;
 
+	// Position is the first attribute of the vertex layout.
+	auto bounds = MeshBounds::Compute(reinterpret_cast<const XMFLOAT3*>(vertices.data()), vertices.size(), sizeof(Vertex));
+
 	_pMeshGeometry->DrawArguments["box"] = {
 		.IndexCount = (UINT) indices.size(),
 		.StartIndexLocation = 0,
 		.BaseVertexLocation = 0,
+		.BoundingBox = bounds.Box,
+		.BoundingSphere = bounds.Sphere,
 	};
 }
 
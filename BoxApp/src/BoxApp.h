@@ -8,12 +8,9 @@
 #include "UploadBuffer.h"
 #include "MathHelper.h"
 #include "MeshGeometry.h"
+#include "InputLayout.h"
 
-struct Vertex
-{
-	DirectX::XMFLOAT3 Pos;
-	DirectX::XMFLOAT4 Color;
-};
+using Vertex = ColorVertexLayout::Vertex;
 
 struct ObjectConstants
 {
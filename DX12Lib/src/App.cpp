@@ -644,7 +644,8 @@ void App::CalculateFrameStats()
 
 		std::wstring windowText = _title +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            FrameStatsText();
 
         SetWindowText(_hWnd, windowText.c_str());
 		
@@ -45,6 +45,9 @@ protected:
     virtual void OnMouseUp(WPARAM, int, int) {}
     virtual void OnMouseMove(WPARAM, int, int) {}
 
+    // Extra text for the window title, refreshed with the frame rate.
+    virtual std::wstring FrameStatsText() const { return {}; }
+
 protected:
 
     bool InitMainWindow();
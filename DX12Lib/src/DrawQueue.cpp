@@ -0,0 +1,98 @@
+#include "DrawQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+
+using uint32 = DrawQueue::uint32;
+using uint64 = DrawQueue::uint64;
+
+namespace
+{
+	// Below this many packets a comparison sort beats clearing the histograms.
+	const size_t SmallSortCount{ 64 };
+}
+
+DrawQueue::Statistics& DrawQueue::Statistics::operator+=(const Statistics& other) {
+	PacketCount += other.PacketCount;
+	DrawCount += other.DrawCount;
+	PipelineStateChanges += other.PipelineStateChanges;
+	GeometryChanges += other.GeometryChanges;
+	TopologyChanges += other.TopologyChanges;
+	SavedStateChanges += other.SavedStateChanges;
+	return *this;
+}
+
+uint64 DrawQueue::MakeKey(uint32 pipelineState, uint32 geometry, uint32 topology, uint32 mesh, float viewDepth) {
+	assert(pipelineState <= 0xFF and geometry <= 0xFFFF and topology <= 0xFF and mesh <= 0xFFFF);
+
+	// Non-negative floats order the same as their bit patterns; the top half keeps the
+	// exponent and 7 bits of mantissa, plenty to draw front to back.
+	uint32 depthBits = viewDepth > 0.0f ? std::bit_cast<uint32>(viewDepth) >> 16 : 0;
+	return (uint64)pipelineState << 56 | (uint64)geometry << 40 | (uint64)topology << 32 | (uint64)mesh << 16 | depthBits;
+}
+
+void DrawQueue::Sort() {
+	const size_t count = _packets.size();
+	if (count <= SmallSortCount) {
+		std::stable_sort(_packets.begin(), _packets.end(), [](const DrawPacket& a, const DrawPacket& b) {
+			return a.SortKey < b.SortKey;
+		});
+		return;
+	}
+
+	// Least significant byte first; a counting sort per byte keeps the order of equal
+	// bytes, so the result is sorted on the whole key and stable.
+	std::array<std::array<uint32, 256>, 8> histograms{};
+	for (const DrawPacket& packet : _packets) {
+		for (int byte = 0; byte < 8; ++byte)
+			histograms[byte][(packet.SortKey >> (8 * byte)) & 0xFF]++;
+	}
+
+	_scratch.resize(count);
+	DrawPacket* pSource = _packets.data();
+	DrawPacket* pTarget = _scratch.data();
+	for (int byte = 0; byte < 8; ++byte) {
+		const int shift = 8 * byte;
+		std::array<uint32, 256>& offsets = histograms[byte];
+
+		// Ids and depths rarely use every byte; a byte all keys share moves nothing.
+		if (offsets[(pSource[0].SortKey >> shift) & 0xFF] == count)
+			continue;
+
+		uint32 offset = 0;
+		for (uint32& bucket : offsets) {
+			uint32 bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			pTarget[offsets[(pSource[i].SortKey >> shift) & 0xFF]++] = pSource[i];
+		std::swap(pSource, pTarget);
+	}
+
+	if (pSource != _packets.data())
+		_packets.swap(_scratch);
+}
+
+void DrawQueue::Split(uint32 maxChunkCount, uint32 minPacketCount, std::vector<Chunk>& chunks) const {
+	assert(maxChunkCount > 0);
+	const uint32 count = (uint32)_packets.size();
+	const uint32 chunkCount = std::clamp(count / std::max(minPacketCount, 1u), 1u, maxChunkCount);
+
+	chunks.clear();
+	for (uint32 k = 1, first = 0; k <= chunkCount and first < count; ++k) {
+		uint32 last = std::max(first, (uint32)((uint64)count * k / chunkCount));
+
+		// Move the end past the rest of the draw it splits.
+		while (last > 0 and last < count and IsSameDraw(_packets[last - 1].SortKey, _packets[last].SortKey))
+			++last;
+
+		if (last > first) chunks.push_back({ first, last });
+		first = last;
+	}
+
+	if (chunks.empty()) chunks.push_back({ 0, 0 });
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// A draw: its sort key and the caller's index of the thing it draws.
+struct DrawPacket
+{
+	std::uint64_t SortKey{};
+	std::uint32_t Item{};
+};
+
+// Per frame list of draws, sorted by a 64 bit key so that draws sharing state end up
+// next to each other, and submitted with only the state changes between neighbours.
+//
+// From the most significant bits down, a key holds the pipeline state (8 bits), the
+// geometry (16 bits), the primitive topology (8 bits), the mesh (16 bits) and the view
+// depth (16 bits). Draws group by pipeline state, geometry and mesh, and run front to
+// back within a group. The ids are the caller's; only their equality and order
+// matter, and a mesh id must stand for one set of draw arguments.
+class DrawQueue
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Statistics
+	{
+		uint32 PacketCount{};
+		uint32 DrawCount{};
+		uint32 PipelineStateChanges{};
+		uint32 GeometryChanges{};
+		uint32 TopologyChanges{};
+
+		// Changes a submission binding all three states for every packet would have made.
+		// Runs of the same mesh are merged into one draw, so StateChanges() +
+		// SavedStateChanges is 3 * PacketCount, not 3 * DrawCount.
+		uint32 SavedStateChanges{};
+
+		uint32 StateChanges() const { return PipelineStateChanges + GeometryChanges + TopologyChanges; }
+
+		Statistics& operator+=(const Statistics& other);
+	};
+
+	// Packets [First, Last), recorded onto one command list.
+	struct Chunk
+	{
+		uint32 First{};
+		uint32 Last{};
+	};
+
+	// viewDepth below zero, behind the eye, sorts as zero.
+	static uint64 MakeKey(uint32 pipelineState, uint32 geometry, uint32 topology, uint32 mesh, float viewDepth);
+
+	static uint32 PipelineState(uint64 key) { return (uint32)(key >> 56); }
+	static uint32 Geometry(uint64 key) { return (uint32)(key >> 40) & 0xFFFF; }
+	static uint32 Topology(uint64 key) { return (uint32)(key >> 32) & 0xFF; }
+	static uint32 Mesh(uint64 key) { return (uint32)(key >> 16) & 0xFFFF; }
+
+	// Packets whose keys only differ in depth draw the same mesh with the same state.
+	static bool IsSameDraw(uint64 a, uint64 b) { return (a >> 16) == (b >> 16); }
+
+	void Clear() { _packets.clear(); }
+	void Add(uint64 sortKey, uint32 item) { _packets.push_back({ sortKey, item }); }
+
+	// Stable: packets with equal keys keep the order they were added in.
+	void Sort();
+
+	std::span<const DrawPacket> Packets() const { return _packets; }
+
+	// Splits the packets into at most maxChunkCount chunks of about equal size and no
+	// fewer than minPacketCount packets. Chunks start at the first packet of a draw, so
+	// runs of the same mesh stay whole. There is always at least one chunk.
+	void Split(uint32 maxChunkCount, uint32 minPacketCount, std::vector<Chunk>& chunks) const;
+
+	template<typename TCommandList>
+	Statistics Submit(TCommandList& commandList) const {
+		return Submit(commandList, Chunk{ 0, (uint32)_packets.size() });
+	}
+
+	// Records the packets of a chunk in order. TCommandList provides SetPipelineState, SetGeometry
+	// and SetPrimitiveTopology, each taking the first packet they apply to, and Draw,
+	// taking a span of packets. The setters are only called for the first packet and
+	// when their field of the key changes. Each run of packets drawing the same mesh is
+	// passed to Draw at once, to be drawn instanced or one by one. A chunk starts from
+	// scratch, as recorded onto a command list of its own.
+	template<typename TCommandList>
+	Statistics Submit(TCommandList& commandList, Chunk chunk) const {
+		assert(chunk.First <= chunk.Last and chunk.Last <= _packets.size());
+		Statistics statistics;
+		statistics.PacketCount = chunk.Last - chunk.First;
+
+		for (size_t first = chunk.First; first < chunk.Last; ) {
+			const DrawPacket& packet = _packets[first];
+			bool isFirst = first == chunk.First;
+			uint64 previousKey = isFirst ? 0 : _packets[first - 1].SortKey;
+
+			if (isFirst or PipelineState(packet.SortKey) != PipelineState(previousKey)) {
+				commandList.SetPipelineState(packet);
+				statistics.PipelineStateChanges++;
+			}
+			if (isFirst or Geometry(packet.SortKey) != Geometry(previousKey)) {
+				commandList.SetGeometry(packet);
+				statistics.GeometryChanges++;
+			}
+			if (isFirst or Topology(packet.SortKey) != Topology(previousKey)) {
+				commandList.SetPrimitiveTopology(packet);
+				statistics.TopologyChanges++;
+			}
+
+			size_t last = first + 1;
+			while (last < chunk.Last and IsSameDraw(_packets[last].SortKey, packet.SortKey))
+				++last;
+
+			commandList.Draw(std::span<const DrawPacket>(_packets.data() + first, last - first));
+			statistics.DrawCount++;
+			first = last;
+		}
+
+		statistics.SavedStateChanges = 3 * statistics.PacketCount - statistics.StateChanges();
+		return statistics;
+	}
+
+private:
+	std::vector<DrawPacket> _packets{};
+	std::vector<DrawPacket> _scratch{};
+};
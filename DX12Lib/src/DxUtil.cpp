@@ -1,5 +1,6 @@
 #include "DxUtil.h"
 
+#include <cstring>
 #include <fstream>
 #include <vector>
 #include <d3dcompiler.h>
@@ -85,6 +86,17 @@ ComPtr<ID3D12Resource> DxUtil::CreateDefaultBuffer(
     const void* pInitData, 
     UINT64 byteSize, 
     ComPtr<ID3D12Resource>& pUploadBuffer) 
+{
+    return CreateDefaultBuffer(pDevice, pCommandList, byteSize, pUploadBuffer,
+        [&](void* pUploadData) { std::memcpy(pUploadData, pInitData, (size_t)byteSize); });
+}
+
+ComPtr<ID3D12Resource> DxUtil::CreateDefaultBuffer(
+    ID3D12Device* pDevice,
+    ID3D12GraphicsCommandList* pCommandList,
+    UINT64 byteSize,
+    ComPtr<ID3D12Resource>& pUploadBuffer,
+    const std::function<void(void* pUploadData)>& writeData)
 {
 #pragma region Create Buffers
     auto heapProperties1 = D3D12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
@@ -113,12 +125,12 @@ ComPtr<ID3D12Resource> DxUtil::CreateDefaultBuffer(
 #pragma endregion
 
 #pragma region Upload to default buffer
-    D3D12_SUBRESOURCE_DATA subResourceData{
-        .pData = pInitData,
-        .RowPitch = (LONG_PTR) byteSize,
-        .SlicePitch = (LONG_PTR) byteSize,
-    };
-
+    // The CPU does not read the upload buffer back.
+    D3D12_RANGE readRange{ 0, 0 };
+    void* pUploadData{};
+    THROW_IF_FAILED(pUploadBuffer->Map(0, &readRange, &pUploadData));
+    writeData(pUploadData);
+    pUploadBuffer->Unmap(0, nullptr);
 
     auto barrier1 = CD3DX12_RESOURCE_BARRIER::Transition(
         pDefaultBuffer.Get(),
@@ -126,13 +138,7 @@ ComPtr<ID3D12Resource> DxUtil::CreateDefaultBuffer(
         D3D12_RESOURCE_STATE_COPY_DEST);
     pCommandList->ResourceBarrier(1, &barrier1);
 
-    UpdateSubresources<1>(pCommandList,
-            pDefaultBuffer.Get(),
-            pUploadBuffer.Get(), 
-            0, 
-            0, 
-            1, 
-            &subResourceData);
+    pCommandList->CopyBufferRegion(pDefaultBuffer.Get(), 0, pUploadBuffer.Get(), 0, byteSize);
 
     auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(
         pDefaultBuffer.Get(),
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <Windows.h>
 #include <wrl.h>
@@ -30,6 +31,16 @@ namespace DxUtil
         Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer
     );
 
+    // Same, but writeData fills the mapped upload buffer itself, so data can be
+    // generated or converted in place instead of being staged in another copy first.
+    Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
+        ID3D12Device* pDevice,
+        ID3D12GraphicsCommandList* pCommandList,
+        UINT64 byteSize,
+        Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
+        const std::function<void(void* pUploadData)>& writeData
+    );
+
     class FileNotFoundException : std::exception
     {
     public:
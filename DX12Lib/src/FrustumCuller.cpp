@@ -0,0 +1,172 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#include "MeshBounds.h"
+#include "SimdSupport.h"
+
+using namespace DirectX;
+using uint32 = FrustumCuller::uint32;
+
+namespace
+{
+	constexpr uint32 RoundUpToFour(uint32 count) {
+		return (count + 3) & ~3u;
+	}
+}
+
+// Planes of the clip space volume -w <= x <= w, -w <= y <= w, 0 <= z <= w pulled back
+// through viewProj (Gribb and Hartmann). With row vectors a clip coordinate is the
+// dot product of the point with a column, so the planes are sums and differences of
+// columns. They are not normalized: only the sign is used.
+FrustumPlanes FrustumPlanes::FromViewProjection(const XMFLOAT4X4& viewProj) {
+	FrustumPlanes planes;
+	float* coefficients[4] = { planes.A, planes.B, planes.C, planes.D };
+	for (int row = 0; row < 4; ++row) {
+		float x = viewProj.m[row][0];
+		float y = viewProj.m[row][1];
+		float z = viewProj.m[row][2];
+		float w = viewProj.m[row][3];
+
+		float* plane = coefficients[row];
+		plane[0] = w + x; // left
+		plane[1] = w - x; // right
+		plane[2] = w + y; // bottom
+		plane[3] = w - y; // top
+		plane[4] = z;     // near
+		plane[5] = w - z; // far
+	}
+	return planes;
+}
+
+void FrustumCuller::Resize(uint32 itemCount) {
+	uint32 oldPaddedCount = (uint32)_centerX.size();
+	uint32 paddedCount = RoundUpToFour(itemCount);
+
+	_centerX.resize(paddedCount, 0.0f);
+	_centerY.resize(paddedCount, 0.0f);
+	_centerZ.resize(paddedCount, 0.0f);
+	_extentX.resize(paddedCount, FLT_MAX);
+	_extentY.resize(paddedCount, FLT_MAX);
+	_extentZ.resize(paddedCount, FLT_MAX);
+
+	// Items that were padding before growing start out unbounded as well.
+	for (uint32 i = std::min(_itemCount, paddedCount); i < std::min(oldPaddedCount, paddedCount); ++i)
+		SetUnbounded(i);
+
+	_itemCount = itemCount;
+}
+
+void FrustumCuller::SetBounds(uint32 item, const BoundingBox& localBox, const XMFLOAT4X4& world) {
+	BoundingBox box = MeshBounds::Transform(localBox, world);
+	_centerX[item] = box.Center.x;
+	_centerY[item] = box.Center.y;
+	_centerZ[item] = box.Center.z;
+	_extentX[item] = box.Extents.x;
+	_extentY[item] = box.Extents.y;
+	_extentZ[item] = box.Extents.z;
+}
+
+void FrustumCuller::SetUnbounded(uint32 item) {
+	_centerX[item] = 0.0f;
+	_centerY[item] = 0.0f;
+	_centerZ[item] = 0.0f;
+	_extentX[item] = FLT_MAX;
+	_extentY[item] = FLT_MAX;
+	_extentZ[item] = FLT_MAX;
+}
+
+uint32 FrustumCuller::CullRange(const FrustumPlanes& planes, uint32 first, uint32 last, uint32* pVisible) const {
+	uint32 visibleCount = 0;
+
+	// A box is outside when it lies entirely behind one of the planes: its center's
+	// distance plus its extents projected on the plane normal is negative.
+#if DX12_HAS_SSE2
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 a[FrustumPlanes::Count], b[FrustumPlanes::Count], c[FrustumPlanes::Count], d[FrustumPlanes::Count];
+	__m128 absA[FrustumPlanes::Count], absB[FrustumPlanes::Count], absC[FrustumPlanes::Count];
+	for (int p = 0; p < FrustumPlanes::Count; ++p) {
+		a[p] = _mm_set1_ps(planes.A[p]);
+		b[p] = _mm_set1_ps(planes.B[p]);
+		c[p] = _mm_set1_ps(planes.C[p]);
+		d[p] = _mm_set1_ps(planes.D[p]);
+		absA[p] = _mm_andnot_ps(signMask, a[p]);
+		absB[p] = _mm_andnot_ps(signMask, b[p]);
+		absC[p] = _mm_andnot_ps(signMask, c[p]);
+	}
+
+	for (uint32 i = first; i < last; i += 4) {
+		__m128 cx = _mm_load_ps(&_centerX[i]);
+		__m128 cy = _mm_load_ps(&_centerY[i]);
+		__m128 cz = _mm_load_ps(&_centerZ[i]);
+		__m128 ex = _mm_load_ps(&_extentX[i]);
+		__m128 ey = _mm_load_ps(&_extentY[i]);
+		__m128 ez = _mm_load_ps(&_extentZ[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < FrustumPlanes::Count; ++p) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, a[p]), _mm_mul_ps(cy, b[p])), _mm_add_ps(_mm_mul_ps(cz, c[p]), d[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, absA[p]), _mm_mul_ps(ey, absB[p])), _mm_mul_ps(ez, absC[p]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		uint32 visibleMask = ~(uint32)_mm_movemask_ps(outside) & 0xF;
+		if (last - i < 4)
+			visibleMask &= (1u << (last - i)) - 1;
+
+		for (; visibleMask != 0; visibleMask &= visibleMask - 1)
+			pVisible[visibleCount++] = i + (uint32)std::countr_zero(visibleMask);
+	}
+#else
+	for (uint32 i = first; i < last; ++i) {
+		bool isOutside = false;
+		for (int p = 0; p < FrustumPlanes::Count and not isOutside; ++p) {
+			float distance = _centerX[i] * planes.A[p] + _centerY[i] * planes.B[p] + _centerZ[i] * planes.C[p] + planes.D[p];
+			float radius = _extentX[i] * fabsf(planes.A[p]) + _extentY[i] * fabsf(planes.B[p]) + _extentZ[i] * fabsf(planes.C[p]);
+			isOutside = distance + radius < 0.0f;
+		}
+
+		if (not isOutside)
+			pVisible[visibleCount++] = i;
+	}
+#endif
+
+	return visibleCount;
+}
+
+void FrustumCuller::Cull(const XMFLOAT4X4& viewProj, std::vector<uint32>& visibleItems, JobSystem& jobSystem) {
+	auto start = std::chrono::steady_clock::now();
+
+	FrustumPlanes planes = FrustumPlanes::FromViewProjection(viewProj);
+
+	uint32 chunkCount = (_itemCount + ChunkSize - 1) / ChunkSize;
+	if (chunkCount <= 1) {
+		visibleItems.resize(_itemCount);
+		visibleItems.resize(CullRange(planes, 0, _itemCount, visibleItems.data()));
+	}
+	else {
+		// Every chunk writes to its own part of the scratch list, which is then
+		// compacted in chunk order.
+		_chunkVisible.resize(_itemCount);
+		_chunkCounts.resize(chunkCount);
+		jobSystem.ParallelFor(0, chunkCount, 1, [&](size_t chunk) {
+			uint32 first = (uint32)chunk * ChunkSize;
+			uint32 last = std::min(first + ChunkSize, _itemCount);
+			_chunkCounts[chunk] = CullRange(planes, first, last, &_chunkVisible[first]);
+		});
+
+		visibleItems.clear();
+		for (uint32 chunk = 0; chunk < chunkCount; ++chunk) {
+			auto chunkBegin = _chunkVisible.begin() + (size_t)chunk * ChunkSize;
+			visibleItems.insert(visibleItems.end(), chunkBegin, chunkBegin + _chunkCounts[chunk]);
+		}
+	}
+
+	_statistics.TestedCount = _itemCount;
+	_statistics.VisibleCount = (uint32)visibleItems.size();
+	_statistics.CullMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
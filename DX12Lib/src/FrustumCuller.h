@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include "AlignedAllocator.h"
+#include "JobSystem.h"
+
+// The six planes of a view frustum as A * x + B * y + C * z + D >= 0 inside, split by
+// component so they can be splatted straight into SIMD registers.
+struct FrustumPlanes
+{
+	static constexpr int Count{ 6 };
+
+	float A[Count];
+	float B[Count];
+	float C[Count];
+	float D[Count];
+
+	// Planes of viewProj, a row vector view * projection matrix as kept on the CPU.
+	static FrustumPlanes FromViewProjection(const DirectX::XMFLOAT4X4& viewProj);
+};
+
+// View frustum culling of many items at once.
+//
+// Every item has a world space bounding box, kept as structure of arrays so four
+// boxes are tested against a plane with a handful of SIMD instructions. Cull()
+// extracts the frustum planes from a view-projection matrix and writes the indices
+// of the items that may be visible. Large item counts are split over a JobSystem;
+// the output is in increasing item order either way.
+class FrustumCuller
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct Statistics
+	{
+		uint32 TestedCount{};
+		uint32 VisibleCount{};
+		double CullMilliseconds{};
+	};
+
+	// Sets the number of items. New items have no bounds and are always visible.
+	void Resize(uint32 itemCount);
+	uint32 ItemCount() const { return _itemCount; }
+
+	// Sets an item's bounds to localBox transformed by world. The result is the box
+	// around the transformed box, so rotated items are culled conservatively.
+	void SetBounds(uint32 item, const DirectX::BoundingBox& localBox, const DirectX::XMFLOAT4X4& world);
+
+	// Makes an item always visible.
+	void SetUnbounded(uint32 item);
+
+	// Replaces visibleItems with the items whose bounds intersect the frustum of
+	// viewProj, a row vector view * projection matrix as kept on the CPU.
+	void Cull(const DirectX::XMFLOAT4X4& viewProj, std::vector<uint32>& visibleItems,
+		JobSystem& jobSystem = JobSystem::Default());
+
+	// Counts of the last Cull().
+	const Statistics& LastStatistics() const { return _statistics; }
+
+private:
+	// Items per job; below this culling is not worth handing to other threads.
+	static constexpr uint32 ChunkSize{ 1024 };
+
+	// Appends the visible items of [first, last) to pVisible and returns their count.
+	uint32 CullRange(const FrustumPlanes& planes, uint32 first, uint32 last, uint32* pVisible) const;
+
+	uint32 _itemCount{};
+
+	// Padded to a multiple of four items so the SIMD loop needs no tail.
+	AlignedVector<float> _centerX{};
+	AlignedVector<float> _centerY{};
+	AlignedVector<float> _centerZ{};
+	AlignedVector<float> _extentX{};
+	AlignedVector<float> _extentY{};
+	AlignedVector<float> _extentZ{};
+
+	std::vector<uint32> _chunkVisible{};
+	std::vector<uint32> _chunkCounts{};
+
+	Statistics _statistics{};
+};
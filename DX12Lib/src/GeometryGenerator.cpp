@@ -1,14 +1,223 @@
 #include "GeometryGenerator.h"
 
 #include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "IndexPacking.h"
+#include "JobSystem.h"
 
 using namespace DirectX;
 
+namespace
+{
+	// Create* overloads that return MeshData allocate it once, at its final size.
+	GeometryGenerator::MeshData AllocateMeshData(GeometryGenerator::MeshSize size) {
+		GeometryGenerator::MeshData meshData;
+		meshData.Vertices.resize(size.VertexCount);
+		meshData.Indices32.resize(size.IndexCount);
+		return meshData;
+	}
+
+	// cos and sin of j * angleStep for every slice j in [0, sliceCount]. Every ring of a
+	// sphere or cylinder uses the same angles around the y axis.
+	struct SliceTable
+	{
+		std::vector<float> Cos;
+		std::vector<float> Sin;
+	};
+
+	SliceTable MakeSliceTable(std::uint32_t sliceCount, float angleStep) {
+		SliceTable table;
+		table.Cos.resize(sliceCount + 1);
+		table.Sin.resize(sliceCount + 1);
+		for (std::uint32_t j = 0; j <= sliceCount; ++j) {
+			table.Cos[j] = cosf(j * angleStep);
+			table.Sin[j] = sinf(j * angleStep);
+		}
+		return table;
+	}
+
+	// Rings and stacks are independent; split them across the job system in chunks of
+	// about 4K vertices.
+	size_t RingGrainSize(std::uint32_t sliceCount) {
+		return std::max<size_t>(1, 4096 / (sliceCount + 1));
+	}
+
+	// Projects count <= 4 vertices onto the sphere and derives normal, tangent and
+	// texture coordinates. The vectors are handled four at a time, one vertex per lane.
+	void ProjectOntoSphere(GeometryGenerator::Vertex* pVertices, size_t count, float radius) {
+		// Unused lanes get a harmless (0, 1, 0).
+		XMFLOAT4 x(0.0f, 0.0f, 0.0f, 0.0f);
+		XMFLOAT4 y(1.0f, 1.0f, 1.0f, 1.0f);
+		XMFLOAT4 z(0.0f, 0.0f, 0.0f, 0.0f);
+		for (size_t i = 0; i < count; ++i) {
+			(&x.x)[i] = pVertices[i].Position.x;
+			(&y.x)[i] = pVertices[i].Position.y;
+			(&z.x)[i] = pVertices[i].Position.z;
+		}
+
+		// Project onto unit sphere.
+		XMVECTOR X = XMLoadFloat4(&x);
+		XMVECTOR Y = XMLoadFloat4(&y);
+		XMVECTOR Z = XMLoadFloat4(&z);
+		XMVECTOR length = XMVectorSqrt(X * X + Y * Y + Z * Z);
+		X = X / length;
+		Y = Y / length;
+		Z = Z / length;
+
+		// Partial derivative of P with respect to theta, normalized: (-sin(theta), 0, cos(theta)).
+		// It is undefined at the poles; use theta = 0 there.
+		XMVECTOR xzLength = XMVectorSqrt(X * X + Z * Z);
+		XMVECTOR isPole = XMVectorEqual(xzLength, XMVectorZero());
+		XMVECTOR tangentX = XMVectorSelect(-Z / xzLength, XMVectorZero(), isPole);
+		XMVECTOR tangentZ = XMVectorSelect(X / xzLength, XMVectorSplatOne(), isPole);
+
+		XMFLOAT4 nx, ny, nz, tx, tz;
+		XMStoreFloat4(&nx, X);
+		XMStoreFloat4(&ny, Y);
+		XMStoreFloat4(&nz, Z);
+		XMStoreFloat4(&tx, tangentX);
+		XMStoreFloat4(&tz, tangentZ);
+
+		for (size_t i = 0; i < count; ++i) {
+			GeometryGenerator::Vertex& v = pVertices[i];
+			v.Normal = XMFLOAT3((&nx.x)[i], (&ny.x)[i], (&nz.x)[i]);
+			v.Position = XMFLOAT3(radius * v.Normal.x, radius * v.Normal.y, radius * v.Normal.z);
+			v.TangentU = XMFLOAT3((&tx.x)[i], 0.0f, (&tz.x)[i]);
+
+			// Derive texture coordinates from spherical coordinates.
+			float theta = atan2f(v.Normal.z, v.Normal.x);
+
+			// Put in [0, 2pi].
+			if (theta < 0.0f)
+				theta += XM_2PI;
+
+			float phi = acosf(std::clamp(v.Normal.y, -1.0f, 1.0f));
+
+			v.TexC.x = theta / XM_2PI;
+			v.TexC.y = phi / XM_PI;
+		}
+	}
+
+	// Open addressing hash map from an undirected edge to the vertex at its midpoint.
+	class EdgeMidpoints
+	{
+	public:
+		explicit EdgeMidpoints(size_t maxEdgeCount) {
+			// Keep the load factor at or below one half.
+			size_t capacity = 16;
+			while (capacity < 2 * maxEdgeCount)
+				capacity *= 2;
+			_slots.assign(capacity, Slot{ EmptyKey, 0 });
+			_mask = capacity - 1;
+		}
+
+		// Returns the midpoint of edge (a, b); isNew is set when the edge was not
+		// present and the caller has to fill in the returned midpoint index.
+		std::uint32_t& FindOrInsert(std::uint32_t a, std::uint32_t b, bool& isNew) {
+			std::uint64_t key = Key(a, b);
+			size_t i = Hash(key);
+			while (_slots[i].Key != key and _slots[i].Key != EmptyKey)
+				i = (i + 1) & _mask;
+
+			isNew = _slots[i].Key == EmptyKey;
+			_slots[i].Key = key;
+			return _slots[i].Midpoint;
+		}
+
+		std::uint32_t Find(std::uint32_t a, std::uint32_t b) const {
+			std::uint64_t key = Key(a, b);
+			size_t i = Hash(key);
+			while (_slots[i].Key != key) {
+				assert(_slots[i].Key != EmptyKey);
+				i = (i + 1) & _mask;
+			}
+			return _slots[i].Midpoint;
+		}
+
+	private:
+		// Both directions of an edge map to the same key. a != b, so no edge has the empty key.
+		static std::uint64_t Key(std::uint32_t a, std::uint32_t b) {
+			return a < b ? (std::uint64_t)a << 32 | b : (std::uint64_t)b << 32 | a;
+		}
+
+		size_t Hash(std::uint64_t key) const {
+			return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & _mask;
+		}
+
+		struct Slot
+		{
+			std::uint64_t Key;
+			std::uint32_t Midpoint;
+		};
+
+		static constexpr std::uint64_t EmptyKey{ ~0ull };
+
+		std::vector<Slot> _slots;
+		size_t _mask{};
+	};
+}
+
+void GeometryGenerator::MeshData::ComputeBounds() {
+	Bounds = MeshBounds::Compute(Vertices.empty() ? nullptr : &Vertices[0].Position, Vertices.size(), sizeof(Vertex));
+}
+
+GeometryGenerator::uint32 GeometryGenerator::MeshData::MaxIndex() const {
+	return IndexPacking::MaxIndex(Indices32);
+}
+
+GeometryGenerator::uint32 GeometryGenerator::MeshData::IndexByteSize() const {
+	return IndexPacking::IndexByteSize(MaxIndex());
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(uint32 nrSubdivisions) {
+	// Every face is a (2^s + 1) x (2^s + 1) vertex grid; faces don't share vertices.
+	uint32 edgeVertexCount = (1u << std::min<uint32>(nrSubdivisions, 6u)) + 1;
+	uint32 triangleCount = 12u << (2 * std::min<uint32>(nrSubdivisions, 6u));
+	return { 6 * edgeVertexCount * edgeVertexCount, 3 * triangleCount };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount) {
+	// Two poles plus stackCount - 1 rings; a triangle fan at each pole and two triangles
+	// per quad in between.
+	return { (stackCount - 1) * (sliceCount + 1) + 2, 6 * sliceCount * (stackCount - 1) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(uint32 numSubdivisions) {
+	// A closed triangle mesh with T = 20 * 4^s triangles has 3T/2 edges and, by Euler's
+	// formula, T/2 + 2 vertices.
+	uint32 triangleCount = 20u << (2 * std::min<uint32>(numSubdivisions, 6u));
+	return { triangleCount / 2 + 2, 3 * triangleCount };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount) {
+	// stackCount + 1 rings, and per cap a ring and a center vertex.
+	uint32 ringVertexCount = sliceCount + 1;
+	return { (stackCount + 1) * ringVertexCount + 2 * (ringVertexCount + 1), 6 * sliceCount * stackCount + 2 * 3 * sliceCount };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n) {
+	return { m * n, (m - 1) * (n - 1) * 6 };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::QuadSize() {
+	return { 4, 6 };
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 nrSubdivisions) {
-	MeshData meshData{};
+	MeshData meshData = AllocateMeshData(BoxSize(nrSubdivisions));
+	CreateBox(width, height, depth, nrSubdivisions, meshData.Vertices, meshData.Indices32);
+	meshData.ComputeBounds();
+	return meshData;
+}
+
+void GeometryGenerator::CreateBox(float width, float height, float depth, uint32 nrSubdivisions,
+	std::span<Vertex> vertices, std::span<uint32> indices) {
+	assert(vertices.size() >= BoxSize(nrSubdivisions).VertexCount and indices.size() >= BoxSize(nrSubdivisions).IndexCount);
 
 #pragma region Vertices
-	Vertex v[24]{};
+	Vertex* v = vertices.data();
 
 	float w2 = 0.5f * width;
 	float h2 = 0.5f * height;
@@ -50,12 +259,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
 	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
 
-	meshData.Vertices.assign(&v[0], &v[24]);
-
 #pragma endregion Vertices
 
 #pragma region Indices
-	uint32 i[36];
+	uint32* i = indices.data();
 
 	// Fill in the front face index data
 	i[0] = 0; i[1] = 1; i[2] = 2;
@@ -80,21 +287,27 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	// Fill in the right face index data
 	i[30] = 20; i[31] = 21; i[32] = 22;
 	i[33] = 20; i[34] = 22; i[35] = 23;
-
-	meshData.Indices32.assign(&i[0], &i[36]);
 #pragma endregion Indices
 
 	// Put a cap on the number of subdivisions.
 	nrSubdivisions = std::min<uint32>(nrSubdivisions, 6u);
 
+	MeshSize size{ 24, 36 };
 	for (uint32 i = 0; i < nrSubdivisions; ++i)
-		Subdivide(meshData);
+		size = Subdivide(vertices, indices, size);
+}
 
+GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount) {
+	MeshData meshData = AllocateMeshData(SphereSize(sliceCount, stackCount));
+	CreateSphere(radius, sliceCount, stackCount, meshData.Vertices, meshData.Indices32);
+	meshData.ComputeBounds();
 	return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount) {
-	MeshData meshData;
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount,
+	std::span<Vertex> vertices, std::span<uint32> indices) {
+	MeshSize size = SphereSize(sliceCount, stackCount);
+	assert(vertices.size() >= size.VertexCount and indices.size() >= size.IndexCount);
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -106,55 +319,57 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back(topVertex);
+	// The top pole comes first and the bottom pole last.
+	uint32 southPoleIndex = size.VertexCount - 1;
+	vertices[0] = topVertex;
+	vertices[southPoleIndex] = bottomVertex;
 
 	float phiStep = XM_PI / stackCount;
 	float thetaStep = 2.0f * XM_PI / sliceCount;
 
+	SliceTable slices = MakeSliceTable(sliceCount, thetaStep);
+	uint32 ringVertexCount = sliceCount + 1;
+
 	// Compute vertices for each stack ring (do not count the poles as rings).
-	for (uint32 i = 1; i <= stackCount - 1; ++i) {
+	JobSystem::Default().ParallelFor(1, stackCount, RingGrainSize(sliceCount), [&](size_t ring) {
+		uint32 i = (uint32)ring;
 		float phi = i * phiStep;
+		float sinPhi = sinf(phi);
+		float cosPhi = cosf(phi);
 
 		// Vertices of ring.
+		Vertex* pVertex = &vertices[1 + (i - 1) * ringVertexCount];
 		for (uint32 j = 0; j <= sliceCount; ++j) {
-			float theta = j * thetaStep;
+			float c = slices.Cos[j];
+			float s = slices.Sin[j];
 
-			Vertex v;
+			Vertex& v = pVertex[j];
 
 			// spherical to cartesian
-			v.Position.x = radius * sinf(phi) * cosf(theta);
-			v.Position.y = radius * cosf(phi);
-			v.Position.z = radius * sinf(phi) * sinf(theta);
-
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius * sinf(phi) * sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius * sinf(phi) * cosf(theta);
+			v.Position = XMFLOAT3(radius * sinPhi * c, radius * cosPhi, radius * sinPhi * s);
 
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+			// The point on the unit sphere is the normal.
+			v.Normal = XMFLOAT3(sinPhi * c, cosPhi, sinPhi * s);
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+			// Partial derivative of P with respect to theta, (-r sin(phi) sin(theta), 0,
+			// r sin(phi) cos(theta)), normalized; sin(phi) > 0 on every ring.
+			v.TangentU = XMFLOAT3(-s, 0.0f, c);
 
-			v.TexC.x = theta / XM_2PI;
+			v.TexC.x = j * thetaStep / XM_2PI;
 			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back(v);
 		}
-	}
-
-	meshData.Vertices.push_back(bottomVertex);
+	});
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
+	uint32* pIndex = indices.data();
 	for (uint32 i = 1; i <= sliceCount; ++i) {
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i + 1);
-		meshData.Indices32.push_back(i);
+		*pIndex++ = 0;
+		*pIndex++ = i + 1;
+		*pIndex++ = i;
 	}
 
 	//
@@ -164,47 +379,40 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// Offset the indices to the index of the first vertex in the first ring.
 	// This is just skipping the top pole vertex.
 	uint32 baseIndex = 1;
-	uint32 ringVertexCount = sliceCount + 1;
-	for (uint32 i = 0; i < stackCount - 2; ++i) {
+	uint32* pInnerIndices = pIndex;
+	JobSystem::Default().ParallelFor(0, stackCount - 2, RingGrainSize(sliceCount), [&](size_t stack) {
+		uint32 i = (uint32)stack;
+		uint32* pIndex = pInnerIndices + i * sliceCount * 6;
 		for (uint32 j = 0; j < sliceCount; ++j) {
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
+			*pIndex++ = baseIndex + i * ringVertexCount + j;
+			*pIndex++ = baseIndex + i * ringVertexCount + j + 1;
+			*pIndex++ = baseIndex + (i + 1) * ringVertexCount + j;
 
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j + 1);
+			*pIndex++ = baseIndex + (i + 1) * ringVertexCount + j;
+			*pIndex++ = baseIndex + i * ringVertexCount + j + 1;
+			*pIndex++ = baseIndex + (i + 1) * ringVertexCount + j + 1;
 		}
-	}
+	});
+	pIndex += (stackCount - 2) * sliceCount * 6;
 
 	//
 	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
 	// and connects the bottom pole to the bottom ring.
 	//
 
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size() - 1;
-
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
 
 	for (uint32 i = 0; i < sliceCount; ++i) {
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i + 1);
+		*pIndex++ = southPoleIndex;
+		*pIndex++ = baseIndex + i;
+		*pIndex++ = baseIndex + i + 1;
 	}
 
-	return meshData;
+	assert(pIndex == indices.data() + size.IndexCount);
 }
 
-void GeometryGenerator::Subdivide(MeshData& meshData) {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
-
+GeometryGenerator::MeshSize GeometryGenerator::Subdivide(std::span<Vertex> vertices, std::span<uint32> indices, MeshSize size) {
 	//       v1
 	//       *
 	//      / \
@@ -215,47 +423,63 @@ void GeometryGenerator::Subdivide(MeshData& meshData) {
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size() / 3;
-	for (uint32 i = 0; i < numTris; ++i) {
-		Vertex v0 = inputCopy.Vertices[inputCopy.Indices32[i * 3 + 0]];
-		Vertex v1 = inputCopy.Vertices[inputCopy.Indices32[i * 3 + 1]];
-		Vertex v2 = inputCopy.Vertices[inputCopy.Indices32[i * 3 + 2]];
-
-		//
-		// Generate the midpoints.
-		//
-
-		Vertex m0 = MidPoint(v0, v1);
-		Vertex m1 = MidPoint(v1, v2);
-		Vertex m2 = MidPoint(v0, v2);
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
-
-		meshData.Indices32.push_back(i * 6 + 0);
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 5);
-
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 4);
-		meshData.Indices32.push_back(i * 6 + 5);
-
-		meshData.Indices32.push_back(i * 6 + 5);
-		meshData.Indices32.push_back(i * 6 + 4);
-		meshData.Indices32.push_back(i * 6 + 2);
-
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 1);
-		meshData.Indices32.push_back(i * 6 + 4);
+	uint32 numTris = size.IndexCount / 3;
+	assert(indices.size() >= 12 * numTris);
+
+	//
+	// Generate the midpoints. Triangles sharing an edge share its midpoint; new
+	// vertices are appended after the existing ones, which stay where they are.
+	//
+
+	EdgeMidpoints midpoints(3 * numTris);
+	uint32 vertexCount = size.VertexCount;
+	for (uint32 i = 0; i < 3 * numTris; ++i) {
+		uint32 a = indices[i];
+		uint32 b = indices[i % 3 == 2 ? i - 2 : i + 1];
+
+		bool isNew = false;
+		uint32& midpoint = midpoints.FindOrInsert(a, b, isNew);
+		if (isNew) {
+			assert(vertexCount < vertices.size());
+			midpoint = vertexCount++;
+			vertices[midpoint] = MidPoint(vertices[a], vertices[b]);
+		}
 	}
+
+	//
+	// Replace every triangle by four. Triangle i moves from indices [3i, 3i + 3)
+	// to [12i, 12i + 12); going back to front never overwrites a triangle that
+	// still has to be read.
+	//
+
+	for (uint32 i = numTris; i-- > 0; ) {
+		uint32 v0 = indices[i * 3 + 0];
+		uint32 v1 = indices[i * 3 + 1];
+		uint32 v2 = indices[i * 3 + 2];
+
+		uint32 m0 = midpoints.Find(v0, v1);
+		uint32 m1 = midpoints.Find(v1, v2);
+		uint32 m2 = midpoints.Find(v0, v2);
+
+		uint32* pIndex = &indices[i * 12];
+		pIndex[0] = v0;
+		pIndex[1] = m0;
+		pIndex[2] = m2;
+
+		pIndex[3] = m0;
+		pIndex[4] = m1;
+		pIndex[5] = m2;
+
+		pIndex[6] = m2;
+		pIndex[7] = m1;
+		pIndex[8] = v2;
+
+		pIndex[9] = m0;
+		pIndex[10] = v1;
+		pIndex[11] = m1;
+	}
+
+	return { vertexCount, numTris * 12 };
 }
 
 GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1) {
@@ -288,7 +512,15 @@ GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Ve
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions) {
-	MeshData meshData;
+	MeshData meshData = AllocateMeshData(GeosphereSize(numSubdivisions));
+	CreateGeosphere(radius, numSubdivisions, meshData.Vertices, meshData.Indices32);
+	meshData.ComputeBounds();
+	return meshData;
+}
+
+void GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions,
+	std::span<Vertex> vertices, std::span<uint32> indices) {
+	assert(vertices.size() >= GeosphereSize(numSubdivisions).VertexCount and indices.size() >= GeosphereSize(numSubdivisions).IndexCount);
 
 	// Put a cap on the number of subdivisions.
 	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
@@ -316,52 +548,33 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
 	};
 
-	meshData.Vertices.resize(12);
-	meshData.Indices32.assign(&k[0], &k[60]);
+	std::copy(&k[0], &k[60], indices.begin());
 
 	for (uint32 i = 0; i < 12; ++i)
-		meshData.Vertices[i].Position = pos[i];
+		vertices[i] = Vertex(pos[i], XMFLOAT3(), XMFLOAT3(), XMFLOAT2());
 
+	MeshSize size{ 12, 60 };
 	for (uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
-
-	// Project vertices onto sphere and scale.
-	for (uint32 i = 0; i < meshData.Vertices.size(); ++i) {
-		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
-
-		// Project onto sphere.
-		XMVECTOR p = radius * n;
-
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
-
-		// Derive texture coordinates from spherical coordinates.
-		float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
-
-		// Put in [0, 2pi].
-		if (theta < 0.0f)
-			theta += XM_2PI;
-
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+		size = Subdivide(vertices, indices, size);
 
-		meshData.Vertices[i].TexC.x = theta / XM_2PI;
-		meshData.Vertices[i].TexC.y = phi / XM_PI;
-
-		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius * sinf(phi) * sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius * sinf(phi) * cosf(theta);
-
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-	}
+	// Project vertices onto sphere and scale, four at a time.
+	JobSystem::Default().ParallelFor(0, size.VertexCount, 4096, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i += 4)
+			ProjectOntoSphere(&vertices[i], std::min<size_t>(4, last - i), radius);
+	});
+}
 
+GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount) {
+	MeshData meshData = AllocateMeshData(CylinderSize(sliceCount, stackCount));
+	CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, meshData.Vertices, meshData.Indices32);
+	meshData.ComputeBounds();
 	return meshData;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount) {
-	MeshData meshData;
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+	std::span<Vertex> vertices, std::span<uint32> indices) {
+	MeshSize size = CylinderSize(sliceCount, stackCount);
+	assert(vertices.size() >= size.VertexCount and indices.size() >= size.IndexCount);
 
 	//
 	// Build Stacks.
@@ -374,85 +587,98 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	uint32 ringCount = stackCount + 1;
 
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	uint32 ringVertexCount = sliceCount + 1;
+
+	float dTheta = 2.0f * XM_PI / sliceCount;
+	SliceTable slices = MakeSliceTable(sliceCount, dTheta);
+
+	// Cylinder can be parameterized as follows, where we introduce v
+	// parameter that goes in the same direction as the v tex-coord
+	// so that the bitangent goes in the same direction as the v tex-coord.
+	//   Let r0 be the bottom radius and let r1 be the top radius.
+	//   y(v) = h - hv for v in [0,1].
+	//   r(v) = r1 + (r0-r1)v
+	//
+	//   x(t, v) = r(v)*cos(t)
+	//   y(t, v) = h - hv
+	//   z(t, v) = r(v)*sin(t)
+	// 
+	//  dx/dt = -r(v)*sin(t)
+	//  dy/dt = 0
+	//  dz/dt = +r(v)*cos(t)
+	//
+	//  dx/dv = (r0-r1)*cos(t)
+	//  dy/dv = -h
+	//  dz/dv = (r0-r1)*sin(t)
+	//
+	// The tangent T = (-sin(t), 0, cos(t)) is unit length, and the normal
+	// T x B = (h*cos(t), r0-r1, h*sin(t)) has the same length everywhere.
+	float dr = bottomRadius - topRadius;
+	float invNormalLength = 1.0f / sqrtf(height * height + dr * dr);
+	float normalXZ = height * invNormalLength;
+	float normalY = dr * invNormalLength;
+
 	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for (uint32 i = 0; i < ringCount; ++i) {
+	JobSystem::Default().ParallelFor(0, ringCount, RingGrainSize(sliceCount), [&](size_t ring) {
+		uint32 i = (uint32)ring;
 		float y = -0.5f * height + i * stackHeight;
 		float r = bottomRadius + i * radiusStep;
 
 		// vertices of ring
-		float dTheta = 2.0f * XM_PI / sliceCount;
+		Vertex* pVertex = &vertices[i * ringVertexCount];
 		for (uint32 j = 0; j <= sliceCount; ++j) {
-			Vertex vertex;
-
-			float c = cosf(j * dTheta);
-			float s = sinf(j * dTheta);
+			float c = slices.Cos[j];
+			float s = slices.Sin[j];
 
+			Vertex& vertex = pVertex[j];
 			vertex.Position = XMFLOAT3(r * c, y, r * s);
+			vertex.Normal = XMFLOAT3(normalXZ * c, normalY, normalXZ * s);
+			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
 
 			vertex.TexC.x = (float)j / sliceCount;
 			vertex.TexC.y = 1.0f - (float)i / stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
-
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-			float dr = bottomRadius - topRadius;
-			XMFLOAT3 bitangent(dr * c, -height, dr * s);
-
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
-
-			meshData.Vertices.push_back(vertex);
 		}
-	}
-
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	uint32 ringVertexCount = sliceCount + 1;
+	});
 
 	// Compute indices for each stack.
-	for (uint32 i = 0; i < stackCount; ++i) {
+	JobSystem::Default().ParallelFor(0, stackCount, RingGrainSize(sliceCount), [&](size_t stack) {
+		uint32 i = (uint32)stack;
+		uint32* pIndex = &indices[i * sliceCount * 6];
 		for (uint32 j = 0; j < sliceCount; ++j) {
-			meshData.Indices32.push_back(i * ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j + 1);
+			*pIndex++ = i * ringVertexCount + j;
+			*pIndex++ = (i + 1) * ringVertexCount + j;
+			*pIndex++ = (i + 1) * ringVertexCount + j + 1;
 
-			meshData.Indices32.push_back(i * ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(i * ringVertexCount + j + 1);
+			*pIndex++ = i * ringVertexCount + j;
+			*pIndex++ = (i + 1) * ringVertexCount + j + 1;
+			*pIndex++ = i * ringVertexCount + j + 1;
 		}
-	}
+	});
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	uint32 vertexCount = ringCount * ringVertexCount;
+	uint32 indexCount = stackCount * sliceCount * 6;
 
-	return meshData;
-}
+	// Each cap is a ring plus a center vertex, and a triangle per slice.
+	uint32 capVertexCount = ringVertexCount + 1;
+	uint32 capIndexCount = 3 * sliceCount;
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-	uint32 sliceCount, uint32 stackCount, MeshData& meshData) {
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
+	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, vertexCount,
+		vertices.subspan(vertexCount, capVertexCount), indices.subspan(indexCount, capIndexCount));
+	vertexCount += capVertexCount;
+	indexCount += capIndexCount;
 
+	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, vertexCount,
+		vertices.subspan(vertexCount, capVertexCount), indices.subspan(indexCount, capIndexCount));
+	vertexCount += capVertexCount;
+	indexCount += capIndexCount;
+
+	assert(vertexCount == size.VertexCount and indexCount == size.IndexCount);
+}
+
+void GeometryGenerator::BuildCylinderTopCap(float /*bottomRadius*/, float topRadius, float height,
+	uint32 sliceCount, uint32 baseIndex, std::span<Vertex> vertices, std::span<uint32> indices) {
 	float y = 0.5f * height;
 	float dTheta = 2.0f * XM_PI / sliceCount;
 
@@ -466,29 +692,28 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 		float u = x / height + 0.5f;
 		float v = z / height + 0.5f;
 
-		meshData.Vertices.push_back(Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+		vertices[i] = Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back(Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+	vertices[sliceCount + 1] = Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
 	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size() - 1;
+	uint32 centerIndex = baseIndex + sliceCount + 1;
 
 	for (uint32 i = 0; i < sliceCount; ++i) {
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i + 1);
-		meshData.Indices32.push_back(baseIndex + i);
+		indices[3 * i] = centerIndex;
+		indices[3 * i + 1] = baseIndex + i + 1;
+		indices[3 * i + 2] = baseIndex + i;
 	}
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-	uint32 sliceCount, uint32 stackCount, MeshData& meshData) {
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float /*topRadius*/, float height,
+	uint32 sliceCount, uint32 baseIndex, std::span<Vertex> vertices, std::span<uint32> indices) {
 	// 
 	// Build bottom cap.
 	//
 
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
 	float y = -0.5f * height;
 
 	// vertices of ring
@@ -502,27 +727,32 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 		float u = x / height + 0.5f;
 		float v = z / height + 0.5f;
 
-		meshData.Vertices.push_back(Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+		vertices[i] = Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back(Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+	vertices[sliceCount + 1] = Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
 	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size() - 1;
+	uint32 centerIndex = baseIndex + sliceCount + 1;
 
 	for (uint32 i = 0; i < sliceCount; ++i) {
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i + 1);
+		indices[3 * i] = centerIndex;
+		indices[3 * i + 1] = baseIndex + i;
+		indices[3 * i + 2] = baseIndex + i + 1;
 	}
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n) {
-	MeshData meshData;
+	MeshData meshData = AllocateMeshData(GridSize(m, n));
+	CreateGrid(width, depth, m, n, meshData.Vertices, meshData.Indices32);
+	meshData.ComputeBounds();
+	return meshData;
+}
 
-	uint32 vertexCount = m * n;
-	uint32 faceCount = (m - 1) * (n - 1) * 2;
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n,
+	std::span<Vertex> vertices, std::span<uint32> indices) {
+	assert(vertices.size() >= GridSize(m, n).VertexCount and indices.size() >= GridSize(m, n).IndexCount);
 
 	//
 	// Create the vertices.
@@ -537,85 +767,88 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n - 1);
 	float dv = 1.0f / (m - 1);
 
-	meshData.Vertices.resize(vertexCount);
-	for (uint32 i = 0; i < m; ++i) {
+	// Rows are independent; split them across the job system in chunks of about 4K vertices.
+	size_t rowGrainSize = std::max<size_t>(1, 4096 / n);
+
+	JobSystem::Default().ParallelFor(0, m, rowGrainSize, [&](size_t row) {
+		uint32 i = (uint32)row;
 		float z = halfDepth - i * dz;
 		for (uint32 j = 0; j < n; ++j) {
 			float x = -halfWidth + j * dx;
 
-			meshData.Vertices[i * n + j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i * n + j].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i * n + j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			vertices[i * n + j].Position = XMFLOAT3(x, 0.0f, z);
+			vertices[i * n + j].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			vertices[i * n + j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
 			// Stretch texture over grid.
-			meshData.Vertices[i * n + j].TexC.x = j * du;
-			meshData.Vertices[i * n + j].TexC.y = i * dv;
+			vertices[i * n + j].TexC.x = j * du;
+			vertices[i * n + j].TexC.y = i * dv;
 		}
-	}
+	});
 
 	//
 	// Create the indices.
 	//
 
-	meshData.Indices32.resize(faceCount * 3); // 3 indices per face
-
 	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for (uint32 i = 0; i < m - 1; ++i) {
+	JobSystem::Default().ParallelFor(0, m - 1, rowGrainSize, [&](size_t row) {
+		uint32 i = (uint32)row;
+		uint32 k = i * (n - 1) * 6;
 		for (uint32 j = 0; j < n - 1; ++j) {
-			meshData.Indices32[k] = i * n + j;
-			meshData.Indices32[k + 1] = i * n + j + 1;
-			meshData.Indices32[k + 2] = (i + 1) * n + j;
+			indices[k] = i * n + j;
+			indices[k + 1] = i * n + j + 1;
+			indices[k + 2] = (i + 1) * n + j;
 
-			meshData.Indices32[k + 3] = (i + 1) * n + j;
-			meshData.Indices32[k + 4] = i * n + j + 1;
-			meshData.Indices32[k + 5] = (i + 1) * n + j + 1;
+			indices[k + 3] = (i + 1) * n + j;
+			indices[k + 4] = i * n + j + 1;
+			indices[k + 5] = (i + 1) * n + j + 1;
 
 			k += 6; // next quad
 		}
-	}
-
-	return meshData;
+	});
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth) {
-	MeshData meshData;
+	MeshData meshData = AllocateMeshData(QuadSize());
+	CreateQuad(x, y, w, h, depth, meshData.Vertices, meshData.Indices32);
+	meshData.ComputeBounds();
+	return meshData;
+}
 
-	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
+void GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth,
+	std::span<Vertex> vertices, std::span<uint32> indices) {
+	assert(vertices.size() >= QuadSize().VertexCount and indices.size() >= QuadSize().IndexCount);
 
 	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
+	vertices[0] = Vertex(
 		x, y - h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		0.0f, 1.0f);
 
-	meshData.Vertices[1] = Vertex(
+	vertices[1] = Vertex(
 		x, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		0.0f, 0.0f);
 
-	meshData.Vertices[2] = Vertex(
+	vertices[2] = Vertex(
 		x + w, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		1.0f, 0.0f);
 
-	meshData.Vertices[3] = Vertex(
+	vertices[3] = Vertex(
 		x + w, y - h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		1.0f, 1.0f);
 
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
+	indices[0] = 0;
+	indices[1] = 1;
+	indices[2] = 2;
 
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
-
-	return meshData;
+	indices[3] = 0;
+	indices[4] = 2;
+	indices[5] = 3;
 }
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
 #include <DirectXMath.h>
+#include <span>
 #include <vector>
 
+#include "MeshBounds.h"
+
 class GeometryGenerator
 {
 public:
@@ -44,7 +48,18 @@ public:
 		std::vector<Vertex> Vertices;
 		std::vector<uint32> Indices32;
 
+		// Bounds of Vertices. The Create* overloads returning MeshData fill them in;
+		// call ComputeBounds() again after moving vertices.
+		MeshBounds::Bounds Bounds{};
+		void ComputeBounds();
+
+		// Largest index in Indices32; IndexByteSize() is the narrowest width holding it.
+		uint32 MaxIndex() const;
+		uint32 IndexByteSize() const;
+
+		// 16-bit copy of Indices32; only valid when IndexByteSize() == 2.
 		std::vector<uint16>& GetIndices16() {
+			assert(IndexByteSize() == 2);
 			if (mIndices16.empty()) {
 				mIndices16.resize(Indices32.size());
 				for (size_t i = 0; i < Indices32.size(); ++i)
@@ -58,6 +73,20 @@ public:
 		std::vector<uint16> mIndices16;
 	};
 
+	// Exact number of vertices and indices a Create* call produces.
+	struct MeshSize
+	{
+		uint32 VertexCount{};
+		uint32 IndexCount{};
+	};
+
+	static MeshSize BoxSize(uint32 nrSubdivisions);
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GeosphereSize(uint32 numSubdivisions);
+	static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GridSize(uint32 m, uint32 n);
+	static MeshSize QuadSize();
+
 	MeshData CreateBox(float width, float height, float depth, uint32 nrSubdivisions);
 	MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
 	MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
@@ -65,10 +94,22 @@ public:
 	MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
 	MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	// Same as above, but generated straight into caller provided memory, e.g. a mapped
+	// staging buffer. The spans must hold at least the counts returned by the matching
+	// *Size function; only that many elements are written.
+	void CreateBox(float width, float height, float depth, uint32 nrSubdivisions, std::span<Vertex> vertices, std::span<uint32> indices);
+	void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, std::span<Vertex> vertices, std::span<uint32> indices);
+	void CreateGeosphere(float radius, uint32 numSubdivisions, std::span<Vertex> vertices, std::span<uint32> indices);
+	void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, std::span<Vertex> vertices, std::span<uint32> indices);
+	void CreateGrid(float width, float depth, uint32 m, uint32 n, std::span<Vertex> vertices, std::span<uint32> indices);
+	void CreateQuad(float x, float y, float w, float h, float depth, std::span<Vertex> vertices, std::span<uint32> indices);
+
 private:
-	void Subdivide(MeshData& meshData);
+	// Splits each of the first size.IndexCount / 3 triangles into four, in place, and returns
+	// the new size. Edge midpoints are shared between the triangles on either side.
+	MeshSize Subdivide(std::span<Vertex> vertices, std::span<uint32> indices, MeshSize size);
 	Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
+	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 baseIndex, std::span<Vertex> vertices, std::span<uint32> indices);
+	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 baseIndex, std::span<Vertex> vertices, std::span<uint32> indices);
 };
 
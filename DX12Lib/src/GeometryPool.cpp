@@ -0,0 +1,292 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "IndexPacking.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	void Transition(ID3D12GraphicsCommandList* pCommandList, ID3D12Resource* pResource,
+		D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) {
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(pResource, before, after);
+		pCommandList->ResourceBarrier(1, &barrier);
+	}
+
+	// Copies count indices of sourceByteSize bytes each to destinationByteSize bytes each.
+	void ConvertIndices(const std::byte* pSource, UINT sourceByteSize, std::byte* pDestination, UINT destinationByteSize, size_t count) {
+		if (sourceByteSize == destinationByteSize) {
+			std::memcpy(pDestination, pSource, count * sourceByteSize);
+			return;
+		}
+
+		if (sourceByteSize == 4) {
+			IndexPacking::Narrow(std::span(reinterpret_cast<const std::uint32_t*>(pSource), count),
+				reinterpret_cast<std::uint16_t*>(pDestination));
+			return;
+		}
+
+		auto pWide = reinterpret_cast<std::uint32_t*>(pDestination);
+		auto pNarrow = reinterpret_cast<const std::uint16_t*>(pSource);
+		for (size_t i = 0; i < count; ++i)
+			pWide[i] = pNarrow[i];
+	}
+}
+
+GeometryPool::GeometryPool(ID3D12Device* pDevice, std::string name, UINT vertexByteStride, UINT vertexCapacity,
+	UINT indexCapacity, DXGI_FORMAT indexFormat)
+	: _pDevice(pDevice),
+	_indexByteSize(indexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4),
+	_vertexAllocator(vertexCapacity),
+	_indexAllocator(indexCapacity) {
+	assert(indexFormat == DXGI_FORMAT_R16_UINT or indexFormat == DXGI_FORMAT_R32_UINT);
+
+	_geometry.Name = std::move(name);
+	_geometry.VertexByteStride = vertexByteStride;
+	_geometry.VertexBufferByteSize = vertexCapacity * vertexByteStride;
+	_geometry.IndexFormat = indexFormat;
+	_geometry.IndexBufferByteSize = indexCapacity * _indexByteSize;
+
+	_geometry.VertexBufferGpu = CreateBuffer(_geometry.VertexBufferByteSize);
+	_geometry.IndexBufferGpu = CreateBuffer(_geometry.IndexBufferByteSize);
+}
+
+ComPtr<ID3D12Resource> GeometryPool::CreateBuffer(UINT64 byteSize) const {
+	auto heapProperties = D3D12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+
+	// Pool buffers rest in GENERIC_READ between copies.
+	ComPtr<ID3D12Resource> pBuffer{};
+	THROW_IF_FAILED(_pDevice->CreateCommittedResource(
+		&heapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(pBuffer.GetAddressOf())));
+	return pBuffer;
+}
+
+GeometryPool::BlockId GeometryPool::AddBlock(ID3D12GraphicsCommandList* pCommandList, UINT vertexCount, UINT indexCount,
+	const std::function<void(std::byte* pVertices, std::byte* pIndices)>& writeData) {
+	OffsetAllocator::Allocation vertices = _vertexAllocator.Allocate(vertexCount);
+	OffsetAllocator::Allocation indices = _indexAllocator.Allocate(indexCount);
+	if (not vertices.IsValid() or not indices.IsValid()) {
+		_vertexAllocator.Free(vertices);
+		_indexAllocator.Free(indices);
+		return InvalidBlock;
+	}
+
+	// Vertices and indices share one upload buffer; index data starts 4-byte aligned.
+	UINT64 vertexByteSize = (UINT64)vertexCount * _geometry.VertexByteStride;
+	UINT64 indexUploadOffset = (vertexByteSize + 3) & ~3ull;
+	UINT64 indexByteSize = (UINT64)indexCount * _indexByteSize;
+
+	auto heapProperties = D3D12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(indexUploadOffset + indexByteSize);
+
+	ComPtr<ID3D12Resource> pUploadBuffer{};
+	THROW_IF_FAILED(_pDevice->CreateCommittedResource(
+		&heapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(pUploadBuffer.GetAddressOf())));
+
+	// The CPU does not read the upload buffer back.
+	D3D12_RANGE readRange{ 0, 0 };
+	void* pUploadData{};
+	THROW_IF_FAILED(pUploadBuffer->Map(0, &readRange, &pUploadData));
+	writeData(static_cast<std::byte*>(pUploadData), static_cast<std::byte*>(pUploadData) + indexUploadOffset);
+	pUploadBuffer->Unmap(0, nullptr);
+
+	ID3D12Resource* pVertexBuffer = _geometry.VertexBufferGpu.Get();
+	ID3D12Resource* pIndexBuffer = _geometry.IndexBufferGpu.Get();
+
+	Transition(pCommandList, pVertexBuffer, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+	Transition(pCommandList, pIndexBuffer, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	pCommandList->CopyBufferRegion(pVertexBuffer, (UINT64)vertices.Offset * _geometry.VertexByteStride,
+		pUploadBuffer.Get(), 0, vertexByteSize);
+	pCommandList->CopyBufferRegion(pIndexBuffer, (UINT64)indices.Offset * _indexByteSize,
+		pUploadBuffer.Get(), indexUploadOffset, indexByteSize);
+
+	Transition(pCommandList, pVertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+	Transition(pCommandList, pIndexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	_transientResources.push_back(std::move(pUploadBuffer));
+
+	BlockId block;
+	if (not _freeBlocks.empty()) {
+		block = _freeBlocks.back();
+		_freeBlocks.pop_back();
+	}
+	else {
+		block = (BlockId)_blocks.size();
+		_blocks.emplace_back();
+	}
+
+	_blocks[block] = Block{ vertices, indices, {} };
+	return block;
+}
+
+GeometryPool::BlockId GeometryPool::AddMesh(ID3D12GraphicsCommandList* pCommandList, std::string_view name,
+	std::span<const std::byte> vertices, std::span<const std::uint32_t> indices, const MeshBounds::Bounds& bounds) {
+	assert(vertices.size() % _geometry.VertexByteStride == 0);
+	assert(IndexPacking::IndexByteSize(IndexPacking::MaxIndex(indices)) <= _indexByteSize);
+	assert(not _geometry.DrawArguments.contains(std::string(name)));
+
+	UINT vertexCount = (UINT)(vertices.size() / _geometry.VertexByteStride);
+	BlockId block = AddBlock(pCommandList, vertexCount, (UINT)indices.size(), [&](std::byte* pVertices, std::byte* pIndices) {
+		std::memcpy(pVertices, vertices.data(), vertices.size());
+		IndexPacking::Pack(indices, _indexByteSize, pIndices);
+	});
+	if (block == InvalidBlock)
+		return InvalidBlock;
+
+	SubMeshGeometry submesh;
+	submesh.IndexCount = (UINT)indices.size();
+	submesh.StartIndexLocation = _blocks[block].Indices.Offset;
+	submesh.BaseVertexLocation = (INT)_blocks[block].Vertices.Offset;
+	submesh.BoundingBox = bounds.Box;
+	submesh.BoundingSphere = bounds.Sphere;
+
+	_geometry.DrawArguments[std::string(name)] = submesh;
+	_blocks[block].SubmeshNames.emplace_back(name);
+	return block;
+}
+
+GeometryPool::BlockId GeometryPool::AddImage(ID3D12GraphicsCommandList* pCommandList, const MeshFile::Image& image) {
+	const MeshFile::Header& header = image.GetHeader();
+	assert(header.VertexStride == _geometry.VertexByteStride);
+
+	BlockId block = AddBlock(pCommandList, header.VertexCount, header.IndexCount, [&](std::byte* pVertices, std::byte* pIndices) {
+		std::memcpy(pVertices, image.Vertices().data(), image.Vertices().size());
+		ConvertIndices(image.Indices().data(), header.IndexByteSize, pIndices, _indexByteSize, header.IndexCount);
+	});
+	if (block == InvalidBlock)
+		return InvalidBlock;
+
+	// The image's locations are relative to its own buffers.
+	UINT baseVertex = _blocks[block].Vertices.Offset;
+	UINT startIndex = _blocks[block].Indices.Offset;
+
+	auto lods = image.Lods();
+	for (const MeshFile::SubmeshRecord& record : image.Submeshes()) {
+		assert(not _geometry.DrawArguments.contains(record.Name));
+
+		SubMeshGeometry submesh;
+		submesh.IndexCount = record.IndexCount;
+		submesh.StartIndexLocation = startIndex + record.StartIndexLocation;
+		submesh.BaseVertexLocation = (INT)baseVertex + record.BaseVertexLocation;
+		submesh.BoundingBox = record.Bounds.Box;
+		submesh.BoundingSphere = record.Bounds.Sphere;
+		for (const MeshFile::LodRecord& lod : lods.subspan(record.FirstLod, record.LodCount))
+			submesh.Lods.push_back(SubMeshLod{ lod.IndexCount, startIndex + lod.StartIndexLocation, lod.Error });
+
+		_geometry.DrawArguments[record.Name] = std::move(submesh);
+		_blocks[block].SubmeshNames.emplace_back(record.Name);
+	}
+
+	return block;
+}
+
+void GeometryPool::Free(BlockId block) {
+	Block& entry = _blocks[block];
+	assert(entry.Vertices.IsValid());
+
+	for (const std::string& name : entry.SubmeshNames)
+		_geometry.DrawArguments.erase(name);
+
+	_vertexAllocator.Free(entry.Vertices);
+	_indexAllocator.Free(entry.Indices);
+	entry = Block{};
+	_freeBlocks.push_back(block);
+}
+
+bool GeometryPool::Defragment(ID3D12GraphicsCommandList* pCommandList) {
+	std::vector<BlockId> liveBlocks;
+	for (BlockId block = 0; block < (BlockId)_blocks.size(); ++block) {
+		if (_blocks[block].Vertices.IsValid())
+			liveBlocks.push_back(block);
+	}
+	std::sort(liveBlocks.begin(), liveBlocks.end(), [&](BlockId a, BlockId b) {
+		return _blocks[a].Vertices.Offset < _blocks[b].Vertices.Offset;
+	});
+
+	// Already packed when every block starts where the one before ends.
+	UINT vertexEnd = 0;
+	UINT indexEnd = 0;
+	bool isPacked = true;
+	for (BlockId block : liveBlocks) {
+		const Block& entry = _blocks[block];
+		isPacked = isPacked and entry.Vertices.Offset == vertexEnd and entry.Indices.Offset == indexEnd;
+		vertexEnd += _vertexAllocator.AllocationSize(entry.Vertices);
+		indexEnd += _indexAllocator.AllocationSize(entry.Indices);
+	}
+	if (isPacked)
+		return false;
+
+	// Copy into new buffers rather than within the old ones, which would overlap.
+	ComPtr<ID3D12Resource> pOldVertexBuffer = _geometry.VertexBufferGpu;
+	ComPtr<ID3D12Resource> pOldIndexBuffer = _geometry.IndexBufferGpu;
+	_geometry.VertexBufferGpu = CreateBuffer(_geometry.VertexBufferByteSize);
+	_geometry.IndexBufferGpu = CreateBuffer(_geometry.IndexBufferByteSize);
+
+	Transition(pCommandList, pOldVertexBuffer.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	Transition(pCommandList, pOldIndexBuffer.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	Transition(pCommandList, _geometry.VertexBufferGpu.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+	Transition(pCommandList, _geometry.IndexBufferGpu.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	std::vector<std::pair<UINT, UINT>> sizes;
+	for (BlockId block : liveBlocks) {
+		sizes.emplace_back(_vertexAllocator.AllocationSize(_blocks[block].Vertices),
+			_indexAllocator.AllocationSize(_blocks[block].Indices));
+	}
+
+	// Allocating from empty allocators in offset order places the blocks back to back.
+	_vertexAllocator.Reset();
+	_indexAllocator.Reset();
+
+	for (size_t i = 0; i < liveBlocks.size(); ++i) {
+		Block& entry = _blocks[liveBlocks[i]];
+		auto [vertexCount, indexCount] = sizes[i];
+
+		OffsetAllocator::Allocation vertices = _vertexAllocator.Allocate(vertexCount);
+		OffsetAllocator::Allocation indices = _indexAllocator.Allocate(indexCount);
+
+		pCommandList->CopyBufferRegion(_geometry.VertexBufferGpu.Get(), (UINT64)vertices.Offset * _geometry.VertexByteStride,
+			pOldVertexBuffer.Get(), (UINT64)entry.Vertices.Offset * _geometry.VertexByteStride, (UINT64)vertexCount * _geometry.VertexByteStride);
+		pCommandList->CopyBufferRegion(_geometry.IndexBufferGpu.Get(), (UINT64)indices.Offset * _indexByteSize,
+			pOldIndexBuffer.Get(), (UINT64)entry.Indices.Offset * _indexByteSize, (UINT64)indexCount * _indexByteSize);
+
+		INT vertexShift = (INT)vertices.Offset - (INT)entry.Vertices.Offset;
+		INT indexShift = (INT)indices.Offset - (INT)entry.Indices.Offset;
+		for (const std::string& name : entry.SubmeshNames) {
+			SubMeshGeometry& submesh = _geometry.DrawArguments[name];
+			submesh.BaseVertexLocation += vertexShift;
+			submesh.StartIndexLocation += indexShift;
+			for (SubMeshLod& lod : submesh.Lods)
+				lod.StartIndexLocation += indexShift;
+		}
+
+		entry.Vertices = vertices;
+		entry.Indices = indices;
+	}
+
+	Transition(pCommandList, _geometry.VertexBufferGpu.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+	Transition(pCommandList, _geometry.IndexBufferGpu.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	// Draws already recorded still read the old buffers.
+	_transientResources.push_back(std::move(pOldVertexBuffer));
+	_transientResources.push_back(std::move(pOldIndexBuffer));
+	return true;
+}
+
+void GeometryPool::ReleaseTransientResources() {
+	_transientResources.clear();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DxUtil.h"
+#include "MeshBounds.h"
+#include "MeshFile.h"
+#include "MeshGeometry.h"
+#include "OffsetAllocator.h"
+
+// One vertex buffer and one index buffer shared by many meshes.
+//
+// Meshes are suballocated from the two buffers with OffsetAllocators and show up as
+// DrawArguments of a single MeshGeometry, whose SubMeshGeometry entries carry the
+// base vertex and start index of their allocation. All meshes therefore bind the same
+// vertex and index buffer views. Indices are stored relative to each mesh's base
+// vertex, so 16-bit indices work as long as every mesh has at most 65536 vertices.
+//
+// Uploads and defragmentation record copies on the command list passed in. The
+// resources they need until that list has executed are kept until
+// ReleaseTransientResources() is called.
+class GeometryPool
+{
+public:
+	using BlockId = std::uint32_t;
+	static constexpr BlockId InvalidBlock{ UINT32_MAX };
+
+	GeometryPool(ID3D12Device* pDevice, std::string name, UINT vertexByteStride, UINT vertexCapacity,
+		UINT indexCapacity, DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT);
+
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	// The pool's buffers and the submeshes of every block added.
+	MeshGeometry& Geometry() { return _geometry; }
+	const MeshGeometry& Geometry() const { return _geometry; }
+
+	// Adds one mesh as the submesh name. vertices holds packed vertices of the pool's
+	// stride, bounds are those of their positions. Returns InvalidBlock when either
+	// buffer has no room left.
+	BlockId AddMesh(ID3D12GraphicsCommandList* pCommandList, std::string_view name,
+		std::span<const std::byte> vertices, std::span<const std::uint32_t> indices, const MeshBounds::Bounds& bounds);
+
+	// Adds all submeshes of a mesh file, uploading straight from the image.
+	BlockId AddImage(ID3D12GraphicsCommandList* pCommandList, const MeshFile::Image& image);
+
+	// Removes a block's submeshes and returns its ranges to the pool.
+	void Free(BlockId block);
+
+	// Moves all blocks to the start of the buffers, so the free space is one range
+	// again. Submeshes get new locations: draws recorded afterwards must read them
+	// from Geometry().DrawArguments again. Returns false if nothing had to move.
+	bool Defragment(ID3D12GraphicsCommandList* pCommandList);
+
+	// Releases upload buffers and buffers replaced by Defragment. Only call once the
+	// command lists passed to the pool since the last call have finished executing.
+	void ReleaseTransientResources();
+
+	UINT FreeVertexCount() const { return _vertexAllocator.FreeSize(); }
+	UINT FreeIndexCount() const { return _indexAllocator.FreeSize(); }
+
+private:
+	struct Block
+	{
+		OffsetAllocator::Allocation Vertices{};
+		OffsetAllocator::Allocation Indices{};
+		std::vector<std::string> SubmeshNames{};
+	};
+
+	// Allocates a block and records the copy of its data from a new upload buffer,
+	// whose mapped vertex and index parts writeData fills.
+	BlockId AddBlock(ID3D12GraphicsCommandList* pCommandList, UINT vertexCount, UINT indexCount,
+		const std::function<void(std::byte* pVertices, std::byte* pIndices)>& writeData);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(UINT64 byteSize) const;
+
+	ID3D12Device* _pDevice{};
+	MeshGeometry _geometry{};
+	UINT _indexByteSize{};
+
+	OffsetAllocator _vertexAllocator;
+	OffsetAllocator _indexAllocator;
+
+	std::vector<Block> _blocks{};
+	std::vector<BlockId> _freeBlocks{};
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> _transientResources{};
+};
@@ -0,0 +1,93 @@
+#include "IndexPacking.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "SimdSupport.h"
+
+using IndexPacking::uint16;
+using IndexPacking::uint32;
+
+uint32 IndexPacking::MaxIndex(std::span<const uint32> indices) {
+	// Four independent maxima so the loop vectorizes.
+	uint32 maxima[4]{};
+	size_t i = 0;
+	for (; i + 4 <= indices.size(); i += 4) {
+		for (int k = 0; k < 4; ++k)
+			maxima[k] = std::max(maxima[k], indices[i + k]);
+	}
+	for (; i < indices.size(); ++i)
+		maxima[0] = std::max(maxima[0], indices[i]);
+
+	return std::max(std::max(maxima[0], maxima[1]), std::max(maxima[2], maxima[3]));
+}
+
+void IndexPacking::Narrow(std::span<const uint32> indices, uint16* pDestination, uint32 baseVertex) {
+	size_t i = 0;
+
+#if DX12_HAS_SSE2
+	// SSE2 only packs with signed saturation: shift [base, base + 0xFFFF] down to
+	// [-0x8000, 0x7FFF], pack, and flip the sign bit to shift it back up.
+	const __m128i bias = _mm_set1_epi32((int)(baseVertex + 0x8000));
+	const __m128i signBit = _mm_set1_epi16((short)0x8000);
+	for (; i + 8 <= indices.size(); i += 8) {
+		__m128i low = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&indices[i])), bias);
+		__m128i high = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&indices[i + 4])), bias);
+		__m128i packed = _mm_xor_si128(_mm_packs_epi32(low, high), signBit);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDestination[i]), packed);
+	}
+#endif
+
+	for (; i < indices.size(); ++i) {
+		assert(indices[i] >= baseVertex and indices[i] - baseVertex <= MaxIndex16);
+		pDestination[i] = static_cast<uint16>(indices[i] - baseVertex);
+	}
+}
+
+void IndexPacking::Pack(std::span<const uint32> indices, uint32 indexByteSize, void* pDestination) {
+	assert(indexByteSize == 2 or indexByteSize == 4);
+
+	if (indexByteSize == 4)
+		std::memcpy(pDestination, indices.data(), indices.size_bytes());
+	else
+		Narrow(indices, static_cast<uint16*>(pDestination));
+}
+
+std::vector<IndexPacking::IndexRange> IndexPacking::SplitFor16BitIndices(std::span<const uint32> indices) {
+	assert(indices.size() % 3 == 0);
+
+	std::vector<IndexRange> ranges;
+	IndexRange range{};
+	uint32 minIndex = UINT32_MAX;
+	uint32 maxIndex = 0;
+
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		uint32 triangleMin = std::min({ indices[i], indices[i + 1], indices[i + 2] });
+		uint32 triangleMax = std::max({ indices[i], indices[i + 1], indices[i + 2] });
+		if (triangleMax - triangleMin > MaxIndex16) return {};
+
+		// Start a new range when the triangle does not fit the current one.
+		uint32 newMin = std::min(minIndex, triangleMin);
+		uint32 newMax = std::max(maxIndex, triangleMax);
+		if (range.IndexCount > 0 and newMax - newMin > MaxIndex16) {
+			range.BaseVertex = minIndex;
+			ranges.push_back(range);
+
+			range = IndexRange{ (uint32)i, 0, 0 };
+			newMin = triangleMin;
+			newMax = triangleMax;
+		}
+
+		minIndex = newMin;
+		maxIndex = newMax;
+		range.IndexCount += 3;
+	}
+
+	if (range.IndexCount > 0) {
+		range.BaseVertex = minIndex;
+		ranges.push_back(range);
+	}
+
+	return ranges;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Index buffer packing: choosing the narrowest index width and narrowing 32-bit
+// indices to 16 bits, either for the whole buffer or per range of vertices.
+namespace IndexPacking
+{
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	// Largest vertex a 16-bit index can address relative to its base vertex.
+	inline constexpr uint32 MaxIndex16{ 0xFFFF };
+
+	uint32 MaxIndex(std::span<const uint32> indices);
+
+	// Bytes per index needed for indices up to maxIndex: 2 or 4.
+	constexpr uint32 IndexByteSize(uint32 maxIndex) {
+		return maxIndex <= MaxIndex16 ? 2 : 4;
+	}
+
+	// Writes indices[i] - baseVertex as 16 bits; every index must be in
+	// [baseVertex, baseVertex + MaxIndex16]. Stores are sequential and 16 bytes wide
+	// where SSE2 is available, so destination may be write-combined upload memory.
+	void Narrow(std::span<const uint32> indices, uint16* pDestination, uint32 baseVertex = 0);
+
+	// Writes the indices with indexByteSize (2 or 4) bytes each.
+	void Pack(std::span<const uint32> indices, uint32 indexByteSize, void* pDestination);
+
+	// A range of an index buffer drawn with its own BaseVertexLocation.
+	struct IndexRange
+	{
+		uint32 StartIndex{};
+		uint32 IndexCount{};
+		uint32 BaseVertex{};
+	};
+
+	// Cuts a triangle list into consecutive ranges whose indices each span at most
+	// MaxIndex16 + 1 vertices, so every range can be drawn with 16-bit indices relative
+	// to its base vertex. Vertices are neither moved nor duplicated, which works well
+	// for meshes with locality, like grids or vertex fetch optimized meshes. Returns no
+	// ranges if a single triangle spans too many vertices.
+	std::vector<IndexRange> SplitFor16BitIndices(std::span<const uint32> indices);
+}
@@ -0,0 +1,70 @@
+#include "IndirectDrawBuilder.h"
+
+#include <array>
+#include <bit>
+#include <cassert>
+
+using uint32 = IndirectDrawBuilder::uint32;
+
+void IndirectDrawBuilder::SetVisibleItems(uint32 itemCount, std::span<const uint32> visibleItems) {
+	_visibility.assign(VisibilityWordCount(itemCount), 0);
+	for (uint32 i : visibleItems) {
+		assert(i < itemCount);
+		_visibility[i / 32] |= 1u << (i % 32);
+	}
+}
+
+uint32 IndirectDrawBuilder::Build(std::span<const IndirectDrawItem> items, std::span<const uint32> visibility,
+	std::span<IndirectDrawCommand> commands) {
+	const uint32 itemCount = (uint32)items.size();
+	const uint32 wordCount = VisibilityWordCount(itemCount);
+	assert(visibility.size() >= wordCount and commands.size() >= itemCount);
+
+	// Per thread state of the shader, one element per thread of the group.
+	std::array<uint32, GroupSize> words{};
+	std::array<uint32, GroupSize> offsets{};
+	uint32 commandCount = 0;
+
+	for (uint32 first = 0; first < wordCount; first += GroupSize) {
+		// Every thread loads a word and drops the bits past the last item.
+		for (uint32 thread = 0; thread < GroupSize; ++thread) {
+			uint32 wordIndex = first + thread;
+			uint32 word = 0;
+			if (wordIndex < wordCount) {
+				word = visibility[wordIndex];
+				uint32 itemsLeft = itemCount - wordIndex * 32;
+				if (itemsLeft < 32) word &= (1u << itemsLeft) - 1;
+			}
+			words[thread] = word;
+		}
+
+		// The group's scan: each word's first command is preceded by the visible items
+		// of the words before it.
+		uint32 visibleCount = 0;
+		for (uint32 thread = 0; thread < GroupSize; ++thread) {
+			offsets[thread] = visibleCount;
+			visibleCount += (uint32)std::popcount(words[thread]);
+		}
+
+		for (uint32 thread = 0; thread < GroupSize; ++thread) {
+			uint32 offset = commandCount + offsets[thread];
+			for (uint32 word = words[thread]; word != 0; word &= word - 1) {
+				const IndirectDrawItem& item = items[(first + thread) * 32 + (uint32)std::countr_zero(word)];
+				commands[offset++] = {
+					.RootConstant = item.RootConstant,
+					.Arguments = {
+						.IndexCountPerInstance = item.IndexCount,
+						.InstanceCount = 1,
+						.StartIndexLocation = item.StartIndexLocation,
+						.BaseVertexLocation = item.BaseVertexLocation,
+						.StartInstanceLocation = 0,
+					},
+				};
+			}
+		}
+
+		commandCount += visibleCount;
+	}
+
+	return commandCount;
+}
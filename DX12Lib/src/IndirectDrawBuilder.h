@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Same layout as D3D12_DRAW_INDEXED_ARGUMENTS, so this file builds without d3d12.h.
+struct DrawIndexedArguments
+{
+	std::uint32_t IndexCountPerInstance{};
+	std::uint32_t InstanceCount{};
+	std::uint32_t StartIndexLocation{};
+	std::int32_t BaseVertexLocation{};
+	std::uint32_t StartInstanceLocation{};
+};
+
+// What the argument builder knows about an item: its draw arguments and the root
+// constant its draw sets, typically the index of its per object data.
+struct IndirectDrawItem
+{
+	std::uint32_t IndexCount{};
+	std::uint32_t StartIndexLocation{};
+	std::int32_t BaseVertexLocation{};
+	std::uint32_t RootConstant{};
+};
+
+// One ExecuteIndirect command of a signature that sets a single 32 bit root constant
+// and then draws indexed.
+struct IndirectDrawCommand
+{
+	std::uint32_t RootConstant{};
+	DrawIndexedArguments Arguments{};
+};
+
+static_assert(sizeof(DrawIndexedArguments) == 20);
+static_assert(sizeof(IndirectDrawItem) == 16);
+static_assert(sizeof(IndirectDrawCommand) == 24);
+
+// Builds the commands of a GPU driven submission from every item's draw arguments and
+// a bit per item saying whether it is visible.
+//
+// The CPU only uploads the items and the visibility bits; a compute shader compacts the
+// visible items into IndirectDrawCommands and a count, which ExecuteIndirect consumes.
+// Build() is the reference of that shader: one group of GroupSize threads takes
+// GroupSize visibility words at a time, scans their visible counts and writes each
+// word's items at its offset. Commands come out in item order, so the reference and
+// the shader produce the same bytes.
+class IndirectDrawBuilder
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// Threads of the shader's single group.
+	static constexpr uint32 GroupSize{ 256 };
+
+	static constexpr uint32 VisibilityWordCount(uint32 itemCount) { return (itemCount + 31) / 32; }
+
+	// Rebuilds the visibility bits of itemCount items from the indices of the visible ones.
+	void SetVisibleItems(uint32 itemCount, std::span<const uint32> visibleItems);
+
+	// Bit i % 32 of word i / 32 is set if item i is visible.
+	std::span<const uint32> Visibility() const { return _visibility; }
+
+	// Writes the commands of the visible items to the front of commands, which must hold
+	// one per item, and returns their count. Bits past the last item are ignored.
+	static uint32 Build(std::span<const IndirectDrawItem> items, std::span<const uint32> visibility,
+		std::span<IndirectDrawCommand> commands);
+
+private:
+	std::vector<uint32> _visibility{};
+};
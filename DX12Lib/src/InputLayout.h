@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <d3d12.h>
+
+#include "VertexLayout.h"
+
+// D3D12 input layouts generated from VertexLayout descriptors, so the formats and
+// offsets the input assembler reads always match the packing code.
+namespace InputLayout
+{
+	constexpr DXGI_FORMAT Format(VertexEncoding encoding) {
+		switch (encoding) {
+		case VertexEncoding::Float32x2: return DXGI_FORMAT_R32G32_FLOAT;
+		case VertexEncoding::Float32x3: return DXGI_FORMAT_R32G32B32_FLOAT;
+		case VertexEncoding::Float32x4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		case VertexEncoding::Float16x2: return DXGI_FORMAT_R16G16_FLOAT;
+		case VertexEncoding::Float16x4: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case VertexEncoding::Snorm16x4: return DXGI_FORMAT_R16G16B16A16_SNORM;
+		case VertexEncoding::Octahedral16: return DXGI_FORMAT_R16G16_SNORM;
+		case VertexEncoding::Unorm8x4: return DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	// Bytes the input assembler reads for every format Format returns.
+	constexpr UINT FormatByteSize(DXGI_FORMAT format) {
+		switch (format) {
+		case DXGI_FORMAT_R32G32_FLOAT: return 8;
+		case DXGI_FORMAT_R32G32B32_FLOAT: return 12;
+		case DXGI_FORMAT_R32G32B32A32_FLOAT: return 16;
+		case DXGI_FORMAT_R16G16_FLOAT: return 4;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT: return 8;
+		case DXGI_FORMAT_R16G16B16A16_SNORM: return 8;
+		case DXGI_FORMAT_R16G16_SNORM: return 4;
+		case DXGI_FORMAT_R8G8B8A8_UNORM: return 4;
+		default: return 0;
+		}
+	}
+
+	// Semantic names as used by the shaders' input signatures.
+	constexpr const char* SemanticName(VertexSemantic semantic) {
+		switch (semantic) {
+		case VertexSemantic::Position: return "Position";
+		case VertexSemantic::Normal: return "Normal";
+		case VertexSemantic::Tangent: return "Tangent";
+		case VertexSemantic::TexCoord: return "TexCoord";
+		case VertexSemantic::Color: return "Color";
+		}
+		return "";
+	}
+
+	template<typename TVertexLayout>
+	constexpr std::array<D3D12_INPUT_ELEMENT_DESC, TVertexLayout::AttributeCount> Elements(UINT inputSlot = 0) {
+		std::array<D3D12_INPUT_ELEMENT_DESC, TVertexLayout::AttributeCount> inputElements{};
+		auto elements = TVertexLayout::Elements();
+		for (size_t i = 0; i < elements.size(); ++i) {
+			inputElements[i] = D3D12_INPUT_ELEMENT_DESC{
+				.SemanticName = SemanticName(elements[i].Semantic),
+				.SemanticIndex = elements[i].SemanticIndex,
+				.Format = Format(elements[i].Encoding),
+				.InputSlot = inputSlot,
+				.AlignedByteOffset = elements[i].ByteOffset,
+				.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+				.InstanceDataStepRate = 0,
+			};
+		}
+		return inputElements;
+	}
+
+	// True when the input elements of the layout tile its Vertex exactly: the first one
+	// starts at byte 0, every other one where the format of the one before ends, and the
+	// last one ends at sizeof(Vertex), which is the stride the vertex buffer views use.
+	template<typename TVertexLayout>
+	constexpr bool MatchesVertex() {
+		UINT offset = 0;
+		for (const D3D12_INPUT_ELEMENT_DESC& element : Elements<TVertexLayout>()) {
+			if (element.AlignedByteOffset != offset or FormatByteSize(element.Format) == 0)
+				return false;
+			offset += FormatByteSize(element.Format);
+		}
+		return offset == TVertexLayout::Stride and offset == sizeof(typename TVertexLayout::Vertex);
+	}
+}
+
+static_assert(InputLayout::MatchesVertex<ColorVertexLayout>());
+static_assert(InputLayout::Elements<ColorVertexLayout>()[0].Format == DXGI_FORMAT_R32G32B32_FLOAT);
+static_assert(InputLayout::Elements<ColorVertexLayout>()[1].Format == DXGI_FORMAT_R8G8B8A8_UNORM);
+static_assert(InputLayout::Elements<ColorVertexLayout>()[1].AlignedByteOffset == 12);
+static_assert(sizeof(ColorVertexLayout::Vertex) == 16);
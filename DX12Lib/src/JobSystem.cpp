@@ -0,0 +1,150 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Identifies the pool and queue a worker thread belongs to.
+	thread_local const JobSystem* tlsPool{};
+	thread_local unsigned tlsQueueIndex{};
+
+	// Number of empty polls before an idle worker goes to sleep.
+	const int IdleSpinCount{ 64 };
+}
+
+JobSystem::JobSystem(unsigned workerCount) {
+	for (unsigned i = 0; i < workerCount + 1; ++i)
+		_queues.push_back(std::make_unique<WorkQueue>());
+
+	_workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; ++i)
+		_workers.emplace_back(&JobSystem::WorkerMain, this, i + 1);
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_stopping = true;
+	}
+	_wakeUp.notify_all();
+
+	for (auto& worker : _workers)
+		worker.join();
+}
+
+unsigned JobSystem::DefaultWorkerCount() {
+	return std::max(1u, std::thread::hardware_concurrency()) - 1;
+}
+
+JobSystem& JobSystem::Default() {
+	static JobSystem pool{};
+	return pool;
+}
+
+void JobSystem::Run(RangeJob& job, std::size_t begin, std::size_t end) {
+	job.Remaining.store(end - begin);
+
+	Execute(Range{ &job, begin, end });
+
+	// Help out until every sub-range of this job has completed. The ranges we execute
+	// here may belong to other (e.g. nested) jobs; that is fine, all of them must finish.
+	while (job.Remaining.load() != 0) {
+		Range range{};
+		if (TryPop(range) or TrySteal(range))
+			Execute(range);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::Execute(Range range) {
+	RangeJob* pJob = range.pJob;
+
+	// Keep the lower half and make the upper half available to thieves until the
+	// remaining range is no larger than the grain size.
+	while (range.Last - range.First > pJob->GrainSize) {
+		std::size_t middle = range.First + (range.Last - range.First) / 2;
+		Push(Range{ pJob, middle, range.Last });
+		range.Last = middle;
+	}
+
+	pJob->Invoke(pJob->pBody, range.First, range.Last);
+
+	// This must be the last access to the job: once Remaining reaches zero
+	// the thread waiting in Run() returns and the job goes out of scope.
+	pJob->Remaining.fetch_sub(range.Last - range.First);
+}
+
+void JobSystem::Push(const Range& range) {
+	WorkQueue& queue = *_queues[CurrentQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Ranges.push_back(range);
+	}
+
+	_queuedRanges.fetch_add(1);
+	if (_sleepingWorkers.load() > 0) {
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_wakeUp.notify_one();
+	}
+}
+
+bool JobSystem::TryPop(Range& range) {
+	WorkQueue& queue = *_queues[CurrentQueueIndex()];
+	std::lock_guard<std::mutex> lock(queue.Mutex);
+	if (queue.Ranges.empty()) return false;
+
+	range = queue.Ranges.back();
+	queue.Ranges.pop_back();
+	_queuedRanges.fetch_sub(1);
+	return true;
+}
+
+bool JobSystem::TrySteal(Range& range) {
+	if (_queuedRanges.load() == 0) return false;
+
+	unsigned queueCount = (unsigned)_queues.size();
+	unsigned self = CurrentQueueIndex();
+	for (unsigned offset = 1; offset < queueCount; ++offset) {
+		WorkQueue& victim = *_queues[(self + offset) % queueCount];
+		std::lock_guard<std::mutex> lock(victim.Mutex);
+		if (victim.Ranges.empty()) continue;
+
+		range = victim.Ranges.front();
+		victim.Ranges.pop_front();
+		_queuedRanges.fetch_sub(1);
+		return true;
+	}
+
+	return false;
+}
+
+void JobSystem::WorkerMain(unsigned queueIndex) {
+	tlsPool = this;
+	tlsQueueIndex = queueIndex;
+
+	int idlePolls = 0;
+	while (not _stopping.load()) {
+		Range range{};
+		if (TryPop(range) or TrySteal(range)) {
+			Execute(range);
+			idlePolls = 0;
+			continue;
+		}
+
+		if (++idlePolls < IdleSpinCount) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_sleepMutex);
+		_sleepingWorkers.fetch_add(1);
+		_wakeUp.wait(lock, [this] { return _stopping.load() or _queuedRanges.load() > 0; });
+		_sleepingWorkers.fetch_sub(1);
+		idlePolls = 0;
+	}
+}
+
+unsigned JobSystem::CurrentQueueIndex() const {
+	return tlsPool == this ? tlsQueueIndex : 0;
+}
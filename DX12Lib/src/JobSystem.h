@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Portable work-stealing thread pool.
+//
+// Every worker owns a deque of index ranges. A worker executing a range larger than
+// the grain size splits it in half, pushes the upper half onto the back of its own
+// deque and keeps going with the lower half. Owners pop from the back (most recently
+// split, still hot in cache) and idle workers steal from the front of other deques
+// (the largest remaining ranges). Threads waiting in ParallelFor help execute work
+// instead of blocking, so ParallelFor may be nested.
+class JobSystem
+{
+public:
+	// workerCount == 0 runs everything on the calling thread.
+	explicit JobSystem(unsigned workerCount = DefaultWorkerCount());
+	~JobSystem();
+
+	// One worker per hardware thread, minus the thread calling ParallelFor.
+	static unsigned DefaultWorkerCount();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Pool shared by everything that does not bring its own.
+	static JobSystem& Default();
+
+	// Number of background workers; the thread calling ParallelFor also participates.
+	unsigned WorkerCount() const { return (unsigned)_workers.size(); }
+	unsigned ThreadCount() const { return WorkerCount() + 1; }
+
+	// Runs body over [begin, end) and returns once every index has been processed.
+	// body is called either as body(first, last) with a sub-range of at most
+	// grainSize indices, or as body(i) for every index.
+	template<typename TBody>
+	void ParallelFor(std::size_t begin, std::size_t end, std::size_t grainSize, TBody&& body);
+
+private:
+	struct RangeJob
+	{
+		void (*Invoke)(const void* pBody, std::size_t first, std::size_t last){};
+		const void* pBody{};
+		std::size_t GrainSize{};
+		std::atomic<std::size_t> Remaining{};
+	};
+
+	struct Range
+	{
+		RangeJob* pJob{};
+		std::size_t First{};
+		std::size_t Last{};
+	};
+
+	struct WorkQueue
+	{
+		std::mutex Mutex;
+		std::deque<Range> Ranges;
+	};
+
+	void Run(RangeJob& job, std::size_t begin, std::size_t end);
+	void Execute(Range range);
+	void Push(const Range& range);
+	bool TryPop(Range& range);
+	bool TrySteal(Range& range);
+	void WorkerMain(unsigned queueIndex);
+	unsigned CurrentQueueIndex() const;
+
+private:
+	std::vector<std::thread> _workers;
+
+	// Queue 0 is shared by all threads that are not workers of this pool;
+	// queue i + 1 belongs to worker i.
+	std::vector<std::unique_ptr<WorkQueue>> _queues;
+
+	std::atomic<std::size_t> _queuedRanges{};
+	std::atomic<unsigned> _sleepingWorkers{};
+	std::atomic<bool> _stopping{};
+	std::mutex _sleepMutex;
+	std::condition_variable _wakeUp;
+};
+
+template<typename TBody>
+void JobSystem::ParallelFor(std::size_t begin, std::size_t end, std::size_t grainSize, TBody&& body) {
+	using Body = std::remove_reference_t<TBody>;
+
+	if (begin >= end) return;
+	if (grainSize == 0) grainSize = 1;
+
+	RangeJob job{};
+	job.pBody = &body;
+	job.GrainSize = grainSize;
+	job.Invoke = [](const void* pBody, std::size_t first, std::size_t last) {
+		auto& typedBody = *static_cast<Body*>(const_cast<void*>(pBody));
+		if constexpr (std::is_invocable_v<Body&, std::size_t, std::size_t>) {
+			typedBody(first, last);
+		}
+		else {
+			for (std::size_t i = first; i < last; ++i)
+				typedBody(i);
+		}
+	};
+
+	// Nothing to split, or nobody to share with: run inline.
+	if (end - begin <= grainSize or _workers.empty()) {
+		job.Invoke(job.pBody, begin, end);
+		return;
+	}
+
+	Run(job, begin, end);
+}
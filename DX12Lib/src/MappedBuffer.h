@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+#include "AlignedAllocator.h"
+
+// Write access to a buffer of T living in persistently mapped memory.
+//
+// The memory is typically write-combined upload heap memory: write it sequentially,
+// in as few calls as possible, and never read it back. Derived classes provide the
+// memory: UploadBuffer maps a D3D12 upload resource, HostMappedBuffer uses plain
+// system memory so the write paths can be exercised and benchmarked without a device.
+template<typename T>
+class MappedBuffer
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Mapped buffer elements are copied with memcpy");
+
+public:
+	MappedBuffer(const MappedBuffer&) = delete;
+	MappedBuffer& operator=(const MappedBuffer&) = delete;
+
+	std::uint32_t ElementCount() const { return _elementCount; }
+	std::uint32_t ElementByteSize() const { return _elementByteSize; }
+
+	// True when elements are stored back to back, i.e. no constant buffer padding.
+	bool IsTightlyPacked() const { return _elementByteSize == sizeof(T); }
+
+	void CopyData(int elementIndex, const T& data) {
+		std::memcpy(&_pMappedData[elementIndex * _elementByteSize], &data, sizeof(T));
+	}
+
+	// Copies data.size() consecutive elements starting at firstElement. Tightly packed
+	// buffers take a single memcpy; padded (constant) buffers copy element by element.
+	void CopyRange(int firstElement, std::span<const T> data) {
+		assert(firstElement >= 0 and firstElement + data.size() <= _elementCount);
+
+		if (IsTightlyPacked()) {
+			std::memcpy(&_pMappedData[firstElement * sizeof(T)], data.data(), data.size_bytes());
+			return;
+		}
+
+		std::uint8_t* pDst = &_pMappedData[firstElement * _elementByteSize];
+		for (const T& element : data) {
+			std::memcpy(pDst, &element, sizeof(T));
+			pDst += _elementByteSize;
+		}
+	}
+
+	// The mapped elements as a span, for producers that generate data straight into
+	// the buffer. Only available for tightly packed buffers.
+	std::span<T> Elements() {
+		assert(IsTightlyPacked());
+		return std::span<T>(reinterpret_cast<T*>(_pMappedData), _elementCount);
+	}
+
+protected:
+	MappedBuffer(std::uint32_t elementCount, std::uint32_t elementByteSize) :
+		_elementCount(elementCount),
+		_elementByteSize(elementByteSize) {}
+
+	~MappedBuffer() = default;
+
+	std::uint8_t* _pMappedData{};
+	std::uint32_t _elementCount{};
+	std::uint32_t _elementByteSize{};
+};
+
+// MappedBuffer backed by aligned system memory instead of an upload heap.
+template<typename T>
+class HostMappedBuffer final : public MappedBuffer<T>
+{
+public:
+	explicit HostMappedBuffer(std::uint32_t elementCount, std::uint32_t elementByteSize = sizeof(T)) :
+		MappedBuffer<T>(elementCount, elementByteSize),
+		_storage(static_cast<size_t>(elementCount) * elementByteSize)
+	{
+		this->_pMappedData = _storage.data();
+	}
+
+	const std::uint8_t* Data() const { return _storage.data(); }
+
+private:
+	AlignedVector<std::uint8_t> _storage;
+};
@@ -0,0 +1,149 @@
+#include "MeshBounds.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+using namespace DirectX;
+
+namespace
+{
+	XMVECTOR LoadPosition(const std::uint8_t* pBase, size_t i, size_t stride) {
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pBase + i * stride));
+	}
+
+	// Largest squared distance from center to any of the points.
+	float MaxDistanceSq(const std::uint8_t* pBase, size_t count, size_t stride, FXMVECTOR center) {
+		XMVECTOR maxima[2] = { XMVectorZero(), XMVectorZero() };
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			maxima[0] = XMVectorMax(maxima[0], XMVector3LengthSq(XMVectorSubtract(LoadPosition(pBase, i, stride), center)));
+			maxima[1] = XMVectorMax(maxima[1], XMVector3LengthSq(XMVectorSubtract(LoadPosition(pBase, i + 1, stride), center)));
+		}
+		for (; i < count; ++i)
+			maxima[0] = XMVectorMax(maxima[0], XMVector3LengthSq(XMVectorSubtract(LoadPosition(pBase, i, stride), center)));
+
+		return XMVectorGetX(XMVectorMax(maxima[0], maxima[1]));
+	}
+
+	// Ritter's bounding sphere: start from the most distant pair among the points
+	// extreme along x, y and z, then grow the sphere just enough for each point outside.
+	BoundingSphere RitterSphere(const std::uint8_t* pBase, size_t count, size_t stride) {
+		size_t minIndex[3]{};
+		size_t maxIndex[3]{};
+		float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = 0; i < count; ++i) {
+			const float* p = reinterpret_cast<const float*>(pBase + i * stride);
+			for (int axis = 0; axis < 3; ++axis) {
+				if (p[axis] < minimum[axis]) {
+					minimum[axis] = p[axis];
+					minIndex[axis] = i;
+				}
+				if (p[axis] > maximum[axis]) {
+					maximum[axis] = p[axis];
+					maxIndex[axis] = i;
+				}
+			}
+		}
+
+		XMVECTOR a = LoadPosition(pBase, minIndex[0], stride);
+		XMVECTOR b = LoadPosition(pBase, maxIndex[0], stride);
+		float widestSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(b, a)));
+		for (int axis = 1; axis < 3; ++axis) {
+			XMVECTOR p0 = LoadPosition(pBase, minIndex[axis], stride);
+			XMVECTOR p1 = LoadPosition(pBase, maxIndex[axis], stride);
+			float distanceSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p1, p0)));
+			if (distanceSq > widestSq) {
+				widestSq = distanceSq;
+				a = p0;
+				b = p1;
+			}
+		}
+
+		XMVECTOR center = XMVectorScale(XMVectorAdd(a, b), 0.5f);
+		float radius = 0.5f * sqrtf(widestSq);
+		for (size_t i = 0; i < count; ++i) {
+			XMVECTOR p = LoadPosition(pBase, i, stride);
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(p, center)));
+			if (distance > radius) {
+				// Move the center towards p so the far side of the old sphere stays inside.
+				float newRadius = 0.5f * (radius + distance);
+				center = XMVectorAdd(center, XMVectorScale(XMVectorSubtract(p, center), (newRadius - radius) / distance));
+				radius = newRadius;
+			}
+		}
+
+		BoundingSphere sphere;
+		XMStoreFloat3(&sphere.Center, center);
+		sphere.Radius = radius;
+		return sphere;
+	}
+}
+
+MeshBounds::Bounds MeshBounds::Compute(const XMFLOAT3* pPositions, size_t count, size_t stride) {
+	if (count == 0)
+		return {};
+
+	auto pBase = reinterpret_cast<const std::uint8_t*>(pPositions);
+
+	// Four independent min/max chains keep the vector units busy instead of waiting
+	// on the previous iteration.
+	XMVECTOR minima[4];
+	XMVECTOR maxima[4];
+	for (int k = 0; k < 4; ++k) {
+		minima[k] = XMVectorReplicate(FLT_MAX);
+		maxima[k] = XMVectorReplicate(-FLT_MAX);
+	}
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		for (int k = 0; k < 4; ++k) {
+			XMVECTOR p = LoadPosition(pBase, i + k, stride);
+			minima[k] = XMVectorMin(minima[k], p);
+			maxima[k] = XMVectorMax(maxima[k], p);
+		}
+	}
+	for (; i < count; ++i) {
+		XMVECTOR p = LoadPosition(pBase, i, stride);
+		minima[0] = XMVectorMin(minima[0], p);
+		maxima[0] = XMVectorMax(maxima[0], p);
+	}
+
+	XMVECTOR minimum = XMVectorMin(XMVectorMin(minima[0], minima[1]), XMVectorMin(minima[2], minima[3]));
+	XMVECTOR maximum = XMVectorMax(XMVectorMax(maxima[0], maxima[1]), XMVectorMax(maxima[2], maxima[3]));
+
+	Bounds bounds;
+	BoundingBox::CreateFromPoints(bounds.Box, minimum, maximum);
+
+	XMVECTOR boxCenter = XMLoadFloat3(&bounds.Box.Center);
+	float boxRadius = sqrtf(MaxDistanceSq(pBase, count, stride, boxCenter));
+	BoundingSphere ritter = RitterSphere(pBase, count, stride);
+	bounds.Sphere = ritter.Radius < boxRadius ? ritter : BoundingSphere(bounds.Box.Center, boxRadius);
+
+	return bounds;
+}
+
+MeshBounds::Bounds MeshBounds::Merge(const Bounds& a, const Bounds& b) {
+	Bounds merged;
+	BoundingBox::CreateMerged(merged.Box, a.Box, b.Box);
+	BoundingSphere::CreateMerged(merged.Sphere, a.Sphere, b.Sphere);
+	return merged;
+}
+
+BoundingBox MeshBounds::Transform(const BoundingBox& box, const XMFLOAT4X4& world) {
+	// The center moves with the matrix; the extent along each world axis is the
+	// absolute rotation and scale part applied to the local extents.
+	XMMATRIX m = XMLoadFloat4x4(&world);
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&box.Center), m);
+	XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+	XMVECTOR worldExtents = XMVectorMultiply(XMVectorSplatX(extents), XMVectorAbs(m.r[0]));
+	worldExtents = XMVectorMultiplyAdd(XMVectorSplatY(extents), XMVectorAbs(m.r[1]), worldExtents);
+	worldExtents = XMVectorMultiplyAdd(XMVectorSplatZ(extents), XMVectorAbs(m.r[2]), worldExtents);
+
+	BoundingBox transformed;
+	XMStoreFloat3(&transformed.Center, center);
+	XMStoreFloat3(&transformed.Extents, worldExtents);
+	return transformed;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+// Bounding volumes of vertex positions, computed once when geometry is built so
+// culling and level of detail selection never have to look at vertices.
+namespace MeshBounds
+{
+	struct Bounds
+	{
+		DirectX::BoundingBox Box{ {}, {} };
+		DirectX::BoundingSphere Sphere{ {}, 0.0f };
+	};
+
+	// Bounds of count positions lying stride bytes apart, so positions can be read
+	// straight out of vertex structs. The box is exact; the sphere is the smaller of
+	// the one around the box center and Ritter's sphere, both of which contain every
+	// point. No points give empty bounds at the origin.
+	Bounds Compute(const DirectX::XMFLOAT3* pPositions, size_t count, size_t stride = sizeof(DirectX::XMFLOAT3));
+
+	Bounds Merge(const Bounds& a, const Bounds& b);
+
+	// Axis aligned box around box transformed by world (Arvo), so rotated boxes grow.
+	DirectX::BoundingBox Transform(const DirectX::BoundingBox& box, const DirectX::XMFLOAT4X4& world);
+}
@@ -0,0 +1,274 @@
+#include "MeshFile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "IndexPacking.h"
+
+using namespace MeshFile;
+
+namespace
+{
+	uint64 AlignUp(uint64 offset) {
+		return (offset + SectionAlignment - 1) & ~(uint64)(SectionAlignment - 1);
+	}
+
+	bool SectionFits(const Section& section, uint64 fileByteSize) {
+		return section.Offset % SectionAlignment == 0 and section.Offset <= fileByteSize
+			and section.ByteSize <= fileByteSize - section.Offset;
+	}
+
+	bool IndexRangeFits(uint32 startIndex, uint32 indexCount, uint32 totalIndexCount) {
+		return (uint64)startIndex + indexCount <= totalIndexCount;
+	}
+
+	// The tables are used without further checks once the image is open, so a record
+	// pointing outside the streams or the lod table rejects the whole file.
+	bool RecordsFit(const Header& header, std::span<const SubmeshRecord> submeshes, std::span<const LodRecord> lods) {
+		for (const LodRecord& lod : lods) {
+			if (not IndexRangeFits(lod.StartIndexLocation, lod.IndexCount, header.IndexCount))
+				return false;
+		}
+
+		for (const SubmeshRecord& submesh : submeshes) {
+			if (std::memchr(submesh.Name, '\0', sizeof(submesh.Name)) == nullptr
+				or not IndexRangeFits(submesh.StartIndexLocation, submesh.IndexCount, header.IndexCount)
+				or submesh.BaseVertexLocation < 0 or (uint32)submesh.BaseVertexLocation > header.VertexCount
+				or (uint64)submesh.FirstLod + submesh.LodCount > header.LodCount)
+				return false;
+		}
+		return true;
+	}
+
+	// Maps a file read-only and returns its first byte, or nullptr.
+	void* MapFile(const std::filesystem::path& path, size_t& byteSize) {
+#ifdef _WIN32
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		LARGE_INTEGER size{};
+		void* pView = nullptr;
+		if (GetFileSizeEx(file, &size) and size.QuadPart > 0) {
+			// The view keeps the mapping alive once both handles are closed.
+			HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping != nullptr) {
+				pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+
+		byteSize = (size_t)size.QuadPart;
+		return pView;
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return nullptr;
+
+		struct stat status{};
+		void* pView = nullptr;
+		if (fstat(file, &status) == 0 and status.st_size > 0) {
+			pView = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (pView == MAP_FAILED)
+				pView = nullptr;
+		}
+		close(file);
+
+		byteSize = (size_t)status.st_size;
+		return pView;
+#endif
+	}
+
+	void UnmapFile(void* pView, size_t byteSize) {
+#ifdef _WIN32
+		(void)byteSize;
+		UnmapViewOfFile(pView);
+#else
+		munmap(pView, byteSize);
+#endif
+	}
+
+	std::string HexString(uint64 value) {
+		char text[17];
+		std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+		return text;
+	}
+}
+
+Image::Image(Image&& other) noexcept {
+	*this = std::move(other);
+}
+
+Image& Image::operator=(Image&& other) noexcept {
+	if (this != &other) {
+		Release();
+		_pBytes = std::exchange(other._pBytes, nullptr);
+		_pHeader = std::exchange(other._pHeader, nullptr);
+		_storage = std::move(other._storage);
+		_pMapping = std::exchange(other._pMapping, nullptr);
+		_mappedByteSize = std::exchange(other._mappedByteSize, 0);
+	}
+	return *this;
+}
+
+Image::~Image() {
+	Release();
+}
+
+void Image::Release() {
+	if (_pMapping != nullptr)
+		UnmapFile(_pMapping, _mappedByteSize);
+
+	_pBytes = nullptr;
+	_pHeader = nullptr;
+	_storage.clear();
+	_pMapping = nullptr;
+	_mappedByteSize = 0;
+}
+
+void Image::Open(const std::byte* pBytes, size_t byteSize) {
+	if (byteSize < sizeof(Header))
+		return;
+
+	auto pHeader = reinterpret_cast<const Header*>(pBytes);
+	if (pHeader->Magic != Magic or pHeader->Version != Version or pHeader->FileByteSize != byteSize)
+		return;
+
+	for (const Section* pSection : { &pHeader->VertexElements, &pHeader->Submeshes, &pHeader->Lods, &pHeader->Vertices, &pHeader->Indices }) {
+		if (not SectionFits(*pSection, byteSize))
+			return;
+	}
+
+	if (pHeader->VertexElements.ByteSize != (uint64)pHeader->VertexElementCount * sizeof(VertexElement)
+		or pHeader->Submeshes.ByteSize != (uint64)pHeader->SubmeshCount * sizeof(SubmeshRecord)
+		or pHeader->Lods.ByteSize != (uint64)pHeader->LodCount * sizeof(LodRecord)
+		or pHeader->Vertices.ByteSize != (uint64)pHeader->VertexCount * pHeader->VertexStride
+		or pHeader->Indices.ByteSize != (uint64)pHeader->IndexCount * pHeader->IndexByteSize
+		or (pHeader->IndexByteSize != 2 and pHeader->IndexByteSize != 4))
+		return;
+
+	_pBytes = pBytes;
+	_pHeader = pHeader;
+	if (not RecordsFit(*pHeader, Submeshes(), Lods())) {
+		_pBytes = nullptr;
+		_pHeader = nullptr;
+	}
+}
+
+Image Image::Map(const std::filesystem::path& path) {
+	Image image;
+	image._pMapping = MapFile(path, image._mappedByteSize);
+	if (image._pMapping != nullptr) {
+		image.Open(static_cast<const std::byte*>(image._pMapping), image._mappedByteSize);
+		if (not image.IsValid())
+			image.Release();
+	}
+	return image;
+}
+
+Image Image::Serialize(const Contents& contents, uint64 contentHash) {
+	assert(contents.Vertices.size() % contents.VertexStride == 0);
+
+	// Indices are relative to the base vertices, so the largest one decides the width.
+	uint32 indexByteSize = IndexPacking::IndexByteSize(IndexPacking::MaxIndex(contents.Indices));
+
+	Header header{
+		.Magic = Magic,
+		.Version = Version,
+		.ContentHash = contentHash,
+		.VertexCount = (uint32)(contents.Vertices.size() / contents.VertexStride),
+		.VertexStride = contents.VertexStride,
+		.IndexCount = (uint32)contents.Indices.size(),
+		.IndexByteSize = indexByteSize,
+		.VertexElementCount = (uint32)contents.VertexElements.size(),
+		.SubmeshCount = (uint32)contents.Submeshes.size(),
+		.LodCount = (uint32)contents.Lods.size(),
+	};
+
+	for (size_t i = 0; i < contents.Submeshes.size(); ++i)
+		header.Bounds = i == 0 ? contents.Submeshes[i].Bounds : MeshBounds::Merge(header.Bounds, contents.Submeshes[i].Bounds);
+
+	uint64 offset = AlignUp(sizeof(Header));
+	auto placeSection = [&](Section& section, uint64 byteSize) {
+		section = Section{ offset, byteSize };
+		offset = AlignUp(offset + byteSize);
+	};
+	placeSection(header.VertexElements, contents.VertexElements.size() * sizeof(VertexElement));
+	placeSection(header.Submeshes, contents.Submeshes.size() * sizeof(SubmeshRecord));
+	placeSection(header.Lods, contents.Lods.size() * sizeof(LodRecord));
+	placeSection(header.Vertices, contents.Vertices.size());
+	placeSection(header.Indices, (uint64)contents.Indices.size() * indexByteSize);
+	header.FileByteSize = offset;
+
+	Image image;
+	image._storage.resize((size_t)header.FileByteSize);
+	std::byte* pBytes = image._storage.data();
+
+	std::memcpy(pBytes, &header, sizeof(header));
+	std::memcpy(pBytes + header.VertexElements.Offset, contents.VertexElements.data(), header.VertexElements.ByteSize);
+	std::memcpy(pBytes + header.Submeshes.Offset, contents.Submeshes.data(), header.Submeshes.ByteSize);
+	std::memcpy(pBytes + header.Lods.Offset, contents.Lods.data(), header.Lods.ByteSize);
+	std::memcpy(pBytes + header.Vertices.Offset, contents.Vertices.data(), header.Vertices.ByteSize);
+	IndexPacking::Pack(contents.Indices, indexByteSize, pBytes + header.Indices.Offset);
+
+	image.Open(pBytes, image._storage.size());
+	assert(image.IsValid());
+	return image;
+}
+
+bool Image::WriteTo(const std::filesystem::path& path) const {
+	if (not IsValid())
+		return false;
+
+	// Write next to the destination and rename, so an interrupted write never leaves a
+	// truncated file under the final name.
+	std::filesystem::path temporaryPath = path;
+	temporaryPath += ".tmp";
+	{
+		std::ofstream fout(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (fout.fail())
+			return false;
+
+		fout.write(reinterpret_cast<const char*>(_pBytes), (std::streamsize)_pHeader->FileByteSize);
+		if (fout.fail())
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	return not error;
+}
+
+Image Image::LoadOrBuild(const std::filesystem::path& directory, std::string_view name, uint64 contentHash,
+	const std::function<Contents()>& build) {
+	std::filesystem::path path = directory / (std::string(name) + "-" + HexString(contentHash) + ".dxmesh");
+
+	Image image = Map(path);
+	if (image.IsValid() and image.GetHeader().ContentHash == contentHash)
+		return image;
+
+	image = Serialize(build(), contentHash);
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (not error)
+		image.WriteTo(path);
+
+	return image;
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "GeometryGenerator.h"
+#include "MeshBounds.h"
+#include "MeshSimplifier.h"
+#include "VertexLayout.h"
+
+// Binary container for the geometry of a MeshGeometry, laid out so a file can be
+// memory mapped and used in place.
+//
+// A file is a Header followed by sections, each starting on a SectionAlignment byte
+// boundary: the vertex elements of the layout the vertices are packed with, the
+// submesh table, the level of detail table, and the vertex and index streams exactly
+// as they are uploaded to the GPU. Opening a file checks the header and that every
+// submesh and level of detail record lies within the index stream and the lod table;
+// all access afterwards is pointer arithmetic into the mapped memory.
+//
+// The header records a content hash chosen by the writer, normally a hash of every
+// input of the procedure that generated the geometry. Apps look files up by that hash
+// with Image::LoadOrBuild, so a change to a generator parameter misses the cache
+// instead of loading stale geometry.
+namespace MeshFile
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	inline constexpr uint32 Magic{ 0x464D5844 }; // "DXMF"
+	inline constexpr uint32 Version{ 2 };
+	inline constexpr uint32 SectionAlignment{ 64 };
+	inline constexpr size_t MaxNameLength{ 31 };
+
+	struct Section
+	{
+		uint64 Offset{};
+		uint64 ByteSize{};
+	};
+
+	struct Header
+	{
+		uint32 Magic{};
+		uint32 Version{};
+		uint64 ContentHash{};
+		uint64 FileByteSize{};
+
+		uint32 VertexCount{};
+		uint32 VertexStride{};
+		uint32 IndexCount{};
+		uint32 IndexByteSize{}; // 2 or 4
+		uint32 VertexElementCount{};
+		uint32 SubmeshCount{};
+		uint32 LodCount{};
+		uint32 Padding{};
+
+		// Bounds of all submeshes, in object space.
+		MeshBounds::Bounds Bounds{};
+
+		Section VertexElements{};
+		Section Submeshes{};
+		Section Lods{};
+		Section Vertices{};
+		Section Indices{};
+	};
+
+	struct SubmeshRecord
+	{
+		char Name[MaxNameLength + 1]{};
+		uint32 IndexCount{};
+		uint32 StartIndexLocation{};
+		std::int32_t BaseVertexLocation{};
+
+		// Levels of detail 1 and up: [FirstLod, FirstLod + LodCount) in the lod table.
+		uint32 FirstLod{};
+		uint32 LodCount{};
+
+		MeshBounds::Bounds Bounds{};
+	};
+
+	struct LodRecord
+	{
+		uint32 IndexCount{};
+		uint32 StartIndexLocation{};
+		float Error{};
+	};
+
+	static_assert(sizeof(Header) % 8 == 0 and sizeof(SubmeshRecord) % 4 == 0);
+	static_assert(sizeof(VertexElement) == 16, "Vertex elements are stored as they are");
+
+	// Geometry on its way into a file: vertices packed with one VertexLayout, 32-bit
+	// indices relative to each submesh's base vertex, and the tables.
+	struct Contents
+	{
+		std::vector<VertexElement> VertexElements{};
+		uint32 VertexStride{};
+		std::vector<std::byte> Vertices{};
+		std::vector<uint32> Indices{};
+		std::vector<SubmeshRecord> Submeshes{};
+		std::vector<LodRecord> Lods{};
+	};
+
+	// Packs the vertices of meshData with TVertexLayout and appends them, its indices
+	// and a submesh called name. makeSource turns each vertex into the VertexSource to
+	// pack, which is where positions can be displaced or colors chosen. lods are the
+	// levels MeshSimplifier::AppendLodChain added to meshData, level 0 first; without
+	// them the submesh draws all of Indices32.
+	template<typename TVertexLayout, typename TMakeSource>
+	void AppendSubmesh(Contents& contents, std::string_view name, const GeometryGenerator::MeshData& meshData,
+		std::span<const MeshSimplifier::LodLevel> lods, TMakeSource&& makeSource) {
+		if (contents.VertexElements.empty()) {
+			auto elements = TVertexLayout::Elements();
+			contents.VertexElements.assign(elements.begin(), elements.end());
+			contents.VertexStride = TVertexLayout::Stride;
+		}
+		assert(contents.VertexStride == TVertexLayout::Stride and "All submeshes share one vertex layout");
+		assert(name.size() <= MaxNameLength);
+
+		SubmeshRecord submesh{};
+		name.copy(submesh.Name, MaxNameLength);
+		submesh.IndexCount = lods.empty() ? (uint32)meshData.Indices32.size() : lods[0].IndexCount;
+		submesh.StartIndexLocation = (uint32)contents.Indices.size();
+		submesh.BaseVertexLocation = (std::int32_t)(contents.Vertices.size() / TVertexLayout::Stride);
+		submesh.FirstLod = (uint32)contents.Lods.size();
+		submesh.LodCount = lods.empty() ? 0 : (uint32)lods.size() - 1;
+
+		size_t firstByte = contents.Vertices.size();
+		contents.Vertices.resize(firstByte + meshData.Vertices.size() * TVertexLayout::Stride);
+
+		// Bounds are taken after makeSource, which may move the vertices.
+		std::vector<DirectX::XMFLOAT3> positions(meshData.Vertices.size());
+		for (size_t i = 0; i < meshData.Vertices.size(); ++i) {
+			VertexSource source = makeSource(meshData.Vertices[i]);
+			positions[i] = source.Position;
+
+			typename TVertexLayout::Vertex vertex;
+			TVertexLayout::Pack(source, vertex);
+			std::memcpy(&contents.Vertices[firstByte + i * TVertexLayout::Stride], vertex.Data, TVertexLayout::Stride);
+		}
+		submesh.Bounds = MeshBounds::Compute(positions.data(), positions.size());
+
+		for (size_t level = 1; level < lods.size(); ++level) {
+			contents.Lods.push_back(LodRecord{
+				.IndexCount = lods[level].IndexCount,
+				.StartIndexLocation = submesh.StartIndexLocation + lods[level].StartIndex,
+				.Error = lods[level].Error,
+			});
+		}
+
+		contents.Indices.insert(contents.Indices.end(), meshData.Indices32.begin(), meshData.Indices32.end());
+		contents.Submeshes.push_back(submesh);
+	}
+
+	// FNV-1a over the inputs that determine a file's geometry.
+	class ContentHash
+	{
+	public:
+		ContentHash& Add(std::span<const std::byte> bytes) {
+			for (std::byte b : bytes)
+				_value = (_value ^ (uint64)b) * 0x100000001B3ull;
+			return *this;
+		}
+
+		template<typename T>
+			requires (not std::is_convertible_v<const T&, std::string_view>)
+		ContentHash& Add(const T& value) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			return Add(std::as_bytes(std::span<const T>(&value, 1)));
+		}
+
+		ContentHash& Add(std::string_view text) {
+			return Add(std::as_bytes(std::span<const char>(text.data(), text.size())));
+		}
+
+		// Adds the layout's elements, so changing a vertex format misses the cache.
+		template<typename TVertexLayout>
+		ContentHash& AddVertexLayout() {
+			auto elements = TVertexLayout::Elements();
+			return Add(std::as_bytes(std::span<const VertexElement>(elements)));
+		}
+
+		uint64 Value() const { return _value; }
+
+	private:
+		uint64 _value{ 0xCBF29CE484222325ull };
+	};
+
+	// A complete mesh file in memory: mapped from disk, or serialized from Contents.
+	class Image
+	{
+	public:
+		Image() = default;
+		Image(Image&& other) noexcept;
+		Image& operator=(Image&& other) noexcept;
+		Image(const Image&) = delete;
+		Image& operator=(const Image&) = delete;
+		~Image();
+
+		// Maps the file at path. The image is invalid if the file does not exist, is not
+		// a mesh file of this Version or its tables point outside the file.
+		static Image Map(const std::filesystem::path& path);
+
+		static Image Serialize(const Contents& contents, uint64 contentHash);
+
+		// Maps <directory>/<name>-<contentHash>.dxmesh, or, when there is no such file,
+		// serializes the Contents returned by build and writes them there for the next
+		// run. Failing to write the cache is not an error.
+		static Image LoadOrBuild(const std::filesystem::path& directory, std::string_view name, uint64 contentHash,
+			const std::function<Contents()>& build);
+
+		bool WriteTo(const std::filesystem::path& path) const;
+
+		bool IsValid() const { return _pHeader != nullptr; }
+		bool IsMapped() const { return _pMapping != nullptr; }
+
+		const Header& GetHeader() const { return *_pHeader; }
+
+		std::span<const VertexElement> VertexElements() const { return SectionAs<VertexElement>(_pHeader->VertexElements); }
+		std::span<const SubmeshRecord> Submeshes() const { return SectionAs<SubmeshRecord>(_pHeader->Submeshes); }
+		std::span<const LodRecord> Lods() const { return SectionAs<LodRecord>(_pHeader->Lods); }
+		std::span<const std::byte> Vertices() const { return SectionAs<std::byte>(_pHeader->Vertices); }
+		std::span<const std::byte> Indices() const { return SectionAs<std::byte>(_pHeader->Indices); }
+
+		// True when the vertices are packed with TVertexLayout.
+		template<typename TVertexLayout>
+		bool HasVertexLayout() const {
+			auto elements = TVertexLayout::Elements();
+			auto stored = VertexElements();
+			return _pHeader->VertexStride == TVertexLayout::Stride and stored.size() == elements.size()
+				and std::memcmp(stored.data(), elements.data(), stored.size_bytes()) == 0;
+		}
+
+	private:
+		template<typename T>
+		std::span<const T> SectionAs(const Section& section) const {
+			return std::span<const T>(reinterpret_cast<const T*>(_pBytes + section.Offset), section.ByteSize / sizeof(T));
+		}
+
+		// Points the image at bytes if they hold a valid file.
+		void Open(const std::byte* pBytes, size_t byteSize);
+		void Release();
+
+		const std::byte* _pBytes{};
+		const Header* _pHeader{};
+
+		// Serialized images own their bytes; mapped ones the mapping.
+		AlignedVector<std::byte, SectionAlignment> _storage{};
+		void* _pMapping{};
+		size_t _mappedByteSize{};
+	};
+}
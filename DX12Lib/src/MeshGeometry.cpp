@@ -1,5 +1,9 @@
 #include "MeshGeometry.h"
 
+#include <d3dcompiler.h>
+
+#include "IndexPacking.h"
+
 D3D12_VERTEX_BUFFER_VIEW MeshGeometry::VertexBufferView() const {
     return D3D12_VERTEX_BUFFER_VIEW{
         .BufferLocation = VertexBufferGpu->GetGPUVirtualAddress(),
@@ -15,3 +19,101 @@ D3D12_INDEX_BUFFER_VIEW MeshGeometry::IndexBufferView() const {
         .Format = IndexFormat,
     };
 }
+
+SubMeshLod SubMeshGeometry::Lod(UINT level) const {
+    if (level == 0)
+        return SubMeshLod{ .IndexCount = IndexCount, .StartIndexLocation = StartIndexLocation };
+
+    return Lods[level - 1];
+}
+
+UINT SubMeshGeometry::SelectLod(float distance, float pixelsPerUnit, float maxPixelError) const {
+    // Errors grow with the level, so walk down from the coarsest one.
+    float maxError = maxPixelError * distance / pixelsPerUnit;
+    for (UINT level = (UINT)Lods.size(); level > 0; --level) {
+        if (Lods[level - 1].Error <= maxError)
+            return level;
+    }
+
+    return 0;
+}
+
+float ScreenSpaceErrorScale(float fovY, float viewportHeight) {
+    return viewportHeight / (2.0f * tanf(0.5f * fovY));
+}
+
+void MeshGeometry::CreateIndexBuffer(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList,
+    std::span<const std::uint32_t> indices) {
+    UINT indexByteSize = IndexPacking::IndexByteSize(IndexPacking::MaxIndex(indices));
+    IndexFormat = indexByteSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    IndexBufferByteSize = (UINT)indices.size() * indexByteSize;
+
+    THROW_IF_FAILED(D3DCreateBlob(IndexBufferByteSize, &IndexBufferCpu));
+    IndexPacking::Pack(indices, indexByteSize, IndexBufferCpu->GetBufferPointer());
+
+    IndexBufferGpu = DxUtil::CreateDefaultBuffer(pDevice, pCommandList, IndexBufferByteSize, IndexBufferUploader,
+        [&](void* pUploadData) { IndexPacking::Pack(indices, indexByteSize, pUploadData); });
+}
+
+std::vector<SubMeshGeometry> MeshGeometry::CreateSplitIndexBuffer(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList,
+    std::span<const std::uint32_t> indices) {
+    std::vector<IndexPacking::IndexRange> ranges = IndexPacking::SplitFor16BitIndices(indices);
+    if (ranges.empty()) {
+        CreateIndexBuffer(pDevice, pCommandList, indices);
+
+        SubMeshGeometry submesh;
+        submesh.IndexCount = (UINT)indices.size();
+        return { submesh };
+    }
+
+    auto writeIndices = [&](void* pData) {
+        auto* pIndices = static_cast<std::uint16_t*>(pData);
+        for (const auto& range : ranges)
+            IndexPacking::Narrow(indices.subspan(range.StartIndex, range.IndexCount), pIndices + range.StartIndex, range.BaseVertex);
+    };
+
+    IndexFormat = DXGI_FORMAT_R16_UINT;
+    IndexBufferByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+
+    THROW_IF_FAILED(D3DCreateBlob(IndexBufferByteSize, &IndexBufferCpu));
+    writeIndices(IndexBufferCpu->GetBufferPointer());
+
+    IndexBufferGpu = DxUtil::CreateDefaultBuffer(pDevice, pCommandList, IndexBufferByteSize, IndexBufferUploader, writeIndices);
+
+    std::vector<SubMeshGeometry> submeshes(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        submeshes[i].IndexCount = ranges[i].IndexCount;
+        submeshes[i].StartIndexLocation = ranges[i].StartIndex;
+        submeshes[i].BaseVertexLocation = (INT)ranges[i].BaseVertex;
+    }
+    return submeshes;
+}
+
+void MeshGeometry::CreateFromImage(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList,
+    const MeshFile::Image& image) {
+    const MeshFile::Header& header = image.GetHeader();
+
+    VertexByteStride = header.VertexStride;
+    VertexBufferByteSize = (UINT)header.Vertices.ByteSize;
+    VertexBufferGpu = DxUtil::CreateDefaultBuffer(pDevice, pCommandList,
+        image.Vertices().data(), VertexBufferByteSize, VertexBufferUploader);
+
+    IndexFormat = header.IndexByteSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    IndexBufferByteSize = (UINT)header.Indices.ByteSize;
+    IndexBufferGpu = DxUtil::CreateDefaultBuffer(pDevice, pCommandList,
+        image.Indices().data(), IndexBufferByteSize, IndexBufferUploader);
+
+    auto lods = image.Lods();
+    for (const MeshFile::SubmeshRecord& record : image.Submeshes()) {
+        SubMeshGeometry submesh;
+        submesh.IndexCount = record.IndexCount;
+        submesh.StartIndexLocation = record.StartIndexLocation;
+        submesh.BaseVertexLocation = record.BaseVertexLocation;
+        submesh.BoundingBox = record.Bounds.Box;
+        submesh.BoundingSphere = record.Bounds.Sphere;
+        for (const MeshFile::LodRecord& lod : lods.subspan(record.FirstLod, record.LodCount))
+            submesh.Lods.push_back(SubMeshLod{ lod.IndexCount, lod.StartIndexLocation, lod.Error });
+
+        DrawArguments[record.Name] = std::move(submesh);
+    }
+}
@@ -1,18 +1,54 @@
 #pragma once
 
+#include <cstdint>
+#include <span>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "Dxutil.h"
+#include "MeshFile.h"
+
+// Coarser version of a submesh. It indexes the submesh's vertices, so it is drawn with
+// the submesh's BaseVertexLocation.
+struct SubMeshLod
+{
+	UINT IndexCount{};
+	UINT StartIndexLocation{};
+
+	// Object space distance the level may deviate from the full detail mesh.
+	float Error{};
+};
 
 struct SubMeshGeometry
 {
 	UINT IndexCount{};
 	UINT StartIndexLocation{};
 	INT BaseVertexLocation{};
+
+	// Object space bounds of the submesh's vertices, filled in when it is built.
 	DirectX::BoundingBox BoundingBox{};
+	DirectX::BoundingSphere BoundingSphere{};
+
+	// Meshlets of the submesh, for geometry that has been clustered with MeshletBuilder:
+	// [StartMeshletLocation, StartMeshletLocation + MeshletCount) in the meshlet buffer.
+	UINT MeshletCount{};
+	UINT StartMeshletLocation{};
+
+	// Levels of detail 1 and up, increasingly coarse; level 0 is the submesh itself.
+	std::vector<SubMeshLod> Lods{};
+
+	UINT LodCount() const { return (UINT)Lods.size() + 1; }
+	SubMeshLod Lod(UINT level) const;
+
+	// Coarsest level whose error, seen from distance, covers at most maxPixelError
+	// pixels. pixelsPerUnit is ScreenSpaceErrorScale() times the object's world scale.
+	UINT SelectLod(float distance, float pixelsPerUnit, float maxPixelError) const;
 };
 
+// Height in pixels of one world unit at distance 1 in front of a perspective camera.
+float ScreenSpaceErrorScale(float fovY, float viewportHeight);
+
 struct MeshGeometry final
 {
 	std::string Name;
@@ -32,6 +68,24 @@ struct MeshGeometry final
 
 	std::unordered_map<std::string, SubMeshGeometry> DrawArguments{};
 
+	// Creates IndexBufferCpu/Gpu/Uploader from 32-bit indices in the narrowest format
+	// that holds them, and sets IndexFormat and IndexBufferByteSize. The indices are
+	// converted straight into the blob and the upload buffer.
+	void CreateIndexBuffer(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList,
+		std::span<const std::uint32_t> indices);
+
+	// Like CreateIndexBuffer, but keeps 16-bit indices for meshes with more vertices
+	// than they can address by splitting the triangles into ranges drawn with their
+	// own BaseVertexLocation. Returns those ranges as submeshes, in index order. Uses
+	// 32-bit indices, and a single submesh, when the mesh cannot be split.
+	std::vector<SubMeshGeometry> CreateSplitIndexBuffer(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList,
+		std::span<const std::uint32_t> indices);
+
+	// Creates the buffers and DrawArguments of a mesh file. Both streams are uploaded
+	// straight from the image, so IndexBufferCpu and VertexBufferCpu stay empty.
+	void CreateFromImage(ID3D12Device* pDevice, ID3D12GraphicsCommandList* pCommandList,
+		const MeshFile::Image& image);
+
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView() const;
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView() const;
 };
@@ -0,0 +1,247 @@
+#include "MeshOptimizer.h"
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+using MeshOptimizer::uint32;
+
+namespace
+{
+	// Forsyth's scoring constants, from "Linear-Speed Vertex Cache Optimisation".
+	const int ScoringCacheSize{ 32 };
+	const float CacheDecayPower{ 1.5f };
+	const float LastTriangleScore{ 0.75f };
+	const float ValenceBoostScale{ 2.0f };
+	const float ValenceBoostPower{ 0.5f };
+
+	// Valences above this all get the (tiny) boost of the last table entry.
+	const int MaxScoredValence{ 64 };
+
+	const uint32 InvalidIndex{ std::numeric_limits<uint32>::max() };
+
+	struct ScoreTables
+	{
+		std::array<float, ScoringCacheSize> Cache{};
+		std::array<float, MaxScoredValence + 1> Valence{};
+	};
+
+	const ScoreTables& GetScoreTables() {
+		static const ScoreTables tables = [] {
+			ScoreTables t;
+			for (int i = 0; i < ScoringCacheSize; ++i) {
+				// The three vertices of the last triangle get a fixed score so the
+				// algorithm does not simply continue along a strip.
+				if (i < 3) {
+					t.Cache[i] = LastTriangleScore;
+					continue;
+				}
+
+				float scale = 1.0f / (ScoringCacheSize - 3);
+				t.Cache[i] = powf(1.0f - (i - 3) * scale, CacheDecayPower);
+			}
+
+			// Boost vertices with few triangles left so they get finished off.
+			t.Valence[0] = 0.0f;
+			for (int i = 1; i <= MaxScoredValence; ++i)
+				t.Valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+			return t;
+		}();
+		return tables;
+	}
+
+	float VertexScore(const ScoreTables& tables, int cachePosition, uint32 remainingTriangles) {
+		// Vertices without triangles left never influence a choice again.
+		if (remainingTriangles == 0) return -1.0f;
+
+		float score = cachePosition < 0 ? 0.0f : tables.Cache[cachePosition];
+		return score + tables.Valence[std::min<uint32>(remainingTriangles, MaxScoredValence)];
+	}
+}
+
+MeshOptimizer::CacheStatistics MeshOptimizer::AnalyzeVertexCache(std::span<const uint32> indices, uint32 vertexCount, uint32 cacheSize) {
+	assert(indices.size() % 3 == 0);
+	assert(cacheSize > 0);
+
+	// A vertex is in the FIFO if fewer than cacheSize misses happened since it was
+	// last loaded. Timestamps start past cacheSize so nothing is cached initially.
+	std::vector<uint32> loadedAt(vertexCount, 0);
+	std::vector<std::uint8_t> referenced(vertexCount, 0);
+	uint32 timestamp = cacheSize + 1;
+	uint32 referencedCount = 0;
+
+	CacheStatistics statistics{};
+	for (uint32 index : indices) {
+		assert(index < vertexCount);
+
+		if (timestamp - loadedAt[index] > cacheSize) {
+			loadedAt[index] = timestamp++;
+			++statistics.TransformedVertexCount;
+		}
+
+		if (not referenced[index]) {
+			referenced[index] = 1;
+			++referencedCount;
+		}
+	}
+
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount > 0)
+		statistics.Acmr = (float)statistics.TransformedVertexCount / triangleCount;
+	if (referencedCount > 0)
+		statistics.Atvr = (float)statistics.TransformedVertexCount / referencedCount;
+	return statistics;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::span<uint32> indices, uint32 vertexCount) {
+	assert(indices.size() % 3 == 0);
+
+	const ScoreTables& tables = GetScoreTables();
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	// Triangles using each vertex, as one array sliced by firstTriangle. The first
+	// remainingTriangles[v] entries of a slice are the triangles not yet emitted.
+	std::vector<uint32> firstTriangle(vertexCount + 1, 0);
+	std::vector<uint32> remainingTriangles(vertexCount, 0);
+	for (uint32 index : indices) {
+		assert(index < vertexCount);
+		++remainingTriangles[index];
+	}
+
+	for (uint32 v = 0; v < vertexCount; ++v)
+		firstTriangle[v + 1] = firstTriangle[v] + remainingTriangles[v];
+
+	std::vector<uint32> vertexTriangles(indices.size());
+	{
+		std::vector<uint32> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+			vertexTriangles[fill[indices[i]]++] = (uint32)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint32 v = 0; v < vertexCount; ++v)
+		vertexScore[v] = VertexScore(tables, -1, remainingTriangles[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<std::uint8_t> emitted(triangleCount, 0);
+	uint32 bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		const uint32* pCorners = &indices[t * 3];
+		triangleScore[t] = vertexScore[pCorners[0]] + vertexScore[pCorners[1]] + vertexScore[pCorners[2]];
+		if (triangleScore[t] > triangleScore[bestTriangle])
+			bestTriangle = (uint32)t;
+	}
+
+	// The input is overwritten as triangles are emitted, so read from a copy.
+	std::vector<uint32> source(indices.begin(), indices.end());
+
+	// Simulated LRU cache, most recently used first. One emitted triangle pushes at
+	// most three vertices out, hence the extra room while the cache is rebuilt.
+	std::array<uint32, ScoringCacheSize + 3> cache{};
+	std::array<uint32, ScoringCacheSize + 3> newCache{};
+	int cacheCount = 0;
+	size_t inputCursor = 0;
+
+	for (size_t outputTriangle = 0; outputTriangle < triangleCount; ++outputTriangle) {
+		// Nothing in the cache has triangles left: continue with the first triangle
+		// of the input that has not been emitted yet.
+		if (bestTriangle == InvalidIndex) {
+			while (emitted[inputCursor]) ++inputCursor;
+			bestTriangle = (uint32)inputCursor;
+		}
+
+		const uint32* pCorners = &source[bestTriangle * 3];
+		indices[outputTriangle * 3 + 0] = pCorners[0];
+		indices[outputTriangle * 3 + 1] = pCorners[1];
+		indices[outputTriangle * 3 + 2] = pCorners[2];
+		emitted[bestTriangle] = 1;
+
+		// Remove the triangle from the remaining lists of its vertices.
+		for (int k = 0; k < 3; ++k) {
+			uint32 v = pCorners[k];
+			uint32* pTriangles = &vertexTriangles[firstTriangle[v]];
+			uint32 count = remainingTriangles[v];
+			for (uint32 i = 0; i < count; ++i) {
+				if (pTriangles[i] == bestTriangle) {
+					pTriangles[i] = pTriangles[count - 1];
+					break;
+				}
+			}
+			remainingTriangles[v] = count - 1;
+		}
+
+		// The triangle's vertices move to the front of the cache, everything else
+		// shifts back.
+		int newCount = 0;
+		for (int k = 0; k < 3; ++k) {
+			uint32 v = pCorners[k];
+			if (std::find(newCache.begin(), newCache.begin() + newCount, v) == newCache.begin() + newCount)
+				newCache[newCount++] = v;
+		}
+
+		for (int i = 0; i < cacheCount; ++i) {
+			uint32 v = cache[i];
+			if (v != pCorners[0] and v != pCorners[1] and v != pCorners[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore every vertex whose position or valence changed, propagate the change
+		// to its remaining triangles and pick the best of those as the next triangle.
+		bestTriangle = InvalidIndex;
+		float bestScore = -std::numeric_limits<float>::max();
+		for (int i = 0; i < newCount; ++i) {
+			uint32 v = newCache[i];
+			int position = i < ScoringCacheSize ? i : -1;
+			cachePosition[v] = position;
+
+			float score = VertexScore(tables, position, remainingTriangles[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const uint32* pTriangles = &vertexTriangles[firstTriangle[v]];
+			for (uint32 j = 0; j < remainingTriangles[v]; ++j) {
+				uint32 t = pTriangles[j];
+				triangleScore[t] += delta;
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, ScoringCacheSize);
+		std::copy(newCache.begin(), newCache.begin() + cacheCount, cache.begin());
+	}
+}
+
+uint32 MeshOptimizer::OptimizeVertexFetchRemap(std::span<uint32> indices, std::span<uint32> remap) {
+	std::fill(remap.begin(), remap.end(), InvalidIndex);
+
+	uint32 nextVertex = 0;
+	for (uint32& index : indices) {
+		assert(index < remap.size());
+
+		if (remap[index] == InvalidIndex)
+			remap[index] = nextVertex++;
+		index = remap[index];
+	}
+
+	uint32 referencedCount = nextVertex;
+	for (uint32& newVertex : remap) {
+		if (newVertex == InvalidIndex)
+			newVertex = nextVertex++;
+	}
+
+	return referencedCount;
+}
+
+void MeshOptimizer::Optimize(GeometryGenerator::MeshData& meshData) {
+	uint32 vertexCount = (uint32)meshData.Vertices.size();
+	OptimizeVertexCache(meshData.Indices32, vertexCount);
+
+	uint32 referencedCount = OptimizeVertexFetch<GeometryGenerator::Vertex>(meshData.Vertices, meshData.Indices32);
+	meshData.Vertices.resize(referencedCount);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+// Reorders triangle lists for the GPU: triangles for post-transform vertex cache
+// reuse, then vertices for linear fetches. Pure CPU code working on plain index
+// spans; none of the passes changes the set of triangles or their winding.
+namespace MeshOptimizer
+{
+	using uint32 = std::uint32_t;
+
+	// Vertex cache efficiency of an index buffer, simulated with a FIFO cache.
+	struct CacheStatistics
+	{
+		uint32 TransformedVertexCount{};
+
+		// Average cache miss ratio: vertex shader invocations per triangle. 0.5 is the
+		// practical optimum for large regular meshes, 3 means no reuse at all.
+		float Acmr{};
+
+		// Average transform to vertex ratio: invocations per referenced vertex; 1 is ideal.
+		float Atvr{};
+	};
+
+	// FIFO size used for reporting; roughly what current hardware achieves.
+	inline constexpr uint32 DefaultCacheSize{ 16 };
+
+	CacheStatistics AnalyzeVertexCache(std::span<const uint32> indices, uint32 vertexCount, uint32 cacheSize = DefaultCacheSize);
+
+	// Reorders the triangles of a list in place using Forsyth's linear-speed algorithm:
+	// greedily emits the highest scoring triangle, where vertices score by their
+	// position in a simulated LRU cache plus a bonus for having few triangles left.
+	void OptimizeVertexCache(std::span<uint32> indices, uint32 vertexCount);
+
+	// Builds remap[oldVertex] = newVertex, numbering vertices in order of first use by
+	// indices, and rewrites indices accordingly. Unreferenced vertices are numbered
+	// after all referenced ones. Returns the number of referenced vertices.
+	uint32 OptimizeVertexFetchRemap(std::span<uint32> indices, std::span<uint32> remap);
+
+	// Moves vertices to the order produced by OptimizeVertexFetchRemap. Returns the
+	// number of referenced vertices, which now come first.
+	template<typename TVertex>
+	uint32 OptimizeVertexFetch(std::span<TVertex> vertices, std::span<uint32> indices);
+
+	// Vertex cache then vertex fetch optimization of a generated mesh. Unreferenced
+	// vertices are dropped. Must run before MeshData::GetIndices16(), which caches its
+	// result.
+	void Optimize(GeometryGenerator::MeshData& meshData);
+}
+
+template<typename TVertex>
+MeshOptimizer::uint32 MeshOptimizer::OptimizeVertexFetch(std::span<TVertex> vertices, std::span<uint32> indices) {
+	std::vector<uint32> remap(vertices.size());
+	uint32 referencedCount = OptimizeVertexFetchRemap(indices, remap);
+
+	std::vector<TVertex> reordered(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		reordered[remap[i]] = vertices[i];
+
+	std::copy(reordered.begin(), reordered.end(), vertices.begin());
+	return referencedCount;
+}
@@ -0,0 +1,311 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+using MeshSimplifier::uint32;
+
+namespace
+{
+	// Levels that keep more than this fraction of the previous level are not worth
+	// the index buffer space.
+	const float MinLodReduction{ 0.9f };
+
+	// A collapse is rejected when a triangle's normal would turn by more than ~85 degrees.
+	const float MinNormalDot{ 0.1f };
+
+	// Symmetric 4x4 matrix of the plane equations (a, b, c, d) accumulated into it,
+	// weighted by triangle area. Dividing by the total weight turns the quadric into the
+	// mean squared distance to those planes.
+	struct Quadric
+	{
+		double A2{}, AB{}, AC{}, AD{};
+		double B2{}, BC{}, BD{};
+		double C2{}, CD{};
+		double D2{};
+		double Weight{};
+
+		void AddPlane(double a, double b, double c, double d, double weight) {
+			A2 += weight * a * a; AB += weight * a * b; AC += weight * a * c; AD += weight * a * d;
+			B2 += weight * b * b; BC += weight * b * c; BD += weight * b * d;
+			C2 += weight * c * c; CD += weight * c * d;
+			D2 += weight * d * d;
+			Weight += weight;
+		}
+
+		Quadric& operator+=(const Quadric& rhs) {
+			A2 += rhs.A2; AB += rhs.AB; AC += rhs.AC; AD += rhs.AD;
+			B2 += rhs.B2; BC += rhs.BC; BD += rhs.BD;
+			C2 += rhs.C2; CD += rhs.CD;
+			D2 += rhs.D2;
+			Weight += rhs.Weight;
+			return *this;
+		}
+
+		double Evaluate(const XMFLOAT3& p) const {
+			double x = p.x, y = p.y, z = p.z;
+			double error =
+				A2 * x * x + 2 * AB * x * y + 2 * AC * x * z + 2 * AD * x +
+				B2 * y * y + 2 * BC * y * z + 2 * BD * y +
+				C2 * z * z + 2 * CD * z +
+				D2;
+			return error > 0.0 ? error : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32 From{};
+		uint32 To{};
+		float Error{};
+	};
+
+	uint64_t EdgeKey(uint32 a, uint32 b) {
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+
+	// Maps every vertex to the first vertex with a bitwise identical position.
+	std::vector<uint32> BuildPositionRemap(std::span<const GeometryGenerator::Vertex> vertices) {
+		struct PositionHash
+		{
+			size_t operator()(const XMFLOAT3& p) const {
+				uint32 bits[3];
+				std::memcpy(bits, &p, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+
+		struct PositionEqual
+		{
+			bool operator()(const XMFLOAT3& a, const XMFLOAT3& b) const {
+				return std::memcmp(&a, &b, sizeof(XMFLOAT3)) == 0;
+			}
+		};
+
+		std::unordered_map<XMFLOAT3, uint32, PositionHash, PositionEqual> firstVertex;
+		firstVertex.reserve(vertices.size());
+
+		std::vector<uint32> remap(vertices.size());
+		for (uint32 v = 0; v < (uint32)vertices.size(); ++v)
+			remap[v] = firstVertex.try_emplace(vertices[v].Position, v).first->second;
+		return remap;
+	}
+
+	XMVECTOR TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2) {
+		XMVECTOR v0 = XMLoadFloat3(&p0);
+		return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&p1), v0), XMVectorSubtract(XMLoadFloat3(&p2), v0));
+	}
+}
+
+size_t MeshSimplifier::Simplify(std::span<const GeometryGenerator::Vertex> vertices, std::span<const uint32> indices,
+	std::span<uint32> destination, size_t targetIndexCount, float maxError, float* pResultError) {
+	assert(indices.size() % 3 == 0);
+	assert(destination.size() >= indices.size());
+
+	const uint32 vertexCount = (uint32)vertices.size();
+	std::vector<uint32> result(indices.begin(), indices.end());
+	float resultError = 0.0f;
+
+	// Lock seam vertices, which share their position with another vertex, and the
+	// endpoints of every edge that does not have exactly two triangles.
+	std::vector<uint32> positionRemap = BuildPositionRemap(vertices);
+	std::vector<uint32> positionUseCount(vertexCount, 0);
+	for (uint32 v = 0; v < vertexCount; ++v)
+		++positionUseCount[positionRemap[v]];
+
+	std::vector<std::uint8_t> isLocked(vertexCount, 0);
+	for (uint32 v = 0; v < vertexCount; ++v)
+		isLocked[v] = positionUseCount[positionRemap[v]] > 1;
+
+	std::unordered_map<uint64_t, uint32> edgeTriangleCount;
+	edgeTriangleCount.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (int k = 0; k < 3; ++k)
+			++edgeTriangleCount[EdgeKey(positionRemap[result[i + k]], positionRemap[result[i + (k + 1) % 3]])];
+	}
+
+	for (const auto& [key, count] : edgeTriangleCount) {
+		if (count == 2) continue;
+		isLocked[uint32(key >> 32)] = 1;
+		isLocked[uint32(key & 0xFFFFFFFF)] = 1;
+	}
+
+	// Locked flags were set on the first vertex of each position; spread them out.
+	for (uint32 v = 0; v < vertexCount; ++v)
+		isLocked[v] = isLocked[v] or isLocked[positionRemap[v]];
+
+	// One quadric per position, from the planes of the triangles around it.
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		const XMFLOAT3& p0 = vertices[result[i + 0]].Position;
+		const XMFLOAT3& p1 = vertices[result[i + 1]].Position;
+		const XMFLOAT3& p2 = vertices[result[i + 2]].Position;
+
+		XMVECTOR normal = TriangleNormal(p0, p1, p2);
+		float doubleArea = XMVectorGetX(XMVector3Length(normal));
+		if (doubleArea <= 0.0f) continue;
+
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, XMVectorScale(normal, 1.0f / doubleArea));
+		double d = -(double(n.x) * p0.x + double(n.y) * p0.y + double(n.z) * p0.z);
+		for (int k = 0; k < 3; ++k)
+			quadrics[positionRemap[result[i + k]]].AddPlane(n.x, n.y, n.z, d, 0.5 * doubleArea);
+	}
+
+	auto collapseError = [&](uint32 from, uint32 to) {
+		Quadric quadric = quadrics[positionRemap[from]];
+		quadric += quadrics[positionRemap[to]];
+		double meanSquared = quadric.Weight > 0.0 ? quadric.Evaluate(vertices[to].Position) / quadric.Weight : 0.0;
+		return (float)std::sqrt(meanSquared);
+	};
+
+	std::vector<uint32> firstTriangle(vertexCount + 1);
+	std::vector<uint32> vertexTriangles;
+	std::vector<Collapse> collapses;
+	std::vector<uint32> collapseTarget(vertexCount);
+	std::vector<std::uint8_t> isTouched(vertexCount);
+
+	// Every pass collapses the cheapest edges whose neighbourhoods do not overlap, then
+	// rebuilds the index buffer, until the target is met or nothing can collapse.
+	while (result.size() > targetIndexCount) {
+		// Triangles around every vertex.
+		std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+		for (uint32 index : result)
+			++firstTriangle[index + 1];
+		for (uint32 v = 0; v < vertexCount; ++v)
+			firstTriangle[v + 1] += firstTriangle[v];
+
+		vertexTriangles.resize(result.size());
+		{
+			std::vector<uint32> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i)
+				vertexTriangles[fill[result[i]]++] = (uint32)(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; ++k) {
+				uint32 a = result[i + k];
+				uint32 b = result[i + (k + 1) % 3];
+				if (not isLocked[a]) collapses.push_back({ a, b, collapseError(a, b) });
+				if (not isLocked[b]) collapses.push_back({ b, a, collapseError(b, a) });
+			}
+		}
+
+		if (collapses.empty()) break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+			return lhs.Error < rhs.Error;
+		});
+
+		// A collapse removes about two triangles. Limit the pass to the error of the
+		// cheapest collapses that would reach the target, so cheap edges blocked by an
+		// overlapping neighbourhood get their turn before expensive ones.
+		size_t trianglesToRemove = (result.size() - targetIndexCount) / 3 + 1;
+		size_t goal = std::min(collapses.size() - 1, trianglesToRemove);
+		float passErrorLimit = std::min(maxError, collapses[goal].Error);
+
+		for (uint32 v = 0; v < vertexCount; ++v)
+			collapseTarget[v] = v;
+		std::fill(isTouched.begin(), isTouched.end(), 0);
+
+		size_t removedTriangles = 0;
+		for (const Collapse& collapse : collapses) {
+			if (removedTriangles >= trianglesToRemove or collapse.Error > passErrorLimit) break;
+
+			uint32 from = collapse.From;
+			uint32 to = collapse.To;
+			if (isTouched[from] or isTouched[to]) continue;
+
+			// Reject collapses that fold a remaining triangle over.
+			bool isValid = true;
+			size_t sharedTriangles = 0;
+			for (uint32 j = firstTriangle[from]; j < firstTriangle[from + 1] and isValid; ++j) {
+				const uint32* pCorners = &result[vertexTriangles[j] * 3];
+				if (pCorners[0] == to or pCorners[1] == to or pCorners[2] == to) {
+					++sharedTriangles;
+					continue;
+				}
+
+				XMFLOAT3 p[3];
+				for (int k = 0; k < 3; ++k)
+					p[k] = vertices[pCorners[k]].Position;
+				XMVECTOR before = XMVector3Normalize(TriangleNormal(p[0], p[1], p[2]));
+
+				for (int k = 0; k < 3; ++k)
+					if (pCorners[k] == from) p[k] = vertices[to].Position;
+				XMVECTOR after = XMVector3Normalize(TriangleNormal(p[0], p[1], p[2]));
+
+				isValid = XMVectorGetX(XMVector3Dot(before, after)) >= MinNormalDot;
+			}
+
+			if (not isValid) continue;
+
+			collapseTarget[from] = to;
+			quadrics[positionRemap[to]] += quadrics[positionRemap[from]];
+			resultError = std::max(resultError, collapse.Error);
+			removedTriangles += sharedTriangles;
+
+			// The triangles around from change; keep the rest of this pass away from them.
+			for (uint32 j = firstTriangle[from]; j < firstTriangle[from + 1]; ++j) {
+				const uint32* pCorners = &result[vertexTriangles[j] * 3];
+				isTouched[pCorners[0]] = isTouched[pCorners[1]] = isTouched[pCorners[2]] = 1;
+			}
+		}
+
+		if (removedTriangles == 0) break;
+
+		// Apply the collapses and drop triangles that became degenerate.
+		size_t writeIndex = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			uint32 a = collapseTarget[result[i + 0]];
+			uint32 b = collapseTarget[result[i + 1]];
+			uint32 c = collapseTarget[result[i + 2]];
+			if (positionRemap[a] == positionRemap[b] or positionRemap[b] == positionRemap[c] or positionRemap[c] == positionRemap[a])
+				continue;
+
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+	}
+
+	std::copy(result.begin(), result.end(), destination.begin());
+	if (pResultError) *pResultError = resultError;
+	return result.size();
+}
+
+std::vector<MeshSimplifier::LodLevel> MeshSimplifier::AppendLodChain(GeometryGenerator::MeshData& meshData,
+	uint32 levelCount, float reduction, float maxError) {
+	std::vector<LodLevel> levels{ LodLevel{ 0, (uint32)meshData.Indices32.size(), 0.0f } };
+
+	std::vector<uint32> source;
+	std::vector<uint32> simplified;
+	while (levels.size() < levelCount) {
+		const LodLevel previous = levels.back();
+		auto first = meshData.Indices32.begin() + previous.StartIndex;
+		source.assign(first, first + previous.IndexCount);
+		simplified.resize(source.size());
+
+		// Every level is simplified from the previous one, so the errors add up.
+		size_t targetIndexCount = (size_t)(previous.IndexCount / 3 * reduction) * 3;
+		float levelError = 0.0f;
+		size_t indexCount = Simplify(meshData.Vertices, source, simplified, targetIndexCount,
+			maxError - previous.Error, &levelError);
+		if (indexCount == 0 or indexCount > previous.IndexCount * MinLodReduction) break;
+
+		MeshOptimizer::OptimizeVertexCache(std::span(simplified).first(indexCount), (uint32)meshData.Vertices.size());
+
+		levels.push_back(LodLevel{ (uint32)meshData.Indices32.size(), (uint32)indexCount, previous.Error + levelError });
+		meshData.Indices32.insert(meshData.Indices32.end(), simplified.begin(), simplified.begin() + indexCount);
+	}
+
+	return levels;
+}
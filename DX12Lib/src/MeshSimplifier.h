@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+// Quadric error metric simplification by half-edge collapses (Garland & Heckbert).
+//
+// A vertex is only ever collapsed onto one of its neighbours, so the simplified index
+// buffer keeps referencing the original vertices: every level of detail shares one
+// vertex buffer. Vertices on open borders, non-manifold edges and attribute seams
+// (several vertices at one position, like the texture seam of a sphere or the edges
+// of a box) never move, which keeps the outline and attributes intact.
+namespace MeshSimplifier
+{
+	using uint32 = std::uint32_t;
+
+	// Writes a simplified version of the triangle list indices to destination, which
+	// must have room for indices.size() entries, and returns its index count. Stops at
+	// targetIndexCount or before the first collapse that would move the surface by
+	// more than maxError. The object space deviation reached is stored in pResultError.
+	size_t Simplify(std::span<const GeometryGenerator::Vertex> vertices, std::span<const uint32> indices,
+		std::span<uint32> destination, size_t targetIndexCount, float maxError = FLT_MAX, float* pResultError = nullptr);
+
+	// A range of MeshData::Indices32 holding one level of detail.
+	struct LodLevel
+	{
+		uint32 StartIndex{};
+		uint32 IndexCount{};
+
+		// Estimated object space distance between this level and level 0: the root mean
+		// square plane distance of the quadrics, summed over the levels in between.
+		float Error{};
+	};
+
+	// Simplifies the mesh into up to levelCount levels, each with about reduction times
+	// the triangles of the one before, and appends the coarser levels to Indices32.
+	// Level 0 is the original index range. Stops early once a level barely shrinks.
+	// New levels are optimized for the vertex cache. Must run before
+	// MeshData::GetIndices16(), which caches its result.
+	std::vector<LodLevel> AppendLodChain(GeometryGenerator::MeshData& meshData, uint32 levelCount,
+		float reduction = 0.5f, float maxError = FLT_MAX);
+}
@@ -0,0 +1,186 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+using MeshletBuilder::uint32;
+
+namespace
+{
+	const uint32 InvalidIndex{ std::numeric_limits<uint32>::max() };
+
+	// Cones wider than this (minimum dot between a triangle normal and the axis) are
+	// almost never culled; skip the test instead of keeping a useless apex.
+	const float MinConeDot{ 0.1f };
+
+	// ConeCutoff of meshlets that can never be backfacing as a whole.
+	const float NeverCulledCutoff{ 2.0f };
+
+	// Face normal of the triangle, or zero for a degenerate one. Triangles are clockwise
+	// when front facing, which for left-handed coordinates makes the cross product of
+	// the first two edges point out of the front face.
+	XMVECTOR FaceNormal(FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2) {
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+		float length = XMVectorGetX(XMVector3Length(normal));
+		return length > 0.0f ? XMVectorScale(normal, 1.0f / length) : XMVectorZero();
+	}
+
+	void ComputeBounds(MeshletBuilder::Meshlet& meshlet, const MeshletBuilder::MeshletData& data,
+		std::span<const GeometryGenerator::Vertex> vertices) {
+		auto position = [&](uint32 localIndex) {
+			return XMLoadFloat3(&vertices[data.VertexIndices[meshlet.VertexOffset + localIndex]].Position);
+		};
+
+		// Sphere around the centre of the bounding box; cheap and tight enough for the
+		// compact meshlets the builder produces.
+		XMVECTOR minimum = position(0);
+		XMVECTOR maximum = minimum;
+		for (uint32 i = 1; i < meshlet.VertexCount; ++i) {
+			minimum = XMVectorMin(minimum, position(i));
+			maximum = XMVectorMax(maximum, position(i));
+		}
+
+		XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+		float radiusSquared = 0.0f;
+		for (uint32 i = 0; i < meshlet.VertexCount; ++i)
+			radiusSquared = std::max(radiusSquared, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(position(i), center))));
+
+		XMStoreFloat3(&meshlet.Center, center);
+		meshlet.Radius = sqrtf(radiusSquared);
+
+		// Normal cone around the average face normal.
+		const uint32* pPrimitives = &data.Primitives[meshlet.PrimitiveOffset];
+		auto faceNormal = [&](uint32 primitive) {
+			return FaceNormal(
+				position(MeshletBuilder::UnpackPrimitive(primitive, 0)),
+				position(MeshletBuilder::UnpackPrimitive(primitive, 1)),
+				position(MeshletBuilder::UnpackPrimitive(primitive, 2)));
+		};
+
+		XMVECTOR axis = XMVectorZero();
+		for (uint32 i = 0; i < meshlet.PrimitiveCount; ++i)
+			axis = XMVectorAdd(axis, faceNormal(pPrimitives[i]));
+
+		meshlet.ConeApex = meshlet.Center;
+		meshlet.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		meshlet.ConeCutoff = NeverCulledCutoff;
+
+		float axisLength = XMVectorGetX(XMVector3Length(axis));
+		if (axisLength <= 0.0f) return;
+		axis = XMVectorScale(axis, 1.0f / axisLength);
+
+		float minDot = 1.0f;
+		for (uint32 i = 0; i < meshlet.PrimitiveCount; ++i) {
+			XMVECTOR normal = faceNormal(pPrimitives[i]);
+			if (XMVector3Equal(normal, XMVectorZero())) continue;
+			minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(normal, axis)));
+		}
+
+		XMStoreFloat3(&meshlet.ConeAxis, axis);
+		if (minDot <= MinConeDot) return;
+
+		// Move the apex back along the axis until it lies behind every triangle's plane,
+		// so the test holds for triangles anywhere in the meshlet, not just at its centre.
+		float maxDistance = 0.0f;
+		for (uint32 i = 0; i < meshlet.PrimitiveCount; ++i) {
+			XMVECTOR normal = faceNormal(pPrimitives[i]);
+			if (XMVector3Equal(normal, XMVectorZero())) continue;
+
+			XMVECTOR p0 = position(MeshletBuilder::UnpackPrimitive(pPrimitives[i], 0));
+			float centerDistance = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, p0), normal));
+			float axisDot = XMVectorGetX(XMVector3Dot(axis, normal));
+			maxDistance = std::max(maxDistance, centerDistance / axisDot);
+		}
+
+		XMStoreFloat3(&meshlet.ConeApex, XMVectorSubtract(center, XMVectorScale(axis, maxDistance)));
+		meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+}
+
+MeshletBuilder::MeshletData MeshletBuilder::Build(std::span<const GeometryGenerator::Vertex> vertices,
+	std::span<const uint32> indices, const Options& options) {
+	assert(indices.size() % 3 == 0);
+	assert(options.MaxVertices >= 3 and options.MaxVertices <= MaxVerticesLimit);
+	assert(options.MaxPrimitives >= 1 and options.MaxPrimitives <= MaxPrimitivesLimit);
+
+	MeshletData data;
+	size_t triangleCount = indices.size() / 3;
+	data.Primitives.reserve(triangleCount);
+	data.VertexIndices.reserve(indices.size() / 2);
+
+	// Local index of every mesh vertex in the meshlet being built.
+	std::vector<uint32> localIndex(vertices.size(), InvalidIndex);
+	Meshlet current{};
+
+	auto finishMeshlet = [&] {
+		for (uint32 i = 0; i < current.VertexCount; ++i)
+			localIndex[data.VertexIndices[current.VertexOffset + i]] = InvalidIndex;
+
+		data.Meshlets.push_back(current);
+		current = Meshlet{};
+		current.VertexOffset = (uint32)data.VertexIndices.size();
+		current.PrimitiveOffset = (uint32)data.Primitives.size();
+	};
+
+	for (size_t t = 0; t < triangleCount; ++t) {
+		const uint32* pCorners = &indices[t * 3];
+		assert(pCorners[0] < vertices.size() and pCorners[1] < vertices.size() and pCorners[2] < vertices.size());
+
+		uint32 newVertexCount =
+			(localIndex[pCorners[0]] == InvalidIndex) +
+			(localIndex[pCorners[1]] == InvalidIndex and pCorners[1] != pCorners[0]) +
+			(localIndex[pCorners[2]] == InvalidIndex and pCorners[2] != pCorners[0] and pCorners[2] != pCorners[1]);
+
+		if (current.VertexCount + newVertexCount > options.MaxVertices or current.PrimitiveCount == options.MaxPrimitives)
+			finishMeshlet();
+
+		uint32 local[3];
+		for (int k = 0; k < 3; ++k) {
+			uint32& index = localIndex[pCorners[k]];
+			if (index == InvalidIndex) {
+				index = current.VertexCount++;
+				data.VertexIndices.push_back(pCorners[k]);
+			}
+			local[k] = index;
+		}
+
+		data.Primitives.push_back(PackPrimitive(local[0], local[1], local[2]));
+		++current.PrimitiveCount;
+	}
+
+	if (current.PrimitiveCount > 0)
+		finishMeshlet();
+
+	JobSystem::Default().ParallelFor(0, data.Meshlets.size(), 64, [&](size_t i) {
+		ComputeBounds(data.Meshlets[i], data, vertices);
+	});
+
+	return data;
+}
+
+MeshletBuilder::MeshletData MeshletBuilder::Build(const GeometryGenerator::MeshData& meshData, const Options& options) {
+	return Build(meshData.Vertices, meshData.Indices32, options);
+}
+
+uint32 MeshletBuilder::Append(MeshletData& destination, const MeshletData& source, uint32 baseVertex) {
+	uint32 firstMeshlet = (uint32)destination.Meshlets.size();
+	uint32 vertexOffset = (uint32)destination.VertexIndices.size();
+	uint32 primitiveOffset = (uint32)destination.Primitives.size();
+
+	for (Meshlet meshlet : source.Meshlets) {
+		meshlet.VertexOffset += vertexOffset;
+		meshlet.PrimitiveOffset += primitiveOffset;
+		destination.Meshlets.push_back(meshlet);
+	}
+
+	for (uint32 index : source.VertexIndices)
+		destination.VertexIndices.push_back(index + baseVertex);
+
+	destination.Primitives.insert(destination.Primitives.end(), source.Primitives.begin(), source.Primitives.end());
+	return firstMeshlet;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+#include <span>
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+// Splits triangle lists into meshlets: small clusters of at most MaxVertices vertices
+// and MaxPrimitives triangles that a mesh shader (or a CPU culling pass) can process
+// independently. Triangles are clustered in index buffer order, so run
+// MeshOptimizer::OptimizeVertexCache first for compact, well-shaped meshlets.
+namespace MeshletBuilder
+{
+	using uint32 = std::uint32_t;
+
+	// Mesh shader limits; local indices are packed into 10 bits each.
+	inline constexpr uint32 MaxVerticesLimit{ 256 };
+	inline constexpr uint32 MaxPrimitivesLimit{ 256 };
+
+	struct Options
+	{
+		uint32 MaxVertices{ 64 };
+		uint32 MaxPrimitives{ 124 };
+	};
+
+	// One cluster, laid out for a StructuredBuffer: every row is a float4.
+	struct Meshlet
+	{
+		// Ranges in MeshletData::VertexIndices and MeshletData::Primitives.
+		uint32 VertexOffset{};
+		uint32 VertexCount{};
+		uint32 PrimitiveOffset{};
+		uint32 PrimitiveCount{};
+
+		// Bounding sphere of the meshlet's vertices.
+		DirectX::XMFLOAT3 Center{};
+		float Radius{};
+
+		// Normal cone: every triangle faces away from any eye position for which
+		// dot(normalize(ConeApex - eye), ConeAxis) >= ConeCutoff. Meshlets whose normals
+		// spread too far get ConeCutoff > 1 and never pass the test.
+		DirectX::XMFLOAT3 ConeApex{};
+		float ConeCutoff{};
+		DirectX::XMFLOAT3 ConeAxis{};
+		float Padding{};
+	};
+
+	static_assert(sizeof(Meshlet) == 64, "Meshlet rows must stay float4 aligned");
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> Meshlets;
+
+		// Mesh vertex index of every meshlet vertex; a meshlet's local vertex i is
+		// VertexIndices[VertexOffset + i].
+		std::vector<uint32> VertexIndices;
+
+		// One triangle per entry, three local vertex indices packed by PackPrimitive.
+		std::vector<uint32> Primitives;
+	};
+
+	constexpr uint32 PackPrimitive(uint32 i0, uint32 i1, uint32 i2) {
+		return i0 | (i1 << 10) | (i2 << 20);
+	}
+
+	constexpr uint32 UnpackPrimitive(uint32 primitive, int corner) {
+		return (primitive >> (corner * 10)) & 0x3FF;
+	}
+
+	MeshletData Build(std::span<const GeometryGenerator::Vertex> vertices, std::span<const uint32> indices, const Options& options = {});
+	MeshletData Build(const GeometryGenerator::MeshData& meshData, const Options& options = {});
+
+	// Appends the meshlets of source to destination, rebasing their ranges and adding
+	// baseVertex to their vertex indices, the way meshes are concatenated into one
+	// vertex buffer. Returns the index of the first appended meshlet, which goes into
+	// SubMeshGeometry::StartMeshletLocation.
+	uint32 Append(MeshletData& destination, const MeshletData& source, uint32 baseVertex);
+
+	// Conservative CPU culling test against the normal cone.
+	inline bool IsBackfacing(const Meshlet& meshlet, DirectX::FXMVECTOR eyePosition) {
+		using namespace DirectX;
+		XMVECTOR view = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&meshlet.ConeApex), eyePosition));
+		return XMVectorGetX(XMVector3Dot(view, XMLoadFloat3(&meshlet.ConeAxis))) >= meshlet.ConeCutoff;
+	}
+}
@@ -0,0 +1,387 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "SimdSupport.h"
+
+using namespace DirectX;
+using uint32 = OcclusionCuller::uint32;
+
+namespace
+{
+	XMFLOAT4 Lerp(const XMFLOAT4& a, const XMFLOAT4& b, float t) {
+		return XMFLOAT4(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), a.z + t * (b.z - a.z), a.w + t * (b.w - a.w));
+	}
+
+	// True when all three vertices are outside the same side plane or beyond the far plane.
+	bool IsOutsideFrustum(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c) {
+		return (a.x > a.w and b.x > b.w and c.x > c.w)
+			or (a.x < -a.w and b.x < -b.w and c.x < -c.w)
+			or (a.y > a.w and b.y > b.w and c.y > c.w)
+			or (a.y < -a.w and b.y < -b.w and c.y < -c.w)
+			or (a.z > a.w and b.z > b.w and c.z > c.w);
+	}
+
+	// Edge function A * x + B * y + C, positive on the side of the triangle.
+	struct Edge
+	{
+		float A;
+		float B;
+		float C;
+	};
+
+	Edge MakeEdge(const XMFLOAT3& from, const XMFLOAT3& to) {
+		float a = from.y - to.y;
+		float b = to.x - from.x;
+		return Edge{ a, b, -(a * from.x + b * from.y) };
+	}
+}
+
+OccluderMesh OccluderMesh::FromImage(const MeshFile::Image& image, std::string_view name) {
+	OccluderMesh mesh;
+
+	auto elements = image.VertexElements();
+	auto position = std::find_if(elements.begin(), elements.end(), [](const VertexElement& element) {
+		return element.Semantic == VertexSemantic::Position and element.Encoding == VertexEncoding::Float32x3;
+	});
+	auto submeshes = image.Submeshes();
+	auto submesh = std::find_if(submeshes.begin(), submeshes.end(), [name](const MeshFile::SubmeshRecord& record) {
+		return name == record.Name;
+	});
+	if (position == elements.end() or submesh == submeshes.end())
+		return mesh;
+
+	const MeshFile::Header& header = image.GetHeader();
+	const std::byte* pIndices = image.Indices().data() + (size_t)submesh->StartIndexLocation * header.IndexByteSize;
+	mesh.Indices.resize(submesh->IndexCount);
+	for (uint32 i = 0; i < submesh->IndexCount; ++i) {
+		if (header.IndexByteSize == sizeof(std::uint16_t)) {
+			std::uint16_t index;
+			std::memcpy(&index, pIndices + i * sizeof(index), sizeof(index));
+			mesh.Indices[i] = index;
+		}
+		else
+			std::memcpy(&mesh.Indices[i], pIndices + i * sizeof(uint32), sizeof(uint32));
+	}
+
+	uint32 vertexCount = mesh.Indices.empty() ? 0 : *std::max_element(mesh.Indices.begin(), mesh.Indices.end()) + 1;
+	const std::byte* pVertices = image.Vertices().data() + (size_t)submesh->BaseVertexLocation * header.VertexStride + position->ByteOffset;
+	mesh.Positions.resize(vertexCount);
+	for (uint32 i = 0; i < vertexCount; ++i)
+		std::memcpy(&mesh.Positions[i], pVertices + (size_t)i * header.VertexStride, sizeof(XMFLOAT3));
+
+	return mesh;
+}
+
+OcclusionCuller::OcclusionCuller(uint32 width, uint32 height)
+	: _width((std::max(width, 1u) + 3) & ~3u), _height(std::max(height, 1u)) {
+	// Halve until a single texel remains; odd sizes round up so every pixel has a parent.
+	size_t offset = 0;
+	uint32 levelWidth = _width;
+	uint32 levelHeight = _height;
+	while (true) {
+		_levels.push_back({ levelWidth, levelHeight, offset });
+		offset += (size_t)levelWidth * levelHeight;
+		if (levelWidth == 1 and levelHeight == 1)
+			break;
+
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+
+	_depth.assign(offset, 1.0f);
+	XMStoreFloat4x4(&_viewProj, XMMatrixIdentity());
+}
+
+std::span<const float> OcclusionCuller::Level(uint32 level) const {
+	const LevelInfo& info = _levels[level];
+	return std::span<const float>(_depth.data() + info.Offset, (size_t)info.Width * info.Height);
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& viewProj) {
+	_viewProj = viewProj;
+	std::fill_n(_depth.begin(), (size_t)_width * _height, 1.0f);
+	_statistics = {};
+}
+
+void OcclusionCuller::RenderOccluder(std::span<const XMFLOAT3> positions, std::span<const uint32> indices, const XMFLOAT4X4& world) {
+	XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&_viewProj));
+	_clipPositions.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i)
+		XMStoreFloat4(&_clipPositions[i], XMVector3Transform(XMLoadFloat3(&positions[i]), worldViewProj));
+
+	_statistics.OccluderCount++;
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		const XMFLOAT4 triangle[3] = { _clipPositions[indices[t]], _clipPositions[indices[t + 1]], _clipPositions[indices[t + 2]] };
+		if (IsOutsideFrustum(triangle[0], triangle[1], triangle[2]))
+			continue;
+
+		// Clip against the near plane z = 0, which leaves a triangle or a quad. The
+		// side planes are left to the bounding rectangle of the rasterizer.
+		XMFLOAT4 polygon[4];
+		int vertexCount = 0;
+		for (int k = 0; k < 3; ++k) {
+			const XMFLOAT4& current = triangle[k];
+			const XMFLOAT4& next = triangle[(k + 1) % 3];
+			bool isCurrentInside = current.z >= 0.0f;
+			bool isNextInside = next.z >= 0.0f;
+			if (isCurrentInside)
+				polygon[vertexCount++] = current;
+			if (isCurrentInside != isNextInside)
+				polygon[vertexCount++] = Lerp(current, next, current.z / (current.z - next.z));
+		}
+
+		if (vertexCount >= 3)
+			RasterizeTriangle(polygon[0], polygon[1], polygon[2]);
+		if (vertexCount == 4)
+			RasterizeTriangle(polygon[0], polygon[2], polygon[3]);
+	}
+}
+
+void OcclusionCuller::RasterizeTriangle(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c) {
+	auto toScreen = [this](const XMFLOAT4& v) {
+		float inverseW = 1.0f / v.w;
+		return XMFLOAT3((0.5f + 0.5f * v.x * inverseW) * _width, (0.5f - 0.5f * v.y * inverseW) * _height, v.z * inverseW);
+	};
+
+	XMFLOAT3 p0 = toScreen(a);
+	XMFLOAT3 p1 = toScreen(b);
+	XMFLOAT3 p2 = toScreen(c);
+
+	// Both faces are drawn: wind every triangle the same way.
+	float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+	if (not (std::fabs(area) > 0.0f))
+		return;
+	if (area < 0.0f) {
+		std::swap(p1, p2);
+		area = -area;
+	}
+
+	// Pixels whose centers can be inside the triangle.
+	float minX = std::max(0.0f, std::ceil(std::min({ p0.x, p1.x, p2.x }) - 0.5f));
+	float maxX = std::min(_width - 1.0f, std::floor(std::max({ p0.x, p1.x, p2.x }) - 0.5f));
+	float minY = std::max(0.0f, std::ceil(std::min({ p0.y, p1.y, p2.y }) - 0.5f));
+	float maxY = std::min(_height - 1.0f, std::floor(std::max({ p0.y, p1.y, p2.y }) - 0.5f));
+	if (not (minX <= maxX and minY <= maxY))
+		return;
+
+	_statistics.TriangleCount++;
+
+	// Each edge function is the weight of the opposite vertex times the area, so the
+	// depth plane is their depth weighted sum.
+	const Edge edges[3] = { MakeEdge(p1, p2), MakeEdge(p2, p0), MakeEdge(p0, p1) };
+	const float inverseArea = 1.0f / area;
+	const Edge depth{
+		(edges[0].A * p0.z + edges[1].A * p1.z + edges[2].A * p2.z) * inverseArea,
+		(edges[0].B * p0.z + edges[1].B * p1.z + edges[2].B * p2.z) * inverseArea,
+		(edges[0].C * p0.z + edges[1].C * p1.z + edges[2].C * p2.z) * inverseArea,
+	};
+
+	// The plane overshoots on thin triangles, by far more than rounding; keeping it
+	// within the vertex depths means an occluder never comes nearer than it is.
+	const float nearestDepth = std::min({ p0.z, p1.z, p2.z });
+	const float farthestDepth = std::max({ p0.z, p1.z, p2.z });
+
+	const int firstX = (int)minX;
+	const int lastX = (int)maxX;
+	const int firstY = (int)minY;
+	const int lastY = (int)maxY;
+
+	// Both paths evaluate A * x + (B * y + C) per pixel center with the same
+	// operations, so they produce identical depth buffers.
+#if DX12_HAS_SSE2
+	const __m128 laneCenters = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 edgeA[3] = { _mm_set1_ps(edges[0].A), _mm_set1_ps(edges[1].A), _mm_set1_ps(edges[2].A) };
+	const __m128 depthA = _mm_set1_ps(depth.A);
+	const __m128 depthMin = _mm_set1_ps(nearestDepth);
+	const __m128 depthMax = _mm_set1_ps(farthestDepth);
+
+	for (int y = firstY; y <= lastY; ++y) {
+		float pixelY = (float)y + 0.5f;
+		const __m128 rowEdges[3] = {
+			_mm_set1_ps(edges[0].B * pixelY + edges[0].C),
+			_mm_set1_ps(edges[1].B * pixelY + edges[1].C),
+			_mm_set1_ps(edges[2].B * pixelY + edges[2].C),
+		};
+		const __m128 rowDepth = _mm_set1_ps(depth.B * pixelY + depth.C);
+		float* pRow = _depth.data() + (size_t)y * _width;
+
+		// Rows are a multiple of four pixels, so the lanes left of firstX are still in
+		// the row; they fail the edge test like every pixel outside the triangle.
+		for (int x = firstX & ~3; x <= lastX; x += 4) {
+			__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), laneCenters);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA[0], pixelX), rowEdges[0]);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA[1], pixelX), rowEdges[1]);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA[2], pixelX), rowEdges[2]);
+
+			// A lane is outside when any edge function has its sign bit set.
+			__m128 anyNegative = _mm_or_ps(_mm_or_ps(e0, e1), e2);
+			if (_mm_movemask_ps(anyNegative) == 0xF)
+				continue;
+
+			__m128 outside = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(anyNegative), 31));
+			__m128 z = _mm_add_ps(_mm_mul_ps(depthA, pixelX), rowDepth);
+			z = _mm_min_ps(_mm_max_ps(z, depthMin), depthMax);
+			__m128 old = _mm_load_ps(pRow + x);
+			__m128 nearer = _mm_min_ps(old, z);
+			_mm_store_ps(pRow + x, _mm_or_ps(_mm_and_ps(outside, old), _mm_andnot_ps(outside, nearer)));
+		}
+	}
+#else
+	for (int y = firstY; y <= lastY; ++y) {
+		float pixelY = (float)y + 0.5f;
+		float rowEdges[3] = {
+			edges[0].B * pixelY + edges[0].C,
+			edges[1].B * pixelY + edges[1].C,
+			edges[2].B * pixelY + edges[2].C,
+		};
+		float rowDepth = depth.B * pixelY + depth.C;
+		float* pRow = _depth.data() + (size_t)y * _width;
+
+		for (int x = firstX; x <= lastX; ++x) {
+			float pixelX = (float)x + 0.5f;
+			float e0 = edges[0].A * pixelX + rowEdges[0];
+			float e1 = edges[1].A * pixelX + rowEdges[1];
+			float e2 = edges[2].A * pixelX + rowEdges[2];
+			if (std::signbit(e0) or std::signbit(e1) or std::signbit(e2))
+				continue;
+
+			float z = std::min(std::max(depth.A * pixelX + rowDepth, nearestDepth), farthestDepth);
+			pRow[x] = std::min(pRow[x], z);
+		}
+	}
+#endif
+}
+
+void OcclusionCuller::BuildHiZ() {
+	for (size_t level = 1; level < _levels.size(); ++level) {
+		const LevelInfo& source = _levels[level - 1];
+		const LevelInfo& target = _levels[level];
+		const float* pSource = _depth.data() + source.Offset;
+		float* pTarget = _depth.data() + target.Offset;
+
+		for (uint32 y = 0; y < target.Height; ++y) {
+			const float* pRow0 = pSource + (size_t)std::min(2 * y, source.Height - 1) * source.Width;
+			const float* pRow1 = pSource + (size_t)std::min(2 * y + 1, source.Height - 1) * source.Width;
+			for (uint32 x = 0; x < target.Width; ++x) {
+				uint32 x0 = std::min(2 * x, source.Width - 1);
+				uint32 x1 = std::min(2 * x + 1, source.Width - 1);
+				pTarget[(size_t)y * target.Width + x] = std::max(std::max(pRow0[x0], pRow0[x1]), std::max(pRow1[x0], pRow1[x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::ProjectBox(const BoundingBox& worldBox, ScreenRect& rect) const {
+	XMMATRIX viewProj = XMLoadFloat4x4(&_viewProj);
+
+	rect = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, FLT_MAX };
+	for (int corner = 0; corner < 8; ++corner) {
+		XMFLOAT3 position(
+			worldBox.Center.x + (corner & 1 ? worldBox.Extents.x : -worldBox.Extents.x),
+			worldBox.Center.y + (corner & 2 ? worldBox.Extents.y : -worldBox.Extents.y),
+			worldBox.Center.z + (corner & 4 ? worldBox.Extents.z : -worldBox.Extents.z));
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&position), viewProj));
+
+		// In front of the near plane w is positive, so the projection below is valid.
+		if (clip.z < 0.0f)
+			return false;
+
+		float inverseW = 1.0f / clip.w;
+		float x = (0.5f + 0.5f * clip.x * inverseW) * _width;
+		float y = (0.5f - 0.5f * clip.y * inverseW) * _height;
+		rect.MinX = std::min(rect.MinX, x);
+		rect.MaxX = std::max(rect.MaxX, x);
+		rect.MinY = std::min(rect.MinY, y);
+		rect.MaxY = std::max(rect.MaxY, y);
+		rect.NearestDepth = std::min(rect.NearestDepth, clip.z * inverseW);
+	}
+	return true;
+}
+
+void OcclusionCuller::SelectOccluders(std::span<const BoundingBox> worldBoxes, std::span<const uint32> candidates,
+	uint32 maxCount, std::vector<uint32>& occluders) const {
+	const float screenArea = (float)_width * _height;
+
+	std::vector<std::pair<float, uint32>> scored;
+	for (uint32 item : candidates) {
+		// A box around the eye may cover everything.
+		ScreenRect rect;
+		float area = screenArea;
+		if (ProjectBox(worldBoxes[item], rect)) {
+			float width = std::min(rect.MaxX, (float)_width) - std::max(rect.MinX, 0.0f);
+			float height = std::min(rect.MaxY, (float)_height) - std::max(rect.MinY, 0.0f);
+			area = std::max(width, 0.0f) * std::max(height, 0.0f);
+		}
+		if (area >= MinOccluderScreenFraction * screenArea)
+			scored.emplace_back(area, item);
+	}
+
+	size_t count = std::min<size_t>(maxCount, scored.size());
+	std::partial_sort(scored.begin(), scored.begin() + count, scored.end(), [](const auto& a, const auto& b) {
+		return a.first > b.first or (a.first == b.first and a.second < b.second);
+	});
+
+	occluders.clear();
+	for (size_t i = 0; i < count; ++i)
+		occluders.push_back(scored[i].second);
+}
+
+bool OcclusionCuller::IsOccluded(const BoundingBox& worldBox) const {
+	ScreenRect rect;
+	if (not ProjectBox(worldBox, rect))
+		return false;
+
+	if (rect.MaxX < 0.0f or rect.MinX >= _width or rect.MaxY < 0.0f or rect.MinY >= _height)
+		return false;
+
+	// Every pixel whose center the box can cover.
+	uint32 x0 = (uint32)std::max(0.0f, std::floor(rect.MinX));
+	uint32 x1 = (uint32)std::min(_width - 1.0f, std::floor(rect.MaxX));
+	uint32 y0 = (uint32)std::max(0.0f, std::floor(rect.MinY));
+	uint32 y1 = (uint32)std::min(_height - 1.0f, std::floor(rect.MaxY));
+
+	// The level on which the rectangle spans at most a few texels.
+	uint32 span = std::max(x1 - x0, y1 - y0) + 1;
+	uint32 level = 0;
+	while (level + 1 < _levels.size() and (span >> level) > 2)
+		++level;
+
+	const LevelInfo& info = _levels[level];
+	const float* pLevel = _depth.data() + info.Offset;
+	float farthestDepth = 0.0f;
+	for (uint32 y = y0 >> level; y <= (y1 >> level); ++y) {
+		for (uint32 x = x0 >> level; x <= (x1 >> level); ++x)
+			farthestDepth = std::max(farthestDepth, pLevel[(size_t)y * info.Width + x]);
+	}
+
+	return rect.NearestDepth > farthestDepth;
+}
+
+bool OcclusionCuller::WriteDepthImage(const std::filesystem::path& path, uint32 level) const {
+	std::span<const float> depths = Level(level);
+
+	// Stretch the drawn depths over the full range; z / w crowds towards 1.
+	float nearest = 1.0f;
+	for (float depth : depths)
+		nearest = std::min(nearest, depth);
+	float scale = nearest < 1.0f ? 255.0f / (1.0f - nearest) : 0.0f;
+
+	std::vector<std::uint8_t> pixels(depths.size());
+	for (size_t i = 0; i < depths.size(); ++i)
+		pixels[i] = (std::uint8_t)std::lround(std::clamp((1.0f - depths[i]) * scale, 0.0f, 255.0f));
+
+	std::ofstream file(path, std::ios::binary);
+	std::string header = "P5\n" + std::to_string(LevelWidth(level)) + " " + std::to_string(LevelHeight(level)) + "\n255\n";
+	file.write(header.data(), (std::streamsize)header.size());
+	file.write(reinterpret_cast<const char*>(pixels.data()), (std::streamsize)pixels.size());
+	return (bool)file;
+}
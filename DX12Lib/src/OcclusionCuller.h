@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include "AlignedAllocator.h"
+#include "MeshFile.h"
+
+// Object space triangles an occluder is rasterized with. They should lie inside the
+// object they stand for; its full detail mesh always does.
+struct OccluderMesh
+{
+	std::vector<DirectX::XMFLOAT3> Positions{};
+	std::vector<std::uint32_t> Indices{};
+
+	// Full detail triangles of the submesh name of a mesh file whose positions are
+	// stored as three floats. Empty if there is no such submesh.
+	static OccluderMesh FromImage(const MeshFile::Image& image, std::string_view name);
+};
+
+// Occlusion culling against a low resolution depth buffer drawn on the CPU.
+//
+// Every frame the largest occluders are rasterized, four pixels at a time, into a
+// depth buffer holding the nearest z / w per pixel center. BuildHiZ() then reduces it
+// to a pyramid in which every texel holds the farthest depth of the pixels below it.
+// A world space box is occluded when its nearest depth lies behind the farthest
+// depth of the few texels that cover its screen rectangle on the level matching its
+// size. Boxes that cross the near plane or leave the screen are never occluded.
+//
+// Occlusion is decided at the buffer's resolution: something showing less than one of
+// its pixels past an occluder's silhouette may be culled.
+class OcclusionCuller
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct Statistics
+	{
+		uint32 OccluderCount{};
+		uint32 TriangleCount{}; // After near plane clipping.
+	};
+
+	// Occluders covering less of the screen than this hide too little to pay for drawing.
+	static constexpr float MinOccluderScreenFraction{ 1.0f / 64.0f };
+
+	// width is rounded up to a multiple of four.
+	explicit OcclusionCuller(uint32 width = 320, uint32 height = 192);
+
+	// Clears the depth buffer. viewProj is the row vector view * projection matrix.
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProj);
+
+	// The at most maxCount candidates, as indices into worldBoxes, whose bounds cover
+	// the most of the screen, largest first. Call after BeginFrame.
+	void SelectOccluders(std::span<const DirectX::BoundingBox> worldBoxes, std::span<const uint32> candidates,
+		uint32 maxCount, std::vector<uint32>& occluders) const;
+
+	// Rasterizes indexed triangles placed by world. Both faces are drawn.
+	void RenderOccluder(std::span<const DirectX::XMFLOAT3> positions, std::span<const uint32> indices,
+		const DirectX::XMFLOAT4X4& world);
+
+	// Builds the pyramid from the depth buffer, once all occluders are drawn.
+	void BuildHiZ();
+
+	// True if worldBox is certainly hidden behind the occluders, at the buffer's resolution.
+	bool IsOccluded(const DirectX::BoundingBox& worldBox) const;
+
+	uint32 Width() const { return _width; }
+	uint32 Height() const { return _height; }
+
+	// Level 0 is the depth buffer itself.
+	uint32 LevelCount() const { return (uint32)_levels.size(); }
+	uint32 LevelWidth(uint32 level) const { return _levels[level].Width; }
+	uint32 LevelHeight(uint32 level) const { return _levels[level].Height; }
+	std::span<const float> Level(uint32 level) const;
+
+	// Writes a level as a binary PGM, near white and far black, for reference images.
+	bool WriteDepthImage(const std::filesystem::path& path, uint32 level = 0) const;
+
+	const Statistics& LastStatistics() const { return _statistics; }
+
+private:
+	struct LevelInfo
+	{
+		uint32 Width{};
+		uint32 Height{};
+		size_t Offset{};
+	};
+
+	// Screen rectangle in pixels and nearest z / w of a world space box.
+	struct ScreenRect
+	{
+		float MinX{};
+		float MinY{};
+		float MaxX{};
+		float MaxY{};
+		float NearestDepth{};
+	};
+
+	// False if the box crosses the near plane, where its projection is unbounded.
+	bool ProjectBox(const DirectX::BoundingBox& worldBox, ScreenRect& rect) const;
+
+	// Triangle in clip space, already clipped against the near plane.
+	void RasterizeTriangle(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c);
+
+	uint32 _width{};
+	uint32 _height{};
+	DirectX::XMFLOAT4X4 _viewProj{};
+
+	// Level 0 rows are 16 byte aligned for the rasterizer; the other levels follow.
+	AlignedVector<float> _depth{};
+	std::vector<LevelInfo> _levels{};
+
+	std::vector<DirectX::XMFLOAT4> _clipPositions{};
+	Statistics _statistics{};
+};
@@ -0,0 +1,233 @@
+#include "OffsetAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+using uint32 = OffsetAllocator::uint32;
+
+namespace
+{
+	constexpr uint32 MantissaBits = 3;
+	constexpr uint32 MantissaValue = 1 << MantissaBits;
+	constexpr uint32 MantissaMask = MantissaValue - 1;
+
+	// Sizes below MantissaValue get a bin each; above, a bin covers the sizes sharing
+	// the top MantissaBits + 1 bits. Rounding up is used to pick a bin that is
+	// guaranteed to fit a request, rounding down to file a free range.
+	uint32 BinRoundUp(uint32 size) {
+		if (size < MantissaValue)
+			return size;
+
+		uint32 mantissaStartBit = (uint32)std::bit_width(size) - 1 - MantissaBits;
+		uint32 exponent = mantissaStartBit + 1;
+		uint32 mantissa = (size >> mantissaStartBit) & MantissaMask;
+		if ((size & ((1u << mantissaStartBit) - 1)) != 0)
+			mantissa++; // may carry into the exponent, which is the next bin up
+
+		return (exponent << MantissaBits) + mantissa;
+	}
+
+	uint32 BinRoundDown(uint32 size) {
+		if (size < MantissaValue)
+			return size;
+
+		uint32 mantissaStartBit = (uint32)std::bit_width(size) - 1 - MantissaBits;
+		uint32 exponent = mantissaStartBit + 1;
+		uint32 mantissa = (size >> mantissaStartBit) & MantissaMask;
+		return (exponent << MantissaBits) | mantissa;
+	}
+
+	// Lowest set bit at or above startBit, or NoSpace.
+	uint32 FindSetBitFrom(uint32 mask, uint32 startBit) {
+		if (startBit >= 32)
+			return OffsetAllocator::NoSpace;
+
+		uint32 masked = mask & (~0u << startBit);
+		return masked == 0 ? OffsetAllocator::NoSpace : (uint32)std::countr_zero(masked);
+	}
+}
+
+OffsetAllocator::OffsetAllocator(uint32 capacity)
+	: _capacity(capacity) {
+	Reset();
+}
+
+void OffsetAllocator::Reset() {
+	_freeSize = 0;
+	_usedTopBins = 0;
+	std::fill(std::begin(_usedLeafBins), std::end(_usedLeafBins), std::uint8_t{ 0 });
+	std::fill(std::begin(_binHeads), std::end(_binHeads), NoSpace);
+	_nodes.clear();
+	_freeNodes.clear();
+
+	if (_capacity > 0)
+		InsertFreeRange(0, _capacity);
+}
+
+uint32 OffsetAllocator::NewNode() {
+	if (not _freeNodes.empty()) {
+		uint32 nodeIndex = _freeNodes.back();
+		_freeNodes.pop_back();
+		_nodes[nodeIndex] = Node{};
+		return nodeIndex;
+	}
+
+	_nodes.emplace_back();
+	return (uint32)_nodes.size() - 1;
+}
+
+uint32 OffsetAllocator::InsertFreeRange(uint32 offset, uint32 size) {
+	uint32 bin = BinRoundDown(size);
+	uint32 topBin = bin / LeafBinCount;
+	uint32 leafBin = bin % LeafBinCount;
+
+	_usedTopBins |= 1u << topBin;
+	_usedLeafBins[topBin] |= (std::uint8_t)(1u << leafBin);
+
+	uint32 nodeIndex = NewNode();
+	Node& node = _nodes[nodeIndex];
+	node.Offset = offset;
+	node.Size = size;
+	node.BinNext = _binHeads[bin];
+	if (node.BinNext != NoSpace)
+		_nodes[node.BinNext].BinPrevious = nodeIndex;
+	_binHeads[bin] = nodeIndex;
+
+	_freeSize += size;
+	return nodeIndex;
+}
+
+void OffsetAllocator::RemoveFreeNode(uint32 nodeIndex) {
+	Node& node = _nodes[nodeIndex];
+
+	if (node.BinPrevious != NoSpace) {
+		_nodes[node.BinPrevious].BinNext = node.BinNext;
+		if (node.BinNext != NoSpace)
+			_nodes[node.BinNext].BinPrevious = node.BinPrevious;
+	}
+	else {
+		// Head of its bin: the bin may become empty.
+		uint32 bin = BinRoundDown(node.Size);
+		uint32 topBin = bin / LeafBinCount;
+		uint32 leafBin = bin % LeafBinCount;
+
+		_binHeads[bin] = node.BinNext;
+		if (node.BinNext != NoSpace)
+			_nodes[node.BinNext].BinPrevious = NoSpace;
+		else {
+			_usedLeafBins[topBin] &= (std::uint8_t)~(1u << leafBin);
+			if (_usedLeafBins[topBin] == 0)
+				_usedTopBins &= ~(1u << topBin);
+		}
+	}
+
+	_freeSize -= node.Size;
+	_freeNodes.push_back(nodeIndex);
+}
+
+OffsetAllocator::Allocation OffsetAllocator::Allocate(uint32 size) {
+	assert(size > 0);
+
+	uint32 minBin = BinRoundUp(size);
+	uint32 topBin = minBin / LeafBinCount;
+	uint32 leafBin = minBin % LeafBinCount;
+
+	// First non-empty bin at or above minBin: in the same top bin, or in the
+	// lowest leaf of the next used top bin.
+	uint32 foundLeaf = NoSpace;
+	if (_usedTopBins & (1u << topBin))
+		foundLeaf = FindSetBitFrom(_usedLeafBins[topBin], leafBin);
+	if (foundLeaf == NoSpace) {
+		topBin = FindSetBitFrom(_usedTopBins, topBin + 1);
+		if (topBin == NoSpace)
+			return {};
+		foundLeaf = (uint32)std::countr_zero((uint32)_usedLeafBins[topBin]);
+	}
+
+	uint32 nodeIndex = _binHeads[topBin * LeafBinCount + foundLeaf];
+	Node node = _nodes[nodeIndex];
+	RemoveFreeNode(nodeIndex);
+	_freeNodes.pop_back(); // the node is reused for the allocation
+
+	Node& used = _nodes[nodeIndex];
+	used = Node{
+		.Offset = node.Offset,
+		.Size = size,
+		.NeighborPrevious = node.NeighborPrevious,
+		.NeighborNext = node.NeighborNext,
+		.IsUsed = true,
+	};
+
+	// Return the tail to the bins as a new neighbour.
+	uint32 remainder = node.Size - size;
+	if (remainder > 0) {
+		uint32 tailIndex = InsertFreeRange(node.Offset + size, remainder);
+		Node& tail = _nodes[tailIndex];
+		Node& head = _nodes[nodeIndex];
+		tail.NeighborPrevious = nodeIndex;
+		tail.NeighborNext = head.NeighborNext;
+		if (head.NeighborNext != NoSpace)
+			_nodes[head.NeighborNext].NeighborPrevious = tailIndex;
+		head.NeighborNext = tailIndex;
+	}
+
+	return Allocation{ node.Offset, nodeIndex };
+}
+
+void OffsetAllocator::Free(Allocation allocation) {
+	if (not allocation.IsValid())
+		return;
+
+	Node node = _nodes[allocation.Node];
+	assert(node.IsUsed and node.Offset == allocation.Offset);
+
+	uint32 offset = node.Offset;
+	uint32 size = node.Size;
+
+	// Merge with free neighbours, whose nodes are released.
+	if (node.NeighborPrevious != NoSpace and not _nodes[node.NeighborPrevious].IsUsed) {
+		const Node& previous = _nodes[node.NeighborPrevious];
+		offset = previous.Offset;
+		size += previous.Size;
+		uint32 previousIndex = node.NeighborPrevious;
+		node.NeighborPrevious = previous.NeighborPrevious;
+		RemoveFreeNode(previousIndex);
+	}
+	if (node.NeighborNext != NoSpace and not _nodes[node.NeighborNext].IsUsed) {
+		const Node& next = _nodes[node.NeighborNext];
+		size += next.Size;
+		uint32 nextIndex = node.NeighborNext;
+		node.NeighborNext = next.NeighborNext;
+		RemoveFreeNode(nextIndex);
+	}
+
+	_freeNodes.push_back(allocation.Node);
+
+	uint32 nodeIndex = InsertFreeRange(offset, size);
+	Node& merged = _nodes[nodeIndex];
+	merged.NeighborPrevious = node.NeighborPrevious;
+	merged.NeighborNext = node.NeighborNext;
+	if (merged.NeighborPrevious != NoSpace)
+		_nodes[merged.NeighborPrevious].NeighborNext = nodeIndex;
+	if (merged.NeighborNext != NoSpace)
+		_nodes[merged.NeighborNext].NeighborPrevious = nodeIndex;
+}
+
+uint32 OffsetAllocator::AllocationSize(Allocation allocation) const {
+	return allocation.IsValid() ? _nodes[allocation.Node].Size : 0;
+}
+
+uint32 OffsetAllocator::LargestFreeRange() const {
+	if (_usedTopBins == 0)
+		return 0;
+
+	uint32 topBin = 31 - (uint32)std::countl_zero(_usedTopBins);
+	uint32 leafBin = 31 - (uint32)std::countl_zero((uint32)_usedLeafBins[topBin]);
+
+	// Sizes in a bin differ, so look at all of the highest bin's ranges.
+	uint32 largest = 0;
+	for (uint32 nodeIndex = _binHeads[topBin * LeafBinCount + leafBin]; nodeIndex != NoSpace; nodeIndex = _nodes[nodeIndex].BinNext)
+		largest = std::max(largest, _nodes[nodeIndex].Size);
+	return largest;
+}
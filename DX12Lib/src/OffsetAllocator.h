@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Hands out ranges of a linear resource, like the elements of a vertex or index
+// buffer, in O(1) (the two-level segregated fit scheme of TLSF).
+//
+// Free ranges are kept in 256 bins whose sizes follow a small floating point format
+// with three mantissa bits, so a bin's sizes are within 12.5% of each other. Two
+// levels of bit masks find the first non-empty bin that fits a request. Freed ranges
+// merge with free neighbours immediately. The allocator only does bookkeeping; it
+// never touches the memory it manages, so it has no device dependency.
+class OffsetAllocator
+{
+public:
+	using uint32 = std::uint32_t;
+
+	static constexpr uint32 NoSpace{ UINT32_MAX };
+
+	struct Allocation
+	{
+		uint32 Offset{ NoSpace };
+		uint32 Node{ NoSpace };
+
+		bool IsValid() const { return Offset != NoSpace; }
+	};
+
+	explicit OffsetAllocator(uint32 capacity);
+
+	// Returns an invalid allocation when there is no free range of size elements.
+	Allocation Allocate(uint32 size);
+	void Free(Allocation allocation);
+
+	// Frees everything.
+	void Reset();
+
+	uint32 AllocationSize(Allocation allocation) const;
+	uint32 Capacity() const { return _capacity; }
+	uint32 FreeSize() const { return _freeSize; }
+	uint32 LargestFreeRange() const;
+
+private:
+	static constexpr uint32 TopBinCount{ 32 };
+	static constexpr uint32 LeafBinCount{ 8 };
+	static constexpr uint32 BinCount{ TopBinCount * LeafBinCount };
+
+	struct Node
+	{
+		uint32 Offset{};
+		uint32 Size{};
+		uint32 BinPrevious{ NoSpace };
+		uint32 BinNext{ NoSpace };
+		uint32 NeighborPrevious{ NoSpace };
+		uint32 NeighborNext{ NoSpace };
+		bool IsUsed{};
+	};
+
+	uint32 NewNode();
+	uint32 InsertFreeRange(uint32 offset, uint32 size);
+	void RemoveFreeNode(uint32 nodeIndex);
+
+	uint32 _capacity{};
+	uint32 _freeSize{};
+
+	uint32 _usedTopBins{};
+	std::uint8_t _usedLeafBins[TopBinCount]{};
+	uint32 _binHeads[BinCount]{};
+
+	std::vector<Node> _nodes{};
+	std::vector<uint32> _freeNodes{};
+};
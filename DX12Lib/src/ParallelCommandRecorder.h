@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "DrawQueue.h"
+#include "JobSystem.h"
+
+// Records the draws of a DrawQueue onto several command lists at once.
+//
+// The queue is split into chunks of whole draws, one per command list, and the chunks
+// are recorded in parallel on a JobSystem, each as if it were a queue of its own. The
+// lists are then submitted in chunk order, so the GPU sees the draws in queue order.
+//
+// TBackend owns the command lists and provides:
+//   BeginList(list, chunk)  resets the list and binds the state every list of the
+//                           frame needs; returns what DrawQueue::Submit records onto.
+//   EndList(list)           closes the list.
+//   Execute(listCount)      submits lists [0, listCount) with one ExecuteCommandLists.
+// BeginList and EndList run on worker threads, but every list only on one of them;
+// Execute runs on the thread calling Record.
+class ParallelCommandRecorder
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// A list costs about as much to begin and submit as a few hundred draws to record.
+	static constexpr uint32 DefaultMinPacketsPerList{ 256 };
+
+	template<typename TBackend>
+	DrawQueue::Statistics Record(const DrawQueue& queue, TBackend& backend, uint32 maxListCount, JobSystem& jobSystem,
+		uint32 minPacketsPerList = DefaultMinPacketsPerList);
+
+	// The chunks the last Record recorded, by list, and their statistics.
+	std::span<const DrawQueue::Chunk> Chunks() const { return _chunks; }
+	std::span<const DrawQueue::Statistics> ListStatistics() const { return _statistics; }
+
+private:
+	std::vector<DrawQueue::Chunk> _chunks{};
+	std::vector<DrawQueue::Statistics> _statistics{};
+};
+
+template<typename TBackend>
+DrawQueue::Statistics ParallelCommandRecorder::Record(const DrawQueue& queue, TBackend& backend, uint32 maxListCount,
+	JobSystem& jobSystem, uint32 minPacketsPerList) {
+	queue.Split(maxListCount, minPacketsPerList, _chunks);
+	_statistics.assign(_chunks.size(), {});
+
+	jobSystem.ParallelFor(0, _chunks.size(), 1, [&](size_t list) {
+		auto& commandList = backend.BeginList((uint32)list, _chunks[list]);
+		_statistics[list] = queue.Submit(commandList, _chunks[list]);
+		backend.EndList((uint32)list);
+	});
+
+	backend.Execute((uint32)_chunks.size());
+
+	DrawQueue::Statistics statistics;
+	for (const DrawQueue::Statistics& listStatistics : _statistics)
+		statistics += listStatistics;
+	return statistics;
+}
@@ -0,0 +1,532 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+using uint32 = SceneBvh::uint32;
+
+struct SceneBvh::BuildItem
+{
+	XMFLOAT3 Min;
+	XMFLOAT3 Max;
+	uint32 Item;
+
+	// Twice the centroid, which bins just as well.
+	float Centroid(int axis) const { return (&Min.x)[axis] + (&Max.x)[axis]; }
+};
+
+namespace
+{
+	// Bins per axis of the SAH split search.
+	constexpr int BinCount{ 16 };
+
+	// Update() reinserts an item whose new box grows its parent's area beyond this.
+	constexpr float ReinsertAreaRatio{ 2.0f };
+
+	// Subtrees with at least this many items are built on two threads.
+	constexpr size_t ParallelBuildThreshold{ 4096 };
+
+	struct Aabb
+	{
+		XMFLOAT3 Min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		XMFLOAT3 Max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const XMFLOAT3& min, const XMFLOAT3& max) {
+			Min = { std::min(Min.x, min.x), std::min(Min.y, min.y), std::min(Min.z, min.z) };
+			Max = { std::max(Max.x, max.x), std::max(Max.y, max.y), std::max(Max.z, max.z) };
+		}
+
+		// Half the surface area, which is all the SAH needs.
+		float HalfArea() const {
+			float dx = Max.x - Min.x;
+			float dy = Max.y - Min.y;
+			float dz = Max.z - Min.z;
+			return dx * dy + dy * dz + dz * dx;
+		}
+	};
+
+	Aabb Union(const XMFLOAT3& minA, const XMFLOAT3& maxA, const XMFLOAT3& minB, const XMFLOAT3& maxB) {
+		Aabb box{ minA, maxA };
+		box.Grow(minB, maxB);
+		return box;
+	}
+
+	bool Equal(const XMFLOAT3& a, const XMFLOAT3& b) {
+		return a.x == b.x and a.y == b.y and a.z == b.z;
+	}
+
+	void ToMinMax(const BoundingBox& box, XMFLOAT3& min, XMFLOAT3& max) {
+		min = { box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z };
+		max = { box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z };
+	}
+
+	// Splits items at the binned SAH optimum along the axis of largest centroid
+	// spread and returns the size of the first part, which is never 0 or all items.
+	template<typename TBuildItem>
+	size_t PartitionSah(std::span<TBuildItem> items) {
+		float centroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float centroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const auto& item : items) {
+			for (int axis = 0; axis < 3; ++axis) {
+				centroidMin[axis] = std::min(centroidMin[axis], item.Centroid(axis));
+				centroidMax[axis] = std::max(centroidMax[axis], item.Centroid(axis));
+			}
+		}
+
+		int axis = 0;
+		for (int a = 1; a < 3; ++a) {
+			if (centroidMax[a] - centroidMin[a] > centroidMax[axis] - centroidMin[axis])
+				axis = a;
+		}
+
+		// All centroids in one place: any split is as good as another.
+		float spread = centroidMax[axis] - centroidMin[axis];
+		if (not (spread > 0.0f))
+			return items.size() / 2;
+
+		float binScale = BinCount / spread;
+		auto binOf = [&](const TBuildItem& item) {
+			return std::min(BinCount - 1, (int)((item.Centroid(axis) - centroidMin[axis]) * binScale));
+		};
+
+		Aabb binBoxes[BinCount];
+		size_t binCounts[BinCount]{};
+		for (const auto& item : items) {
+			int bin = binOf(item);
+			binBoxes[bin].Grow(item.Min, item.Max);
+			binCounts[bin]++;
+		}
+
+		// Cost of splitting after bin b, sweeping once from each side.
+		float leftCosts[BinCount - 1];
+		Aabb sweep;
+		size_t count = 0;
+		for (int b = 0; b < BinCount - 1; ++b) {
+			sweep.Grow(binBoxes[b].Min, binBoxes[b].Max);
+			count += binCounts[b];
+			leftCosts[b] = count == 0 ? 0.0f : sweep.HalfArea() * count;
+		}
+
+		int bestSplit = 0;
+		float bestCost = FLT_MAX;
+		sweep = Aabb{};
+		count = 0;
+		for (int b = BinCount - 1; b > 0; --b) {
+			sweep.Grow(binBoxes[b].Min, binBoxes[b].Max);
+			count += binCounts[b];
+			float cost = leftCosts[b - 1] + (count == 0 ? 0.0f : sweep.HalfArea() * count);
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+
+		auto middle = std::partition(items.begin(), items.end(), [&](const TBuildItem& item) {
+			return binOf(item) < bestSplit;
+		});
+
+		size_t leftCount = (size_t)(middle - items.begin());
+		return leftCount == 0 or leftCount == items.size() ? items.size() / 2 : leftCount;
+	}
+}
+
+void SceneBvh::Build(std::span<const BoundingBox> boxes, JobSystem& jobSystem) {
+	std::vector<BuildItem> items(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++i) {
+		ToMinMax(boxes[i], items[i].Min, items[i].Max);
+		items[i].Item = (uint32)i;
+	}
+
+	_itemLeaves.assign(boxes.size(), InvalidNode);
+	BuildTree(items, jobSystem);
+}
+
+void SceneBvh::Rebuild(JobSystem& jobSystem) {
+	std::vector<BuildItem> items;
+	items.reserve(_itemCount);
+	for (uint32 leaf : _itemLeaves) {
+		if (leaf == InvalidNode) continue;
+
+		const Node& node = _nodes[leaf];
+		items.push_back({ node.Min, node.Max, node.Item });
+	}
+
+	std::fill(_itemLeaves.begin(), _itemLeaves.end(), InvalidNode);
+	BuildTree(items, jobSystem);
+}
+
+void SceneBvh::BuildTree(std::vector<BuildItem>& items, JobSystem& jobSystem) {
+	// A binary tree over n leaves has 2n - 1 nodes. Giving every subtree a fixed range
+	// of them lets both halves of a split be built at the same time.
+	_nodes.assign(items.empty() ? 0 : 2 * items.size() - 1, Node{});
+	_freeNodes.clear();
+	_itemCount = (uint32)items.size();
+	_root = items.empty() ? InvalidNode : 0;
+
+	if (not items.empty())
+		BuildSubtree(items, 0, InvalidNode, jobSystem);
+}
+
+void SceneBvh::BuildSubtree(std::span<BuildItem> items, uint32 firstNode, uint32 parent, JobSystem& jobSystem) {
+	Aabb bounds;
+	for (const auto& item : items)
+		bounds.Grow(item.Min, item.Max);
+
+	Node& node = _nodes[firstNode];
+	node.Min = bounds.Min;
+	node.Max = bounds.Max;
+	node.Parent = parent;
+
+	if (items.size() == 1) {
+		node.Item = items[0].Item;
+		_itemLeaves[node.Item] = firstNode;
+		return;
+	}
+
+	size_t leftCount = PartitionSah(items);
+	uint32 leftNode = firstNode + 1;
+	uint32 rightNode = firstNode + 2 * (uint32)leftCount;
+	node.Children[0] = leftNode;
+	node.Children[1] = rightNode;
+
+	auto buildSide = [&](size_t side) {
+		if (side == 0)
+			BuildSubtree(items.first(leftCount), leftNode, firstNode, jobSystem);
+		else
+			BuildSubtree(items.subspan(leftCount), rightNode, firstNode, jobSystem);
+	};
+
+	if (items.size() >= ParallelBuildThreshold)
+		jobSystem.ParallelFor(0, 2, 1, buildSide);
+	else {
+		buildSide(0);
+		buildSide(1);
+	}
+}
+
+uint32 SceneBvh::AllocateNode() {
+	if (not _freeNodes.empty()) {
+		uint32 node = _freeNodes.back();
+		_freeNodes.pop_back();
+		_nodes[node] = Node{};
+		return node;
+	}
+
+	_nodes.emplace_back();
+	return (uint32)_nodes.size() - 1;
+}
+
+void SceneBvh::FreeNode(uint32 node) {
+	_freeNodes.push_back(node);
+}
+
+void SceneBvh::Insert(uint32 item, const BoundingBox& box) {
+	assert(item != InvalidItem and not Contains(item));
+
+	uint32 leaf = AllocateNode();
+	ToMinMax(box, _nodes[leaf].Min, _nodes[leaf].Max);
+	_nodes[leaf].Item = item;
+
+	if (item >= _itemLeaves.size())
+		_itemLeaves.resize((size_t)item + 1, InvalidNode);
+	_itemLeaves[item] = leaf;
+	_itemCount++;
+
+	InsertLeaf(leaf);
+}
+
+void SceneBvh::InsertLeaf(uint32 leaf) {
+	if (_root == InvalidNode) {
+		_root = leaf;
+		_nodes[leaf].Parent = InvalidNode;
+		return;
+	}
+
+	// Walk down towards the sibling that adds the least area to the tree (Catto's
+	// branch and bound simplified to a greedy descent).
+	const XMFLOAT3 leafMin = _nodes[leaf].Min;
+	const XMFLOAT3 leafMax = _nodes[leaf].Max;
+	uint32 sibling = _root;
+	while (not _nodes[sibling].IsLeaf()) {
+		const Node& node = _nodes[sibling];
+		float area = Aabb{ node.Min, node.Max }.HalfArea();
+		float combinedArea = Union(node.Min, node.Max, leafMin, leafMax).HalfArea();
+
+		// Pairing with this node creates a parent of combinedArea; descending grows
+		// this node and every ancestor by the same amount.
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int c = 0; c < 2; ++c) {
+			const Node& child = _nodes[node.Children[c]];
+			float childCombinedArea = Union(child.Min, child.Max, leafMin, leafMax).HalfArea();
+			float growth = child.IsLeaf() ? childCombinedArea : childCombinedArea - Aabb{ child.Min, child.Max }.HalfArea();
+			childCosts[c] = growth + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] and cost < childCosts[1])
+			break;
+
+		sibling = childCosts[0] <= childCosts[1] ? node.Children[0] : node.Children[1];
+	}
+
+	uint32 oldParent = _nodes[sibling].Parent;
+	uint32 newParent = AllocateNode();
+	Aabb combined = Union(_nodes[sibling].Min, _nodes[sibling].Max, leafMin, leafMax);
+	_nodes[newParent].Min = combined.Min;
+	_nodes[newParent].Max = combined.Max;
+	_nodes[newParent].Parent = oldParent;
+	_nodes[newParent].Children[0] = sibling;
+	_nodes[newParent].Children[1] = leaf;
+	_nodes[sibling].Parent = newParent;
+	_nodes[leaf].Parent = newParent;
+
+	if (oldParent == InvalidNode)
+		_root = newParent;
+	else {
+		Node& parent = _nodes[oldParent];
+		parent.Children[parent.Children[0] == sibling ? 0 : 1] = newParent;
+		RefitFrom(oldParent);
+	}
+}
+
+void SceneBvh::Remove(uint32 item) {
+	assert(Contains(item));
+
+	uint32 leaf = _itemLeaves[item];
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	_itemLeaves[item] = InvalidNode;
+	_itemCount--;
+}
+
+void SceneBvh::RemoveLeaf(uint32 leaf) {
+	if (leaf == _root) {
+		_root = InvalidNode;
+		return;
+	}
+
+	// The sibling takes the place of the parent.
+	uint32 parent = _nodes[leaf].Parent;
+	uint32 grandParent = _nodes[parent].Parent;
+	uint32 sibling = _nodes[parent].Children[0] == leaf ? _nodes[parent].Children[1] : _nodes[parent].Children[0];
+
+	_nodes[sibling].Parent = grandParent;
+	FreeNode(parent);
+
+	if (grandParent == InvalidNode)
+		_root = sibling;
+	else {
+		Node& node = _nodes[grandParent];
+		node.Children[node.Children[0] == parent ? 0 : 1] = sibling;
+		RefitFrom(grandParent);
+	}
+}
+
+void SceneBvh::Update(uint32 item, const BoundingBox& box) {
+	assert(Contains(item));
+
+	uint32 leaf = _itemLeaves[item];
+	ToMinMax(box, _nodes[leaf].Min, _nodes[leaf].Max);
+
+	// Small moves only refit. An item that moved far away from its sibling would
+	// stretch the boxes of all its ancestors, so it is moved in the tree instead.
+	uint32 parent = _nodes[leaf].Parent;
+	if (parent != InvalidNode) {
+		const Node& parentNode = _nodes[parent];
+		float parentArea = Aabb{ parentNode.Min, parentNode.Max }.HalfArea();
+		float grownArea = Union(parentNode.Min, parentNode.Max, _nodes[leaf].Min, _nodes[leaf].Max).HalfArea();
+		if (grownArea > ReinsertAreaRatio * parentArea) {
+			RemoveLeaf(leaf);
+			InsertLeaf(leaf);
+			return;
+		}
+	}
+
+	RefitFrom(parent);
+}
+
+void SceneBvh::RefitFrom(uint32 node) {
+	for (; node != InvalidNode; node = _nodes[node].Parent) {
+		const Node& left = _nodes[_nodes[node].Children[0]];
+		const Node& right = _nodes[_nodes[node].Children[1]];
+		Aabb box = Union(left.Min, left.Max, right.Min, right.Max);
+
+		Node& current = _nodes[node];
+		if (Equal(box.Min, current.Min) and Equal(box.Max, current.Max))
+			break;
+
+		current.Min = box.Min;
+		current.Max = box.Max;
+	}
+}
+
+float SceneBvh::SahCost() const {
+	if (_root == InvalidNode or _nodes[_root].IsLeaf())
+		return 0.0f;
+
+	float innerArea = 0.0f;
+	std::vector<uint32> stack{ _root };
+	while (not stack.empty()) {
+		const Node& node = _nodes[stack.back()];
+		stack.pop_back();
+		if (node.IsLeaf()) continue;
+
+		innerArea += Aabb{ node.Min, node.Max }.HalfArea();
+		stack.push_back(node.Children[0]);
+		stack.push_back(node.Children[1]);
+	}
+
+	float rootArea = Aabb{ _nodes[_root].Min, _nodes[_root].Max }.HalfArea();
+	return rootArea > 0.0f ? innerArea / rootArea : 0.0f;
+}
+
+void SceneBvh::AppendSubtreeItems(uint32 node, std::vector<uint32>& items) const {
+	uint32 stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = node;
+
+	while (stackSize > 0) {
+		const Node& current = _nodes[stack[--stackSize]];
+		if (current.IsLeaf()) {
+			items.push_back(current.Item);
+			continue;
+		}
+
+		// Incremental inserts can make the tree deeper than the stack; recurse then.
+		if (stackSize + 2 > (int)std::size(stack)) {
+			AppendSubtreeItems(current.Children[0], items);
+			AppendSubtreeItems(current.Children[1], items);
+			continue;
+		}
+
+		stack[stackSize++] = current.Children[1];
+		stack[stackSize++] = current.Children[0];
+	}
+}
+
+SceneBvh::QueryStatistics SceneBvh::QueryFrustum(const XMFLOAT4X4& viewProj, std::vector<uint32>& items) const {
+	items.clear();
+	QueryStatistics statistics;
+	if (_root == InvalidNode)
+		return statistics;
+
+	FrustumPlanes planes = FrustumPlanes::FromViewProjection(viewProj);
+
+	// Bit p of a node's plane mask is set while the node still straddles plane p;
+	// children of a node inside a plane need not test it again.
+	constexpr uint32 AllPlanes{ (1u << FrustumPlanes::Count) - 1 };
+	std::vector<std::pair<uint32, uint32>> stack{ { _root, AllPlanes } };
+
+	while (not stack.empty()) {
+		auto [nodeIndex, planeMask] = stack.back();
+		stack.pop_back();
+		statistics.VisitedNodeCount++;
+
+		const Node& node = _nodes[nodeIndex];
+		float center[3] = { 0.5f * (node.Min.x + node.Max.x), 0.5f * (node.Min.y + node.Max.y), 0.5f * (node.Min.z + node.Max.z) };
+		float extents[3] = { 0.5f * (node.Max.x - node.Min.x), 0.5f * (node.Max.y - node.Min.y), 0.5f * (node.Max.z - node.Min.z) };
+
+		bool isOutside = false;
+		for (uint32 mask = planeMask; mask != 0; mask &= mask - 1) {
+			int p = std::countr_zero(mask);
+			float distance = center[0] * planes.A[p] + center[1] * planes.B[p] + center[2] * planes.C[p] + planes.D[p];
+			float radius = extents[0] * fabsf(planes.A[p]) + extents[1] * fabsf(planes.B[p]) + extents[2] * fabsf(planes.C[p]);
+			if (distance + radius < 0.0f) {
+				isOutside = true;
+				break;
+			}
+			if (distance - radius >= 0.0f)
+				planeMask &= ~(1u << p);
+		}
+
+		if (isOutside)
+			continue;
+
+		if (planeMask == 0)
+			AppendSubtreeItems(nodeIndex, items);
+		else if (node.IsLeaf())
+			items.push_back(node.Item);
+		else {
+			stack.push_back({ node.Children[1], planeMask });
+			stack.push_back({ node.Children[0], planeMask });
+		}
+	}
+
+	statistics.ItemCount = (uint32)items.size();
+	return statistics;
+}
+
+void SceneBvh::QueryFrustums(std::span<const XMFLOAT4X4> viewProjs, std::span<std::vector<uint32>> items, JobSystem& jobSystem) const {
+	assert(items.size() >= viewProjs.size());
+
+	jobSystem.ParallelFor(0, viewProjs.size(), 1, [&](size_t i) {
+		QueryFrustum(viewProjs[i], items[i]);
+	});
+}
+
+void SceneBvh::RayCast(std::span<const Ray> rays, std::span<RayHit> hits, JobSystem& jobSystem) const {
+	assert(hits.size() >= rays.size());
+
+	jobSystem.ParallelFor(0, rays.size(), 64, [&](size_t first, size_t last) {
+		std::vector<std::pair<uint32, float>> stack;
+		for (size_t i = first; i < last; ++i)
+			hits[i] = CastRay(rays[i], stack);
+	});
+}
+
+SceneBvh::RayHit SceneBvh::CastRay(const Ray& ray, std::vector<std::pair<uint32, float>>& stack) const {
+	RayHit hit{ InvalidItem, ray.MaxDistance };
+	if (_root == InvalidNode)
+		return hit;
+
+	const float origin[3] = { ray.Origin.x, ray.Origin.y, ray.Origin.z };
+	const float inverseDirection[3] = { 1.0f / ray.Direction.x, 1.0f / ray.Direction.y, 1.0f / ray.Direction.z };
+
+	// Distance at which the ray enters a node's box, or infinity if it misses it.
+	auto entryDistance = [&](const Node& node) {
+		const float* pMin = &node.Min.x;
+		const float* pMax = &node.Max.x;
+		float tNear = 0.0f;
+		float tFar = hit.Distance;
+		for (int axis = 0; axis < 3; ++axis) {
+			float t0 = (pMin[axis] - origin[axis]) * inverseDirection[axis];
+			float t1 = (pMax[axis] - origin[axis]) * inverseDirection[axis];
+			tNear = std::max(tNear, std::min(t0, t1));
+			tFar = std::min(tFar, std::max(t0, t1));
+		}
+		return tNear <= tFar ? tNear : INFINITY;
+	};
+
+	stack.clear();
+	float rootDistance = entryDistance(_nodes[_root]);
+	if (rootDistance != INFINITY)
+		stack.push_back({ _root, rootDistance });
+
+	while (not stack.empty()) {
+		auto [nodeIndex, distance] = stack.back();
+		stack.pop_back();
+		if (hit.Item != InvalidItem and distance >= hit.Distance)
+			continue;
+
+		const Node& node = _nodes[nodeIndex];
+		if (node.IsLeaf()) {
+			hit = { node.Item, distance };
+			continue;
+		}
+
+		// Visit the nearer child first so the farther one is more likely pruned.
+		float childDistances[2] = { entryDistance(_nodes[node.Children[0]]), entryDistance(_nodes[node.Children[1]]) };
+		int nearer = childDistances[1] < childDistances[0] ? 1 : 0;
+		if (childDistances[1 - nearer] != INFINITY)
+			stack.push_back({ node.Children[1 - nearer], childDistances[1 - nearer] });
+		if (childDistances[nearer] != INFINITY)
+			stack.push_back({ node.Children[nearer], childDistances[nearer] });
+	}
+
+	return hit;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+// Dynamic bounding volume hierarchy over scene items, so visibility and picking
+// queries only look at the part of the scene they touch.
+//
+// Items are small integers chosen by the caller, typically render item indices, and
+// each is a leaf holding its world space box. Build() creates a tree with the binned
+// surface area heuristic (SAH). Insert(), Remove() and Update() change the tree in
+// place; Update() refits the boxes above an item that moved a little and reinserts
+// one that moved far. Either way the tree drifts from the SAH optimum over time:
+// SahCost() measures that and Rebuild() builds a fresh SAH tree over the current boxes.
+class SceneBvh
+{
+public:
+	using uint32 = std::uint32_t;
+	static constexpr uint32 InvalidItem{ UINT32_MAX };
+
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin{};
+		DirectX::XMFLOAT3 Direction{};
+		float MaxDistance{ FLT_MAX };
+	};
+
+	// The item whose box a ray enters first, at Distance times its direction.
+	struct RayHit
+	{
+		uint32 Item{ InvalidItem };
+		float Distance{};
+	};
+
+	struct QueryStatistics
+	{
+		uint32 VisitedNodeCount{};
+		uint32 ItemCount{};
+	};
+
+	// Replaces all items: item i gets boxes[i].
+	void Build(std::span<const DirectX::BoundingBox> boxes, JobSystem& jobSystem = JobSystem::Default());
+
+	// Builds a new tree over the current items and boxes.
+	void Rebuild(JobSystem& jobSystem = JobSystem::Default());
+
+	void Insert(uint32 item, const DirectX::BoundingBox& box);
+	void Remove(uint32 item);
+
+	// Gives an item a new box.
+	void Update(uint32 item, const DirectX::BoundingBox& box);
+
+	bool Contains(uint32 item) const { return item < _itemLeaves.size() and _itemLeaves[item] != InvalidNode; }
+	uint32 ItemCount() const { return _itemCount; }
+
+	// Summed surface area of the inner nodes relative to the root's: the number of
+	// inner nodes a ray through the scene is expected to visit.
+	float SahCost() const;
+
+	// Replaces items with the items whose boxes intersect the frustum of viewProj, a
+	// row vector view * projection matrix, in no particular order. Subtrees entirely
+	// inside the frustum are added without testing their boxes.
+	QueryStatistics QueryFrustum(const DirectX::XMFLOAT4X4& viewProj, std::vector<uint32>& items) const;
+
+	// QueryFrustum for several frusta at once, such as shadow cascades.
+	void QueryFrustums(std::span<const DirectX::XMFLOAT4X4> viewProjs, std::span<std::vector<uint32>> items,
+		JobSystem& jobSystem = JobSystem::Default()) const;
+
+	// Nearest hit of every ray. Rays that hit nothing get InvalidItem.
+	void RayCast(std::span<const Ray> rays, std::span<RayHit> hits, JobSystem& jobSystem = JobSystem::Default()) const;
+
+private:
+	static constexpr uint32 InvalidNode{ UINT32_MAX };
+
+	struct Node
+	{
+		DirectX::XMFLOAT3 Min{};
+		uint32 Parent{ InvalidNode };
+		DirectX::XMFLOAT3 Max{};
+		uint32 Item{ InvalidItem }; // Leaves only.
+		uint32 Children[2]{ InvalidNode, InvalidNode };
+
+		bool IsLeaf() const { return Item != InvalidItem; }
+	};
+
+	struct BuildItem;
+
+	// Builds the subtree over items into the 2 * items.size() - 1 nodes from firstNode.
+	void BuildSubtree(std::span<BuildItem> items, uint32 firstNode, uint32 parent, JobSystem& jobSystem);
+	void BuildTree(std::vector<BuildItem>& items, JobSystem& jobSystem);
+
+	uint32 AllocateNode();
+	void FreeNode(uint32 node);
+
+	void InsertLeaf(uint32 leaf);
+	void RemoveLeaf(uint32 leaf);
+
+	// Recomputes node boxes from their children up to the root, stopping early at the
+	// first box that does not change.
+	void RefitFrom(uint32 node);
+
+	void AppendSubtreeItems(uint32 node, std::vector<uint32>& items) const;
+	RayHit CastRay(const Ray& ray, std::vector<std::pair<uint32, float>>& stack) const;
+
+	std::vector<Node> _nodes{};
+	std::vector<uint32> _freeNodes{};
+	std::vector<uint32> _itemLeaves{};
+	uint32 _root{ InvalidNode };
+	uint32 _itemCount{};
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+// Instruction sets the compiler may use, as 0 or 1 for #if, with their intrinsics
+// headers. Every kernel with a SIMD path keeps a scalar one for when both are 0.
+//
+// SSE2 is part of x64 and enabled on x86 by /arch:SSE2 (MSVC) or -msse2. DX12_HAS_AVX2
+// is only 1 when the whole binary is built with /arch:AVX2 or -mavx2 and so requires
+// it. Kernels worth an AVX2 version should not depend on that: they go into a
+// translation unit of their own built with /arch:AVX2, their functions marked
+// DX12_TARGET_AVX2 for GCC and Clang, and are picked once at run time with
+// CpuHasAvx2() when DX12_CAN_COMPILE_AVX2.
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DX12_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define DX12_HAS_SSE2 0
+#endif
+
+#if defined(__AVX2__)
+#define DX12_HAS_AVX2 1
+#else
+#define DX12_HAS_AVX2 0
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DX12_CAN_COMPILE_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define DX12_CAN_COMPILE_AVX2 0
+#endif
+
+#if defined(__GNUC__) && !DX12_HAS_AVX2
+#define DX12_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DX12_TARGET_AVX2
+#endif
+
+#if DX12_CAN_COMPILE_AVX2
+// True when both the CPU and the OS support AVX2: the CPU has the instructions and
+// the OS saves the YMM registers on context switches.
+inline bool CpuHasAvx2() {
+#if DX12_HAS_AVX2
+	return true;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// OSXSAVE and AVX, then XMM and YMM state enabled in XCR0.
+	__cpuid(info, 1);
+	const int osxsaveAndAvx = (1 << 27) | (1 << 28);
+	if ((info[2] & osxsaveAndAvx) != osxsaveAndAvx or (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	// Also checks XCR0.
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
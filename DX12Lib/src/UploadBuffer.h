@@ -3,25 +3,28 @@
 #include <wrl.h>
 
 #include "Dxutil.h"
+#include "MappedBuffer.h"
 #include "MathHelper.h"
 
 template<typename T>
-class UploadBuffer
+class UploadBuffer final : public MappedBuffer<T>
 {
+	using MappedBuffer<T>::_pMappedData;
+	using MappedBuffer<T>::_elementByteSize;
+
 public:
 	UploadBuffer(
 		ID3D12Device* pDevice, 
 		UINT elementCount,
 		bool isConstantBuffer) : 
-		_isConstantBuffer(isConstantBuffer)
-	{
 		// Constant buffer elements need to be multiples of 256 bytes.
 		// This is because the hardware can only view constant data 
 		// at m*256 byte offsets and of n*256 byte lengths. 
-		_elementByteSize = (_isConstantBuffer)
+		MappedBuffer<T>(elementCount, isConstantBuffer
 			? DxUtil::CalcConstantBufferByteSize(sizeof(T))
-			: sizeof(T);
-
+			: sizeof(T)),
+		_isConstantBuffer(isConstantBuffer)
+	{
 		CD3DX12_HEAP_PROPERTIES prop(D3D12_HEAP_TYPE_UPLOAD);
 		D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(_elementByteSize * elementCount);
 
@@ -60,13 +63,7 @@ public:
 		return _pUploadBuffer.Get();
 	}
 
-	void CopyData(int elementIndex, const T& data) {
-		memcpy(&_pMappedData[elementIndex*_elementByteSize], &data, sizeof(T));
-	}
-
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> _pUploadBuffer{};
-	BYTE* _pMappedData{};
-	UINT _elementByteSize{};
 	bool _isConstantBuffer{};
 };
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include "GeometryGenerator.h"
+
+// Compact vertex formats described once, at compile time.
+//
+// A VertexLayout lists VertexAttributes, each a semantic plus the encoding it is
+// stored with. From that single description the layout derives its stride, a packed
+// Vertex type, the code that encodes a VertexSource into it, and a table of elements
+// from which InputLayout.h builds the matching D3D12_INPUT_ELEMENT_DESC array:
+//
+//     using ColorVertexLayout = VertexLayout<
+//         VertexAttribute<VertexSemantic::Position, VertexEncoding::Float32x3>,
+//         VertexAttribute<VertexSemantic::Color, VertexEncoding::Unorm8x4>>;
+//
+// All encodings except Octahedral16 are expanded by the input assembler, so shaders
+// keep reading float3/float4 inputs.
+
+enum class VertexSemantic
+{
+	Position,
+	Normal,
+	Tangent,
+	TexCoord,
+	Color,
+};
+
+enum class VertexEncoding
+{
+	Float32x2,
+	Float32x3,
+	Float32x4,
+
+	// Half floats; vectors with three components are stored with w.
+	Float16x2,
+	Float16x4,
+
+	// Unit vectors, components in [-1, 1].
+	Snorm16x4,
+
+	// Unit vector folded onto an octahedron and stored as two snorm16s. The shader
+	// unfolds it:
+	//     float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	//     if (n.z < 0.0f) n.xy = (1.0f - abs(n.yx)) * (n.xy >= 0.0f ? 1.0f : -1.0f);
+	//     n = normalize(n);
+	Octahedral16,
+
+	// RGBA8 colors.
+	Unorm8x4,
+};
+
+// Every attribute a layout can pick from, in full precision.
+struct VertexSource
+{
+	DirectX::XMFLOAT3 Position{};
+	DirectX::XMFLOAT3 Normal{};
+	DirectX::XMFLOAT3 Tangent{};
+	DirectX::XMFLOAT2 TexCoord{};
+	DirectX::XMFLOAT4 Color{ 1.0f, 1.0f, 1.0f, 1.0f };
+
+	static VertexSource FromMeshVertex(const GeometryGenerator::Vertex& vertex, const DirectX::XMFLOAT4& color = { 1.0f, 1.0f, 1.0f, 1.0f }) {
+		return VertexSource{ vertex.Position, vertex.Normal, vertex.TangentU, vertex.TexC, color };
+	}
+};
+
+namespace VertexEncodings
+{
+	constexpr std::uint32_t ByteSize(VertexEncoding encoding) {
+		switch (encoding) {
+		case VertexEncoding::Float32x2: return 8;
+		case VertexEncoding::Float32x3: return 12;
+		case VertexEncoding::Float32x4: return 16;
+		case VertexEncoding::Float16x2: return 4;
+		case VertexEncoding::Float16x4: return 8;
+		case VertexEncoding::Snorm16x4: return 8;
+		case VertexEncoding::Octahedral16: return 4;
+		case VertexEncoding::Unorm8x4: return 4;
+		}
+		return 0;
+	}
+
+	// Source value of a semantic; positions get w = 1, directions w = 0.
+	template<VertexSemantic TSemantic>
+	DirectX::XMVECTOR Load(const VertexSource& source) {
+		using namespace DirectX;
+		if constexpr (TSemantic == VertexSemantic::Position)
+			return XMVectorSetW(XMLoadFloat3(&source.Position), 1.0f);
+		else if constexpr (TSemantic == VertexSemantic::Normal)
+			return XMLoadFloat3(&source.Normal);
+		else if constexpr (TSemantic == VertexSemantic::Tangent)
+			return XMLoadFloat3(&source.Tangent);
+		else if constexpr (TSemantic == VertexSemantic::TexCoord)
+			return XMLoadFloat2(&source.TexCoord);
+		else
+			return XMLoadFloat4(&source.Color);
+	}
+
+	template<VertexEncoding TEncoding>
+	void Store(DirectX::FXMVECTOR value, std::uint8_t* pDestination) {
+		using namespace DirectX;
+		using namespace DirectX::PackedVector;
+
+		if constexpr (TEncoding == VertexEncoding::Float32x2) {
+			XMFLOAT2 encoded;
+			XMStoreFloat2(&encoded, value);
+			std::memcpy(pDestination, &encoded, sizeof(encoded));
+		}
+		else if constexpr (TEncoding == VertexEncoding::Float32x3) {
+			XMFLOAT3 encoded;
+			XMStoreFloat3(&encoded, value);
+			std::memcpy(pDestination, &encoded, sizeof(encoded));
+		}
+		else if constexpr (TEncoding == VertexEncoding::Float32x4) {
+			XMFLOAT4 encoded;
+			XMStoreFloat4(&encoded, value);
+			std::memcpy(pDestination, &encoded, sizeof(encoded));
+		}
+		else if constexpr (TEncoding == VertexEncoding::Float16x2) {
+			XMHALF2 encoded;
+			XMStoreHalf2(&encoded, value);
+			std::memcpy(pDestination, &encoded, sizeof(encoded));
+		}
+		else if constexpr (TEncoding == VertexEncoding::Float16x4) {
+			XMHALF4 encoded;
+			XMStoreHalf4(&encoded, value);
+			std::memcpy(pDestination, &encoded, sizeof(encoded));
+		}
+		else if constexpr (TEncoding == VertexEncoding::Snorm16x4) {
+			XMSHORTN4 encoded;
+			XMStoreShortN4(&encoded, value);
+			std::memcpy(pDestination, &encoded, sizeof(encoded));
+		}
+		else if constexpr (TEncoding == VertexEncoding::Octahedral16) {
+			// Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half
+			// over the upper one.
+			XMFLOAT3 n;
+			XMStoreFloat3(&n, value);
+			float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+			float x = sum > 0.0f ? n.x / sum : 0.0f;
+			float y = sum > 0.0f ? n.y / sum : 0.0f;
+			if (n.z < 0.0f) {
+				float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+				float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+				x = foldedX;
+				y = foldedY;
+			}
+
+			XMSHORTN2 encoded;
+			XMStoreShortN2(&encoded, XMVectorSet(x, y, 0.0f, 0.0f));
+			std::memcpy(pDestination, &encoded, sizeof(encoded));
+		}
+		else if constexpr (TEncoding == VertexEncoding::Unorm8x4) {
+			XMUBYTEN4 encoded;
+			XMStoreUByteN4(&encoded, value);
+			std::memcpy(pDestination, &encoded, sizeof(encoded));
+		}
+	}
+}
+
+template<VertexSemantic TSemantic, VertexEncoding TEncoding, std::uint32_t TSemanticIndex = 0>
+struct VertexAttribute
+{
+	static constexpr VertexSemantic Semantic{ TSemantic };
+	static constexpr VertexEncoding Encoding{ TEncoding };
+	static constexpr std::uint32_t SemanticIndex{ TSemanticIndex };
+	static constexpr std::uint32_t ByteSize{ VertexEncodings::ByteSize(TEncoding) };
+
+	static void Pack(const VertexSource& source, std::uint8_t* pDestination) {
+		VertexEncodings::Store<TEncoding>(VertexEncodings::Load<TSemantic>(source), pDestination);
+	}
+};
+
+// An attribute of a layout, with its byte offset in the vertex.
+struct VertexElement
+{
+	VertexSemantic Semantic{};
+	VertexEncoding Encoding{};
+	std::uint32_t SemanticIndex{};
+	std::uint32_t ByteOffset{};
+};
+
+template<typename... TAttributes>
+class VertexLayout
+{
+public:
+	static constexpr std::uint32_t AttributeCount{ sizeof...(TAttributes) };
+	static constexpr std::uint32_t Stride{ (TAttributes::ByteSize + ...) };
+
+	// One vertex: the attributes back to back, in the order they are listed.
+	struct Vertex
+	{
+		std::uint8_t Data[Stride];
+	};
+
+	static_assert(sizeof(Vertex) == Stride);
+
+	static void Pack(const VertexSource& source, Vertex& vertex) {
+		std::uint8_t* pDestination = vertex.Data;
+		((TAttributes::Pack(source, pDestination), pDestination += TAttributes::ByteSize), ...);
+	}
+
+	static Vertex Pack(const VertexSource& source) {
+		Vertex vertex;
+		Pack(source, vertex);
+		return vertex;
+	}
+
+	static constexpr std::array<VertexElement, AttributeCount> Elements() {
+		std::array<VertexElement, AttributeCount> elements{};
+		size_t i = 0;
+		std::uint32_t offset = 0;
+		((elements[i++] = VertexElement{ TAttributes::Semantic, TAttributes::Encoding, TAttributes::SemanticIndex, offset },
+			offset += TAttributes::ByteSize), ...);
+		return elements;
+	}
+};
+
+// Position and RGBA8 color, 16 bytes; what the color shaders of the apps consume.
+using ColorVertexLayout = VertexLayout<
+	VertexAttribute<VertexSemantic::Position, VertexEncoding::Float32x3>,
+	VertexAttribute<VertexSemantic::Color, VertexEncoding::Unorm8x4>>;
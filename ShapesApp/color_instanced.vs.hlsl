@@ -0,0 +1,27 @@
+#include "color.hlsli"
+
+// color.vs.hlsl for instanced draws: the world transform comes from the instance
+// buffer instead of cbPerObject.
+struct InstanceData
+{
+    float4x4 World;
+};
+
+StructuredBuffer<InstanceData> gInstances : register(t0);
+
+cbuffer cbInstances : register(b2)
+{
+    uint gFirstInstance;
+};
+
+VertexOut main(VertexIn vin, uint instanceID : SV_InstanceID)
+{
+    VertexOut vout;
+    
+    // Transform to homogenous clip space
+    float4 pos = mul(float4(vin.Pos, 1.0f), gInstances[gFirstInstance + instanceID].World);
+    vout.Pos = mul(pos, gViewProj);
+    
+    vout.Color = vin.Color;
+    return vout;
+};
\ No newline at end of file
@@ -0,0 +1,99 @@
+// Compacts the visible items into ExecuteIndirect commands and their count.
+// IndirectDrawBuilder::Build is the CPU reference of this shader; both write the same
+// commands in item order.
+#define GROUP_SIZE 256
+
+struct DrawItem
+{
+    uint IndexCount;
+    uint StartIndexLocation;
+    int BaseVertexLocation;
+    uint RootConstant;
+};
+
+// A root constant followed by D3D12_DRAW_INDEXED_ARGUMENTS.
+struct DrawCommand
+{
+    uint RootConstant;
+    uint IndexCountPerInstance;
+    uint InstanceCount;
+    uint StartIndexLocation;
+    int BaseVertexLocation;
+    uint StartInstanceLocation;
+};
+
+cbuffer cbBuild : register(b0)
+{
+    uint gItemCount;
+};
+
+StructuredBuffer<DrawItem> gItems : register(t0);
+StructuredBuffer<uint> gVisibility : register(t1);
+
+RWStructuredBuffer<DrawCommand> gCommands : register(u0);
+RWStructuredBuffer<uint> gCommandCount : register(u1);
+
+// Ping-pong buffers of the scan.
+groupshared uint gsSums[2][GROUP_SIZE];
+
+// Dispatched as a single group, which walks the visibility words GROUP_SIZE at a time.
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint thread : SV_GroupIndex)
+{
+    uint wordCount = (gItemCount + 31) / 32;
+    uint commandCount = 0;
+
+    for (uint first = 0; first < wordCount; first += GROUP_SIZE)
+    {
+        // Load a word and drop the bits past the last item.
+        uint wordIndex = first + thread;
+        uint word = 0;
+        if (wordIndex < wordCount)
+        {
+            word = gVisibility[wordIndex];
+            uint itemsLeft = gItemCount - wordIndex * 32;
+            if (itemsLeft < 32)
+                word &= (1u << itemsLeft) - 1;
+        }
+
+        // Inclusive scan of the visible counts.
+        uint visible = countbits(word);
+        uint buffer = 0;
+        gsSums[0][thread] = visible;
+        GroupMemoryBarrierWithGroupSync();
+
+        [unroll]
+        for (uint stride = 1; stride < GROUP_SIZE; stride *= 2)
+        {
+            uint sum = gsSums[buffer][thread];
+            if (thread >= stride)
+                sum += gsSums[buffer][thread - stride];
+            buffer ^= 1;
+            gsSums[buffer][thread] = sum;
+            GroupMemoryBarrierWithGroupSync();
+        }
+
+        uint offset = commandCount + gsSums[buffer][thread] - visible;
+        for (; word != 0; word &= word - 1)
+        {
+            DrawItem item = gItems[wordIndex * 32 + firstbitlow(word)];
+
+            DrawCommand command;
+            command.RootConstant = item.RootConstant;
+            command.IndexCountPerInstance = item.IndexCount;
+            command.InstanceCount = 1;
+            command.StartIndexLocation = item.StartIndexLocation;
+            command.BaseVertexLocation = item.BaseVertexLocation;
+            command.StartInstanceLocation = 0;
+            gCommands[offset++] = command;
+        }
+
+        commandCount += gsSums[buffer][GROUP_SIZE - 1];
+
+        // The next words' scan overwrites the sums read above.
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (thread == 0)
+        gCommandCount[0] = commandCount;
+}
@@ -1,12 +1,32 @@
 #include "FrameResource.h"
 
 
-FrameResource::FrameResource(ID3D12Device* pDevice, UINT passCount, UINT objectCount) {
+FrameResource::FrameResource(ID3D12Device* pDevice, UINT passCount, UINT objectCount, UINT commandListCount) {
 	THROW_IF_FAILED(pDevice->CreateCommandAllocator(
 		D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())
 	));
 
+	CommandAllocators.resize(commandListCount);
+	CommandLists.resize(commandListCount);
+	for (UINT i = 0; i < commandListCount; ++i) {
+		THROW_IF_FAILED(pDevice->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(CommandAllocators[i].GetAddressOf())
+		));
+		THROW_IF_FAILED(pDevice->CreateCommandList(
+			0,
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			CommandAllocators[i].Get(),
+			nullptr,
+			IID_PPV_ARGS(CommandLists[i].GetAddressOf())
+		));
+		THROW_IF_FAILED(CommandLists[i]->Close());
+	}
+
 	PassCBuffer = std::make_unique<UploadBuffer<PassConstants>>(pDevice, passCount, true);
 	ObjectCBuffer = std::make_unique<UploadBuffer<ObjectConstants>>(pDevice, objectCount, true);
+	InstanceBuffer = std::make_unique<UploadBuffer<InstanceData>>(pDevice, 2 * objectCount, false);
+	IndirectItemBuffer = std::make_unique<UploadBuffer<IndirectDrawItem>>(pDevice, objectCount, false);
+	VisibilityBuffer = std::make_unique<UploadBuffer<std::uint32_t>>(pDevice, IndirectDrawBuilder::VisibilityWordCount(objectCount), false);
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 #include <memory>
+#include <vector>
 
 #include "DxUtil.h"
+#include "IndirectDrawBuilder.h"
 #include "UploadBuffer.h"  
 #include "MathHelper.h"
 
@@ -27,17 +29,37 @@ struct ObjectConstants
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 };
 
+// Element of the structured buffer instanced draws read their transforms from.
+struct InstanceData
+{
+    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+};
+
 struct FrameResource
 {
-	FrameResource(ID3D12Device* pDevice, UINT passCount, UINT objectCount);
+	FrameResource(ID3D12Device* pDevice, UINT passCount, UINT objectCount, UINT commandListCount = 1);
 	~FrameResource() {};
 
 	FrameResource(const FrameResource& rhs) = delete;
 	FrameResource& operator&(const FrameResource& rhs) = delete;
 
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc{};
+
+	// Lists draws are recorded onto in parallel, each with its own allocator as an
+	// allocator may only be used by one thread at a time. Created closed.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> CommandAllocators{};
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> CommandLists{};
 	std::unique_ptr<UploadBuffer<PassConstants>> PassCBuffer{};
 	std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCBuffer{};
 
+	// The first objectCount elements hold every object's transform, by object index,
+	// for indirect draws; the instanced draws of a frame write theirs after them.
+	std::unique_ptr<UploadBuffer<InstanceData>> InstanceBuffer{};
+
+	// What the indirect argument builder reads: every object's draw arguments and
+	// whether it is visible this frame.
+	std::unique_ptr<UploadBuffer<IndirectDrawItem>> IndirectItemBuffer{};
+	std::unique_ptr<UploadBuffer<std::uint32_t>> VisibilityBuffer{};
+
 	UINT64 Fence{};
 };
\ No newline at end of file
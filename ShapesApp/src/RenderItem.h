@@ -17,5 +17,10 @@ struct RenderItem
 	UINT IndexCount{};
 	UINT StartIndexLocation{};
 	int BaseVertexLocation{};
+
+	// Submesh the draw arguments come from. When it has levels of detail, IndexCount and
+	// StartIndexLocation are reselected every frame.
+	const SubMeshGeometry* pSubMesh{};
+	UINT Lod{};
 };
 
@@ -1,15 +1,34 @@
   #include "ShapesApp.h"
 
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cstddef>
 #include <DirectXColors.h>
 #include <d3dcompiler.h>
 
 #include "GeometryGenerator.h"
+#include "JobSystem.h"
+#include "MeshBounds.h"
+#include "MeshFile.h"
 #include "MeshGeometry.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
 
+namespace
+{
+	// Pipeline state ids of the draw queue keys.
+	const std::uint32_t SinglePipelineState{ 0 };
+	const std::uint32_t InstancedPipelineState{ 1 };
+
+	// The command signature reads IndirectDrawCommands straight out of the builder's buffer.
+	static_assert(sizeof(DrawIndexedArguments) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+	static_assert(offsetof(IndirectDrawCommand, Arguments) == sizeof(UINT));
+}
+
 ShapeApp::ShapeApp(HINSTANCE hInstance)
 	: App(hInstance) 
 {
@@ -31,6 +50,7 @@ bool ShapeApp::Initialize() {
 	BuildInputLayout();
 	BuildShapeGeometry();
 	BuildRenderItems();
+	BuildIndirectDrawResources();
 	BuildFrameResources();
 	BuildDescriptorHeaps();
 	BuildConstantBufferViews();
@@ -43,6 +63,7 @@ bool ShapeApp::Initialize() {
 
 	// Wait until initialization is complete
 	FlushCommandQueue();
+	_pGeometryPool->ReleaseTransientResources();
 
 	return true;
 }
@@ -61,11 +82,15 @@ void ShapeApp::OnResize() {
 		nearPlane, farPlane);
 
 	XMStoreFloat4x4(&_projection, projection);
+
+	_lodPixelScale = ScreenSpaceErrorScale(XM_PIDIV4, (float)_clientHeight);
 }
 
 void ShapeApp::Update(const GameTimer& gt) {
 	OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	UpdateLods();
+	CullRenderItems();
 
 	// Cycle through the circular frame resource array.
 	_currentFrameResourceIndex = (_currentFrameResourceIndex + 1) % RenderItem::NrFrameResources;
@@ -82,6 +107,7 @@ void ShapeApp::Update(const GameTimer& gt) {
 
 	UpdateObjectCBs(gt);
 	UpdateMainPassCB(gt);
+	if (_isIndirect) UpdateIndirectDrawInputs();
 }
 
 void ShapeApp::Draw(const GameTimer& /*timer*/) {
@@ -91,68 +117,81 @@ void ShapeApp::Draw(const GameTimer& /*timer*/) {
 	// We can only reset when the associated command lists have finished execution on the GPU.
 	THROW_IF_FAILED(pCommandListAllocator->Reset());
 
-	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
-	// Reusing the command list reuses memory.
-	if (_isWireframe) {
-		THROW_IF_FAILED(_pCommandList->Reset(pCommandListAllocator.Get(), _pipelineStateObjects["opaque_wireframe"].Get()));
+	if (_isIndirect) {
+		// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
+		// Reusing the command list reuses memory.
+		THROW_IF_FAILED(_pCommandList->Reset(pCommandListAllocator.Get(), nullptr));
+
+		RecordClear(_pCommandList.Get());
+		BindFrameState(_pCommandList.Get());
+		DrawRenderItemsIndirect(_pCommandList.Get());
+		RecordPresentBarrier(_pCommandList.Get());
+
+		// Done recording commands.
+		THROW_IF_FAILED(_pCommandList->Close());
+
+		// Add the command list to the queue for execution.
+		ID3D12CommandList* cmdsLists[] = { _pCommandList.Get() };
+		_pCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 	}
 	else {
-		THROW_IF_FAILED(_pCommandList->Reset(pCommandListAllocator.Get(), _pipelineStateObjects["opaque"].Get()));
+		// Records on the frame resource's lists in parallel and executes them.
+		DrawRenderItems(_drawQueue);
 	}
 
-	// Set the viewport and scissor rect. This needs to be reset whenever the command list is reset.
-	_pCommandList->RSSetViewports(1, &_screenViewport);
-	_pCommandList->RSSetScissorRects(1, &_scissorRect);
+	// swap the back and front buffers
+	THROW_IF_FAILED(_pSwapChain->Present(0, 0));
+	_currentBackBuffer = (_currentBackBuffer + 1) % _swapChainBufferCount;
+
+	// Advance the fence value to mark commands up to this fence point.
+	_pCurrentFrameResource->Fence = ++_currentFence;
+
+	// Add an instruction to the command queue to set a new fence point. 
+	// Because we are on the GPU timeline, the new fence point won't be 
+	// set until the GPU finishes processing all the commands prior to this Signal().
+	_pCommandQueue->Signal(_pFence.Get(), _currentFence);
+}
 
+void ShapeApp::RecordClear(ID3D12GraphicsCommandList* pCommandList) {
 	// Indicate a state transition on the resource usage.
-	auto barrier1 = CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+	auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-	_pCommandList->ResourceBarrier(1, &barrier1);
+	pCommandList->ResourceBarrier(1, &barrier);
 
 	// Clear the back buffer and depth buffer.
-	_pCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
-	_pCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	pCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
+	pCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+}
+
+void ShapeApp::BindFrameState(ID3D12GraphicsCommandList* pCommandList) {
+	// Set the viewport and scissor rect. This needs to be reset whenever the command list is reset.
+	pCommandList->RSSetViewports(1, &_screenViewport);
+	pCommandList->RSSetScissorRects(1, &_scissorRect);
 
 	// Specify the buffers we are going to render to.
 	auto currentBackBufferView = CurrentBackBufferView();
 	auto depthStencilView = DepthStencilView();
 	// OM = Output Merger stage
-	_pCommandList->OMSetRenderTargets(1, &currentBackBufferView, true, &depthStencilView);
+	pCommandList->OMSetRenderTargets(1, &currentBackBufferView, true, &depthStencilView);
 
 	ID3D12DescriptorHeap* descriptorHeaps[] = { _pCbvHeap.Get() };
-	_pCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-	_pCommandList->SetGraphicsRootSignature(_pRootSignature.Get());
+	pCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	pCommandList->SetGraphicsRootSignature(_pRootSignature.Get());
 
 	int passCbvIndex = _passCbvOffset + _currentFrameResourceIndex;
 	auto passCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(_pCbvHeap->GetGPUDescriptorHandleForHeapStart());
 	passCbvHandle.Offset(passCbvIndex, _cbvSrvUavDescriptorSize);
-	_pCommandList->SetGraphicsRootDescriptorTable(1, passCbvHandle);
+	pCommandList->SetGraphicsRootDescriptorTable(1, passCbvHandle);
 
-	DrawRenderItems(_pCommandList.Get(), _opaqueRenderItems);
+	auto pInstanceBuffer = _pCurrentFrameResource->InstanceBuffer->Resource();
+	pCommandList->SetGraphicsRootShaderResourceView(3, pInstanceBuffer->GetGPUVirtualAddress());
+}
 
+void ShapeApp::RecordPresentBarrier(ID3D12GraphicsCommandList* pCommandList) {
 	// Indicate a state transition on the resource usage.
-	auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+	auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-	_pCommandList->ResourceBarrier(1, &barrier2);
-
-	// Done recording commands.
-	THROW_IF_FAILED(_pCommandList->Close());
-
-	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { _pCommandList.Get() };
-	_pCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
-
-	// swap the back and front buffers
-	THROW_IF_FAILED(_pSwapChain->Present(0, 0));
-	_currentBackBuffer = (_currentBackBuffer + 1) % _swapChainBufferCount;
-
-	// Advance the fence value to mark commands up to this fence point.
-	_pCurrentFrameResource->Fence = ++_currentFence;
-
-	// Add an instruction to the command queue to set a new fence point. 
-	// Because we are on the GPU timeline, the new fence point won't be 
-	// set until the GPU finishes processing all the commands prior to this Signal().
-	_pCommandQueue->Signal(_pFence.Get(), _currentFence);
+	pCommandList->ResourceBarrier(1, &barrier);
 }
 
 void ShapeApp::OnMouseDown(WPARAM /*btnState*/, int x, int y) {
@@ -193,12 +232,32 @@ void ShapeApp::OnMouseMove(WPARAM btnState, int x, int y) {
 	_lastMousePosition.y = y;
 }
 
+std::wstring ShapeApp::FrameStatsText() const {
+	std::wstring text = L"   visible: " + std::to_wstring(_cullStatistics.ItemCount) + L"/" + std::to_wstring(_sceneBvh.ItemCount()) +
+		L"   nodes: " + std::to_wstring(_cullStatistics.VisitedNodeCount) +
+		L"   occluded: " + std::to_wstring(_occludedCount);
+	if (_isIndirect)
+		return text + L"   indirect draws: " + std::to_wstring(_visibleItemIndices.size());
+
+	return text +
+		L"   state changes: " + std::to_wstring(_drawStatistics.StateChanges()) +
+		L" (saved " + std::to_wstring(_drawStatistics.SavedStateChanges) + L")" +
+		L"   draws: " + std::to_wstring(_drawStatistics.DrawCount) + L"/" + std::to_wstring(_drawStatistics.PacketCount) +
+		L"   lists: " + std::to_wstring(_commandRecorder.Chunks().size());
+}
+
 void ShapeApp::OnKeyboardInput(const GameTimer& gt) {
 	// Check if most significant bit is set
 	if (GetAsyncKeyState(VK_TAB) & 0x8000)
 		_isWireframe = true;
 	else
 		_isWireframe = false;
+
+	// Toggle between indirect and CPU recorded draws on key press.
+	bool isIndirectKeyDown = (GetAsyncKeyState('I') & 0x8000) != 0;
+	if (isIndirectKeyDown and not _wasIndirectKeyDown)
+		_isIndirect = not _isIndirect;
+	_wasIndirectKeyDown = isIndirectKeyDown;
 }
 
 void ShapeApp::UpdateCamera(const GameTimer& gt) {
@@ -216,9 +275,95 @@ void ShapeApp::UpdateCamera(const GameTimer& gt) {
 	XMStoreFloat4x4(&_view, view);
 }
 
+void ShapeApp::UpdateLods() {
+	XMVECTOR eyePosition = XMLoadFloat3(&_eyePos);
+
+	for (auto& pItem : _renderItems) {
+		if (not pItem->pSubMesh or pItem->pSubMesh->Lods.empty()) continue;
+
+		// Project the level errors with the object's largest scale at its origin.
+		XMMATRIX world = XMLoadFloat4x4(&pItem->World);
+		float scale = std::max({
+			XMVectorGetX(XMVector3Length(world.r[0])),
+			XMVectorGetX(XMVector3Length(world.r[1])),
+			XMVectorGetX(XMVector3Length(world.r[2])) });
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(world.r[3], eyePosition)));
+
+		UINT level = pItem->pSubMesh->SelectLod(std::max(distance, 1.0f), _lodPixelScale * scale, _maxLodPixelError);
+		SubMeshLod lod = pItem->pSubMesh->Lod(level);
+		pItem->IndexCount = lod.IndexCount;
+		pItem->StartIndexLocation = lod.StartIndexLocation;
+		pItem->Lod = level;
+	}
+}
+
+void ShapeApp::CullRenderItems() {
+	// An item whose World changed is dirty for every frame resource until its
+	// constant buffers are rewritten; move its bounds the first time around.
+	for (std::uint32_t i = 0; i < _opaqueRenderItems.size(); ++i) {
+		const RenderItem* pItem = _opaqueRenderItems[i];
+		if (pItem->NrFramesDirty == RenderItem::NrFrameResources) {
+			_worldBoxes[i] = MeshBounds::Transform(pItem->pSubMesh->BoundingBox, pItem->World);
+			_sceneBvh.Update(i, _worldBoxes[i]);
+		}
+	}
+
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&_view), XMLoadFloat4x4(&_projection)));
+	_cullStatistics = _sceneBvh.QueryFrustum(viewProj, _visibleItemIndices);
+
+	_occlusionCuller.BeginFrame(viewProj);
+	_occluderCandidates.clear();
+	for (std::uint32_t i : _visibleItemIndices) {
+		if (_occluderMeshes.contains(_opaqueRenderItems[i]->pSubMesh))
+			_occluderCandidates.push_back(i);
+	}
+	_occlusionCuller.SelectOccluders(_worldBoxes, _occluderCandidates, MaxOccluderCount, _occluderIndices);
+	for (std::uint32_t i : _occluderIndices) {
+		const RenderItem* pItem = _opaqueRenderItems[i];
+		const OccluderMesh& occluder = _occluderMeshes.at(pItem->pSubMesh);
+		_occlusionCuller.RenderOccluder(occluder.Positions, occluder.Indices, pItem->World);
+	}
+	_occlusionCuller.BuildHiZ();
+
+	size_t frustumVisibleCount = _visibleItemIndices.size();
+	std::erase_if(_visibleItemIndices, [this](std::uint32_t i) { return _occlusionCuller.IsOccluded(_worldBoxes[i]); });
+	_occludedCount = (std::uint32_t)(frustumVisibleCount - _visibleItemIndices.size());
+
+	// Indirect draws leave the sorting and batching to the GPU's command order.
+	if (_isIndirect) {
+		_indirectDrawBuilder.SetVisibleItems((std::uint32_t)_opaqueRenderItems.size(), _visibleItemIndices);
+		return;
+	}
+
+	auto meshId = [this](const RenderItem* pItem) { return _subMeshIds.at(pItem->pSubMesh) + pItem->Lod; };
+
+	std::fill(_meshDrawCounts.begin(), _meshDrawCounts.end(), 0u);
+	for (std::uint32_t i : _visibleItemIndices)
+		_meshDrawCounts[meshId(_opaqueRenderItems[i])]++;
+
+	// Opaque draws go front to back.
+	XMMATRIX view = XMLoadFloat4x4(&_view);
+	_drawQueue.Clear();
+	for (std::uint32_t i : _visibleItemIndices) {
+		const RenderItem* pItem = _opaqueRenderItems[i];
+		std::uint32_t mesh = meshId(pItem);
+		std::uint32_t pipelineState = _meshDrawCounts[mesh] > 1 ? InstancedPipelineState : SinglePipelineState;
+		std::uint32_t geometry = _geometryIds.at(pItem->pMeshGeometry);
+		float viewDepth = XMVectorGetZ(XMVector3Transform(XMLoadFloat3(&_worldBoxes[i].Center), view));
+		_drawQueue.Add(DrawQueue::MakeKey(pipelineState, geometry, (std::uint32_t)pItem->PrimitiveType, mesh, viewDepth), i);
+	}
+	_drawQueue.Sort();
+}
+
 void ShapeApp::UpdateObjectCBs(const GameTimer& gt) {
 	auto currObjectCB = _pCurrentFrameResource->ObjectCBuffer.get();
-	for (auto& pItem : _renderItems) {
+	auto currInstanceBuffer = _pCurrentFrameResource->InstanceBuffer.get();
+
+	// Every item writes its own constant buffer slot, so items can be updated in parallel.
+	JobSystem::Default().ParallelFor(0, _renderItems.size(), 256, [&](size_t i) {
+		auto& pItem = _renderItems[i];
+
 		// Only update the cbuffer data if the constants have changed.  
 		// This needs to be tracked per frame resource.
 		if (pItem->NrFramesDirty > 0) {
@@ -228,10 +373,11 @@ void ShapeApp::UpdateObjectCBs(const GameTimer& gt) {
 			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
 
 			currObjectCB->CopyData(pItem->ObjectCBufferIndex, objConstants);
+			currInstanceBuffer->CopyData(pItem->ObjectCBufferIndex, InstanceData{ .World = objConstants.World });
 
 			pItem->NrFramesDirty--;
 		}
-	}
+	});
 }
 
 void ShapeApp::UpdateMainPassCB(const GameTimer& gt) {
@@ -265,6 +411,23 @@ void ShapeApp::UpdateMainPassCB(const GameTimer& gt) {
 	currPassCB->CopyData(0, _mainPassCB);
 }
 
+void ShapeApp::UpdateIndirectDrawInputs() {
+	// Every item's arguments, as levels of detail change them; written in order, since
+	// the upload heap is write combined.
+	std::span<IndirectDrawItem> items = _pCurrentFrameResource->IndirectItemBuffer->Elements();
+	for (size_t i = 0; i < _opaqueRenderItems.size(); ++i) {
+		const RenderItem* pItem = _opaqueRenderItems[i];
+		items[i] = {
+			.IndexCount = pItem->IndexCount,
+			.StartIndexLocation = pItem->StartIndexLocation,
+			.BaseVertexLocation = pItem->BaseVertexLocation,
+			.RootConstant = pItem->ObjectCBufferIndex,
+		};
+	}
+
+	_pCurrentFrameResource->VisibilityBuffer->CopyRange(0, _indirectDrawBuilder.Visibility());
+}
+
 void ShapeApp::BuildDescriptorHeaps() {
 	UINT objCount = (UINT)_opaqueRenderItems.size();
 
@@ -343,14 +506,18 @@ void ShapeApp::BuildRootSignature() {
 	cbvTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1);
 
 	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[2]{};
+	CD3DX12_ROOT_PARAMETER slotRootParameter[4]{};
 
 	// Create root CBVs.
 	slotRootParameter[0].InitAsDescriptorTable(1, &cbvTable0);
 	slotRootParameter[1].InitAsDescriptorTable(1, &cbvTable1);
 
+	// Instanced draws: the first instance's index in the instance buffer, and the buffer.
+	slotRootParameter[2].InitAsConstants(1, 2);
+	slotRootParameter[3].InitAsShaderResourceView(0);
+
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(2, slotRootParameter, 0, nullptr,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(4, slotRootParameter, 0, nullptr,
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 	// create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
@@ -371,150 +538,86 @@ void ShapeApp::BuildRootSignature() {
 
 void ShapeApp::BuildShaders() {
 	_shaders["standardVS"] = DxUtil::LoadBinary(L"color.vs.cso");
+	_shaders["instancedVS"] = DxUtil::LoadBinary(L"color_instanced.vs.cso");
 	_shaders["opaquePS"] = DxUtil::LoadBinary(L"color.ps.cso");
+	_shaders["indirectBuildCS"] = DxUtil::LoadBinary(L"indirect_build.cs.cso");
 }
 
 void ShapeApp::BuildInputLayout() {
-	D3D12_INPUT_ELEMENT_DESC positionDesc{
-		.SemanticName = "Position",
-		.SemanticIndex = 0,
-		.Format = DXGI_FORMAT_R32G32B32_FLOAT,
-		.InputSlot = 0,
-		.AlignedByteOffset = 0,
-		.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-		.InstanceDataStepRate = 0,
-	};
-
-	D3D12_INPUT_ELEMENT_DESC elementDesc{
-	.SemanticName = "Color",
-	.SemanticIndex = 0,
-	.Format = DXGI_FORMAT_R32G32B32A32_FLOAT,
-	.InputSlot = 0,
-	.AlignedByteOffset = 12,
-	.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-	.InstanceDataStepRate = 0,
-	};
-
-	_inputLayout = { positionDesc , elementDesc };
+	auto inputElements = InputLayout::Elements<ColorVertexLayout>();
+	_inputLayout.assign(inputElements.begin(), inputElements.end());
 }
 
 void ShapeApp::BuildShapeGeometry() {
+	// Everything the generated geometry depends on. Bump the version string whenever
+	// the generation code below changes in a way the parameters do not capture.
+	struct ShapeParameters
+	{
+		float BoxWidth = 1.5f, BoxHeight = 0.5f, BoxDepth = 1.5f;
+		std::uint32_t BoxSubdivisions = 3;
+		float GridWidth = 20.0f, GridDepth = 30.0f;
+		std::uint32_t GridRows = 60, GridColumns = 40;
+		float SphereRadius = 0.5f;
+		std::uint32_t SphereSlices = 20, SphereStacks = 20;
+		float CylinderBottomRadius = 0.5f, CylinderTopRadius = 0.3f, CylinderHeight = 3.0f;
+		std::uint32_t CylinderSlices = 20, CylinderStacks = 20;
+		std::uint32_t LodCount = 4;
+	} parameters;
+
+	std::uint64_t contentHash = MeshFile::ContentHash{}
+		.Add("ShapeApp::BuildShapeGeometry v1")
+		.Add(parameters)
+		.AddVertexLayout<ColorVertexLayout>()
+		.Value();
+
+	MeshFile::Image image = MeshFile::Image::LoadOrBuild("MeshCache", "shapeGeo", contentHash, [&] {
+		GeometryGenerator geometryGenerator{};
+		GeometryGenerator::MeshData box = geometryGenerator.CreateBox(
+			parameters.BoxWidth, parameters.BoxHeight, parameters.BoxDepth, parameters.BoxSubdivisions);
+		GeometryGenerator::MeshData grid = geometryGenerator.CreateGrid(
+			parameters.GridWidth, parameters.GridDepth, parameters.GridRows, parameters.GridColumns);
+		GeometryGenerator::MeshData sphere = geometryGenerator.CreateSphere(
+			parameters.SphereRadius, parameters.SphereSlices, parameters.SphereStacks);
+		GeometryGenerator::MeshData cylinder = geometryGenerator.CreateCylinder(parameters.CylinderBottomRadius,
+			parameters.CylinderTopRadius, parameters.CylinderHeight, parameters.CylinderSlices, parameters.CylinderStacks);
+
+		// Reorder for the post-transform vertex cache.
+		for (GeometryGenerator::MeshData* pMesh : { &box, &grid, &sphere, &cylinder })
+			MeshOptimizer::Optimize(*pMesh);
+
+		// Coarser levels of detail are appended to the index lists and share the vertices.
+		auto boxLods = MeshSimplifier::AppendLodChain(box, parameters.LodCount);
+		auto sphereLods = MeshSimplifier::AppendLodChain(sphere, parameters.LodCount);
+		auto cylinderLods = MeshSimplifier::AppendLodChain(cylinder, parameters.LodCount);
+
+		auto colored = [](const XMVECTORF32& color) {
+			return [color](const GeometryGenerator::Vertex& vertex) {
+				return VertexSource{ .Position = vertex.Position, .Color = XMFLOAT4(color) };
+			};
+		};
 
-	GeometryGenerator geometryGenerator{};
-	GeometryGenerator::MeshData box = geometryGenerator.CreateBox(1.5f, 0.5f, 1.5f, 3);
-	GeometryGenerator::MeshData grid = geometryGenerator.CreateGrid(20.0f, 30.0f, 60, 40);
-	GeometryGenerator::MeshData sphere = geometryGenerator.CreateSphere(0.5f, 20, 20);
-	GeometryGenerator::MeshData cylinder = geometryGenerator.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-
-	//
-	// We are concatenating all the geometry into one big vertex/index buffer.  So
-	// define the regions in the buffer each submesh covers.
-	//
-
-	// Cache the vertex offsets to each object in the concatenated vertex buffer.
-	UINT boxVertexOffset = 0;
-	UINT gridVertexOffset = (UINT)box.Vertices.size();
-	UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-	UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
-
-	// Cache the starting index for each object in the concatenated index buffer.
-	UINT boxIndexOffset = 0;
-	UINT gridIndexOffset = (UINT)box.Indices32.size();
-	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-	UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-
-	// Define the SubmeshGeometry that cover different 
-	// regions of the vertex/index buffers.
-
-	SubMeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = boxIndexOffset;
-	boxSubmesh.BaseVertexLocation = boxVertexOffset;
-
-	SubMeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-	gridSubmesh.StartIndexLocation = gridIndexOffset;
-	gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
-	SubMeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-
-	SubMeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
-
-	//
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-	//
-
-	auto totalVertexCount =
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		sphere.Vertices.size() +
-		cylinder.Vertices.size();
-
-	std::vector<Vertex> vertices(totalVertexCount);
-
-	UINT k = 0;
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k) {
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkGreen);
-	}
-
-	for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k) {
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::ForestGreen);
-	}
-
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k) {
-		vertices[k].Pos = sphere.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::Crimson);
-	}
-
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k) {
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
-	}
-
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
-
-	auto pGeometry = std::make_unique<MeshGeometry>();
-	pGeometry->Name = "shapeGeo";
-
-	THROW_IF_FAILED(D3DCreateBlob(vbByteSize, &pGeometry->VertexBufferCpu));
-	CopyMemory(pGeometry->VertexBufferCpu->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	THROW_IF_FAILED(D3DCreateBlob(ibByteSize, &pGeometry->IndexBufferCpu));
-	CopyMemory(pGeometry->IndexBufferCpu->GetBufferPointer(), indices.data(), ibByteSize);
-
-	pGeometry->VertexBufferGpu = DxUtil::CreateDefaultBuffer(_pDevice.Get(),
-		_pCommandList.Get(), vertices.data(), vbByteSize, pGeometry->VertexBufferUploader);
-
-	pGeometry->IndexBufferGpu = DxUtil::CreateDefaultBuffer(_pDevice.Get(),
-		_pCommandList.Get(), indices.data(), ibByteSize, pGeometry->IndexBufferUploader);
-
-	pGeometry->VertexByteStride = sizeof(Vertex);
-	pGeometry->VertexBufferByteSize = vbByteSize;
-	pGeometry->IndexFormat = DXGI_FORMAT_R16_UINT;
-	pGeometry->IndexBufferByteSize = ibByteSize;
-
-	pGeometry->DrawArguments["box"] = boxSubmesh;
-	pGeometry->DrawArguments["grid"] = gridSubmesh;
-	pGeometry->DrawArguments["sphere"] = sphereSubmesh;
-	pGeometry->DrawArguments["cylinder"] = cylinderSubmesh;
-
-	_geometries[pGeometry->Name] = std::move(pGeometry);
+		// All the geometry is concatenated into one big vertex/index buffer, each mesh
+		// being a submesh of it.
+		MeshFile::Contents contents;
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "box", box, boxLods, colored(DirectX::Colors::DarkGreen));
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "grid", grid, {}, colored(DirectX::Colors::ForestGreen));
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "sphere", sphere, sphereLods, colored(DirectX::Colors::Crimson));
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "cylinder", cylinder, cylinderLods, colored(DirectX::Colors::SteelBlue));
+		return contents;
+	});
+
+	// Leave room for meshes streamed in later.
+	const UINT vertexCapacity = std::max(64u * 1024u, 2 * image.GetHeader().VertexCount);
+	const UINT indexCapacity = std::max(256u * 1024u, 2 * image.GetHeader().IndexCount);
+	_pGeometryPool = std::make_unique<GeometryPool>(_pDevice.Get(), "shapeGeo", (UINT)sizeof(Vertex), vertexCapacity, indexCapacity);
+
+	[[maybe_unused]] GeometryPool::BlockId shapes = _pGeometryPool->AddImage(_pCommandList.Get(), image);
+	assert(shapes != GeometryPool::InvalidBlock);
+
+	// The coarser levels of detail collapse onto the full detail vertices, so the full
+	// detail triangles stand in for whichever level is drawn.
+	for (const MeshFile::SubmeshRecord& submesh : image.Submeshes())
+		_occluderMeshes[&_pGeometryPool->Geometry().DrawArguments[submesh.Name]] = OccluderMesh::FromImage(image, submesh.Name);
 }
 
 void ShapeApp::BuildPSOs() {
@@ -570,14 +673,43 @@ void ShapeApp::BuildPSOs() {
 	opaqueWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
 	THROW_IF_FAILED(_pDevice->CreateGraphicsPipelineState(&opaqueWireframePsoDesc, IID_PPV_ARGS(&_pipelineStateObjects["opaque_wireframe"])));
 #pragma endregion Opaque Wireframe
+
+#pragma region Opaque Instanced
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueInstancedPsoDesc = opaquePsoDesc;
+	opaqueInstancedPsoDesc.VS =
+	{
+		.pShaderBytecode = _shaders["instancedVS"]->GetBufferPointer(),
+		.BytecodeLength = _shaders["instancedVS"]->GetBufferSize(),
+	};
+	THROW_IF_FAILED(_pDevice->CreateGraphicsPipelineState(&opaqueInstancedPsoDesc, IID_PPV_ARGS(&_pipelineStateObjects["opaque_instanced"])));
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueInstancedWireframePsoDesc = opaqueInstancedPsoDesc;
+	opaqueInstancedWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+	THROW_IF_FAILED(_pDevice->CreateGraphicsPipelineState(&opaqueInstancedWireframePsoDesc, IID_PPV_ARGS(&_pipelineStateObjects["opaque_instanced_wireframe"])));
+#pragma endregion Opaque Instanced
+
+#pragma region Indirect Build
+	D3D12_COMPUTE_PIPELINE_STATE_DESC indirectBuildPsoDesc{
+		.pRootSignature = _pIndirectBuildRootSignature.Get(),
+		.CS =
+		{
+			.pShaderBytecode = _shaders["indirectBuildCS"]->GetBufferPointer(),
+			.BytecodeLength = _shaders["indirectBuildCS"]->GetBufferSize(),
+		},
+	};
+	THROW_IF_FAILED(_pDevice->CreateComputePipelineState(&indirectBuildPsoDesc, IID_PPV_ARGS(&_pipelineStateObjects["indirect_build"])));
+#pragma endregion Indirect Build
 }
 
 void ShapeApp::BuildFrameResources() {
+	UINT commandListCount = std::min(JobSystem::Default().ThreadCount(), MaxCommandListCount);
+
 	for (int i = 0; i < RenderItem::NrFrameResources; ++i) {
 		_frameResources.push_back(std::make_unique<FrameResource>(
 			_pDevice.Get(),
 			1, 
-			(UINT)_renderItems.size()));
+			(UINT)_renderItems.size(),
+			commandListCount));
 	}
 }
 
@@ -585,21 +717,23 @@ void ShapeApp::BuildRenderItems() {
 	auto boxRitem = std::make_unique<RenderItem>();
 	XMStoreFloat4x4(&boxRitem->World, XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(0.0f, 0.5f, 0.0f));
 	boxRitem->ObjectCBufferIndex = 0;
-	boxRitem->pMeshGeometry = _geometries["shapeGeo"].get();
+	boxRitem->pMeshGeometry = &_pGeometryPool->Geometry();
 	boxRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	boxRitem->IndexCount = boxRitem->pMeshGeometry->DrawArguments["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->pMeshGeometry->DrawArguments["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->pMeshGeometry->DrawArguments["box"].BaseVertexLocation;
+	boxRitem->pSubMesh = &boxRitem->pMeshGeometry->DrawArguments["box"];
 	_renderItems.push_back(std::move(boxRitem));
 
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
 	gridRitem->ObjectCBufferIndex = 1;
-	gridRitem->pMeshGeometry = _geometries["shapeGeo"].get();
+	gridRitem->pMeshGeometry = &_pGeometryPool->Geometry();
 	gridRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	gridRitem->IndexCount = gridRitem->pMeshGeometry->DrawArguments["grid"].IndexCount;
 	gridRitem->StartIndexLocation = gridRitem->pMeshGeometry->DrawArguments["grid"].StartIndexLocation;
 	gridRitem->BaseVertexLocation = gridRitem->pMeshGeometry->DrawArguments["grid"].BaseVertexLocation;
+	gridRitem->pSubMesh = &gridRitem->pMeshGeometry->DrawArguments["grid"];
 	_renderItems.push_back(std::move(gridRitem));
 
 	UINT objCBIndex = 2;
@@ -617,35 +751,39 @@ void ShapeApp::BuildRenderItems() {
 
 		XMStoreFloat4x4(&leftCylRitem->World, rightCylWorld);
 		leftCylRitem->ObjectCBufferIndex = objCBIndex++;
-		leftCylRitem->pMeshGeometry = _geometries["shapeGeo"].get();
+		leftCylRitem->pMeshGeometry = &_pGeometryPool->Geometry();
 		leftCylRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		leftCylRitem->IndexCount = leftCylRitem->pMeshGeometry->DrawArguments["cylinder"].IndexCount;
 		leftCylRitem->StartIndexLocation = leftCylRitem->pMeshGeometry->DrawArguments["cylinder"].StartIndexLocation;
 		leftCylRitem->BaseVertexLocation = leftCylRitem->pMeshGeometry->DrawArguments["cylinder"].BaseVertexLocation;
+		leftCylRitem->pSubMesh = &leftCylRitem->pMeshGeometry->DrawArguments["cylinder"];
 
 		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
 		rightCylRitem->ObjectCBufferIndex = objCBIndex++;
-		rightCylRitem->pMeshGeometry = _geometries["shapeGeo"].get();
+		rightCylRitem->pMeshGeometry = &_pGeometryPool->Geometry();
 		rightCylRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		rightCylRitem->IndexCount = rightCylRitem->pMeshGeometry->DrawArguments["cylinder"].IndexCount;
 		rightCylRitem->StartIndexLocation = rightCylRitem->pMeshGeometry->DrawArguments["cylinder"].StartIndexLocation;
 		rightCylRitem->BaseVertexLocation = rightCylRitem->pMeshGeometry->DrawArguments["cylinder"].BaseVertexLocation;
+		rightCylRitem->pSubMesh = &rightCylRitem->pMeshGeometry->DrawArguments["cylinder"];
 
 		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
 		leftSphereRitem->ObjectCBufferIndex = objCBIndex++;
-		leftSphereRitem->pMeshGeometry = _geometries["shapeGeo"].get();
+		leftSphereRitem->pMeshGeometry = &_pGeometryPool->Geometry();
 		leftSphereRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		leftSphereRitem->IndexCount = leftSphereRitem->pMeshGeometry->DrawArguments["sphere"].IndexCount;
 		leftSphereRitem->StartIndexLocation = leftSphereRitem->pMeshGeometry->DrawArguments["sphere"].StartIndexLocation;
 		leftSphereRitem->BaseVertexLocation = leftSphereRitem->pMeshGeometry->DrawArguments["sphere"].BaseVertexLocation;
+		leftSphereRitem->pSubMesh = &leftSphereRitem->pMeshGeometry->DrawArguments["sphere"];
 
 		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
 		rightSphereRitem->ObjectCBufferIndex = objCBIndex++;
-		rightSphereRitem->pMeshGeometry = _geometries["shapeGeo"].get();
+		rightSphereRitem->pMeshGeometry = &_pGeometryPool->Geometry();
 		rightSphereRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		rightSphereRitem->IndexCount = rightSphereRitem->pMeshGeometry->DrawArguments["sphere"].IndexCount;
 		rightSphereRitem->StartIndexLocation = rightSphereRitem->pMeshGeometry->DrawArguments["sphere"].StartIndexLocation;
 		rightSphereRitem->BaseVertexLocation = rightSphereRitem->pMeshGeometry->DrawArguments["sphere"].BaseVertexLocation;
+		rightSphereRitem->pSubMesh = &rightSphereRitem->pMeshGeometry->DrawArguments["sphere"];
 
 		_renderItems.push_back(std::move(leftCylRitem));
 		_renderItems.push_back(std::move(rightCylRitem));
@@ -656,28 +794,220 @@ void ShapeApp::BuildRenderItems() {
 	// All the render items are opaque.
 	for (auto& e : _renderItems)
 		_opaqueRenderItems.push_back(e.get());
+
+	// Items whose World changes later are refit by CullRenderItems.
+	_worldBoxes.clear();
+	for (const RenderItem* pItem : _opaqueRenderItems)
+		_worldBoxes.push_back(MeshBounds::Transform(pItem->pSubMesh->BoundingBox, pItem->World));
+	_sceneBvh.Build(_worldBoxes);
+
+	std::uint32_t meshCount = 0;
+	for (const RenderItem* pItem : _opaqueRenderItems) {
+		_geometryIds.try_emplace(pItem->pMeshGeometry, (std::uint32_t)_geometryIds.size());
+		if (_subMeshIds.try_emplace(pItem->pSubMesh, meshCount).second)
+			meshCount += pItem->pSubMesh->LodCount();
+	}
+	_meshDrawCounts.resize(meshCount);
 }
 
-void ShapeApp::DrawRenderItems(ID3D12GraphicsCommandList* pCommandList, const std::vector<RenderItem*>& items) {
-	UINT objCBByteSize = DxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+void ShapeApp::BuildIndirectDrawResources() {
+	// A command only sets the root constant and the draw arguments, so every item has
+	// to share the geometry and topology bound before ExecuteIndirect.
+	assert(_geometryIds.size() == 1);
+	assert(std::ranges::all_of(_opaqueRenderItems, [this](const RenderItem* pItem) {
+		return pItem->PrimitiveType == _opaqueRenderItems[0]->PrimitiveType;
+	}));
 
-	// For each render item...
-	for (size_t i = 0; i < items.size(); ++i) {
-		auto ri = items[i];
+	// The builder's item count, its inputs and its outputs.
+	CD3DX12_ROOT_PARAMETER slotRootParameter[5]{};
+	slotRootParameter[0].InitAsConstants(1, 0);
+	slotRootParameter[1].InitAsShaderResourceView(0);
+	slotRootParameter[2].InitAsShaderResourceView(1);
+	slotRootParameter[3].InitAsUnorderedAccessView(0);
+	slotRootParameter[4].InitAsUnorderedAccessView(1);
 
-		auto vBufferView = ri->pMeshGeometry->VertexBufferView();
-		pCommandList->IASetVertexBuffers(0, 1, &vBufferView);
-		auto iBufferView = ri->pMeshGeometry->IndexBufferView();
-		pCommandList->IASetIndexBuffer(&iBufferView);
-		pCommandList->IASetPrimitiveTopology(ri->PrimitiveType);
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(5, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
 
-		// Offset to the CBV in the descriptor heap for this object and for this frame resource.
-		UINT cbvIndex = _currentFrameResourceIndex * (UINT)_opaqueRenderItems.size() + ri->ObjectCBufferIndex;
-		auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(_pCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		cbvHandle.Offset(cbvIndex, _cbvSrvUavDescriptorSize);
+	ComPtr<ID3DBlob> serializedRootSignature{};
+	ComPtr<ID3DBlob> errorBlob{};
+	HRESULT hr = D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+		serializedRootSignature.GetAddressOf(), errorBlob.GetAddressOf());
 
-		pCommandList->SetGraphicsRootDescriptorTable(0, cbvHandle);
+	if (errorBlob) OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	THROW_IF_FAILED(hr);
 
-		pCommandList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
-	}
+	THROW_IF_FAILED(_pDevice->CreateRootSignature(
+		0,
+		serializedRootSignature->GetBufferPointer(),
+		serializedRootSignature->GetBufferSize(),
+		IID_PPV_ARGS(_pIndirectBuildRootSignature.GetAddressOf())));
+
+	// An IndirectDrawCommand: the instanced shader's first instance, then the draw.
+	D3D12_INDIRECT_ARGUMENT_DESC arguments[2]{};
+	arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[0].Constant = { .RootParameterIndex = 2, .DestOffsetIn32BitValues = 0, .Num32BitValuesToSet = 1 };
+	arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc{
+		.ByteStride = sizeof(IndirectDrawCommand),
+		.NumArgumentDescs = _countof(arguments),
+		.pArgumentDescs = arguments,
+	};
+	THROW_IF_FAILED(_pDevice->CreateCommandSignature(&commandSignatureDesc, _pRootSignature.Get(),
+		IID_PPV_ARGS(_pCommandSignature.GetAddressOf())));
+
+	CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+	auto commandBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(
+		_opaqueRenderItems.size() * sizeof(IndirectDrawCommand), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	THROW_IF_FAILED(_pDevice->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &commandBufferDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(_pIndirectCommandBuffer.GetAddressOf())));
+
+	auto countBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(std::uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	THROW_IF_FAILED(_pDevice->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &countBufferDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(_pIndirectCountBuffer.GetAddressOf())));
+}
+
+void ShapeApp::DrawRenderItems(const DrawQueue& drawQueue) {
+	// Binds what DrawQueue::Submit asks for from the render item a packet draws.
+	struct Recorder
+	{
+		ShapeApp& App;
+		ID3D12GraphicsCommandList* pCommandList;
+
+		// The queue's packets. An instanced run writes its transforms at the index of its
+		// first packet, so the lists recorded in parallel never write the same element.
+		const DrawPacket* pFirstPacket;
+
+		void SetPipelineState(const DrawPacket& packet) {
+			bool isInstanced = DrawQueue::PipelineState(packet.SortKey) == InstancedPipelineState;
+			const char* name = isInstanced
+				? (App._isWireframe ? "opaque_instanced_wireframe" : "opaque_instanced")
+				: (App._isWireframe ? "opaque_wireframe" : "opaque");
+			pCommandList->SetPipelineState(App._pipelineStateObjects.at(name).Get());
+		}
+
+		void SetGeometry(const DrawPacket& packet) {
+			const MeshGeometry* pGeometry = App._opaqueRenderItems[packet.Item]->pMeshGeometry;
+			auto vBufferView = pGeometry->VertexBufferView();
+			pCommandList->IASetVertexBuffers(0, 1, &vBufferView);
+			auto iBufferView = pGeometry->IndexBufferView();
+			pCommandList->IASetIndexBuffer(&iBufferView);
+		}
+
+		void SetPrimitiveTopology(const DrawPacket& packet) {
+			pCommandList->IASetPrimitiveTopology(App._opaqueRenderItems[packet.Item]->PrimitiveType);
+		}
+
+		void Draw(std::span<const DrawPacket> packets) {
+			const RenderItem* ri = App._opaqueRenderItems[packets[0].Item];
+
+			if (DrawQueue::PipelineState(packets[0].SortKey) == SinglePipelineState) {
+				// Offset to the CBV in the descriptor heap for this object and for this frame resource.
+				UINT cbvIndex = App._currentFrameResourceIndex * (UINT)App._opaqueRenderItems.size() + ri->ObjectCBufferIndex;
+				auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(App._pCbvHeap->GetGPUDescriptorHandleForHeapStart());
+				cbvHandle.Offset(cbvIndex, App._cbvSrvUavDescriptorSize);
+
+				pCommandList->SetGraphicsRootDescriptorTable(0, cbvHandle);
+
+				pCommandList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+				return;
+			}
+
+			// The packets share their draw arguments; only the transforms differ. They go
+			// after the per object transforms the indirect draws use.
+			auto pInstanceBuffer = App._pCurrentFrameResource->InstanceBuffer.get();
+			UINT firstInstance = (UINT)(App._opaqueRenderItems.size() + (packets.data() - pFirstPacket));
+			for (size_t i = 0; i < packets.size(); ++i) {
+				InstanceData instance{};
+				XMStoreFloat4x4(&instance.World, XMMatrixTranspose(XMLoadFloat4x4(&App._opaqueRenderItems[packets[i].Item]->World)));
+				pInstanceBuffer->CopyData((int)(firstInstance + i), instance);
+			}
+
+			pCommandList->SetGraphicsRoot32BitConstant(2, firstInstance, 0);
+			pCommandList->DrawIndexedInstanced(ri->IndexCount, (UINT)packets.size(), ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
+	};
+
+	// ParallelCommandRecorder backend over the frame resource's lists. The first list
+	// clears the targets; the present barrier goes on _pCommandList, submitted last.
+	struct Backend
+	{
+		ShapeApp& App;
+		std::vector<Recorder> Recorders;
+
+		Recorder& BeginList(std::uint32_t list, DrawQueue::Chunk /*chunk*/) {
+			auto& pAllocator = App._pCurrentFrameResource->CommandAllocators[list];
+			Recorder& recorder = Recorders[list];
+			THROW_IF_FAILED(pAllocator->Reset());
+			THROW_IF_FAILED(recorder.pCommandList->Reset(pAllocator.Get(), nullptr));
+
+			if (list == 0) App.RecordClear(recorder.pCommandList);
+			App.BindFrameState(recorder.pCommandList);
+			return recorder;
+		}
+
+		void EndList(std::uint32_t list) {
+			THROW_IF_FAILED(Recorders[list].pCommandList->Close());
+		}
+
+		void Execute(std::uint32_t listCount) {
+			auto pAllocator = App._pCurrentFrameResource->CmdListAlloc;
+			THROW_IF_FAILED(App._pCommandList->Reset(pAllocator.Get(), nullptr));
+			App.RecordPresentBarrier(App._pCommandList.Get());
+			THROW_IF_FAILED(App._pCommandList->Close());
+
+			std::vector<ID3D12CommandList*> commandLists{};
+			for (std::uint32_t i = 0; i < listCount; ++i)
+				commandLists.push_back(Recorders[i].pCommandList);
+			commandLists.push_back(App._pCommandList.Get());
+			App._pCommandQueue->ExecuteCommandLists((UINT)commandLists.size(), commandLists.data());
+		}
+	};
+
+	Backend backend{ *this };
+	for (auto& pCommandList : _pCurrentFrameResource->CommandLists)
+		backend.Recorders.push_back({ *this, pCommandList.Get(), drawQueue.Packets().data() });
+
+	_drawStatistics = _commandRecorder.Record(drawQueue, backend, (std::uint32_t)backend.Recorders.size(), JobSystem::Default());
+}
+
+void ShapeApp::DrawRenderItemsIndirect(ID3D12GraphicsCommandList* pCommandList) {
+	UINT itemCount = (UINT)_opaqueRenderItems.size();
+
+	// Compact the visible items into commands.
+	pCommandList->SetPipelineState(_pipelineStateObjects["indirect_build"].Get());
+	pCommandList->SetComputeRootSignature(_pIndirectBuildRootSignature.Get());
+	pCommandList->SetComputeRoot32BitConstant(0, itemCount, 0);
+	pCommandList->SetComputeRootShaderResourceView(1, _pCurrentFrameResource->IndirectItemBuffer->Resource()->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootShaderResourceView(2, _pCurrentFrameResource->VisibilityBuffer->Resource()->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(3, _pIndirectCommandBuffer->GetGPUVirtualAddress());
+	pCommandList->SetComputeRootUnorderedAccessView(4, _pIndirectCountBuffer->GetGPUVirtualAddress());
+	pCommandList->Dispatch(1, 1, 1);
+
+	CD3DX12_RESOURCE_BARRIER toArguments[] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(_pIndirectCommandBuffer.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
+		CD3DX12_RESOURCE_BARRIER::Transition(_pIndirectCountBuffer.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
+	};
+	pCommandList->ResourceBarrier(_countof(toArguments), toArguments);
+
+	// The instanced shader finds each item's transform at the index its command sets.
+	const RenderItem* pItem = _opaqueRenderItems[0];
+	pCommandList->SetPipelineState(_pipelineStateObjects[_isWireframe ? "opaque_instanced_wireframe" : "opaque_instanced"].Get());
+	auto vBufferView = pItem->pMeshGeometry->VertexBufferView();
+	pCommandList->IASetVertexBuffers(0, 1, &vBufferView);
+	auto iBufferView = pItem->pMeshGeometry->IndexBufferView();
+	pCommandList->IASetIndexBuffer(&iBufferView);
+	pCommandList->IASetPrimitiveTopology(pItem->PrimitiveType);
+
+	pCommandList->ExecuteIndirect(_pCommandSignature.Get(), itemCount, _pIndirectCommandBuffer.Get(), 0, _pIndirectCountBuffer.Get(), 0);
+
+	CD3DX12_RESOURCE_BARRIER toUnorderedAccess[] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(_pIndirectCommandBuffer.Get(),
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(_pIndirectCountBuffer.Get(),
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+	};
+	pCommandList->ResourceBarrier(_countof(toUnorderedAccess), toUnorderedAccess);
 }
\ No newline at end of file
@@ -5,17 +5,20 @@
 
 #include "RenderItem.h"
 #include "FrameResource.h"
+#include "DrawQueue.h"
 #include "DxUtil.h"
 #include "App.h"
 #include "UploadBuffer.h"
 #include "MathHelper.h"
+#include "GeometryPool.h"
+#include "IndirectDrawBuilder.h"
 #include "MeshGeometry.h"
+#include "OcclusionCuller.h"
+#include "ParallelCommandRecorder.h"
+#include "SceneBvh.h"
+#include "InputLayout.h"
 
-struct Vertex
-{
-	DirectX::XMFLOAT3 Pos;
-	DirectX::XMFLOAT4 Color;
-};
+using Vertex = ColorVertexLayout::Vertex;
 
 class ShapeApp final : public App
 {
@@ -34,10 +37,15 @@ private:
 	virtual void OnMouseUp(WPARAM btnState, int x, int y) override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y) override;
 
+	virtual std::wstring FrameStatsText() const override;
+
 	void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void UpdateLods();
+	void CullRenderItems();
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void UpdateIndirectDrawInputs();
 
 	void BuildDescriptorHeaps();
 	void BuildConstantBufferViews();
@@ -48,8 +56,14 @@ private:
 	void BuildPSOs(); // PSO
 	void BuildFrameResources();
 	void BuildRenderItems();
+	void BuildIndirectDrawResources();
+
+	void RecordClear(ID3D12GraphicsCommandList* commandList);
+	void BindFrameState(ID3D12GraphicsCommandList* commandList);
+	void RecordPresentBarrier(ID3D12GraphicsCommandList* commandList);
 
-	void DrawRenderItems(ID3D12GraphicsCommandList* commandList, const std::vector<RenderItem*>& renderItems);
+	void DrawRenderItems(const DrawQueue& drawQueue);
+	void DrawRenderItemsIndirect(ID3D12GraphicsCommandList* commandList);
 
 	std::vector<std::unique_ptr<FrameResource>> _frameResources{};
 	FrameResource* _pCurrentFrameResource{};
@@ -60,7 +74,8 @@ private:
 
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _srvDescriptorHeap{};
 
-	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> _geometries{};
+	// Vertex and index buffers shared by all meshes.
+	std::unique_ptr<GeometryPool> _pGeometryPool{};
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3DBlob>> _shaders{};
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D12PipelineState>> _pipelineStateObjects{};
 
@@ -69,6 +84,49 @@ private:
 	std::vector<std::unique_ptr<RenderItem>> _renderItems;
 	std::vector<RenderItem*> _opaqueRenderItems;
 
+	// World space bounds of the opaque render items, by index, and those of them in
+	// the view frustum and not occluded this frame.
+	std::vector<DirectX::BoundingBox> _worldBoxes{};
+	SceneBvh _sceneBvh{};
+	SceneBvh::QueryStatistics _cullStatistics{};
+	std::vector<std::uint32_t> _visibleItemIndices{};
+
+	// The visible items as draw packets sorted by state, the geometry and mesh ids their
+	// keys use, and the state changes the last submission made. A submesh has a mesh id
+	// per level of detail, starting at the one stored here; meshes drawn more than once
+	// in a frame are drawn instanced.
+	DrawQueue _drawQueue{};
+	std::unordered_map<const MeshGeometry*, std::uint32_t> _geometryIds{};
+	std::unordered_map<const SubMeshGeometry*, std::uint32_t> _subMeshIds{};
+	std::vector<std::uint32_t> _meshDrawCounts{};
+	DrawQueue::Statistics _drawStatistics{};
+
+	// The draw queue is recorded onto up to this many of the frame resource's lists at
+	// once, one per job system thread.
+	static constexpr std::uint32_t MaxCommandListCount{ 8 };
+	ParallelCommandRecorder _commandRecorder{};
+
+	// GPU driven submission, toggled with I: a compute shader turns the items' draw
+	// arguments and visibility bits into commands for a single ExecuteIndirect. The
+	// command and count buffers are shared by the frame resources, as the frames'
+	// command lists run one after another on the queue.
+	bool _isIndirect{ true };
+	bool _wasIndirectKeyDown{ false };
+	IndirectDrawBuilder _indirectDrawBuilder{};
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> _pIndirectBuildRootSignature{};
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> _pCommandSignature{};
+	Microsoft::WRL::ComPtr<ID3D12Resource> _pIndirectCommandBuffer{};
+	Microsoft::WRL::ComPtr<ID3D12Resource> _pIndirectCountBuffer{};
+
+	// Occluder triangles by submesh. The largest items in view that have them are
+	// drawn into the occlusion culler every frame.
+	static constexpr std::uint32_t MaxOccluderCount{ 8 };
+	std::unordered_map<const SubMeshGeometry*, OccluderMesh> _occluderMeshes{};
+	OcclusionCuller _occlusionCuller{};
+	std::vector<std::uint32_t> _occluderCandidates{};
+	std::vector<std::uint32_t> _occluderIndices{};
+	std::uint32_t _occludedCount{};
+
 	PassConstants _mainPassCB{};
 	UINT _passCbvOffset{};
 	bool _isWireframe{ false };
@@ -81,5 +139,10 @@ private:
 	float _phi{ 0.2f * DirectX::XM_PI };
 	float _radius{ 15.f };
 
+	// Level of detail selection: pixels per world unit at distance 1, and the largest
+	// geometric error, in pixels, a level may show on screen.
+	float _lodPixelScale{ 1.0f };
+	float _maxLodPixelError{ 1.0f };
+
 	POINT _lastMousePosition{};
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "DxUtil.h"
 #include "UploadBuffer.h"  
 #include "MathHelper.h"
+#include "VertexLayout.h"
 
 struct PassConstants{
     DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
@@ -27,11 +28,7 @@ struct ObjectConstants
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 };
 
-struct Vertex
-{
-    DirectX::XMFLOAT3 Pos;
-    DirectX::XMFLOAT4 Color;
-};
+using Vertex = ColorVertexLayout::Vertex;
 
 struct FrameResource
 {
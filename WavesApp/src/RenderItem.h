@@ -17,5 +17,8 @@ struct RenderItem
 	UINT IndexCount{};
 	UINT StartIndexLocation{};
 	int BaseVertexLocation{};
+
+	// Submesh the draw arguments come from.
+	const SubMeshGeometry* pSubMesh{};
 };
 
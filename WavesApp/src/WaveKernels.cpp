@@ -0,0 +1,175 @@
+#include "WaveKernels.h"
+
+#include <cmath>
+
+#include "SimdSupport.h"
+#include "WaveKernelsAvx2.h"
+
+using namespace WaveKernels;
+
+namespace
+{
+	void StencilRowScalar(float* pPrev, const float* pUp, const float* pCurr, const float* pDown,
+		int count, const SimConstants& k)
+	{
+		for (int j = 0; j < count; ++j)
+		{
+			float neighbours = pDown[j] + pUp[j] + pCurr[j + 1] + pCurr[j - 1];
+			pPrev[j] = k.K1 * pPrev[j] + k.K2 * pCurr[j] + k.K3 * neighbours;
+		}
+	}
+
+	void NormalRowScalar(const float* pUp, const float* pCurr, const float* pDown, int count, float twoDx,
+		float* pNormalX, float* pNormalY, float* pNormalZ, float* pTangentX, float* pTangentY)
+	{
+		for (int j = 0; j < count; ++j)
+		{
+			float l = pCurr[j - 1];
+			float r = pCurr[j + 1];
+			float t = pUp[j];
+			float b = pDown[j];
+
+			float nx = l - r;
+			float nz = b - t;
+			float normalLength = std::sqrt(nx * nx + twoDx * twoDx + nz * nz);
+			pNormalX[j] = nx / normalLength;
+			pNormalY[j] = twoDx / normalLength;
+			pNormalZ[j] = nz / normalLength;
+
+			float ty = r - l;
+			float tangentLength = std::sqrt(twoDx * twoDx + ty * ty);
+			pTangentX[j] = twoDx / tangentLength;
+			pTangentY[j] = ty / tangentLength;
+		}
+	}
+
+#if DX12_HAS_SSE2
+	void StencilRowSse2(float* pPrev, const float* pUp, const float* pCurr, const float* pDown,
+		int count, const SimConstants& k)
+	{
+		const __m128 k1 = _mm_set1_ps(k.K1);
+		const __m128 k2 = _mm_set1_ps(k.K2);
+		const __m128 k3 = _mm_set1_ps(k.K3);
+
+		int j = 0;
+		for (; j + 4 <= count; j += 4)
+		{
+			__m128 neighbours = _mm_add_ps(_mm_loadu_ps(pDown + j), _mm_loadu_ps(pUp + j));
+			neighbours = _mm_add_ps(neighbours, _mm_loadu_ps(pCurr + j + 1));
+			neighbours = _mm_add_ps(neighbours, _mm_loadu_ps(pCurr + j - 1));
+
+			__m128 result = _mm_add_ps(
+				_mm_mul_ps(k1, _mm_loadu_ps(pPrev + j)),
+				_mm_mul_ps(k2, _mm_loadu_ps(pCurr + j)));
+			result = _mm_add_ps(result, _mm_mul_ps(k3, neighbours));
+
+			_mm_storeu_ps(pPrev + j, result);
+		}
+
+		StencilRowScalar(pPrev + j, pUp + j, pCurr + j, pDown + j, count - j, k);
+	}
+
+	void NormalRowSse2(const float* pUp, const float* pCurr, const float* pDown, int count, float twoDx,
+		float* pNormalX, float* pNormalY, float* pNormalZ, float* pTangentX, float* pTangentY)
+	{
+		const __m128 ny = _mm_set1_ps(twoDx);
+		const __m128 nySquared = _mm_mul_ps(ny, ny);
+
+		int j = 0;
+		for (; j + 4 <= count; j += 4)
+		{
+			__m128 l = _mm_loadu_ps(pCurr + j - 1);
+			__m128 r = _mm_loadu_ps(pCurr + j + 1);
+			__m128 t = _mm_loadu_ps(pUp + j);
+			__m128 b = _mm_loadu_ps(pDown + j);
+
+			__m128 nx = _mm_sub_ps(l, r);
+			__m128 nz = _mm_sub_ps(b, t);
+			__m128 normalLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), nySquared), _mm_mul_ps(nz, nz)));
+			_mm_storeu_ps(pNormalX + j, _mm_div_ps(nx, normalLength));
+			_mm_storeu_ps(pNormalY + j, _mm_div_ps(ny, normalLength));
+			_mm_storeu_ps(pNormalZ + j, _mm_div_ps(nz, normalLength));
+
+			__m128 ty = _mm_sub_ps(r, l);
+			__m128 tangentLength = _mm_sqrt_ps(_mm_add_ps(nySquared, _mm_mul_ps(ty, ty)));
+			_mm_storeu_ps(pTangentX + j, _mm_div_ps(ny, tangentLength));
+			_mm_storeu_ps(pTangentY + j, _mm_div_ps(ty, tangentLength));
+		}
+
+		NormalRowScalar(pUp + j, pCurr + j, pDown + j, count - j, twoDx,
+			pNormalX + j, pNormalY + j, pNormalZ + j, pTangentX + j, pTangentY + j);
+	}
+#endif
+
+#if DX12_CAN_COMPILE_AVX2 && DX12_HAS_SSE2
+	void StencilRowAvx2(float* pPrev, const float* pUp, const float* pCurr, const float* pDown,
+		int count, const SimConstants& k)
+	{
+		int j = Avx2::StencilRowBlocks(pPrev, pUp, pCurr, pDown, count, k);
+		StencilRowSse2(pPrev + j, pUp + j, pCurr + j, pDown + j, count - j, k);
+	}
+
+	void NormalRowAvx2(const float* pUp, const float* pCurr, const float* pDown, int count, float twoDx,
+		float* pNormalX, float* pNormalY, float* pNormalZ, float* pTangentX, float* pTangentY)
+	{
+		int j = Avx2::NormalRowBlocks(pUp, pCurr, pDown, count, twoDx, pNormalX, pNormalY, pNormalZ, pTangentX, pTangentY);
+		NormalRowSse2(pUp + j, pCurr + j, pDown + j, count - j, twoDx,
+			pNormalX + j, pNormalY + j, pNormalZ + j, pTangentX + j, pTangentY + j);
+	}
+#endif
+
+	const KernelTable ScalarKernels{ StencilRowScalar, NormalRowScalar };
+#if DX12_HAS_SSE2
+	const KernelTable Sse2Kernels{ StencilRowSse2, NormalRowSse2 };
+#endif
+#if DX12_CAN_COMPILE_AVX2 && DX12_HAS_SSE2
+	const KernelTable Avx2Kernels{ StencilRowAvx2, NormalRowAvx2 };
+#endif
+}
+
+SimdLevel WaveKernels::BestAvailable()
+{
+#if DX12_CAN_COMPILE_AVX2 && DX12_HAS_SSE2
+	// CPUID only needs asking once.
+	static const bool hasAvx2 = CpuHasAvx2();
+	if (hasAvx2)
+		return SimdLevel::Avx2;
+#endif
+#if DX12_HAS_SSE2
+	return SimdLevel::Sse2;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+bool WaveKernels::IsAvailable(SimdLevel level)
+{
+	return static_cast<int>(level) <= static_cast<int>(BestAvailable());
+}
+
+const char* WaveKernels::ToString(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Sse2: return "sse2";
+	case SimdLevel::Avx2: return "avx2";
+	default: return "scalar";
+	}
+}
+
+const KernelTable& WaveKernels::GetKernels(SimdLevel level)
+{
+	if (not IsAvailable(level))
+		level = BestAvailable();
+
+	switch (level)
+	{
+#if DX12_CAN_COMPILE_AVX2 && DX12_HAS_SSE2
+	case SimdLevel::Avx2: return Avx2Kernels;
+#endif
+#if DX12_HAS_SSE2
+	case SimdLevel::Sse2: return Sse2Kernels;
+#endif
+	default: return ScalarKernels;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Row kernels for the Waves height-field solver.
+//
+// Every kernel processes one grid row stored as a contiguous float plane. The scalar
+// versions are the reference; the SSE2 and AVX2 versions perform the same IEEE
+// operations in the same order (no FMA, exact sqrt and divide), so all levels
+// produce bit-identical results.
+
+namespace WaveKernels
+{
+    enum class SimdLevel
+    {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    // Highest SIMD level compiled into this binary that the CPU supports. AVX2 kernels
+    // are built into every x86 binary and picked when the CPU has AVX2.
+    SimdLevel BestAvailable();
+    bool IsAvailable(SimdLevel level);
+    const char* ToString(SimdLevel level);
+
+    struct SimConstants
+    {
+        float K1{};
+        float K2{};
+        float K3{};
+    };
+
+    // For j in [0, count):
+    //   prev[j] = k1*prev[j] + k2*curr[j] + k3*(down[j] + up[j] + curr[j+1] + curr[j-1])
+    // pCurr[-1] and pCurr[count] must be readable.
+    using StencilRowFn = void(*)(float* pPrev, const float* pUp, const float* pCurr, const float* pDown,
+        int count, const SimConstants& k);
+
+    // For j in [0, count), writes the unit normal (l - r, 2dx, b - t) and the
+    // unit tangent (2dx, r - l, 0) where l/r are curr[j-1]/curr[j+1] and t/b are up[j]/down[j].
+    using NormalRowFn = void(*)(const float* pUp, const float* pCurr, const float* pDown, int count, float twoDx,
+        float* pNormalX, float* pNormalY, float* pNormalZ, float* pTangentX, float* pTangentY);
+
+    struct KernelTable
+    {
+        StencilRowFn StencilRow{};
+        NormalRowFn NormalRow{};
+    };
+
+    // Falls back to the best available level if the requested one was not compiled in.
+    const KernelTable& GetKernels(SimdLevel level);
+}
@@ -0,0 +1,61 @@
+#include "WaveKernelsAvx2.h"
+
+#include "SimdSupport.h"
+
+// Built with /arch:AVX2 by the projects; DX12_TARGET_AVX2 does the same for GCC and
+// Clang without requiring AVX2 of the whole program.
+
+#if DX12_CAN_COMPILE_AVX2
+DX12_TARGET_AVX2 int WaveKernels::Avx2::StencilRowBlocks(float* pPrev, const float* pUp, const float* pCurr,
+	const float* pDown, int count, const SimConstants& k)
+{
+	const __m256 k1 = _mm256_set1_ps(k.K1);
+	const __m256 k2 = _mm256_set1_ps(k.K2);
+	const __m256 k3 = _mm256_set1_ps(k.K3);
+
+	int j = 0;
+	for (; j + 8 <= count; j += 8)
+	{
+		__m256 neighbours = _mm256_add_ps(_mm256_loadu_ps(pDown + j), _mm256_loadu_ps(pUp + j));
+		neighbours = _mm256_add_ps(neighbours, _mm256_loadu_ps(pCurr + j + 1));
+		neighbours = _mm256_add_ps(neighbours, _mm256_loadu_ps(pCurr + j - 1));
+
+		__m256 result = _mm256_add_ps(
+			_mm256_mul_ps(k1, _mm256_loadu_ps(pPrev + j)),
+			_mm256_mul_ps(k2, _mm256_loadu_ps(pCurr + j)));
+		result = _mm256_add_ps(result, _mm256_mul_ps(k3, neighbours));
+
+		_mm256_storeu_ps(pPrev + j, result);
+	}
+	return j;
+}
+
+DX12_TARGET_AVX2 int WaveKernels::Avx2::NormalRowBlocks(const float* pUp, const float* pCurr, const float* pDown,
+	int count, float twoDx, float* pNormalX, float* pNormalY, float* pNormalZ, float* pTangentX, float* pTangentY)
+{
+	const __m256 ny = _mm256_set1_ps(twoDx);
+	const __m256 nySquared = _mm256_mul_ps(ny, ny);
+
+	int j = 0;
+	for (; j + 8 <= count; j += 8)
+	{
+		__m256 l = _mm256_loadu_ps(pCurr + j - 1);
+		__m256 r = _mm256_loadu_ps(pCurr + j + 1);
+		__m256 t = _mm256_loadu_ps(pUp + j);
+		__m256 b = _mm256_loadu_ps(pDown + j);
+
+		__m256 nx = _mm256_sub_ps(l, r);
+		__m256 nz = _mm256_sub_ps(b, t);
+		__m256 normalLength = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), nySquared), _mm256_mul_ps(nz, nz)));
+		_mm256_storeu_ps(pNormalX + j, _mm256_div_ps(nx, normalLength));
+		_mm256_storeu_ps(pNormalY + j, _mm256_div_ps(ny, normalLength));
+		_mm256_storeu_ps(pNormalZ + j, _mm256_div_ps(nz, normalLength));
+
+		__m256 ty = _mm256_sub_ps(r, l);
+		__m256 tangentLength = _mm256_sqrt_ps(_mm256_add_ps(nySquared, _mm256_mul_ps(ty, ty)));
+		_mm256_storeu_ps(pTangentX + j, _mm256_div_ps(ny, tangentLength));
+		_mm256_storeu_ps(pTangentY + j, _mm256_div_ps(ty, tangentLength));
+	}
+	return j;
+}
+#endif
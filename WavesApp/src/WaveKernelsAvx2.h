@@ -0,0 +1,17 @@
+#pragma once
+
+#include "WaveKernels.h"
+
+// The AVX2 loops of the wave kernels, in a translation unit of their own built for
+// AVX2 so the rest of the program still runs on CPUs without it. They only process
+// whole blocks of 8 elements and return how many they did; WaveKernels.cpp finishes
+// the row with the SSE2 kernels. Only call them when CpuHasAvx2().
+
+namespace WaveKernels::Avx2
+{
+    int StencilRowBlocks(float* pPrev, const float* pUp, const float* pCurr, const float* pDown,
+        int count, const SimConstants& k);
+
+    int NormalRowBlocks(const float* pUp, const float* pCurr, const float* pDown, int count, float twoDx,
+        float* pNormalX, float* pNormalY, float* pNormalZ, float* pTangentX, float* pTangentY);
+}
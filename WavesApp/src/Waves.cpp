@@ -1,8 +1,8 @@
 #include "Waves.h"
-#include <ppl.h>
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
 
 using namespace DirectX;
 
@@ -11,6 +11,9 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 	_nrRows = m;
 	_nrCols = n;
 
+	// Round every row up to a whole number of cache lines.
+	_rowPitch = (n + 15) & ~15;
+
 	_vertexCount = m * n;
 	_triangleCount = (m - 1) * (n - 1) * 2;
 
@@ -19,32 +22,26 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 
 	float d = damping * dt + 2.0f;
 	float e = (speed * speed) * (dt * dt) / (dx * dx);
-	_simConstant1 = (damping * dt - 2.0f) / d;
-	_simConstant2 = (4.0f - 8.0f * e) / d;
-	_simConstant3 = (2.0f * e) / d;
+	_simConstants.K1 = (damping * dt - 2.0f) / d;
+	_simConstants.K2 = (4.0f - 8.0f * e) / d;
+	_simConstants.K3 = (2.0f * e) / d;
 
-	_prevSolution.resize(m * n);
-	_currentSolution.resize(m * n);
-	_normals.resize(m * n);
-	_tangentX.resize(m * n);
+	_halfWidth = (n - 1) * dx * 0.5f;
+	_halfDepth = (m - 1) * dx * 0.5f;
 
-	// Generate grid vertices in system memory.
+	// The grid starts out flat: zero heights, straight up normals and +x tangents.
+	size_t planeSize = static_cast<size_t>(m) * _rowPitch;
+	_prevHeights.assign(planeSize, 0.0f);
+	_currHeights.assign(planeSize, 0.0f);
+	_normalX.assign(planeSize, 0.0f);
+	_normalY.assign(planeSize, 1.0f);
+	_normalZ.assign(planeSize, 0.0f);
+	_tangentX.assign(planeSize, 1.0f);
+	_tangentY.assign(planeSize, 0.0f);
 
-	float halfWidth = (n - 1) * dx * 0.5f;
-	float halfDepth = (m - 1) * dx * 0.5f;
-	for (int i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i * dx;
-		for (int j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j * dx;
+	_dirtyRowRanges = { RowRange{ 0, m } };
 
-			_prevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			_currentSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			_normals[i * n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			_tangentX[i * n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-		}
-	}
+	SetSimdLevel(_simdLevel);
 }
 
 Waves::~Waves()
@@ -80,75 +77,503 @@ float Waves::Depth()const
 	return _nrRows * _spatialStep;
 }
 
-void Waves::Update(float dt)
+XMFLOAT3 Waves::Position(int i)const
+{
+	int row = i / _nrCols;
+	int column = i % _nrCols;
+	return XMFLOAT3(-_halfWidth + column * _spatialStep, _currHeights[Index(row, column)], _halfDepth - row * _spatialStep);
+}
+
+XMFLOAT3 Waves::Normal(int i)const
+{
+	size_t k = Index(i / _nrCols, i % _nrCols);
+	return XMFLOAT3(_normalX[k], _normalY[k], _normalZ[k]);
+}
+
+XMFLOAT3 Waves::TangentX(int i)const
+{
+	size_t k = Index(i / _nrCols, i % _nrCols);
+	return XMFLOAT3(_tangentX[k], _tangentY[k], 0.0f);
+}
+
+void Waves::GetPositions(XMFLOAT3* pPositions)const
+{
+	for (int i = 0; i < _nrRows; ++i)
+	{
+		float z = _halfDepth - i * _spatialStep;
+		const float* pHeights = HeightRow(i);
+		for (int j = 0; j < _nrCols; ++j)
+			*pPositions++ = XMFLOAT3(-_halfWidth + j * _spatialStep, pHeights[j], z);
+	}
+}
+
+void Waves::SetSimdLevel(WaveKernels::SimdLevel level)
+{
+	_simdLevel = WaveKernels::IsAvailable(level) ? level : WaveKernels::BestAvailable();
+	_pKernels = &WaveKernels::GetKernels(_simdLevel);
+}
+
+int Waves::Update(float dt)
+{
+	// Accumulate time. Each instance keeps its own clock.
+	_accumulatedTime += dt;
+
+	if (_sparseTracking)
+		std::fill(_dirtyTiles.begin(), _dirtyTiles.end(), std::uint8_t{ 0 });
+
+	// Only update the simulation at the specified time step, as many
+	// times as needed to catch up with the time that has passed.
+	int steps = 0;
+	while (_accumulatedTime >= _timeStep)
+	{
+		if (_maxSubsteps > 0 and steps == _maxSubsteps)
+		{
+			// Drop the backlog but keep the fraction of a step we are into.
+			float backlog = std::floor(_accumulatedTime / _timeStep);
+			_droppedSteps += static_cast<long long>(backlog);
+			_accumulatedTime -= backlog * _timeStep;
+			break;
+		}
+
+		_accumulatedTime -= _timeStep;
+		++steps;
+	}
+
+	RunSteps(steps);
+
+	if (_sparseTracking and steps > 0)
+		RetireQuiescentTiles();
+
+	// Normals are only needed for the last step.
+	if (steps > 0)
+	{
+		if (_sparseTracking)
+			ComputeNormalsSparse();
+		else
+			ComputeNormals();
+	}
+
+	UpdateDirtyRowRanges();
+
+	return steps;
+}
+
+void Waves::SetTemporalBlocking(int stepsPerBlock, int tileRows, int tileColumns)
+{
+	_stepsPerBlock = stepsPerBlock;
+	_tileRows = std::max(1, tileRows);
+	_tileColumns = std::max(1, tileColumns);
+
+	if (_stepsPerBlock > 1)
+	{
+		_blockPrevHeights.assign(_prevHeights.size(), 0.0f);
+		_blockCurrHeights.assign(_currHeights.size(), 0.0f);
+	}
+	else
+	{
+		_blockPrevHeights = {};
+		_blockCurrHeights = {};
+	}
+}
+
+void Waves::SetSparseTracking(bool enabled, float epsilon)
+{
+	_sparseTracking = enabled;
+	_quiescenceEpsilon = epsilon;
+
+	if (not enabled)
+	{
+		_activeTiles = {};
+		_steppedTiles = {};
+		_dirtyTiles = {};
+		_nonFlatNormalTiles = {};
+		_tileList = {};
+		UpdateDirtyRowRanges();
+		return;
+	}
+
+	_activeTileRows = (_nrRows + ActiveTileSize - 1) / ActiveTileSize;
+	_activeTileColumns = (_nrCols + ActiveTileSize - 1) / ActiveTileSize;
+	size_t tileCount = static_cast<size_t>(_activeTileRows) * _activeTileColumns;
+	_activeTiles.assign(tileCount, 0);
+	_steppedTiles.assign(tileCount, 0);
+	_dirtyTiles.assign(tileCount, 0);
+
+	// Normals may be anything at this point; the next update resets the flat ones.
+	_nonFlatNormalTiles.assign(tileCount, 1);
+
+	// Activate every tile that is not at rest yet.
+	for (int i = 0; i < _nrRows; ++i)
+	{
+		for (int j = 0; j < _nrCols; ++j)
+		{
+			size_t k = Index(i, j);
+			if (_prevHeights[k] != 0.0f or _currHeights[k] != 0.0f)
+				MarkActive(i, j);
+		}
+	}
+
+	UpdateDirtyRowRanges();
+}
+
+int Waves::ActiveTileCount()const
+{
+	return static_cast<int>(std::count(_activeTiles.begin(), _activeTiles.end(), std::uint8_t{ 1 }));
+}
+
+void Waves::RunSteps(int steps)
+{
+	if (_sparseTracking)
+	{
+		while (steps-- > 0)
+			StepSparse();
+		return;
+	}
+
+	while (_stepsPerBlock > 1 and steps > 1)
+	{
+		int blockSteps = std::min(steps, _stepsPerBlock);
+		StepTiled(blockSteps);
+		steps -= blockSteps;
+	}
+
+	while (steps-- > 0)
+		StepSimulation();
+}
+
+void Waves::StepSimulation()
+{
+	// Only update interior points; we use zero boundary conditions.
+	_pJobSystem->ParallelFor(1, _nrRows - 1, RowGrainSize(), [this] (size_t row)
+		{
+			int i = (int)row;
+
+			// After this update we will be discarding the old previous
+			// buffer, so overwrite that buffer with the new update.
+			// Note how we can do this inplace (read/write to same element) 
+			// because we won't need prev_ij again and the assignment happens last.
+
+			// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+			// Moreover, our +z axis goes "down"; this is just to 
+			// keep consistent with our row indices going down.
+			_pKernels->StencilRow(
+				&_prevHeights[Index(i, 1)],
+				&_currHeights[Index(i - 1, 1)],
+				&_currHeights[Index(i, 1)],
+				&_currHeights[Index(i + 1, 1)],
+				_nrCols - 2,
+				_simConstants);
+		});
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(_prevHeights, _currHeights);
+}
+
+void Waves::StepTiled(int steps)
+{
+	int tileCount = ((_nrRows + _tileRows - 1) / _tileRows) * ((_nrCols + _tileColumns - 1) / _tileColumns);
+
+	// Tiles read the solution planes and write the block planes, so they are independent.
+	_pJobSystem->ParallelFor(0, tileCount, 1, [this, steps] (size_t tile)
+		{
+			StepTile((int)tile, steps);
+		});
+
+	std::swap(_prevHeights, _blockPrevHeights);
+	std::swap(_currHeights, _blockCurrHeights);
+}
+
+void Waves::StepTile(int tileIndex, int steps)
+{
+	int tilesPerRow = (_nrCols + _tileColumns - 1) / _tileColumns;
+
+	// The cells this tile owns.
+	int r0 = (tileIndex / tilesPerRow) * _tileRows;
+	int c0 = (tileIndex % tilesPerRow) * _tileColumns;
+	int r1 = std::min(_nrRows, r0 + _tileRows);
+	int c1 = std::min(_nrCols, c0 + _tileColumns);
+
+	// The owned cells plus a halo of one cell per step, clipped to the grid.
+	int haloR0 = std::max(0, r0 - steps);
+	int haloC0 = std::max(0, c0 - steps);
+	int haloR1 = std::min(_nrRows, r1 + steps);
+	int haloC1 = std::min(_nrCols, c1 + steps);
+
+	int localRows = haloR1 - haloR0;
+	int localCols = haloC1 - haloC0;
+	size_t localPitch = (localCols + 15) & ~15;
+
+	// Per thread scratch, reused across tiles and blocks.
+	thread_local AlignedVector<float> scratch;
+	size_t localPlaneSize = localRows * localPitch;
+	if (scratch.size() < 2 * localPlaneSize)
+		scratch.resize(2 * localPlaneSize);
+
+	float* pLocalPrev = scratch.data();
+	float* pLocalCurr = scratch.data() + localPlaneSize;
+
+	for (int i = 0; i < localRows; ++i)
+	{
+		size_t src = Index(haloR0 + i, haloC0);
+		std::copy_n(&_prevHeights[src], localCols, pLocalPrev + i * localPitch);
+		std::copy_n(&_currHeights[src], localCols, pLocalCurr + i * localPitch);
+	}
+
+	// Step s only has valid inputs within steps - s + 1 cells of the owned region, so
+	// the updated region shrinks by one cell every step (a trapezoid in time). Boundary
+	// cells of the grid are never updated: zero boundary conditions.
+	for (int s = 1; s <= steps; ++s)
+	{
+		int margin = steps - s;
+		int rowBegin = std::max(1, r0 - margin);
+		int rowEnd = std::min(_nrRows - 1, r1 + margin);
+		int colBegin = std::max(1, c0 - margin);
+		int colEnd = std::min(_nrCols - 1, c1 + margin);
+
+		for (int i = rowBegin; i < rowEnd; ++i)
+		{
+			size_t k = (i - haloR0) * localPitch + (colBegin - haloC0);
+			_pKernels->StencilRow(
+				pLocalPrev + k,
+				pLocalCurr + k - localPitch,
+				pLocalCurr + k,
+				pLocalCurr + k + localPitch,
+				colEnd - colBegin,
+				_simConstants);
+		}
+
+		std::swap(pLocalPrev, pLocalCurr);
+	}
+
+	// Write back the owned cells of the last two time levels.
+	for (int i = r0; i < r1; ++i)
+	{
+		size_t src = (i - haloR0) * localPitch + (c0 - haloC0);
+		size_t dst = Index(i, c0);
+		std::copy_n(pLocalPrev + src, c1 - c0, &_blockPrevHeights[dst]);
+		std::copy_n(pLocalCurr + src, c1 - c0, &_blockCurrHeights[dst]);
+	}
+}
+
+void Waves::StepSparse()
 {
-	static float t = 0;
+	// Waves travel at most one cell per step, so everything that can change this step
+	// lies in the active tiles and the ring around them. All other cells are zero and
+	// surrounded by zeros: the stencil would just produce zero again.
+	DilateTiles(_activeTiles, _steppedTiles);
+
+	_tileList.clear();
+	for (size_t t = 0; t < _steppedTiles.size(); ++t)
+	{
+		if (_steppedTiles[t])
+		{
+			_tileList.push_back(static_cast<int>(t));
+			_dirtyTiles[t] = 1;
+		}
+	}
+
+	// About 16K cells per task, like the dense row passes.
+	size_t grainSize = std::max(1, (16 * 1024) / (ActiveTileSize * ActiveTileSize));
+	_pJobSystem->ParallelFor(0, _tileList.size(), grainSize, [this] (size_t k)
+		{
+			int tile = _tileList[k];
+			int r0 = (tile / _activeTileColumns) * ActiveTileSize;
+			int c0 = (tile % _activeTileColumns) * ActiveTileSize;
+
+			// Only update interior points; we use zero boundary conditions.
+			int rowBegin = std::max(1, r0);
+			int rowEnd = std::min(_nrRows - 1, r0 + ActiveTileSize);
+			int colBegin = std::max(1, c0);
+			int colEnd = std::min(_nrCols - 1, c0 + ActiveTileSize);
 
-	// Accumulate time.
-	t += dt;
+			for (int i = rowBegin; i < rowEnd; ++i)
+			{
+				_pKernels->StencilRow(
+					&_prevHeights[Index(i, colBegin)],
+					&_currHeights[Index(i - 1, colBegin)],
+					&_currHeights[Index(i, colBegin)],
+					&_currHeights[Index(i + 1, colBegin)],
+					colEnd - colBegin,
+					_simConstants);
+			}
+		});
 
-	// Only update the simulation at the specified time step.
-	if (t >= _timeStep)
+	std::swap(_prevHeights, _currHeights);
+
+	// The waves may have spread into every tile we stepped.
+	std::swap(_activeTiles, _steppedTiles);
+}
+
+void Waves::RetireQuiescentTiles()
+{
+	_tileList.clear();
+	for (size_t t = 0; t < _activeTiles.size(); ++t)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, _nrRows - 1, [this] (int i)
-			//for(int i = 1; i < mNumRows-1; ++i)
+		if (_activeTiles[t])
+			_tileList.push_back(static_cast<int>(t));
+	}
+
+	// Tiles only touch their own cells and flag, so they can be checked in parallel.
+	_pJobSystem->ParallelFor(0, _tileList.size(), 1, [this] (size_t k)
+		{
+			int tile = _tileList[k];
+			int r0 = (tile / _activeTileColumns) * ActiveTileSize;
+			int c0 = (tile % _activeTileColumns) * ActiveTileSize;
+			int r1 = std::min(_nrRows, r0 + ActiveTileSize);
+			int c1 = std::min(_nrCols, c0 + ActiveTileSize);
+
+			for (int i = r0; i < r1; ++i)
 			{
-				for (int j = 1; j < _nrCols - 1; ++j)
+				for (int j = c0; j < c1; ++j)
 				{
-					// After this update we will be discarding the old previous
-					// buffer, so overwrite that buffer with the new update.
-					// Note how we can do this inplace (read/write to same element) 
-					// because we won't need prev_ij again and the assignment happens last.
-
-					// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-					// Moreover, our +z axis goes "down"; this is just to 
-					// keep consistent with our row indices going down.
-
-					_prevSolution[i * _nrCols + j].y =
-						_simConstant1 * _prevSolution[i * _nrCols + j].y +
-						_simConstant2 * _currentSolution[i * _nrCols + j].y +
-						_simConstant3 * (_currentSolution[(i + 1) * _nrCols + j].y +
-							_currentSolution[(i - 1) * _nrCols + j].y +
-							_currentSolution[i * _nrCols + j + 1].y +
-							_currentSolution[i * _nrCols + j - 1].y);
+					size_t index = Index(i, j);
+					if (std::abs(_currHeights[index]) > _quiescenceEpsilon or std::abs(_prevHeights[index]) > _quiescenceEpsilon)
+						return;
 				}
-			});
+			}
+
+			for (int i = r0; i < r1; ++i)
+			{
+				std::fill(&_prevHeights[Index(i, c0)], &_prevHeights[Index(i, c0)] + (c1 - c0), 0.0f);
+				std::fill(&_currHeights[Index(i, c0)], &_currHeights[Index(i, c0)] + (c1 - c0), 0.0f);
+			}
+			_activeTiles[tile] = 0;
+		});
+}
+
+void Waves::ComputeNormals()
+{
+	_pJobSystem->ParallelFor(1, _nrRows - 1, RowGrainSize(), [this] (size_t firstRow, size_t lastRow)
+		{
+			ComputeNormalRows((int)firstRow, (int)lastRow, 1, _nrCols - 1);
+		});
+}
+
+void Waves::ComputeNormalsSparse()
+{
+	// Normals of cells next to an active tile see its heights, so compute them for the
+	// ring around the active tiles as well, and flatten the tiles that left that set.
+	DilateTiles(_activeTiles, _steppedTiles);
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(_prevSolution, _currentSolution);
+	_tileList.clear();
+	for (size_t t = 0; t < _steppedTiles.size(); ++t)
+	{
+		if (_steppedTiles[t] or _nonFlatNormalTiles[t])
+			_tileList.push_back(static_cast<int>(t));
+	}
 
-		t = 0.0f; // reset time
+	_pJobSystem->ParallelFor(0, _tileList.size(), 1, [this] (size_t k)
+		{
+			int tile = _tileList[k];
+			int r0 = (tile / _activeTileColumns) * ActiveTileSize;
+			int c0 = (tile % _activeTileColumns) * ActiveTileSize;
+			int r1 = std::min(_nrRows, r0 + ActiveTileSize);
+			int c1 = std::min(_nrCols, c0 + ActiveTileSize);
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, _nrRows - 1, [this] (int i)
-			//for(int i = 1; i < mNumRows - 1; ++i)
+			if (_steppedTiles[tile])
 			{
-				for (int j = 1; j < _nrCols - 1; ++j)
-				{
-					float l = _currentSolution[i * _nrCols + j - 1].y;
-					float r = _currentSolution[i * _nrCols + j + 1].y;
-					float t = _currentSolution[(i - 1) * _nrCols + j].y;
-					float b = _currentSolution[(i + 1) * _nrCols + j].y;
-					_normals[i * _nrCols + j].x = -r + l;
-					_normals[i * _nrCols + j].y = 2.0f * _spatialStep;
-					_normals[i * _nrCols + j].z = b - t;
-
-					XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&_normals[i * _nrCols + j]));
-					XMStoreFloat3(&_normals[i * _nrCols + j], n);
-
-					_tangentX[i * _nrCols + j] = XMFLOAT3(2.0f * _spatialStep, r - l, 0.0f);
-					XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&_tangentX[i * _nrCols + j]));
-					XMStoreFloat3(&_tangentX[i * _nrCols + j], T);
-				}
-			});
+				ComputeNormalRows(std::max(1, r0), std::min(_nrRows - 1, r1), std::max(1, c0), std::min(_nrCols - 1, c1));
+				return;
+			}
+
+			for (int i = r0; i < r1; ++i)
+			{
+				size_t index = Index(i, c0);
+				std::fill(&_normalX[index], &_normalX[index] + (c1 - c0), 0.0f);
+				std::fill(&_normalY[index], &_normalY[index] + (c1 - c0), 1.0f);
+				std::fill(&_normalZ[index], &_normalZ[index] + (c1 - c0), 0.0f);
+				std::fill(&_tangentX[index], &_tangentX[index] + (c1 - c0), 1.0f);
+				std::fill(&_tangentY[index], &_tangentY[index] + (c1 - c0), 0.0f);
+			}
+		});
+
+	_nonFlatNormalTiles = _steppedTiles;
+}
+
+void Waves::ComputeNormalRows(int firstRow, int lastRow, int firstColumn, int lastColumn)
+{
+	//
+	// Compute normals using finite difference scheme.
+	//
+	for (int i = firstRow; i < lastRow; ++i)
+	{
+		size_t k = Index(i, firstColumn);
+		_pKernels->NormalRow(
+			&_currHeights[Index(i - 1, firstColumn)],
+			&_currHeights[k],
+			&_currHeights[Index(i + 1, firstColumn)],
+			lastColumn - firstColumn,
+			2.0f * _spatialStep,
+			&_normalX[k], &_normalY[k], &_normalZ[k],
+			&_tangentX[k], &_tangentY[k]);
+	}
+}
+
+void Waves::MarkActive(int row, int column)
+{
+	_activeTiles[(row / ActiveTileSize) * _activeTileColumns + column / ActiveTileSize] = 1;
+}
+
+void Waves::DilateTiles(const std::vector<std::uint8_t>& tiles, std::vector<std::uint8_t>& dilated)const
+{
+	std::fill(dilated.begin(), dilated.end(), std::uint8_t{ 0 });
+
+	for (int ti = 0; ti < _activeTileRows; ++ti)
+	{
+		for (int tj = 0; tj < _activeTileColumns; ++tj)
+		{
+			if (not tiles[ti * _activeTileColumns + tj])
+				continue;
+
+			for (int i = std::max(0, ti - 1); i <= std::min(_activeTileRows - 1, ti + 1); ++i)
+				for (int j = std::max(0, tj - 1); j <= std::min(_activeTileColumns - 1, tj + 1); ++j)
+					dilated[i * _activeTileColumns + j] = 1;
+		}
+	}
+}
+
+void Waves::UpdateDirtyRowRanges()
+{
+	_dirtyRowRanges.clear();
+
+	if (not _sparseTracking)
+	{
+		_dirtyRowRanges.push_back(RowRange{ 0, _nrRows });
+		return;
+	}
+
+	// Dirty tiles are tracked per tile, but vertices are uploaded by whole rows.
+	for (int ti = 0; ti < _activeTileRows; ++ti)
+	{
+		bool isDirty = false;
+		for (int tj = 0; tj < _activeTileColumns and not isDirty; ++tj)
+		{
+			size_t t = static_cast<size_t>(ti) * _activeTileColumns + tj;
+			isDirty = _dirtyTiles[t] or _activeTiles[t];
+		}
+		if (not isDirty)
+			continue;
+
+		int first = ti * ActiveTileSize;
+		int last = std::min(_nrRows, first + ActiveTileSize);
+		if (not _dirtyRowRanges.empty() and _dirtyRowRanges.back().Last == first)
+			_dirtyRowRanges.back().Last = last;
+		else
+			_dirtyRowRanges.push_back(RowRange{ first, last });
 	}
 }
 
+size_t Waves::RowGrainSize()const
+{
+	if (_rowGrainSize > 0)
+		return _rowGrainSize;
+
+	// Aim for tasks of about 16K cells, enough to amortize scheduling overhead.
+	return std::max<size_t>(1, (16 * 1024) / _nrCols);
+}
+
 void Waves::Disturb(int i, int j, float magnitude)
 {
 	// Don't disturb boundaries.
@@ -158,9 +583,18 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f * magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	_currentSolution[i * _nrCols + j].y += magnitude;
-	_currentSolution[i * _nrCols + j + 1].y += halfMag;
-	_currentSolution[i * _nrCols + j - 1].y += halfMag;
-	_currentSolution[(i + 1) * _nrCols + j].y += halfMag;
-	_currentSolution[(i - 1) * _nrCols + j].y += halfMag;
+	_currHeights[Index(i, j)] += magnitude;
+	_currHeights[Index(i, j + 1)] += halfMag;
+	_currHeights[Index(i, j - 1)] += halfMag;
+	_currHeights[Index(i + 1, j)] += halfMag;
+	_currHeights[Index(i - 1, j)] += halfMag;
+
+	if (_sparseTracking)
+	{
+		MarkActive(i, j);
+		MarkActive(i, j + 1);
+		MarkActive(i, j - 1);
+		MarkActive(i + 1, j);
+		MarkActive(i - 1, j);
+	}
 }
@@ -1,8 +1,15 @@
 #pragma once
 
+#include <cassert>
+#include <cstdint>
+#include <span>
 #include <vector>
 #include <DirectXMath.h>
 
+#include "AlignedAllocator.h"
+#include "JobSystem.h"
+#include "WaveKernels.h"
+
 class Waves
 {
 public:
@@ -18,31 +25,203 @@ public:
     float Width()const;
     float Depth()const;
 
-    const DirectX::XMFLOAT3& Position(int i)const { return _currentSolution[i]; }
-    const DirectX::XMFLOAT3& Normal(int i)const { return _normals[i]; }
-    const DirectX::XMFLOAT3& TangentX(int i)const { return _tangentX[i]; }
+    // Positions are not stored; they are rebuilt from the height plane on request.
+    DirectX::XMFLOAT3 Position(int i)const;
+    DirectX::XMFLOAT3 Normal(int i)const;
+    DirectX::XMFLOAT3 TangentX(int i)const;
+
+    // Writes all VertexCount() positions in row-major order.
+    void GetPositions(DirectX::XMFLOAT3* pPositions)const;
+
+    // Fills vertices[0, VertexCount()) with makeVertex(position) straight from the
+    // height plane. Every task writes one contiguous block of rows front to back, so
+    // the vertices can target write-combined (mapped upload) memory directly.
+    // With interpolation < 1 the heights are blended from the previous step towards
+    // the current one; pass InterpolationFactor() for smooth rendering.
+    template<typename TVertex, typename TMakeVertex>
+    void WriteVertices(std::span<TVertex> vertices, TMakeVertex&& makeVertex, float interpolation = 1.0f)const;
+
+    // Same as WriteVertices, but only for the vertices of rows [firstRow, lastRow).
+    template<typename TVertex, typename TMakeVertex>
+    void WriteVertexRows(std::span<TVertex> vertices, int firstRow, int lastRow, TMakeVertex&& makeVertex, float interpolation = 1.0f)const;
+
+    // Heights of the current solution for one row; ColumnCount() floats, 64-byte aligned.
+    const float* HeightRow(int row)const { return &_currHeights[static_cast<size_t>(row) * _rowPitch]; }
 
-    void Update(float dt);
+    void SetSimdLevel(WaveKernels::SimdLevel level);
+    WaveKernels::SimdLevel GetSimdLevel()const { return _simdLevel; }
+
+    // Pool the row passes are split across; JobSystem::Default() unless overridden.
+    void SetJobSystem(JobSystem* pJobSystem) { _pJobSystem = pJobSystem; }
+
+    // Minimum number of rows per task. 0 picks a size of roughly 16K cells.
+    void SetRowGrainSize(int rows) { _rowGrainSize = rows; }
+
+    // Advances the simulation clock by dt and runs as many fixed time steps as fit,
+    // computing normals once after the last one. Returns the number of steps taken.
+    int Update(float dt);
     void Disturb(int i, int j, float magnitude);
 
+    // Upper bound on the steps a single Update may run; 0 means unbounded. When the
+    // bound is hit the remaining backlog is dropped (the simulation slows down)
+    // instead of making the next frames even more expensive.
+    void SetMaxSubsteps(int maxSubsteps) { _maxSubsteps = maxSubsteps; }
+    int MaxSubsteps()const { return _maxSubsteps; }
+
+    // Fraction of a time step accumulated but not yet simulated, in [0, 1).
+    float InterpolationFactor()const { return _accumulatedTime / _timeStep; }
+
+    // Total number of steps dropped because of the substep bound.
+    long long DroppedSteps()const { return _droppedSteps; }
+
+    // Temporal blocking for grids larger than the caches. When an Update runs two or
+    // more steps, the grid is cut into tiles and each tile, plus a halo of one cell
+    // per step, is copied into a cache-resident scratch buffer and advanced up to
+    // stepsPerBlock steps before it is written back. Halo cells are recomputed by
+    // the neighbouring tiles; results are identical to stepping the whole grid.
+    // stepsPerBlock <= 1 disables blocking (the default).
+    void SetTemporalBlocking(int stepsPerBlock, int tileRows = 128, int tileColumns = 128);
+    int StepsPerBlock()const { return _stepsPerBlock; }
+
+    // Sparse tracking for mostly calm water. The grid is divided into square tiles and
+    // only active tiles, plus the ring of tiles their waves can spread into, are
+    // stepped. A tile retires, snapping back to flat water, once all of its heights are
+    // within epsilon of zero. Takes precedence over temporal blocking.
+    void SetSparseTracking(bool enabled, float epsilon = 1.0e-4f);
+    bool IsSparseTracking()const { return _sparseTracking; }
+    int ActiveTileCount()const;
+
+    struct RowRange
+    {
+        int First{};
+        int Last{};
+    };
+
+    // Rows whose vertices may differ from the previous frame, as sorted, disjoint
+    // [First, Last) ranges: rows stepped or retired by the last Update, plus rows of
+    // active tiles since their interpolated positions move every frame. Always the
+    // whole grid without sparse tracking.
+    std::span<const RowRange> DirtyRowRanges()const { return _dirtyRowRanges; }
+
+    // Side length, in cells, of the tiles used by sparse tracking.
+    static constexpr int ActiveTileSize{ 32 };
+
+private:
+    size_t Index(int row, int column)const { return static_cast<size_t>(row) * _rowPitch + column; }
+
+    void RunSteps(int steps);
+    void StepSimulation();
+    void StepTiled(int steps);
+    void StepTile(int tileIndex, int steps);
+    void StepSparse();
+    void RetireQuiescentTiles();
+    void ComputeNormals();
+    void ComputeNormalsSparse();
+    void ComputeNormalRows(int firstRow, int lastRow, int firstColumn, int lastColumn);
+    void MarkActive(int row, int column);
+    void DilateTiles(const std::vector<std::uint8_t>& tiles, std::vector<std::uint8_t>& dilated)const;
+    void UpdateDirtyRowRanges();
+    size_t RowGrainSize()const;
+
 private:
     int _nrRows{};
     int _nrCols{};
 
+    // Floats between the starts of two consecutive rows in every plane. Rows are
+    // padded so each one starts on a 64-byte boundary.
+    int _rowPitch{};
+
     int _vertexCount{};
     int _triangleCount{};
 
     // Simulation constants we can precompute.
-    float _simConstant1{};
-    float _simConstant2{};
-    float _simConstant3{};
+    WaveKernels::SimConstants _simConstants{};
 
     float _timeStep{};
     float _spatialStep{};
 
-    std::vector<DirectX::XMFLOAT3> _prevSolution;
-    std::vector<DirectX::XMFLOAT3> _currentSolution;
-    std::vector<DirectX::XMFLOAT3> _normals;
-    std::vector<DirectX::XMFLOAT3> _tangentX;
+    // Simulation time received through Update but not yet simulated.
+    float _accumulatedTime{};
+    int _maxSubsteps{};
+    long long _droppedSteps{};
+
+    float _halfWidth{};
+    float _halfDepth{};
+
+    WaveKernels::SimdLevel _simdLevel{ WaveKernels::BestAvailable() };
+    const WaveKernels::KernelTable* _pKernels{};
+
+    JobSystem* _pJobSystem{ &JobSystem::Default() };
+    int _rowGrainSize{};
+
+    // Height field (the y coordinate) of the previous and current solution.
+    AlignedVector<float> _prevHeights;
+    AlignedVector<float> _currHeights;
+
+    // Temporal blocking settings; see SetTemporalBlocking().
+    int _stepsPerBlock{};
+    int _tileRows{};
+    int _tileColumns{};
+
+    // Output planes of a tiled block; swapped with the solution planes afterwards.
+    AlignedVector<float> _blockPrevHeights;
+    AlignedVector<float> _blockCurrHeights;
+
+    // Sparse tracking state, one flag per tile. Inactive tiles hold zero heights in
+    // both solution planes.
+    bool _sparseTracking{};
+    float _quiescenceEpsilon{};
+    int _activeTileRows{};
+    int _activeTileColumns{};
+    std::vector<std::uint8_t> _activeTiles;
+    std::vector<std::uint8_t> _steppedTiles;
+    std::vector<std::uint8_t> _dirtyTiles;
+    std::vector<std::uint8_t> _nonFlatNormalTiles;
+    std::vector<int> _tileList;
+    std::vector<RowRange> _dirtyRowRanges;
+
+    // Normal and tangent components, one plane each; TangentX always has z == 0.
+    AlignedVector<float> _normalX;
+    AlignedVector<float> _normalY;
+    AlignedVector<float> _normalZ;
+    AlignedVector<float> _tangentX;
+    AlignedVector<float> _tangentY;
 };
 
+template<typename TVertex, typename TMakeVertex>
+void Waves::WriteVertices(std::span<TVertex> vertices, TMakeVertex&& makeVertex, float interpolation)const
+{
+    WriteVertexRows(vertices, 0, _nrRows, makeVertex, interpolation);
+}
+
+template<typename TVertex, typename TMakeVertex>
+void Waves::WriteVertexRows(std::span<TVertex> vertices, int firstRow, int lastRow, TMakeVertex&& makeVertex, float interpolation)const
+{
+    assert(firstRow >= 0 and lastRow <= _nrRows);
+    assert(vertices.size() >= static_cast<size_t>(lastRow) * _nrCols);
+
+    _pJobSystem->ParallelFor(firstRow, lastRow, RowGrainSize(), [&](size_t first, size_t last)
+        {
+            TVertex* pVertex = vertices.data() + first * _nrCols;
+            for (size_t i = first; i < last; ++i)
+            {
+                float z = _halfDepth - i * _spatialStep;
+                const float* pHeights = &_currHeights[Index(static_cast<int>(i), 0)];
+                const float* pPrevHeights = &_prevHeights[Index(static_cast<int>(i), 0)];
+
+                if (interpolation >= 1.0f)
+                {
+                    for (int j = 0; j < _nrCols; ++j)
+                        *pVertex++ = makeVertex(DirectX::XMFLOAT3(-_halfWidth + j * _spatialStep, pHeights[j], z));
+                }
+                else
+                {
+                    for (int j = 0; j < _nrCols; ++j)
+                    {
+                        float y = pPrevHeights[j] + interpolation * (pHeights[j] - pPrevHeights[j]);
+                        *pVertex++ = makeVertex(DirectX::XMFLOAT3(-_halfWidth + j * _spatialStep, y, z));
+                    }
+                }
+            }
+        });
+}
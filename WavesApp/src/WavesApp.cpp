@@ -1,10 +1,16 @@
 #include "WavesApp.h"
 
+#include <algorithm>
 #include <array>
+#include <string>
 #include <DirectXColors.h>
 #include <d3dcompiler.h>
 
 #include "GeometryGenerator.h"
+#include "InputLayout.h"
+#include "JobSystem.h"
+#include "MeshBounds.h"
+#include "MeshFile.h"
 #include "MeshGeometry.h"
 
 using namespace DirectX;
@@ -28,6 +34,12 @@ bool WavesApp::Initialize() {
 
 
 	_pWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	// Cap the steps per frame so one long frame (e.g. after dragging
+	// the window) can't make the following frames even longer.
+	_pWaves->SetMaxSubsteps(4);
+	// Only step and upload the parts of the lake that are moving.
+	_pWaves->SetSparseTracking(true);
+	_waveRowsFramesDirty.assign(_pWaves->RowCount(), RenderItem::NrFrameResources);
 
 	BuildRootSignature();
 	BuildShaders();
@@ -68,6 +80,7 @@ void WavesApp::OnResize() {
 void WavesApp::Update(const GameTimer& gt) {
 	OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	CullRenderItems();
 
 	// Cycle through the circular frame resource array.
 	_currentFrameResourceIndex = (_currentFrameResourceIndex + 1) % RenderItem::NrFrameResources;
@@ -128,7 +141,7 @@ void WavesApp::Draw(const GameTimer& /*timer*/) {
 	auto passCB = _pCurrentFrameResource->PassCBuffer->Resource();
 	_pCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
 
-	DrawRenderItems(_pCommandList.Get(), _opaqueRenderItems);
+	DrawRenderItems(_pCommandList.Get(), _drawQueue);
 
 	// Indicate a state transition on the resource usage.
 	auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -193,6 +206,14 @@ void WavesApp::OnMouseMove(WPARAM btnState, int x, int y) {
 	_lastMousePosition.y = y;
 }
 
+std::wstring WavesApp::FrameStatsText() const {
+	return L"   visible: " + std::to_wstring(_cullStatistics.ItemCount) + L"/" + std::to_wstring(_sceneBvh.ItemCount()) +
+		L"   nodes: " + std::to_wstring(_cullStatistics.VisitedNodeCount) +
+		L"   occluded: " + std::to_wstring(_occludedCount) +
+		L"   state changes: " + std::to_wstring(_drawStatistics.StateChanges()) +
+		L" (saved " + std::to_wstring(_drawStatistics.SavedStateChanges) + L")";
+}
+
 void WavesApp::OnKeyboardInput(const GameTimer& gt) {
 	// Check if most significant bit is set
 	if (GetAsyncKeyState(VK_TAB) & 0x8000)
@@ -216,9 +237,59 @@ void WavesApp::UpdateCamera(const GameTimer& gt) {
 	XMStoreFloat4x4(&_view, view);
 }
 
+void WavesApp::CullRenderItems() {
+	// An item whose World changed is dirty for every frame resource until its
+	// constant buffers are rewritten; move its bounds the first time around.
+	for (std::uint32_t i = 0; i < _opaqueRenderItems.size(); ++i) {
+		const RenderItem* pItem = _opaqueRenderItems[i];
+		if (pItem->NrFramesDirty == RenderItem::NrFrameResources) {
+			_worldBoxes[i] = MeshBounds::Transform(pItem->pSubMesh->BoundingBox, pItem->World);
+			_sceneBvh.Update(i, _worldBoxes[i]);
+		}
+	}
+
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&_view), XMLoadFloat4x4(&_projection)));
+	_cullStatistics = _sceneBvh.QueryFrustum(viewProj, _visibleItemIndices);
+
+	_occlusionCuller.BeginFrame(viewProj);
+	_occluderCandidates.clear();
+	for (std::uint32_t i : _visibleItemIndices) {
+		if (_occluderMeshes.contains(_opaqueRenderItems[i]->pSubMesh))
+			_occluderCandidates.push_back(i);
+	}
+	_occlusionCuller.SelectOccluders(_worldBoxes, _occluderCandidates, MaxOccluderCount, _occluderIndices);
+	for (std::uint32_t i : _occluderIndices) {
+		const RenderItem* pItem = _opaqueRenderItems[i];
+		const OccluderMesh& occluder = _occluderMeshes.at(pItem->pSubMesh);
+		_occlusionCuller.RenderOccluder(occluder.Positions, occluder.Indices, pItem->World);
+	}
+	_occlusionCuller.BuildHiZ();
+
+	size_t frustumVisibleCount = _visibleItemIndices.size();
+	std::erase_if(_visibleItemIndices, [this](std::uint32_t i) { return _occlusionCuller.IsOccluded(_worldBoxes[i]); });
+	_occludedCount = (std::uint32_t)(frustumVisibleCount - _visibleItemIndices.size());
+
+	// Every item uses the one opaque pipeline state; opaque draws go front to back.
+	XMMATRIX view = XMLoadFloat4x4(&_view);
+	_drawQueue.Clear();
+	for (std::uint32_t i : _visibleItemIndices) {
+		const RenderItem* pItem = _opaqueRenderItems[i];
+		float viewDepth = XMVectorGetZ(XMVector3Transform(XMLoadFloat3(&_worldBoxes[i].Center), view));
+		std::uint32_t geometry = _geometryIds.at(pItem->pMeshGeometry);
+		std::uint32_t mesh = _subMeshIds.at(pItem->pSubMesh);
+		_drawQueue.Add(DrawQueue::MakeKey(0, geometry, (std::uint32_t)pItem->PrimitiveType, mesh, viewDepth), i);
+	}
+	_drawQueue.Sort();
+}
+
 void WavesApp::UpdateObjectCBs(const GameTimer& gt) {
 	auto currObjectCB = _pCurrentFrameResource->ObjectCBuffer.get();
-	for (auto& pItem : _renderItems) {
+
+	// Every item writes its own constant buffer slot, so items can be updated in parallel.
+	JobSystem::Default().ParallelFor(0, _renderItems.size(), 256, [&](size_t i) {
+		auto& pItem = _renderItems[i];
+
 		// Only update the cbuffer data if the constants have changed.  
 		// This needs to be tracked per frame resource.
 		if (pItem->NrFramesDirty > 0) {
@@ -231,7 +302,7 @@ void WavesApp::UpdateObjectCBs(const GameTimer& gt) {
 
 			pItem->NrFramesDirty--;
 		}
-	}
+	});
 }
 
 void WavesApp::UpdateMainPassCB(const GameTimer& gt) {
@@ -268,10 +339,9 @@ void WavesApp::UpdateMainPassCB(const GameTimer& gt) {
 void WavesApp::UpdateWaves(const GameTimer& gt)
 {
 	// Every quarter second, generate a random wave.
-	static float t_base = 0.0f;
-	if ((_timer.TotalTime() - t_base) >= 0.25f)
+	if ((_timer.TotalTime() - _lastDisturbTime) >= 0.25f)
 	{
-		t_base += 0.25f;
+		_lastDisturbTime += 0.25f;
 
 		int i = MathHelper::Rand(4, _pWaves->RowCount() - 5);
 		int j = MathHelper::Rand(4, _pWaves->ColumnCount() - 5);
@@ -284,16 +354,35 @@ void WavesApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	_pWaves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Every frame resource has its own vertex buffer, so a changed row has to be
+	// written to each of them, like render items with NrFramesDirty.
+	for (const auto& range : _pWaves->DirtyRowRanges())
+		std::fill(_waveRowsFramesDirty.begin() + range.First, _waveRowsFramesDirty.begin() + range.Last, RenderItem::NrFrameResources);
+
+	// Update the wave vertex buffer with the new solution, writing the vertices
+	// straight into the mapped upload memory instead of one CopyData per vertex.
 	auto currWavesVB = _pCurrentFrameResource->WavesVertexBuffer.get();
-	for (int i = 0; i < _pWaves->VertexCount(); ++i)
+	const XMFLOAT4 color(DirectX::Colors::Blue);
+	auto makeVertex = [&color](const XMFLOAT3& position)
+		{
+			return ColorVertexLayout::Pack({ .Position = position, .Color = color });
+		};
+
+	int rowCount = _pWaves->RowCount();
+	for (int first = 0; first < rowCount; )
 	{
-		Vertex v;
+		if (_waveRowsFramesDirty[first] == 0)
+		{
+			++first;
+			continue;
+		}
 
-		v.Pos = _pWaves->Position(i);
-		v.Color = XMFLOAT4(DirectX::Colors::Blue);
+		int last = first;
+		while (last < rowCount and _waveRowsFramesDirty[last] > 0)
+			_waveRowsFramesDirty[last++]--;
 
-		currWavesVB->CopyData(i, v);
+		_pWaves->WriteVertexRows(currWavesVB->Elements(), first, last, makeVertex, _pWaves->InterpolationFactor());
+		first = last;
 	}
 
 	// Set the dynamic VB of the wave renderitem to the current frame VB.
@@ -334,112 +423,89 @@ void WavesApp::BuildShaders() {
 }
 
 void WavesApp::BuildInputLayout() {
-	D3D12_INPUT_ELEMENT_DESC positionDesc{
-		.SemanticName = "Position",
-		.SemanticIndex = 0,
-		.Format = DXGI_FORMAT_R32G32B32_FLOAT,
-		.InputSlot = 0,
-		.AlignedByteOffset = 0,
-		.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-		.InstanceDataStepRate = 0,
-	};
-
-	D3D12_INPUT_ELEMENT_DESC elementDesc{
-	.SemanticName = "Color",
-	.SemanticIndex = 0,
-	.Format = DXGI_FORMAT_R32G32B32A32_FLOAT,
-	.InputSlot = 0,
-	.AlignedByteOffset = 12,
-	.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
-	.InstanceDataStepRate = 0,
-	};
-
-	_inputLayout = { positionDesc , elementDesc };
+	auto inputElements = InputLayout::Elements<ColorVertexLayout>();
+	_inputLayout.assign(inputElements.begin(), inputElements.end());
 }
 
 void WavesApp::BuildLandGeometry()
 {
-	GeometryGenerator geometryGenerator{};
-	GeometryGenerator::MeshData grid = geometryGenerator.CreateGrid(160.0f, 160.0f, 50, 50);
+	// The land only depends on the grid dimensions and the height and color functions
+	// below; bump the version string when those change.
+	struct LandParameters
+	{
+		float Width = 160.0f, Depth = 160.0f;
+		std::uint32_t Rows = 50, Columns = 50;
+	} parameters;
 
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  In addition, color the vertices based on their height so we have
-	// sandy looking beaches, grassy low hills, and snow mountain peaks.
+	std::uint64_t contentHash = MeshFile::ContentHash{}
+		.Add("WavesApp::BuildLandGeometry v1")
+		.Add(parameters)
+		.AddVertexLayout<ColorVertexLayout>()
+		.Value();
 
-	std::vector<Vertex> vertices(grid.Vertices.size());
-	for (size_t i = 0; i < grid.Vertices.size(); ++i)
+	MeshFile::Image image = MeshFile::Image::LoadOrBuild("MeshCache", "landGeo", contentHash, [&]
 	{
-		auto& p = grid.Vertices[i].Position;
-		vertices[i].Pos = p;
-		vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
-
-		// Color the vertex based on its height.
-		if (vertices[i].Pos.y < -10.0f)
-		{
-			// Sandy beach color.
-			vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 5.0f)
-		{
-			// Light yellow-green.
-			vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 12.0f)
-		{
-			// Dark yellow-green.
-			vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
-		}
-		else if (vertices[i].Pos.y < 20.0f)
+		GeometryGenerator geometryGenerator{};
+		GeometryGenerator::MeshData grid = geometryGenerator.CreateGrid(
+			parameters.Width, parameters.Depth, parameters.Rows, parameters.Columns);
+
+		// Extract the vertex elements we are interested and apply the height function to
+		// each vertex.  In addition, color the vertices based on their height so we have
+		// sandy looking beaches, grassy low hills, and snow mountain peaks.
+		auto makeSource = [this](const GeometryGenerator::Vertex& vertex)
 		{
-			// Dark brown.
-			vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
-		}
-		else
-		{
-			// White snow.
-			vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-		}
-	}
-
-	const UINT vertexBufferByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-	std::vector<std::uint16_t> indices = grid.GetIndices16();
-	const UINT indexBufferByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+			VertexSource source{ .Position = vertex.Position };
+			auto& p = source.Position;
+			p.y = GetHillsHeight(p.x, p.z);
+
+			// Color the vertex based on its height.
+			if (p.y < -10.0f)
+			{
+				// Sandy beach color.
+				source.Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
+			}
+			else if (p.y < 5.0f)
+			{
+				// Light yellow-green.
+				source.Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+			}
+			else if (p.y < 12.0f)
+			{
+				// Dark yellow-green.
+				source.Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
+			}
+			else if (p.y < 20.0f)
+			{
+				// Dark brown.
+				source.Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
+			}
+			else
+			{
+				// White snow.
+				source.Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			}
+
+			return source;
+		};
+
+		MeshFile::Contents contents;
+		MeshFile::AppendSubmesh<ColorVertexLayout>(contents, "grid", grid, {}, makeSource);
+		return contents;
+	});
 
 	auto geometry = std::make_unique<MeshGeometry>();
 	geometry->Name = "landGeo";
+	geometry->CreateFromImage(_pDevice.Get(), _pCommandList.Get(), image);
 
-	THROW_IF_FAILED(D3DCreateBlob(vertexBufferByteSize, &geometry->VertexBufferCpu));
-	CopyMemory(geometry->VertexBufferCpu->GetBufferPointer(), vertices.data(), vertexBufferByteSize);
-
-	THROW_IF_FAILED(D3DCreateBlob(indexBufferByteSize, &geometry->IndexBufferCpu));
-	CopyMemory(geometry->IndexBufferCpu->GetBufferPointer(), indices.data(), indexBufferByteSize);
-
-	geometry->VertexBufferGpu = DxUtil::CreateDefaultBuffer(_pDevice.Get(),
-		_pCommandList.Get(), vertices.data(), vertexBufferByteSize, geometry->VertexBufferUploader);
-
-	geometry->IndexBufferGpu = DxUtil::CreateDefaultBuffer(_pDevice.Get(),
-		_pCommandList.Get(), indices.data(), indexBufferByteSize, geometry->IndexBufferUploader);
-
-	geometry->VertexByteStride = sizeof(Vertex);
-	geometry->VertexBufferByteSize = vertexBufferByteSize;
-	geometry->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geometry->IndexBufferByteSize = indexBufferByteSize;
-
-	SubMeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
-
-	geometry->DrawArguments["grid"] = submesh;
+	// The hills hide the water behind them.
+	_occluderMeshes[&geometry->DrawArguments["grid"]] = OccluderMesh::FromImage(image, "grid");
 
 	_geometries["landGeo"] = std::move(geometry);
 }
 
 void WavesApp::BuildWavesGeometryBuffers()
 {
-	std::vector<std::uint16_t> indices(3 * _pWaves->TriangleCount()); // 3 indices per face
-	assert(_pWaves->VertexCount() < 0x0000ffff);
+	std::vector<std::uint32_t> indices(3 * _pWaves->TriangleCount()); // 3 indices per face
 
 	// Iterate over each quad.
 	int m = _pWaves->RowCount();
@@ -462,7 +528,6 @@ void WavesApp::BuildWavesGeometryBuffers()
 	}
 
 	UINT vertexBufferByteSize = _pWaves->VertexCount() * sizeof(Vertex);
-	UINT indexBufferByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geometry = std::make_unique<MeshGeometry>();
 	geometry->Name = "waterGeo";
@@ -471,23 +536,32 @@ void WavesApp::BuildWavesGeometryBuffers()
 	geometry->VertexBufferCpu = nullptr;
 	geometry->VertexBufferGpu = nullptr;
 
-	THROW_IF_FAILED(D3DCreateBlob(indexBufferByteSize, &geometry->IndexBufferCpu));
-	CopyMemory(geometry->IndexBufferCpu->GetBufferPointer(), indices.data(), indexBufferByteSize);
+	// Grids with more than 65536 vertices are drawn in bands of rows that 16-bit
+	// indices can address: "grid", "grid1", "grid2", ...
+	std::vector<SubMeshGeometry> submeshes = geometry->CreateSplitIndexBuffer(_pDevice.Get(), _pCommandList.Get(), indices);
 
-	geometry->IndexBufferGpu = DxUtil::CreateDefaultBuffer(_pDevice.Get(),
-		_pCommandList.Get(), indices.data(), indexBufferByteSize, geometry->IndexBufferUploader);
+	// The surface moves, so the bounds of the flat grid are grown by a generous bound
+	// on how far the disturbances of UpdateWaves raise or lower it.
+	const float waveHeightBound = 2.0f;
+	std::vector<XMFLOAT3> positions(_pWaves->VertexCount());
+	_pWaves->GetPositions(positions.data());
+	for (SubMeshGeometry& submesh : submeshes)
+	{
+		auto partIndices = std::span(indices).subspan(submesh.StartIndexLocation, submesh.IndexCount);
+		UINT vertexCount = *std::max_element(partIndices.begin(), partIndices.end()) - submesh.BaseVertexLocation + 1;
+		MeshBounds::Bounds bounds = MeshBounds::Compute(&positions[submesh.BaseVertexLocation], vertexCount);
+
+		submesh.BoundingBox = bounds.Box;
+		submesh.BoundingBox.Extents.y += waveHeightBound;
+		submesh.BoundingSphere = bounds.Sphere;
+		submesh.BoundingSphere.Radius += waveHeightBound;
+	}
 
 	geometry->VertexByteStride = sizeof(Vertex);
 	geometry->VertexBufferByteSize = vertexBufferByteSize;
-	geometry->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geometry->IndexBufferByteSize = indexBufferByteSize;
-
-	SubMeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
 
-	geometry->DrawArguments["grid"] = submesh;
+	for (size_t i = 0; i < submeshes.size(); ++i)
+		geometry->DrawArguments[i == 0 ? "grid" : "grid" + std::to_string(i)] = submeshes[i];
 
 	_geometries["waterGeo"] = std::move(geometry);
 }
@@ -556,57 +630,101 @@ void WavesApp::BuildFrameResources() {
 
 void WavesApp::BuildRenderItems()
 {
-	auto wavesRitem = std::make_unique<RenderItem>();
-	wavesRitem->World = MathHelper::Identity4x4();
-	wavesRitem->ObjectCBufferIndex = 0;
-	wavesRitem->pMeshGeometry = _geometries["waterGeo"].get();
-	wavesRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	wavesRitem->IndexCount = wavesRitem->pMeshGeometry->DrawArguments["grid"].IndexCount;
-	wavesRitem->StartIndexLocation = wavesRitem->pMeshGeometry->DrawArguments["grid"].StartIndexLocation;
-	wavesRitem->BaseVertexLocation = wavesRitem->pMeshGeometry->DrawArguments["grid"].BaseVertexLocation;
-
-	_pWavesRenderItem = wavesRitem.get();
-	_opaqueRenderItems.push_back(wavesRitem.get());
+	// One render item per part of the water grid; they share the dynamic vertex buffer.
+	MeshGeometry* pWaterGeometry = _geometries["waterGeo"].get();
+	for (size_t part = 0; ; ++part) {
+		auto submesh = pWaterGeometry->DrawArguments.find(part == 0 ? "grid" : "grid" + std::to_string(part));
+		if (submesh == pWaterGeometry->DrawArguments.end())
+			break;
+
+		auto wavesRitem = std::make_unique<RenderItem>();
+		wavesRitem->World = MathHelper::Identity4x4();
+		wavesRitem->ObjectCBufferIndex = (UINT)_renderItems.size();
+		wavesRitem->pMeshGeometry = pWaterGeometry;
+		wavesRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wavesRitem->IndexCount = submesh->second.IndexCount;
+		wavesRitem->StartIndexLocation = submesh->second.StartIndexLocation;
+		wavesRitem->BaseVertexLocation = submesh->second.BaseVertexLocation;
+		wavesRitem->pSubMesh = &submesh->second;
+
+		if (part == 0)
+			_pWavesRenderItem = wavesRitem.get();
+		_opaqueRenderItems.push_back(wavesRitem.get());
+		_renderItems.push_back(std::move(wavesRitem));
+	}
 
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
-	gridRitem->ObjectCBufferIndex = 1;
+	gridRitem->ObjectCBufferIndex = (UINT)_renderItems.size();
 	gridRitem->pMeshGeometry = _geometries["landGeo"].get();
 	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	gridRitem->IndexCount = gridRitem->pMeshGeometry->DrawArguments["grid"].IndexCount;
 	gridRitem->StartIndexLocation = gridRitem->pMeshGeometry->DrawArguments["grid"].StartIndexLocation;
 	gridRitem->BaseVertexLocation = gridRitem->pMeshGeometry->DrawArguments["grid"].BaseVertexLocation;
+	gridRitem->pSubMesh = &gridRitem->pMeshGeometry->DrawArguments["grid"];
 
 	_opaqueRenderItems.push_back(gridRitem.get());
 
-	_renderItems.push_back(std::move(wavesRitem));
 	_renderItems.push_back(std::move(gridRitem));
-}
 
-void WavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
-{
-	UINT objCBByteSize = DxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	// The water's bounds already allow for the wave height, so they never change.
+	_worldBoxes.clear();
+	for (const RenderItem* pItem : _opaqueRenderItems)
+		_worldBoxes.push_back(MeshBounds::Transform(pItem->pSubMesh->BoundingBox, pItem->World));
+	_sceneBvh.Build(_worldBoxes);
 
-	auto objectCB = _pCurrentFrameResource->ObjectCBuffer->Resource();
+	for (const RenderItem* pItem : _opaqueRenderItems) {
+		_geometryIds.try_emplace(pItem->pMeshGeometry, (std::uint32_t)_geometryIds.size());
+		_subMeshIds.try_emplace(pItem->pSubMesh, (std::uint32_t)_subMeshIds.size());
+	}
+}
 
-	// For each render item...
-	for (size_t i = 0; i < ritems.size(); ++i)
+void WavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const DrawQueue& drawQueue)
+{
+	// Binds what DrawQueue::Submit asks for from the render item a packet draws.
+	struct Recorder
 	{
-		auto ri = ritems[i];
+		const std::vector<RenderItem*>& Items;
+		ID3D12GraphicsCommandList* pCommandList;
+		D3D12_GPU_VIRTUAL_ADDRESS ObjectCBAddress;
+		UINT ObjectCBByteSize;
 
-		auto vertexBufferView = ri->pMeshGeometry->VertexBufferView();
-		cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
-		auto indexBufferView = ri->pMeshGeometry->IndexBufferView();
-		cmdList->IASetIndexBuffer(&indexBufferView);
-		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+		// The command list was reset with the pipeline state every item uses.
+		void SetPipelineState(const DrawPacket&) {}
+
+		void SetGeometry(const DrawPacket& packet)
+		{
+			const MeshGeometry* pGeometry = Items[packet.Item]->pMeshGeometry;
+			auto vertexBufferView = pGeometry->VertexBufferView();
+			pCommandList->IASetVertexBuffers(0, 1, &vertexBufferView);
+			auto indexBufferView = pGeometry->IndexBufferView();
+			pCommandList->IASetIndexBuffer(&indexBufferView);
+		}
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress();
-		objCBAddress += ri->ObjectCBufferIndex * objCBByteSize;
+		void SetPrimitiveTopology(const DrawPacket& packet)
+		{
+			pCommandList->IASetPrimitiveTopology(Items[packet.Item]->PrimitiveType);
+		}
 
-		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+		// No two items share a submesh here, so there is nothing to instance.
+		void Draw(std::span<const DrawPacket> packets)
+		{
+			for (const DrawPacket& packet : packets)
+			{
+				const RenderItem* ri = Items[packet.Item];
+				pCommandList->SetGraphicsRootConstantBufferView(0, ObjectCBAddress + ri->ObjectCBufferIndex * ObjectCBByteSize);
+				pCommandList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+			}
+		}
+	};
 
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
-	}
+	Recorder recorder{
+		_opaqueRenderItems,
+		cmdList,
+		_pCurrentFrameResource->ObjectCBuffer->Resource()->GetGPUVirtualAddress(),
+		DxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants)),
+	};
+	_drawStatistics = drawQueue.Submit(recorder);
 }
 
 float WavesApp::GetHillsHeight(float x, float z)const
@@ -5,11 +5,14 @@
 
 #include "RenderItem.h"
 #include "FrameResource.h"
+#include "DrawQueue.h"
 #include "DxUtil.h"
 #include "App.h"
 #include "UploadBuffer.h"
 #include "MathHelper.h"
 #include "MeshGeometry.h"
+#include "OcclusionCuller.h"
+#include "SceneBvh.h"
 #include "Waves.h"
 
 class WavesApp final : public App
@@ -29,8 +32,11 @@ private:
 	virtual void OnMouseUp(WPARAM btnState, int x, int y) override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y) override;
 
+	virtual std::wstring FrameStatsText() const override;
+
 	void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void CullRenderItems();
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
@@ -44,7 +50,7 @@ private:
 	void BuildFrameResources();
 	void BuildRenderItems();
 
-	void DrawRenderItems(ID3D12GraphicsCommandList* commandList, const std::vector<RenderItem*>& renderItems);
+	void DrawRenderItems(ID3D12GraphicsCommandList* commandList, const DrawQueue& drawQueue);
 
 	float GetHillsHeight(float x, float z) const;
 	DirectX::XMFLOAT3 GetHillsNormal(float x, float z) const;
@@ -67,10 +73,36 @@ private:
 
 	std::unique_ptr<Waves> _pWaves;
 	RenderItem* _pWavesRenderItem{};
+	float _lastDisturbTime{};
+	// Per wave row, the number of frame resources whose vertex buffer is out of date.
+	std::vector<int> _waveRowsFramesDirty{};
 
 	std::vector<std::unique_ptr<RenderItem>> _renderItems{};
 	std::vector<RenderItem*> _opaqueRenderItems{};
 
+	// World space bounds of the opaque render items, by index, and those of them in
+	// the view frustum and not occluded this frame.
+	std::vector<DirectX::BoundingBox> _worldBoxes{};
+	SceneBvh _sceneBvh{};
+	SceneBvh::QueryStatistics _cullStatistics{};
+	std::vector<std::uint32_t> _visibleItemIndices{};
+
+	// The visible items as draw packets sorted by state, the geometry and mesh ids their
+	// keys use, and the state changes the last submission made.
+	DrawQueue _drawQueue{};
+	std::unordered_map<const MeshGeometry*, std::uint32_t> _geometryIds{};
+	std::unordered_map<const SubMeshGeometry*, std::uint32_t> _subMeshIds{};
+	DrawQueue::Statistics _drawStatistics{};
+
+	// Occluder triangles by submesh. The largest items in view that have them are
+	// drawn into the occlusion culler every frame.
+	static constexpr std::uint32_t MaxOccluderCount{ 8 };
+	std::unordered_map<const SubMeshGeometry*, OccluderMesh> _occluderMeshes{};
+	OcclusionCuller _occlusionCuller{};
+	std::vector<std::uint32_t> _occluderCandidates{};
+	std::vector<std::uint32_t> _occluderIndices{};
+	std::uint32_t _occludedCount{};
+
 	PassConstants _mainPassCB{};
 	bool _isWireframe{ false };
 